@@ -0,0 +1,58 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/ABuffer.glsl"
+#include "../include/ABufferDeferred.glsl"
+#include "../include/ABufferTiles.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (location = 2) flat in uint IN_MATERIAL;
+
+layout (set = 0, binding = 3, r32ui) uniform uimage2D LIST_HEAD_TEX;
+layout (set = 0, binding = 4, std430) buffer FragmentListBuffer
+{
+  uint fragmentsCounter;
+  uint capacity;
+  DeferredFragment entries[];
+} gList;
+
+// set for every 8x8 tile that gets a fragment, the resolve only runs over flagged tiles
+layout (set = 0, binding = 9, std430) buffer TileFlags
+{
+  uint tileFlags[];
+};
+
+void mark_tile()
+{
+  uint tile = abuffer_tile_id(ivec2(gl_FragCoord.xy), ivec2(gFrame.viewport.xy));
+  if (tileFlags[tile] == 0)
+    tileFlags[tile] = 1;
+}
+
+// no texture is sampled here, the resolve shades the nearest fragments only
+void main()
+{
+  // the resolve has no derivatives, it derives the mip level from the UV footprint and the texture size
+  vec2 uvDx = dFdx(IN_UV);
+  vec2 uvDy = dFdy(IN_UV);
+  float footprint = 0.5 * log2(max(max(dot(uvDx, uvDx), dot(uvDy, uvDy)), 1e-20));
+
+  DeferredFragment entry;
+  entry.depth = gl_FragCoord.z;
+  entry.uv = IN_UV;
+  entry.normal = pack_normal(normalize(IN_NORM));
+  entry.material = (IN_MATERIAL & 0xffffu) | (packHalf2x16(vec2(footprint, 0)) << 16);
+
+  uint fragmentId = atomicAdd(gList.fragmentsCounter, 1);
+
+  // the counter keeps counting, the renderer reads it back and grows the list for the next frames
+  if (fragmentId >= gList.capacity)
+    return;
+
+  mark_tile();
+
+  entry.next = imageAtomicExchange(LIST_HEAD_TEX, ivec2(gl_FragCoord.xy), fragmentId);
+  gList.entries[fragmentId] = entry;
+}
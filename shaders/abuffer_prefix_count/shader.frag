@@ -0,0 +1,33 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/ABufferTiles.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (set = 0, binding = 3, std430) buffer CountBuffer
+{
+  uint counts[];
+};
+
+// set for every 8x8 tile that gets a fragment, resolve and composite only run over flagged tiles
+layout (set = 0, binding = 9, std430) buffer TileFlags
+{
+  uint tileFlags[];
+};
+
+void mark_tile()
+{
+  uint tile = abuffer_tile_id(ivec2(gl_FragCoord.xy), ivec2(gFrame.viewport.xy));
+  if (tileFlags[tile] == 0)
+    tileFlags[tile] = 1;
+}
+
+// every fragment passing the depth test is stored by the store pass, so none is skipped here
+void main()
+{
+  uint pixel = uint(gl_FragCoord.y) * uint(gFrame.viewport.x) + uint(gl_FragCoord.x);
+  atomicAdd(counts[pixel], 1);
+  mark_tile();
+}
@@ -0,0 +1,34 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/ABuffer.glsl"
+
+layout(early_fragment_tests) in;
+
+// first fragment of every pixel, advanced past the stored ones
+layout (set = 0, binding = 3, std430) buffer OffsetBuffer
+{
+  uint offsets[];
+};
+
+layout (set = 0, binding = 4, std430) buffer FragmentListBuffer
+{
+  uint fragmentsCounter;
+  uint capacity;
+  PackedFragment entries[];
+} gList;
+
+void main()
+{
+  vec4 outColor = shade_transparent();
+
+  uint pixel = uint(gl_FragCoord.y) * uint(gFrame.viewport.x) + uint(gl_FragCoord.x);
+  uint fragmentId = atomicAdd(offsets[pixel], 1);
+
+  // fragments past capacity are counted by the scan, the renderer reads it back and grows the buffer
+  if (fragmentId >= gList.capacity)
+    return;
+
+  gList.entries[fragmentId] = PackedFragment(gl_FragCoord.z, packUnorm4x8(outColor));
+}
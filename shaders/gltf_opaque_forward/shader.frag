@@ -4,6 +4,7 @@
 #include "../include/GLTFMaterial.glsl"
 #include "../include/coords.glsl"
 #include "../include/BRDF.glsl"
+#include "../include/VT.glsl"
 
 layout(early_fragment_tests) in;
 
@@ -25,6 +26,34 @@ layout (push_constant) uniform PushData
 layout (set = 0, binding = 1) uniform sampler2D BASE_COLOR_TEX;
 layout (set = 0, binding = 2) uniform sampler2D METALLIC_ROUGHNESS_TEX;
 
+layout (set = 0, binding = 5) uniform sampler2D BASE_COLOR_PAGES;
+layout (set = 0, binding = 6) uniform usampler2D BASE_COLOR_PAGE_TABLE;
+layout (set = 0, binding = 7) uniform sampler2D METALLIC_ROUGHNESS_PAGES;
+layout (set = 0, binding = 8) uniform usampler2D METALLIC_ROUGHNESS_PAGE_TABLE;
+
+// virtual textures fall back to the resident mip tail of the regular texture until their pages arrive
+vec4 sample_base_color(vec2 uv)
+{
+  vec2 uvDx = dFdx(uv);
+  vec2 uvDy = dFdy(uv);
+  bool valid = false;
+  vec4 s = vec4(0);
+  if (vt_enabled(pc.vtBaseColor))
+    s = vt_sample(BASE_COLOR_PAGES, BASE_COLOR_PAGE_TABLE, pc.vtBaseColor, uv, uvDx, uvDy, valid);
+  return valid ? s : textureGrad(BASE_COLOR_TEX, uv, uvDx, uvDy);
+}
+
+vec4 sample_metallic_roughness(vec2 uv)
+{
+  vec2 uvDx = dFdx(uv);
+  vec2 uvDy = dFdy(uv);
+  bool valid = false;
+  vec4 s = vec4(0);
+  if (vt_enabled(pc.vtMetallicRoughness))
+    s = vt_sample(METALLIC_ROUGHNESS_PAGES, METALLIC_ROUGHNESS_PAGE_TABLE, pc.vtMetallicRoughness, uv, uvDx, uvDy, valid);
+  return valid ? s : textureGrad(METALLIC_ROUGHNESS_TEX, uv, uvDx, uvDy);
+}
+
 layout (location = 0) out vec4 OUT_COLOR;
 layout (location = 1) out vec2 OUT_VELOCITY;
 
@@ -36,16 +65,17 @@ void main()
 
   if ((renderFlags & RF_NO_METALLIC_ROUGHNESS_TEX) == 0)
   {
-    vec4 m = texture(METALLIC_ROUGHNESS_TEX, IN_UV);
-    metallic = m.b; //!!!!!
-    roughness = m.g;
+    vec4 m = sample_metallic_roughness(IN_UV);
+    vec2 rm = (renderFlags & RF_PACKED_METALLIC_ROUGHNESS) != 0 ? m.rg : m.gb;
+    metallic = rm.y;
+    roughness = rm.x;
   }
 
   vec3 baseColor = pc.baseColorFactor.rgb;
 
   if ((renderFlags & RF_NO_BASECOLOR_TEX) == 0)
   {
-    baseColor = texture(BASE_COLOR_TEX, IN_UV).rgb;
+    baseColor = sample_base_color(IN_UV).rgb;
   }
 
   vec3 N = normalize(IN_NORM);
@@ -10,4 +10,14 @@ struct FragmentEntry
   uint next;
 };
 
+// prefix sum layout, fragments of a pixel are contiguous
+struct PackedFragment
+{
+  float depth;
+  uint packedColor;
+};
+
+#define ABUFFER_SCAN_THREADS 256
+#define ABUFFER_SCAN_BLOCK_SIZE 1024 // elements scanned by a workgroup, ABUFFER_SCAN_BLOCK_SIZE in TransparencyRenderer.hpp
+
 #endif
\ No newline at end of file
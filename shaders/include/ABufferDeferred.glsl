@@ -0,0 +1,38 @@
+#ifndef ABUFFER_DEFERRED_GLSL_INCLUDED
+#define ABUFFER_DEFERRED_GLSL_INCLUDED
+
+// Deferred A-buffer, fragments keep surface attributes and are shaded in the resolve
+
+#define ABUFFER_DEFERRED_LAYERS 8 // fragments shaded per pixel, ABUFFER_DEFERRED_LAYERS in TransparencyRenderer.hpp
+
+struct DeferredFragment
+{
+  float depth;
+  uint next;
+  vec2 uv;
+  uint normal; // view space, octahedral
+  uint material; // material group index in the low half, log2 of the UV footprint as half float in the high one
+};
+
+vec2 oct_wrap(vec2 v)
+{
+  return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+uint pack_normal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.z >= 0.0 ? n.xy : oct_wrap(n.xy);
+  return packSnorm2x16(e);
+}
+
+vec3 unpack_normal(uint packed)
+{
+  vec2 e = unpackSnorm2x16(packed);
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0)
+    n.xy = oct_wrap(n.xy);
+  return normalize(n);
+}
+
+#endif
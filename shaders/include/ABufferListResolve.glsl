@@ -0,0 +1,48 @@
+#ifndef ABUFFER_LIST_RESOLVE_GLSL_INCLUDED
+#define ABUFFER_LIST_RESOLVE_GLSL_INCLUDED
+
+// Resolve kernel of the linked list A-buffer, abuffer_resolve_k* specialize it for ABUFFER_RESOLVE_LAYERS.
+// Dispatched indirectly with a workgroup per listed tile, pixels of other tiles are not written.
+
+#include "ABufferResolve.glsl"
+#include "ABufferTiles.glsl"
+
+#define COLOR_TARGET_BINDING 2
+#include "Composite.glsl"
+
+layout (set = 0, binding = 0, r32ui) uniform readonly uimage2D LIST_HEAD_TEX; 
+
+layout (set = 0, binding = 1, std430) readonly buffer FragmentListBuffer
+{
+  uint fragmentsCounter;
+  uint capacity;
+  FragmentEntry entries[];
+} gList;
+
+layout (set = 0, binding = 3, std430) readonly buffer TileList
+{
+  uint tiles[];
+};
+
+layout (local_size_x = ABUFFER_TILE_SIZE, local_size_y = ABUFFER_TILE_SIZE) in;
+void main()
+{
+  ivec2 resolution = imageSize(COLOR_TARGET);
+  ivec2 pixelPos = abuffer_tile_origin(tiles[gl_WorkGroupID.x], resolution) + ivec2(gl_LocalInvocationID.xy);
+  if (any(greaterThanEqual(pixelPos, resolution)))
+    return;
+
+  resolve_begin();
+
+  uint head = imageLoad(LIST_HEAD_TEX, pixelPos).x;
+  while (head != ABUFFER_LIST_END)
+  {
+    FragmentEntry entry = gList.entries[head];
+    resolve_insert(PackedFragment(entry.depth, entry.packedColor));
+    head = entry.next;
+  }
+
+  composite_over(pixelPos, resolve_composite());
+}
+
+#endif
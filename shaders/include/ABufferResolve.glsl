@@ -0,0 +1,67 @@
+#ifndef ABUFFER_RESOLVE_GLSL_INCLUDED
+#define ABUFFER_RESOLVE_GLSL_INCLUDED
+
+// The nearest ABUFFER_RESOLVE_LAYERS fragments of a pixel are kept sorted in registers, farther ones are
+// merged into a tail that is composited behind them as a single weighted average layer.
+// ABUFFER_RESOLVE_LAYERS has to be defined by the including shader.
+
+#include "ABuffer.glsl"
+
+PackedFragment resolveLayers[ABUFFER_RESOLVE_LAYERS];
+uint resolveCount;
+vec4 tailAccum; // premultiplied color and alpha sums
+float tailRevealage;
+
+void resolve_begin()
+{
+  resolveCount = 0;
+  tailAccum = vec4(0);
+  tailRevealage = 1.0;
+}
+
+void resolve_tail(PackedFragment fragment)
+{
+  vec4 c = unpackUnorm4x8(fragment.packedColor);
+  tailAccum += vec4(c.rgb * c.a, c.a);
+  tailRevealage *= 1.0 - c.a;
+}
+
+void resolve_insert(PackedFragment fragment)
+{
+  if (resolveCount == ABUFFER_RESOLVE_LAYERS)
+  {
+    if (fragment.depth >= resolveLayers[ABUFFER_RESOLVE_LAYERS - 1].depth)
+    {
+      resolve_tail(fragment);
+      return;
+    }
+    resolve_tail(resolveLayers[ABUFFER_RESOLVE_LAYERS - 1]);
+  }
+
+  uint i = min(resolveCount, ABUFFER_RESOLVE_LAYERS - 1);
+  for (; i > 0 && resolveLayers[i - 1].depth > fragment.depth; i--)
+    resolveLayers[i] = resolveLayers[i - 1];
+  resolveLayers[i] = fragment;
+  resolveCount = min(resolveCount + 1, ABUFFER_RESOLVE_LAYERS);
+}
+
+// premultiplied color and coverage, front to back over the layers and the tail behind them
+vec4 resolve_composite()
+{
+  vec3 color = vec3(0);
+  float alpha = 0.0;
+  for (uint i = 0; i < resolveCount; i++)
+  {
+    vec4 c = unpackUnorm4x8(resolveLayers[i].packedColor);
+    color += (1.0 - alpha) * c.rgb * c.a;
+    alpha += (1.0 - alpha) * c.a;
+  }
+
+  float tailAlpha = 1.0 - tailRevealage;
+  color += (1.0 - alpha) * tailAccum.rgb / max(tailAccum.a, 1e-5) * tailAlpha;
+  alpha += (1.0 - alpha) * tailAlpha;
+
+  return vec4(color, alpha);
+}
+
+#endif
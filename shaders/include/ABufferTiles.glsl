@@ -0,0 +1,24 @@
+#ifndef ABUFFER_TILES_GLSL_INCLUDED
+#define ABUFFER_TILES_GLSL_INCLUDED
+
+// Screen tiles touched by transparent fragments, see TileClassifier in ABufferRenderer.hpp
+
+#define ABUFFER_TILE_SIZE 8 // ABUFFER_TILE_SIZE in ABufferRenderer.hpp
+
+uint abuffer_tiles_x(ivec2 resolution)
+{
+  return uint(resolution.x + ABUFFER_TILE_SIZE - 1) / ABUFFER_TILE_SIZE;
+}
+
+uint abuffer_tile_id(ivec2 pixel, ivec2 resolution)
+{
+  return uint(pixel.y / ABUFFER_TILE_SIZE) * abuffer_tiles_x(resolution) + uint(pixel.x / ABUFFER_TILE_SIZE);
+}
+
+ivec2 abuffer_tile_origin(uint tile, ivec2 resolution)
+{
+  uint tilesX = abuffer_tiles_x(resolution);
+  return ivec2(tile % tilesX, tile / tilesX) * ABUFFER_TILE_SIZE;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef COMPOSITE_GLSL_INCLUDED
+#define COMPOSITE_GLSL_INCLUDED
+
+// Transparency resolves composite in place over the HDR color target, bound at COLOR_TARGET_BINDING.
+// Every pixel is read and written by a single invocation, so no synchronization is needed.
+
+#ifndef COLOR_TARGET_BINDING
+#error "COLOR_TARGET_BINDING is not defined"
+#endif
+
+layout (set = 0, binding = COLOR_TARGET_BINDING, rgba16f) uniform image2D COLOR_TARGET;
+
+// Premultiplied color and coverage over the color target, pixels without transparency are not touched.
+// Coverage accumulates in alpha, so compositing into a target cleared to zero stores premultiplied layers.
+void composite_over(ivec2 pixel, vec4 premultiplied)
+{
+  if (premultiplied.a <= 0.0 && all(equal(premultiplied.rgb, vec3(0))))
+    return;
+
+  vec4 dst = imageLoad(COLOR_TARGET, pixel);
+  imageStore(COLOR_TARGET, pixel, premultiplied + (1.0 - premultiplied.a) * dst);
+}
+
+#endif
@@ -8,6 +8,8 @@ struct PushConstMaterial
   mat4 normalTransform;
   vec4 baseColorFactor;
   vec4 metallic_roughness_alphaCutoff_flags;
+  uvec4 vtBaseColor; // virtual texture parameters, see VT.glsl
+  uvec4 vtMetallicRoughness;
 };
 
 struct GlobalFrameParams
@@ -25,6 +27,7 @@ struct GlobalFrameParams
 
 #define RF_NO_BASECOLOR_TEX 1u
 #define RF_NO_METALLIC_ROUGHNESS_TEX 2u
+#define RF_PACKED_METALLIC_ROUGHNESS 4u // roughness in R, metallic in G
 
 float get_metallic(in PushConstMaterial mat)
 {
@@ -0,0 +1,17 @@
+#ifndef MATERIAL_TABLE_GLSL_INCLUDED
+#define MATERIAL_TABLE_GLSL_INCLUDED
+
+// Parameters of all Blend material groups in one buffer, for passes that shade several groups without
+// per group bindings, see MaterialTable in TransparencyRenderer.hpp. Base color and metallic-roughness
+// textures of group i are bound as elements 2 * i and 2 * i + 1 of one sampler array.
+
+#define MATERIAL_TABLE_TEXTURED_GROUPS 32 // groups with textures, MATERIAL_TABLE_TEXTURED_GROUPS in TransparencyRenderer.hpp
+
+// packed like PushConstMaterial
+struct MaterialTableEntry
+{
+  vec4 baseColorFactor;
+  vec4 metallic_roughness_alphaCutoff_flags;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef OIT_GLSL_INCLUDED
+#define OIT_GLSL_INCLUDED
+
+// Order independent transparency techniques next to the A-buffer, see TransparencyRenderer.hpp
+
+#include "coords.glsl"
+
+#define OIT_K 8 // layers of the k-buffer, KBUFFER_LAYERS in TransparencyRenderer.hpp
+#define OIT_KBUFFER_EMPTY 0xffffffffu
+#define OIT_MIN_ALPHA (1.0 / 255.0) // fragments below are skipped, they would take k-buffer layers
+
+#define OIT_MOMENT_BIAS 5e-5 // for 32 bit float moments
+#define OIT_MOMENT_OVERESTIMATION 0.25
+
+float oit_view_depth(float depth, vec4 projection_params)
+{
+  return -linearize_depth(depth, projection_params.z, projection_params.w);
+}
+
+// weighted blended OIT, McGuire and Bavoil 2013, weight function (10)
+float oit_weight(float view_depth, float alpha)
+{
+  float z5 = view_depth / 5.0;
+  float z200 = view_depth / 200.0;
+  return alpha * clamp(10.0 / (1e-5 + z5 * z5 + z200 * z200 * z200 * z200 * z200 * z200), 1e-2, 3e3);
+}
+
+// logarithmic depth in [-1, 1], moments are computed from it
+float oit_warp_depth(float view_depth, vec4 projection_params)
+{
+  float znear = projection_params.z;
+  float zfar = projection_params.w;
+  return clamp(log(view_depth / znear) / log(zfar / znear), 0.0, 1.0) * 2.0 - 1.0;
+}
+
+// moment-based OIT, Muenstermann et al. 2018, four power moments weighted by absorbance
+void oit_generate_moments(float warped_depth, float alpha, out float b0, out vec4 b)
+{
+  float absorbance = -log(1.0 - clamp(alpha, 0.0, 0.9999));
+  float z2 = warped_depth * warped_depth;
+  b0 = absorbance;
+  b = vec4(warped_depth, z2, z2 * warped_depth, z2 * z2) * absorbance;
+}
+
+// transmittance in front of warped_depth reconstructed from the summed moments
+float oit_transmittance(float b0, vec4 moments, float warped_depth)
+{
+  if (b0 < 1e-5)
+    return 1.0;
+
+  vec4 b = mix(moments / b0, vec4(0.0, 0.375, 0.0, 0.375), OIT_MOMENT_BIAS);
+
+  // Cholesky factorization of the Hankel matrix
+  float L21D11 = b.z - b.x * b.y;
+  float D11 = b.y - b.x * b.x;
+  float invD11 = 1.0 / D11;
+  float L21 = L21D11 * invD11;
+  float D22 = (b.w - b.y * b.y) - L21D11 * L21;
+
+  // solve for the polynomial with roots at the support points of the distribution
+  vec3 c = vec3(1.0, warped_depth, warped_depth * warped_depth);
+  c.y -= b.x;
+  c.z -= b.y + L21 * c.y;
+  c.y *= invD11;
+  c.z /= D22;
+  c.y -= L21 * c.z;
+  c.x -= dot(c.yz, b.xy);
+
+  float p = c.y / c.z;
+  float q = c.x / c.z;
+  float r = sqrt(max(p * p * 0.25 - q, 0.0));
+  vec3 z = vec3(warped_depth, -p * 0.5 - r, -p * 0.5 + r);
+
+  // absorbance in front of warped_depth, interpolated through the support points
+  vec3 f = vec3(OIT_MOMENT_OVERESTIMATION, z.y < z.x ? 1.0 : 0.0, z.z < z.x ? 1.0 : 0.0);
+  float f01 = (f.y - f.x) / (z.y - z.x);
+  float f12 = (f.z - f.y) / (z.z - z.y);
+  float f012 = (f12 - f01) / (z.z - z.x);
+
+  vec3 polynomial;
+  polynomial.x = f01 - f012 * z.y;
+  polynomial.z = f012;
+  polynomial.y = polynomial.x - f012 * z.x;
+  polynomial.x = f.x - polynomial.x * z.x;
+
+  float absorbance = polynomial.x + dot(b.xy, polynomial.yz);
+  return clamp(exp(-b0 * absorbance), 0.0, 1.0);
+}
+
+#endif
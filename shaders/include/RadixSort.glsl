@@ -0,0 +1,56 @@
+#ifndef RADIX_SORT_GLSL_INCLUDED
+#define RADIX_SORT_GLSL_INCLUDED
+
+// Least significant digit radix sort of key/value pairs, see RadixSort.hpp. Keys are one or two uints,
+// 64-bit keys are stored as the low word followed by the high one.
+
+#define RADIX_SORT_BITS 4 // per pass, RADIX_SORT_BITS in RadixSort.hpp
+#define RADIX_SORT_BINS 16
+#define RADIX_SORT_THREADS 256
+#define RADIX_SORT_BLOCK_SIZE 1024 // pairs of a workgroup, RADIX_SORT_BLOCK_SIZE in RadixSort.hpp
+
+layout (push_constant) uniform PushData
+{
+  uint count; // of pairs
+  uint shift; // of the digit in the key, in bits
+  uint keyWords;
+  uint pass; // of the histogram scan
+};
+
+uint radix_sort_blocks()
+{
+  return (count + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+}
+
+// digit of the pass, word is the key word holding it
+uint radix_sort_digit(uint word)
+{
+  return (word >> (shift & 31u)) & (RADIX_SORT_BINS - 1);
+}
+
+shared uint radixSortSums[RADIX_SORT_THREADS];
+
+uint workgroup_exclusive_scan(uint value, out uint total)
+{
+  uint tid = gl_LocalInvocationID.x;
+  radixSortSums[tid] = value;
+  barrier();
+
+  for (uint offset = 1; offset < RADIX_SORT_THREADS; offset <<= 1)
+  {
+    uint add = tid >= offset ? radixSortSums[tid - offset] : 0;
+    barrier();
+    radixSortSums[tid] += add;
+    barrier();
+  }
+
+  uint result = radixSortSums[tid] - value;
+  total = radixSortSums[RADIX_SORT_THREADS - 1];
+  barrier(); // the sums are reused by the next scan
+  return result;
+}
+
+// Histograms are stored digit major, HISTOGRAMS[digit * blocks + block], so their exclusive scan is the
+// first output position of every digit of every block.
+
+#endif
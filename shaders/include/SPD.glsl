@@ -0,0 +1,145 @@
+#ifndef SPD_GLSL_INCLUDED
+#define SPD_GLSL_INCLUDED
+
+// Single pass downsampler. Every workgroup reduces a 64x64 tile of mip 0 to mips 1..6 in shared
+// memory, the last workgroup to finish (global atomic counter) reduces mip 6 to the tail of the chain.
+// Includer defines SPD_IMAGE_FORMAT before including this file.
+
+#define SPD_MAX_MIPS 13
+#define SPD_TILE 64
+
+#define SPD_FILTER_BOX 0
+#define SPD_FILTER_BOX_SRGB 1
+#define SPD_FILTER_MIN 2
+#define SPD_FILTER_MAX 3
+
+layout (push_constant) uniform PushData
+{
+  uint mipsCount;
+  uint filterMode;
+  uint groupsCount;
+};
+
+// unused slots past mipsCount alias the last mip and are never accessed
+layout (set = 0, binding = 0, SPD_IMAGE_FORMAT) uniform coherent image2D MIPS[SPD_MAX_MIPS];
+
+layout (set = 0, binding = 1, std430) buffer SPDCounter
+{
+  uint finishedGroups;
+};
+
+shared vec4 sTile[SPD_TILE/2 * SPD_TILE/2];
+shared bool sLastGroup;
+
+vec3 srgb_to_linear(vec3 c)
+{
+  return mix(c / 12.92, pow((c + 0.055) / 1.055, vec3(2.4)), greaterThan(c, vec3(0.04045)));
+}
+
+vec3 linear_to_srgb(vec3 c)
+{
+  return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, greaterThan(c, vec3(0.0031308)));
+}
+
+vec4 spd_load(uint mip, ivec2 pos)
+{
+  ivec2 size = imageSize(MIPS[mip]);
+  vec4 v = imageLoad(MIPS[mip], clamp(pos, ivec2(0), size - 1));
+  if (filterMode == SPD_FILTER_BOX_SRGB)
+    v.rgb = srgb_to_linear(v.rgb);
+  return v;
+}
+
+void spd_store(uint mip, ivec2 pos, vec4 v)
+{
+  if (any(greaterThanEqual(pos, imageSize(MIPS[mip]))))
+    return;
+  if (filterMode == SPD_FILTER_BOX_SRGB)
+    v.rgb = linear_to_srgb(v.rgb);
+  imageStore(MIPS[mip], pos, v);
+}
+
+vec4 spd_reduce(vec4 v0, vec4 v1, vec4 v2, vec4 v3)
+{
+  if (filterMode == SPD_FILTER_MIN)
+    return min(min(v0, v1), min(v2, v3));
+  if (filterMode == SPD_FILTER_MAX)
+    return max(max(v0, v1), max(v2, v3));
+  return (v0 + v1 + v2 + v3) * 0.25;
+}
+
+// Reduces the 64x64 region of src_mip at src_origin into src_mip + 1..src_mip + 6
+void spd_downsample_tile(uint src_mip, ivec2 src_origin)
+{
+  uint tid = gl_LocalInvocationIndex;
+  const uint halfTile = SPD_TILE / 2;
+
+  // first level straight from the image, 4 texels per thread
+  for (uint i = tid; i < halfTile * halfTile; i += gl_WorkGroupSize.x)
+  {
+    ivec2 p = ivec2(i % halfTile, i / halfTile);
+    ivec2 s = src_origin + 2 * p;
+    vec4 v = spd_reduce(
+      spd_load(src_mip, s), 
+      spd_load(src_mip, s + ivec2(1, 0)),
+      spd_load(src_mip, s + ivec2(0, 1)),
+      spd_load(src_mip, s + ivec2(1, 1)));
+
+    sTile[i] = v;
+    spd_store(src_mip + 1, src_origin / 2 + p, v);
+  }
+  barrier();
+
+  // the rest from shared memory, the tile is reduced in place
+  for (uint level = 2; level <= 6 && src_mip + level < mipsCount; level++)
+  {
+    uint size = SPD_TILE >> level;
+    uint srcSize = size * 2;
+    bool active = tid < size * size;
+    ivec2 p = ivec2(tid % size, tid / size);
+    vec4 v = vec4(0);
+
+    if (active)
+    {
+      uint s = 2 * p.y * srcSize + 2 * p.x;
+      v = spd_reduce(sTile[s], sTile[s + 1], sTile[s + srcSize], sTile[s + srcSize + 1]);
+    }
+    barrier();
+
+    if (active)
+    {
+      sTile[tid] = v;
+      spd_store(src_mip + level, (src_origin >> level) + p, v);
+    }
+    barrier();
+  }
+}
+
+void spd_main()
+{
+  ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * SPD_TILE;
+  spd_downsample_tile(0, tileOrigin);
+
+  if (mipsCount <= 7)
+    return;
+
+  // publish mip 6 of this tile before signaling
+  memoryBarrierImage();
+  barrier();
+
+  if (gl_LocalInvocationIndex == 0)
+    sLastGroup = atomicAdd(finishedGroups, 1) == groupsCount - 1;
+  barrier();
+
+  if (!sLastGroup)
+    return;
+
+  memoryBarrierImage();
+  spd_downsample_tile(6, ivec2(0));
+
+  // ready for the next dispatch
+  if (gl_LocalInvocationIndex == 0)
+    finishedGroups = 0;
+}
+
+#endif
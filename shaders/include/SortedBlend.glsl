@@ -0,0 +1,27 @@
+#ifndef SORTED_BLEND_GLSL_INCLUDED
+#define SORTED_BLEND_GLSL_INCLUDED
+
+// Blend instances drawn in back to front order, see SortedInstanceRenderer in TransparencyRenderer.hpp
+
+struct BlendInstance
+{
+  mat4 model;
+  mat4 normalTransform; // to view space
+  vec4 center; // of the object space bounds
+  uint firstIndex;
+  uint indexCount;
+  int vertexOffset;
+  uint materialGroup;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawIndexedCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+#endif
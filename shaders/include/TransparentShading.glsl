@@ -0,0 +1,113 @@
+#ifndef TRANSPARENT_SHADING_GLSL_INCLUDED
+#define TRANSPARENT_SHADING_GLSL_INCLUDED
+
+// Material inputs and forward shading of Blend geometry, shared by the transparency techniques.
+// Bindings 0-2 and 5-8 of set 0 are taken, see draw_transparent in ABufferRenderer.hpp.
+
+#include "GLTFMaterial.glsl"
+#include "coords.glsl"
+#include "BRDF.glsl"
+#include "VT.glsl"
+
+layout (location = 0) in vec2 IN_UV;
+layout (location = 1) in vec3 IN_NORM;
+
+layout (set = 0, binding = 0) uniform UboData
+{
+  GlobalFrameParams gFrame;
+}; 
+
+layout (push_constant) uniform PushData
+{
+  PushConstMaterial pc;
+};
+
+layout (set = 0, binding = 1) uniform sampler2D BASE_COLOR_TEX;
+layout (set = 0, binding = 2) uniform sampler2D METALLIC_ROUGHNESS_TEX;
+
+layout (set = 0, binding = 5) uniform sampler2D BASE_COLOR_PAGES;
+layout (set = 0, binding = 6) uniform usampler2D BASE_COLOR_PAGE_TABLE;
+layout (set = 0, binding = 7) uniform sampler2D METALLIC_ROUGHNESS_PAGES;
+layout (set = 0, binding = 8) uniform usampler2D METALLIC_ROUGHNESS_PAGE_TABLE;
+
+// virtual textures fall back to the resident mip tail of the regular texture until their pages arrive
+vec4 sample_base_color(vec2 uv)
+{
+  vec2 uvDx = dFdx(uv);
+  vec2 uvDy = dFdy(uv);
+  bool valid = false;
+  vec4 s = vec4(0);
+  if (vt_enabled(pc.vtBaseColor))
+    s = vt_sample(BASE_COLOR_PAGES, BASE_COLOR_PAGE_TABLE, pc.vtBaseColor, uv, uvDx, uvDy, valid);
+  return valid ? s : textureGrad(BASE_COLOR_TEX, uv, uvDx, uvDy);
+}
+
+vec4 sample_metallic_roughness(vec2 uv)
+{
+  vec2 uvDx = dFdx(uv);
+  vec2 uvDy = dFdy(uv);
+  bool valid = false;
+  vec4 s = vec4(0);
+  if (vt_enabled(pc.vtMetallicRoughness))
+    s = vt_sample(METALLIC_ROUGHNESS_PAGES, METALLIC_ROUGHNESS_PAGE_TABLE, pc.vtMetallicRoughness, uv, uvDx, uvDy, valid);
+  return valid ? s : textureGrad(METALLIC_ROUGHNESS_TEX, uv, uvDx, uvDy);
+}
+
+// alpha only, for passes that need coverage but no color
+float transparent_alpha()
+{
+  float alpha = pc.baseColorFactor.a;
+  if ((get_render_flags(pc) & RF_NO_BASECOLOR_TEX) == 0)
+    alpha *= sample_base_color(IN_UV).a;
+  return alpha;
+}
+
+// shaded color and alpha of the fragment, not premultiplied. screen_uv is the fragment position on the
+// screen, passes rendering at a lower resolution than gFrame.viewport pass it scaled by their target size.
+vec4 shade_transparent_at(vec2 screen_uv)
+{
+  uint renderFlags = get_render_flags(pc);
+  float metallic = get_metallic(pc);
+  float roughness = get_rouhness(pc);
+
+  if ((renderFlags & RF_NO_METALLIC_ROUGHNESS_TEX) == 0)
+  {
+    vec4 m = sample_metallic_roughness(IN_UV);
+    vec2 rm = (renderFlags & RF_PACKED_METALLIC_ROUGHNESS) != 0 ? m.rg : m.gb;
+    metallic = rm.y;
+    roughness = rm.x;
+  }
+
+  vec3 baseColor = pc.baseColorFactor.rgb;
+  float alpha = pc.baseColorFactor.a;
+
+  if ((renderFlags & RF_NO_BASECOLOR_TEX) == 0)
+  {
+    vec4 s = sample_base_color(IN_UV);
+    baseColor *= s.rgb;
+    alpha *= s.a;
+  }
+
+  vec3 N = normalize(IN_NORM);
+  vec3 L = gFrame.sunDirection.xyz;  
+  vec3 V = vec3(0, 0, 0);
+
+  {
+    vec3 cameraPos = reconstruct_camera_vec(screen_uv, gl_FragCoord.z, gFrame.projectionParams);
+
+    V = normalize(-cameraPos);
+
+  }
+  vec3 ambientLight = vec3(0.15, 0.15, 0.15);
+  vec3 brdf = BRDF(N, V, L, baseColor, gFrame.sunColor.rgb, ambientLight, metallic, roughness); 
+  //brdf = pow(brdf, vec3(1/2.2));
+
+  return vec4(brdf, alpha);
+}
+
+vec4 shade_transparent()
+{
+  return shade_transparent_at(gl_FragCoord.xy / gFrame.viewport.xy);
+}
+
+#endif
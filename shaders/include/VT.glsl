@@ -0,0 +1,67 @@
+#ifndef VT_GLSL_INCLUDED
+#define VT_GLSL_INCLUDED
+
+// Virtual texture sampling, see VirtualTextures.hpp.
+// Texture parameters are uvec4(vt id, level 0 width, level 0 height, levels), zero levels for regular textures.
+// Page table entries are uvec4(page cache x, page cache y, mapped level, valid).
+
+#define VT_PAGE_SIZE 128.0
+#define VT_PAGE_BORDER 4.0
+#define VT_PAGE_STRIDE 136.0
+#define VT_FEEDBACK_NONE 0xffffffffu
+
+bool vt_enabled(uvec4 vt)
+{
+  return vt.w != 0;
+}
+
+vec2 vt_level_size(uvec4 vt, uint level)
+{
+  return max(floor(vec2(vt.yz) / float(1u << level)), vec2(1.0));
+}
+
+// level of the virtual mip chain covering the pixel footprint, like hardware lod selection.
+// Derivatives are passed in, callers take them in uniform control flow.
+uint vt_level(uvec4 vt, vec2 uv_dx, vec2 uv_dy, float lod_bias)
+{
+  vec2 dx = uv_dx * vec2(vt.yz);
+  vec2 dy = uv_dy * vec2(vt.yz);
+  float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + lod_bias;
+  return uint(clamp(lod, 0.0, float(vt.w - 1)));
+}
+
+uvec2 vt_page(uvec4 vt, vec2 uv, uint level)
+{
+  vec2 texel = fract(uv) * vt_level_size(vt, level);
+  uvec2 pagesCount = uvec2(ceil(vt_level_size(vt, level) / VT_PAGE_SIZE));
+  return min(uvec2(texel / VT_PAGE_SIZE), pagesCount - 1);
+}
+
+// vt id : 10 bits, level : 4 bits, page x : 9 bits, page y : 9 bits
+uint vt_pack_page(uvec4 vt, uint level, uvec2 page)
+{
+  return (vt.x << 22) | (level << 18) | (page.x << 9) | page.y;
+}
+
+// samples the finest resident page, valid is false if not even the last level is resident
+vec4 vt_sample(sampler2D page_cache, usampler2D page_table, uvec4 vt, vec2 uv, vec2 uv_dx, vec2 uv_dy, 
+  out bool valid)
+{
+  uint level = vt_level(vt, uv_dx, uv_dy, 0.0);
+  uvec4 entry = texelFetch(page_table, ivec2(vt_page(vt, uv, level)), int(level));
+  valid = entry.w != 0;
+  if (!valid)
+    return vec4(0);
+
+  // the entry may point to a coarser page, address it in its own level
+  vec2 levelSize = vt_level_size(vt, entry.z);
+  vec2 texel = fract(uv) * levelSize;
+  vec2 inPage = texel - floor(texel / VT_PAGE_SIZE) * VT_PAGE_SIZE;
+
+  vec2 cacheSize = vec2(textureSize(page_cache, 0));
+  vec2 cacheUV = (vec2(entry.xy) * VT_PAGE_STRIDE + VT_PAGE_BORDER + inPage) / cacheSize;
+  vec2 gradScale = levelSize / cacheSize;
+  return textureGrad(page_cache, cacheUV, uv_dx * gradScale, uv_dy * gradScale);
+}
+
+#endif
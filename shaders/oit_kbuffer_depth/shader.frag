@@ -0,0 +1,31 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/OIT.glsl"
+
+layout(early_fragment_tests) in;
+
+// OIT_K nearest depths per pixel, ascending
+layout (set = 0, binding = 3, std430) buffer DepthBuffer
+{
+  uint depths[];
+};
+
+void main()
+{
+  if (transparent_alpha() < OIT_MIN_ALPHA)
+    return;
+
+  uint base = (uint(gl_FragCoord.y) * uint(gFrame.viewport.x) + uint(gl_FragCoord.x)) * OIT_K;
+
+  // positive float depths order like their bits, each layer keeps the minimum and passes the larger one on
+  uint depth = floatBitsToUint(gl_FragCoord.z);
+  for (uint i = 0; i < OIT_K; i++)
+  {
+    uint previous = atomicMin(depths[base + i], depth);
+    if (previous == OIT_KBUFFER_EMPTY)
+      break;
+    depth = max(previous, depth);
+  }
+}
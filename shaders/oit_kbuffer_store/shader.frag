@@ -0,0 +1,50 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/OIT.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (set = 0, binding = 3, std430) readonly buffer DepthBuffer
+{
+  uint depths[];
+};
+
+layout (set = 0, binding = 4, std430) writeonly buffer ColorBuffer
+{
+  uint colors[];
+};
+
+// fragments behind the k layers, blended like weighted blended OIT
+layout (location = 0) out vec4 OUT_ACCUM;
+layout (location = 1) out float OUT_REVEALAGE;
+
+void main()
+{
+  OUT_ACCUM = vec4(0);
+  OUT_REVEALAGE = 0.0;
+
+  vec4 color = shade_transparent();
+  if (color.a < OIT_MIN_ALPHA)
+    return;
+
+  uint base = (uint(gl_FragCoord.y) * uint(gFrame.viewport.x) + uint(gl_FragCoord.x)) * OIT_K;
+  uint depth = floatBitsToUint(gl_FragCoord.z);
+
+  if (depth <= depths[base + OIT_K - 1])
+  {
+    for (uint i = 0; i < OIT_K; i++)
+    {
+      if (depths[base + i] == depth)
+      {
+        colors[base + i] = packUnorm4x8(color);
+        return;
+      }
+    }
+  }
+
+  float weight = oit_weight(oit_view_depth(gl_FragCoord.z, gFrame.projectionParams), color.a);
+  OUT_ACCUM = vec4(color.rgb * color.a, color.a) * weight;
+  OUT_REVEALAGE = color.a;
+}
@@ -0,0 +1,24 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/OIT.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (set = 0, binding = 3, rgba32f) uniform readonly image2D MOMENTS_TEX;
+layout (set = 0, binding = 4, r32f) uniform readonly image2D ABSORBANCE_TEX;
+
+layout (location = 0) out vec4 OUT_ACCUM; // additive
+
+void main()
+{
+  vec4 color = shade_transparent();
+
+  ivec2 pixelPos = ivec2(gl_FragCoord.xy);
+  float depth = oit_warp_depth(oit_view_depth(gl_FragCoord.z, gFrame.projectionParams), gFrame.projectionParams);
+  float transmittance = oit_transmittance(
+    imageLoad(ABSORBANCE_TEX, pixelPos).r, imageLoad(MOMENTS_TEX, pixelPos), depth);
+
+  OUT_ACCUM = vec4(color.rgb * color.a, color.a) * transmittance;
+}
@@ -0,0 +1,17 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/OIT.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (location = 0) out vec4 OUT_MOMENTS; // additive
+layout (location = 1) out float OUT_ABSORBANCE; // additive
+
+void main()
+{
+  float alpha = transparent_alpha();
+  float depth = oit_warp_depth(oit_view_depth(gl_FragCoord.z, gFrame.projectionParams), gFrame.projectionParams);
+  oit_generate_moments(depth, alpha, OUT_ABSORBANCE, OUT_MOMENTS);
+}
@@ -0,0 +1,19 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/TransparentShading.glsl"
+#include "../include/OIT.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (location = 0) out vec4 OUT_ACCUM; // additive
+layout (location = 1) out float OUT_REVEALAGE; // multiplied by 1 - alpha
+
+void main()
+{
+  vec4 color = shade_transparent();
+  float weight = oit_weight(oit_view_depth(gl_FragCoord.z, gFrame.projectionParams), color.a);
+
+  OUT_ACCUM = vec4(color.rgb * color.a, color.a) * weight;
+  OUT_REVEALAGE = color.a;
+}
@@ -0,0 +1,68 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "../include/GLTFMaterial.glsl"
+#include "../include/MaterialTable.glsl"
+#include "../include/coords.glsl"
+#include "../include/BRDF.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (location = 0) in vec2 IN_UV;
+layout (location = 1) in vec3 IN_NORM;
+layout (location = 2) flat in uint IN_MATERIAL;
+
+layout (location = 0) out vec4 OUT_COLOR;
+
+layout (set = 0, binding = 0) uniform UboData
+{
+  GlobalFrameParams gFrame;
+};
+
+layout (set = 0, binding = 2, std430) readonly buffer MaterialBuffer
+{
+  MaterialTableEntry materials[];
+};
+
+layout (set = 0, binding = 3) uniform sampler2D MATERIAL_TEXTURES[2 * MATERIAL_TABLE_TEXTURED_GROUPS];
+
+// same inputs and BRDF as shade_transparent in TransparentShading.glsl, blended over the target in draw order
+void main()
+{
+  MaterialTableEntry mat = materials[IN_MATERIAL];
+
+  uint renderFlags = floatBitsToUint(mat.metallic_roughness_alphaCutoff_flags.w);
+  float metallic = mat.metallic_roughness_alphaCutoff_flags.x;
+  float roughness = mat.metallic_roughness_alphaCutoff_flags.y;
+
+  if ((renderFlags & RF_NO_METALLIC_ROUGHNESS_TEX) == 0)
+  {
+    vec4 m = texture(MATERIAL_TEXTURES[nonuniformEXT(2 * IN_MATERIAL + 1)], IN_UV);
+    vec2 rm = (renderFlags & RF_PACKED_METALLIC_ROUGHNESS) != 0 ? m.rg : m.gb;
+    metallic = rm.y;
+    roughness = rm.x;
+  }
+
+  vec3 baseColor = mat.baseColorFactor.rgb;
+  float alpha = mat.baseColorFactor.a;
+
+  if ((renderFlags & RF_NO_BASECOLOR_TEX) == 0)
+  {
+    vec4 s = texture(MATERIAL_TEXTURES[nonuniformEXT(2 * IN_MATERIAL)], IN_UV);
+    baseColor *= s.rgb;
+    alpha *= s.a;
+  }
+
+  vec3 N = normalize(IN_NORM);
+  vec3 L = gFrame.sunDirection.xyz;
+  vec2 screenUV = gl_FragCoord.xy / gFrame.viewport.xy;
+  vec3 V = normalize(-reconstruct_camera_vec(screenUV, gl_FragCoord.z, gFrame.projectionParams));
+
+  vec3 ambientLight = vec3(0.15, 0.15, 0.15);
+  vec3 brdf = BRDF(N, V, L, baseColor, gFrame.sunColor.rgb, ambientLight, metallic, roughness);
+
+  // premultiplied, clamped like the colors of the other modes
+  vec4 c = clamp(vec4(brdf, alpha), 0.0, 1.0);
+  OUT_COLOR = vec4(c.rgb * c.a, c.a);
+}
@@ -0,0 +1,36 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/GLTFMaterial.glsl"
+#include "../include/SortedBlend.glsl"
+
+layout (set = 0, binding = 0) uniform UboData
+{
+  GlobalFrameParams gFrame;
+};
+
+layout (set = 0, binding = 1, std430) readonly buffer InstanceBuffer
+{
+  BlendInstance instances[];
+};
+
+layout (location = 0) in vec3 IN_POS;
+layout (location = 1) in vec3 IN_NORM;
+layout (location = 2) in vec2 IN_UV;
+
+layout (location = 0) out vec2 OUT_UV;
+layout (location = 1) out vec3 OUT_NORM;
+layout (location = 2) flat out uint OUT_MATERIAL;
+
+void main()
+{
+  // the indirect draws pass the instance id as the first instance
+  BlendInstance instance = instances[gl_InstanceIndex];
+
+  vec4 pos = gFrame.viewProjection * (instance.model * vec4(IN_POS, 1));
+  pos += vec4(gFrame.jitter.xy, 0, 0) * pos.w;
+  gl_Position = pos;
+  OUT_UV = IN_UV;
+  OUT_NORM = vec3(instance.normalTransform * vec4(IN_NORM, 0));
+  OUT_MATERIAL = instance.materialGroup;
+}
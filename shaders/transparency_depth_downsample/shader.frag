@@ -0,0 +1,19 @@
+#version 460 core
+
+// Half resolution copy of the opaque depth. Keeps the farthest depth of every 2x2 quad, so transparent
+// fragments pass the depth test if any of the covered pixels sees them.
+
+layout (set = 0, binding = 0) uniform sampler2D DEPTH_TEX;
+
+void main()
+{
+  ivec2 size = textureSize(DEPTH_TEX, 0);
+  ivec2 base = 2 * ivec2(gl_FragCoord.xy);
+
+  float depth = 0.0;
+  for (int y = 0; y < 2; y++)
+    for (int x = 0; x < 2; x++)
+      depth = max(depth, texelFetch(DEPTH_TEX, min(base + ivec2(x, y), size - 1), 0).r);
+
+  gl_FragDepth = depth;
+}
@@ -0,0 +1,44 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+#include "../include/VT.glsl"
+
+layout(early_fragment_tests) in;
+
+layout (push_constant) uniform PushData
+{
+  mat4 MVP;
+  uvec4 vtBaseColor;
+  uvec4 vtMetallicRoughness;
+  vec4 lodBias; // x - log2 of the feedback downscale
+};
+
+layout (location = 0) in vec2 IN_UV;
+
+layout (set = 0, binding = 0, std430) buffer FeedbackBuffer
+{
+  uint width;
+  uint pad[3];
+  uint pages[];
+} gFeedback;
+
+void main()
+{
+  // neighbouring pixels report different textures of the material
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  bool oddPixel = ((pixel.x + pixel.y) & 1) != 0;
+  bool pickMR = vt_enabled(vtMetallicRoughness) && (oddPixel || !vt_enabled(vtBaseColor));
+  uvec4 vt = pickMR ? vtMetallicRoughness : vtBaseColor;
+
+  vec2 uvDx = dFdx(IN_UV);
+  vec2 uvDy = dFdy(IN_UV);
+
+  uint page = VT_FEEDBACK_NONE;
+  if (vt_enabled(vt))
+  {
+    // derivatives are taken at feedback resolution, bias back to the full resolution level
+    uint level = vt_level(vt, uvDx, uvDy, -lodBias.x);
+    page = vt_pack_page(vt, level, vt_page(vt, IN_UV, level));
+  }
+  gFeedback.pages[pixel.y * gFeedback.width + pixel.x] = page;
+}
@@ -0,0 +1,22 @@
+#version 460 core
+#extension GL_GOOGLE_include_directive : enable
+
+layout (push_constant) uniform PushData
+{
+  mat4 MVP;
+  uvec4 vtBaseColor;
+  uvec4 vtMetallicRoughness;
+  vec4 lodBias;
+};
+
+layout (location = 0) in vec3 IN_POS;
+layout (location = 1) in vec3 IN_NORM;
+layout (location = 2) in vec2 IN_UV;
+
+layout (location = 0) out vec2 OUT_UV;
+
+void main()
+{
+  gl_Position = MVP * vec4(IN_POS, 1);
+  OUT_UV = IN_UV;
+}
@@ -29,6 +29,9 @@ protected:
 
   void drawImGui(etna::SyncCommandBuffer &cmd, const etna::Image &backbuffer);
 
+  // the textureCompressionBC device feature is enabled
+  bool hasTextureCompressionBC() const { return textureCompressionBC; }
+
 private:
   struct EtnaDeleter
   {
@@ -56,6 +59,7 @@ private:
   EtnaDeleter etnaDeleter;
   std::unique_ptr<etna::SimpleSubmitContext> submitCtx;  
   std::unique_ptr<ImguiInitilizer> imguiCtx;
+  bool textureCompressionBC = false;
 };
 
 
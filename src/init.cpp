@@ -49,6 +49,43 @@ static std::optional<vk::UniqueSurfaceKHR> create_surface(SDL_Window *window)
   return {vk::UniqueSurfaceKHR{api_surface, instance}};
 }
 
+// etna picks the physical device during initialize, so optional features are chosen before it from a
+// temporary instance. A feature is enabled only if every device has it, whichever is picked supports it.
+static bool all_devices_support_bc()
+{
+  auto getInstanceProcAddr = PFN_vkGetInstanceProcAddr(SDL_Vulkan_GetVkGetInstanceProcAddr());
+  if (!getInstanceProcAddr)
+    return false;
+
+  auto createInstance = PFN_vkCreateInstance(getInstanceProcAddr(nullptr, "vkCreateInstance"));
+  VkApplicationInfo appInfo {.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO, .apiVersion = VK_API_VERSION_1_0};
+  VkInstanceCreateInfo info {.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO, .pApplicationInfo = &appInfo};
+  VkInstance instance = VK_NULL_HANDLE;
+  if (!createInstance || createInstance(&info, nullptr, &instance) != VK_SUCCESS)
+    return false;
+
+  auto enumerateDevices =
+    PFN_vkEnumeratePhysicalDevices(getInstanceProcAddr(instance, "vkEnumeratePhysicalDevices"));
+  auto getFeatures = PFN_vkGetPhysicalDeviceFeatures(getInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures"));
+  auto destroyInstance = PFN_vkDestroyInstance(getInstanceProcAddr(instance, "vkDestroyInstance"));
+
+  uint32_t count = 0;
+  enumerateDevices(instance, &count, nullptr);
+  std::vector<VkPhysicalDevice> devices(count);
+  enumerateDevices(instance, &count, devices.data());
+
+  bool supported = count > 0;
+  for (auto device : devices)
+  {
+    VkPhysicalDeviceFeatures features {};
+    getFeatures(device, &features);
+    supported = supported && features.textureCompressionBC;
+  }
+
+  destroyInstance(instance, nullptr);
+  return supported;
+}
+
 AppInit::AppInit(uint32_t init_width, uint32_t init_height)
 {
   setenv("SDL_VIDEODRIVER", "x11", 1); // nvidia hates wayland...
@@ -79,8 +116,14 @@ AppInit::AppInit(uint32_t init_width, uint32_t init_height)
   std::vector<const char*> device_ext {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
   params.deviceExtensions = device_ext;
   params.features.features.fragmentStoresAndAtomics = VK_TRUE;
+  params.features.features.multiDrawIndirect = VK_TRUE; // sorted transparent instances in one draw
+  params.features.features.drawIndirectFirstInstance = VK_TRUE; // firstInstance is the instance id
+  textureCompressionBC = all_devices_support_bc();
+  params.features.features.textureCompressionBC = textureCompressionBC ? VK_TRUE : VK_FALSE;
 
   etna::initialize(params);
+  if (!textureCompressionBC)
+    spdlog::warn("BC texture compression is not supported by every device, textures are uploaded uncompressed");
   auto surface = create_surface(getWindow()).value();
   submitCtx = etna::create_submit_context(surface.release(), {init_width, init_height}, true);
 
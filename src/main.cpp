@@ -8,15 +8,25 @@
 #include <etna/Sampler.hpp>
 #include <etna/RenderTargetStates.hpp>
 
+#include <algorithm>
 #include <span>
+#include <string_view>
 #include <optional>
 #include <ranges>
+#include <deque>
 
 #include "scene/Camera.hpp"
 #include "scene/GLTFScene.hpp"
 #include "scene/SceneRenderer.hpp"
 #include "scene/ABufferRenderer.hpp"
+#include "scene/TransparencyRenderer.hpp"
+#include "scene/TextureStreamer.hpp"
+#include "scene/VirtualTextures.hpp"
+#include "scene/SceneLoader.hpp"
+#include "scene/AccessorKernels.hpp"
+#include "scene/WorldManager.hpp"
 #include "renderer/TAA.hpp"
+#include "renderer/MipGenerator.hpp"
 
 #include "app.hpp"
 #include "events/events.hpp"
@@ -38,9 +48,161 @@ struct GlobalParamsSystem
     ImGui::SliderFloat3("Sun direction", sunDir.data(), -1.f, 1.f);
     ImGui::SliderFloat("FOV", &fov, 60.f, 120.f);
     ImGui::Checkbox("Enable jitter", &enableJitter);
+    ImGui::SliderInt("Texture budget, MiB", &textureBudgetMiB, 16, 2048);
+    ImGui::Text("Streamed textures : %u, %u MiB resident, %u uploads pending", 
+      streamedTextures, residentMiB, pendingUploads);
+    ImGui::Text("Virtual textures : %u, %u pages resident, %u pages pending",
+      virtualTextures, residentPages, pendingPages);
+
+    std::array<const char *, scene::TRANSPARENCY_MODES_COUNT> modeNames;
+    for (uint32_t i = 0; i < scene::TRANSPARENCY_MODES_COUNT; i++)
+      modeNames[i] = scene::get_transparency_mode_name(scene::TransparencyMode(i));
+    if (ImGui::Combo("Transparency", &transparencyMode, modeNames.data(), int(modeNames.size())))
+      transparencyModeChanged = true;
+
+    for (uint32_t i = 0; i < scene::TRANSPARENCY_MODES_COUNT; i++)
+    {
+      ImGui::Text("%-18s %6.3f ms GPU (avg %6.3f ms), %6.1f MiB", modeNames[i], transparencyStats[i].lastGpuMs,
+        transparencyStats[i].avgGpuMs, transparencyStats[i].memoryBytes / float(1 << 20));
+    }
+
+    if (benchmarkRunning)
+      ImGui::Text("Transparency benchmark is running, results go to the log");
+    else if (ImGui::Button("Benchmark transparency"))
+      benchmarkRequested = true;
+
+    std::array<std::string, scene::ABUFFER_RESOLVE_LAYERS.size()> layerLabels;
+    std::array<const char *, scene::ABUFFER_RESOLVE_LAYERS.size()> layerNames;
+    for (size_t i = 0; i < layerLabels.size(); i++)
+    {
+      layerLabels[i] = std::to_string(scene::ABUFFER_RESOLVE_LAYERS[i]);
+      layerNames[i] = layerLabels[i].c_str();
+    }
+    if (ImGui::Combo("A-buffer resolve layers", &resolveLayersIndex, layerNames.data(), int(layerNames.size())))
+      resolveLayersChanged = true;
+    ImGui::Checkbox("Half resolution A-buffer", &halfResolution);
+
+    if (resolveBenchmarkRunning)
+      ImGui::Text("Resolve benchmark is running, results go to the log");
+    else if (ImGui::Button("Benchmark A-buffer resolve"))
+      resolveBenchmarkRequested = true;
+
+    auto showABufferStats = [](const char *name, const scene::ABufferStats &stats) {
+      ImGui::Text("%s : %u MiB, %.2f M fragments, last frame %.2f M, peak %.2f M, %u overflows, %u resizes",
+        name, uint32_t(stats.bufferBytes >> 20), stats.capacity * 1e-6f, stats.lastFragments * 1e-6f,
+        stats.peakFragments * 1e-6f, stats.overflowFrames, stats.resizes);
+    };
+    showABufferStats("A-buffer", abufferStats);
+    showABufferStats("A-buffer prefix sum", prefixSumStats);
+    showABufferStats("A-buffer deferred", deferredStats);
+    ImGui::Text("A-buffer transparent tiles : %u of %u", activeTiles, tilesCount);
+    ImGui::Text("Sorted Blend instances : %u", sortedInstances);
+
+    if (showWorld)
+    {
+      ImGui::Text("World : %u of %u tiles resident, %u loading, %u images (%u shared)",
+        worldStats.residentTiles, worldStats.tiles, worldStats.loadingTiles, worldStats.images,
+        worldStats.sharedImageRefs);
+      ImGui::Text("World pools : %u MiB vertices in %u free ranges, %u MiB indices in %u free ranges",
+        uint32_t((worldStats.vertexPoolUsed * sizeof(scene::Vertex)) >> 20), worldStats.vertexFreeRanges,
+        uint32_t((worldStats.indexPoolUsed * sizeof(uint32_t)) >> 20), worldStats.indexFreeRanges);
+    }
+
+    ImGui::InputText("Scene path", scenePath.data(), scenePath.size());
+    if (ImGui::Button("Load scene"))
+      loadRequested = true;
+    if (loading)
+      ImGui::Text("Loading : %s, %.0f%%, upload %.2f ms (max %.2f ms), frame max %.2f ms",
+        loadingState, loadProgress * 100.f, lastUploadMs, maxUploadMs, maxLoadFrameMs);
+    else if (maxLoadFrameMs > 0.f)
+      ImGui::Text("Last load : upload max %.2f ms, frame max %.2f ms", maxUploadMs, maxLoadFrameMs);
     ImGui::EndChild();
   }
 
+  void updateStreaming(scene::TextureStreamer &streamer)
+  {
+    auto config = streamer.getConfig();
+    config.budgetBytes = uint64_t(textureBudgetMiB) << 20;
+    streamer.setConfig(config);
+
+    streamedTextures = streamer.getStreamedTextures();
+    residentMiB = uint32_t(streamer.getResidentBytes() >> 20);
+    pendingUploads = streamer.getPendingUploads();
+  }
+
+  void updateVirtualTextures(const scene::VirtualTextureSystem &vt)
+  {
+    virtualTextures = vt.getVirtualTexturesCount();
+    residentPages = vt.getResidentPages();
+    pendingPages = vt.getPendingPages();
+  }
+
+  std::optional<std::string> takeSceneLoadRequest()
+  {
+    if (!std::exchange(loadRequested, false))
+      return std::nullopt;
+    return std::string {scenePath.data()};
+  }
+
+
+  // frame times are tracked while a load is in progress to show the hitches it causes
+  void updateSceneLoading(const scene::AsyncSceneLoader *loader, float dt)
+  {
+    bool wasLoading = std::exchange(loading, loader != nullptr);
+    if (!loader)
+      return;
+
+    if (!wasLoading)
+      maxLoadFrameMs = 0.f;
+    maxLoadFrameMs = std::max(maxLoadFrameMs, dt * 1e3f);
+
+    switch (loader->getState())
+    {
+    case scene::AsyncSceneLoader::State::Preparing: loadingState = "preparing"; break;
+    case scene::AsyncSceneLoader::State::Uploading: loadingState = "uploading"; break;
+    case scene::AsyncSceneLoader::State::Refining: loadingState = "refining"; break;
+    case scene::AsyncSceneLoader::State::Done: loadingState = "done"; break;
+    }
+    loadProgress = loader->getProgress();
+    lastUploadMs = float(loader->getLastUploadMs());
+    maxUploadMs = float(loader->getMaxUploadMs());
+  }
+
+  void updateTransparency(scene::TransparencyRenderer &renderer)
+  {
+    if (std::exchange(transparencyModeChanged, false))
+      renderer.setMode(scene::TransparencyMode(transparencyMode));
+    if (std::exchange(benchmarkRequested, false))
+      renderer.startBenchmark(240);
+    if (std::exchange(resolveLayersChanged, false))
+      renderer.setResolveLayers(scene::ABUFFER_RESOLVE_LAYERS[resolveLayersIndex]);
+    if (std::exchange(resolveBenchmarkRequested, false))
+      renderer.startResolveBenchmark();
+    renderer.setHalfResolution(halfResolution);
+
+    // the benchmark switches modes on its own
+    transparencyMode = int(renderer.getMode());
+    benchmarkRunning = renderer.isBenchmarkRunning();
+    resolveBenchmarkRunning = renderer.isResolveBenchmarkRunning();
+    auto layers = std::ranges::find(scene::ABUFFER_RESOLVE_LAYERS, renderer.getResolveLayers());
+    resolveLayersIndex = int(layers - scene::ABUFFER_RESOLVE_LAYERS.begin());
+    for (uint32_t i = 0; i < scene::TRANSPARENCY_MODES_COUNT; i++)
+      transparencyStats[i] = renderer.getStats(scene::TransparencyMode(i));
+    abufferStats = renderer.getABufferStats();
+    prefixSumStats = renderer.getPrefixSumStats();
+    deferredStats = renderer.getDeferredStats();
+    activeTiles = renderer.getTiles().getLastActiveTiles();
+    tilesCount = renderer.getTiles().getTilesCount();
+    sortedInstances = renderer.getSortedInstancesCount();
+  }
+
+  void updateWorld(const scene::WorldManager *world)
+  {
+    showWorld = world != nullptr;
+    if (world)
+      worldStats = world->getStats();
+  }
+
   void updateParams(scene::GlobalFrameConstantHandler &handler)
   {
     handler.setSunColor({sunRadiance[0], sunRadiance[1], sunRadiance[2]});
@@ -62,6 +224,44 @@ private:
   float fov = 90.f;
   float prevFov = -1.f;
   bool enableJitter = true;
+
+  int textureBudgetMiB = 256;
+  uint32_t streamedTextures = 0;
+  uint32_t residentMiB = 0;
+  uint32_t pendingUploads = 0;
+
+  uint32_t virtualTextures = 0;
+  uint32_t residentPages = 0;
+  uint32_t pendingPages = 0;
+
+  int transparencyMode = 0;
+  bool transparencyModeChanged = false;
+  bool benchmarkRequested = false;
+  bool benchmarkRunning = false;
+  int resolveLayersIndex = 1;
+  bool resolveLayersChanged = false;
+  bool halfResolution = false;
+  bool resolveBenchmarkRequested = false;
+  bool resolveBenchmarkRunning = false;
+  std::array<scene::TransparencyStats, scene::TRANSPARENCY_MODES_COUNT> transparencyStats;
+  scene::ABufferStats abufferStats;
+  scene::ABufferStats prefixSumStats;
+  scene::ABufferStats deferredStats;
+  uint32_t activeTiles = 0;
+  uint32_t tilesCount = 0;
+  uint32_t sortedInstances = 0;
+
+  bool showWorld = false;
+  scene::WorldManager::Stats worldStats;
+
+  std::array<char, 256> scenePath {"assets/FlightHelmet/FlightHelmet.gltf"};
+  bool loadRequested = false;
+  bool loading = false;
+  const char *loadingState = "";
+  float loadProgress = 0.f;
+  float lastUploadMs = 0.f;
+  float maxUploadMs = 0.f;
+  float maxLoadFrameMs = 0.f;
 };
 
 struct EtnaSampleApp : AppInit 
@@ -83,6 +283,21 @@ struct EtnaSampleApp : AppInit
   }
 
   void loadScene(const std::string &path)
+  {
+    initRenderers();
+    scene = scene::load_scene(path, *utilCmd, loadOptions);
+    attachScene();
+  }
+
+  // Streams a world of glTF tiles listed in a .world file around the camera, see scene::WorldManager
+  void loadWorld(const std::string &path)
+  {
+    initRenderers();
+    world = std::make_unique<scene::WorldManager>(scene::load_world_index(path), loadOptions);
+    attachScene();
+  }
+
+  void initRenderers()
   {
     scene::RenderTargetInfo rtInfo {
       {rts->getColorFmt(), rts->getVelocityFmt()},
@@ -103,37 +318,173 @@ struct EtnaSampleApp : AppInit
       "shaders/abuffer_render/shader.frag.spv"
     });
 
-    etna::create_program("abuffer_resolve", {
-      "shaders/abuffer_resolve/shader.comp.spv"
+    for (uint32_t layers : scene::ABUFFER_RESOLVE_LAYERS)
+    {
+      etna::create_program("abuffer_resolve_k" + std::to_string(layers), {
+        "shaders/abuffer_resolve_k" + std::to_string(layers) + "/shader.comp.spv"
+      });
+    }
+
+    etna::create_program("abuffer_synthetic", {
+      "shaders/abuffer_synthetic/shader.comp.spv"
+    });
+
+    etna::create_program("abuffer_tiles", {
+      "shaders/abuffer_tiles/shader.comp.spv"
+    });
+
+    etna::create_program("abuffer_prefix_count", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/abuffer_prefix_count/shader.frag.spv"
+    });
+
+    etna::create_program("abuffer_prefix_scan", {
+      "shaders/abuffer_prefix_scan/shader.comp.spv"
+    });
+
+    etna::create_program("abuffer_prefix_store", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/abuffer_prefix_store/shader.frag.spv"
+    });
+
+    etna::create_program("abuffer_prefix_resolve", {
+      "shaders/abuffer_prefix_resolve/shader.comp.spv"
+    });
+
+    etna::create_program("transparency_depth_downsample", {
+      "shaders/transparency_depth_downsample/shader.vert.spv",
+      "shaders/transparency_depth_downsample/shader.frag.spv"
+    });
+
+    etna::create_program("transparency_upsample", {
+      "shaders/transparency_upsample/shader.comp.spv"
+    });
+
+    etna::create_program("abuffer_deferred_render", {
+      "shaders/abuffer_deferred/shader.vert.spv",
+      "shaders/abuffer_deferred/shader.frag.spv"
+    });
+
+    etna::create_program("abuffer_deferred_resolve", {
+      "shaders/abuffer_deferred_resolve/shader.comp.spv"
+    });
+
+    etna::create_program("sorted_blend", {
+      "shaders/sorted_blend/shader.vert.spv",
+      "shaders/sorted_blend/shader.frag.spv"
+    });
+
+    etna::create_program("sorted_blend_keys", {
+      "shaders/sorted_blend_keys/shader.comp.spv"
+    });
+
+    etna::create_program("sorted_blend_commands", {
+      "shaders/sorted_blend_commands/shader.comp.spv"
+    });
+
+    etna::create_program("radix_sort_count", {
+      "shaders/radix_sort_count/shader.comp.spv"
+    });
+
+    etna::create_program("radix_sort_scan", {
+      "shaders/radix_sort_scan/shader.comp.spv"
+    });
+
+    etna::create_program("radix_sort_scatter", {
+      "shaders/radix_sort_scatter/shader.comp.spv"
+    });
+
+    etna::create_program("oit_weighted", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/oit_weighted/shader.frag.spv"
+    });
+
+    etna::create_program("oit_weighted_resolve", {
+      "shaders/oit_weighted_resolve/shader.comp.spv"
+    });
+
+    etna::create_program("oit_moments_generate", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/oit_moments_generate/shader.frag.spv"
+    });
+
+    etna::create_program("oit_moments_accumulate", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/oit_moments_accumulate/shader.frag.spv"
     });
 
-    etna::create_program("fullscreen_blend", {
-      "shaders/fullscreen_blend/shader.vert.spv",
-      "shaders/fullscreen_blend/shader.frag.spv"
+    etna::create_program("oit_moments_resolve", {
+      "shaders/oit_moments_resolve/shader.comp.spv"
+    });
+
+    etna::create_program("oit_kbuffer_depth", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/oit_kbuffer_depth/shader.frag.spv"
+    });
+
+    etna::create_program("oit_kbuffer_store", {
+      "shaders/abuffer_render/shader.vert.spv",
+      "shaders/oit_kbuffer_store/shader.frag.spv"
+    });
+
+    etna::create_program("oit_kbuffer_resolve", {
+      "shaders/oit_kbuffer_resolve/shader.comp.spv"
     });
     
     etna::create_program("taa", {
       "shaders/TAA/shader.comp.spv",
     });
 
-    auto srcRes = rts->getColor().getExtent2D();
+    etna::create_program("spd_rgba8", {
+      "shaders/spd_rgba8/shader.comp.spv"
+    });
 
-    glm::uvec2 resolution {srcRes.width, srcRes.height};
+    etna::create_program("spd_rgba16f", {
+      "shaders/spd_rgba16f/shader.comp.spv"
+    });
+
+    etna::create_program("spd_r32f", {
+      "shaders/spd_r32f/shader.comp.spv"
+    });
+
+    etna::create_program("vt_feedback", {
+      "shaders/vt_feedback/shader.vert.spv",
+      "shaders/vt_feedback/shader.frag.spv"
+    });
 
     opaqueRenderer = std::make_unique<scene::SceneRenderer>("gltf_opaque_forward", "gltf_depth_prepass", rtInfo);
-    abufferRenderer = std::make_unique<scene::ABufferRenderer>("abuffer_render", rts->getDepth());
-    abufferResolver = std::make_unique<scene::ABufferResolver>("abuffer_resolve", resolution);
+    transparencyRenderer = std::make_unique<scene::TransparencyRenderer>(rts->getDepth());
 
     utilCmd.emplace(getSubmitCtx().getCommandPool());
+    mipGenerator = std::make_unique<renderer::MipGenerator>("spd");
+
+    loadOptions = scene::SceneLoadOptions {
+      .weldVertices = true,
+      .geometryReads = scene::GeometryReads::Direct,
+      .textureCompression =
+        hasTextureCompressionBC() ? scene::TextureCompression::BC : scene::TextureCompression::None,
+      .textureCacheDir = "cache/textures",
+      .mipGenerator = mipGenerator.get(),
+      .streamTextures = true
+    };
 
-    scene = scene::load_scene(path, *utilCmd);
-    opaqueRenderer->attachToScene(*scene);
-    abufferRenderer->attachToScene(*scene);
-    
-    texBlender = std::make_unique<scene::TexBlender>("fullscreen_blend", rtInfo.colorRT[0]);
     taaPass = std::make_unique<renderer::TAA>("taa");
   }
 
+  // Starts loading another scene while the current one keeps rendering, it is swapped in when ready.
+  // While a load is in progress the request is queued and started once that load has finished refining,
+  // a newer request replaces a queued one. Loads are never cancelled, that would wait for preparation.
+  void loadSceneAsync(const std::string &path)
+  {
+    if (sceneLoader)
+    {
+      spdlog::info("Scene {} is queued after {}", path, sceneLoader->getPath());
+      queuedScenePath = path;
+      return;
+    }
+    sceneLoader = std::make_unique<scene::AsyncSceneLoader>(path, loadOptions);
+  }
+
   void onResolutionChanged(uint32_t new_width, uint32_t new_height) override
   {
     auto res = getRenderResolution(new_width, new_height);
@@ -142,14 +493,19 @@ struct EtnaSampleApp : AppInit
     gFrameConsts.setViewport(res.x, res.y);
 
     rts->onResolutionChanged(res.x, res.y);
-    abufferRenderer->onResolutionChanged(res.x, res.y);
-    abufferResolver->onResolutionChanged({res.x, res.y});
+    transparencyRenderer->onResolutionChanged(res.x, res.y);
+    virtualTextures->onResolutionChanged(res);
   }
   
   void recordRenderCmd(etna::SyncCommandBuffer &cmd, const etna::Image &backbuffer) override
   {
     gFrameConsts.onBeginFrame();
-    rts->nextFrame(); // swap history  
+    updateSceneLoading(cmd);
+    updateWorld(cmd);
+    auto &activeScene = getActiveScene();
+    textureStreamer->update(cmd, gFrameConsts.getParams());
+    virtualTextures->update(cmd);
+    rts->nextFrame(); // the last targets become history
     auto resolution = rts->getColor().getExtent2D();
     
     vk::Rect2D renderArea {
@@ -166,11 +522,13 @@ struct EtnaSampleApp : AppInit
       };
 
       etna::RenderTargetState rts{cmd, renderArea.extent, {}, depthAttachment};
-      cmd.bindVertexBuffer(0, scene->getVertexBuff(), 0);
-      cmd.bindIndexBuffer(scene->getIndexBuff(), 0, vk::IndexType::eUint32);
-      opaqueRenderer->depthPrepass(cmd, gFrameConsts, *scene);
+      cmd.bindVertexBuffer(0, activeScene.getVertexBuff(), 0);
+      cmd.bindIndexBuffer(activeScene.getIndexBuff(), 0, vk::IndexType::eUint32);
+      opaqueRenderer->depthPrepass(cmd, gFrameConsts, activeScene);
     }
 
+    virtualTextures->renderFeedback(cmd, gFrameConsts);
+
     { // color pass
       etna::RenderingAttachment colorAttachment {
         .view = rts->getColor().getView({}),
@@ -194,19 +552,16 @@ struct EtnaSampleApp : AppInit
       etna::RenderTargetState rts{cmd, renderArea.extent, 
         {colorAttachment, velocityAttachment}, depthAttachment};
 
-      cmd.bindVertexBuffer(0, scene->getVertexBuff(), 0);
-      cmd.bindIndexBuffer(scene->getIndexBuff(), 0, vk::IndexType::eUint32);
-      opaqueRenderer->render(cmd, gFrameConsts, *scene);
+      cmd.bindVertexBuffer(0, activeScene.getVertexBuff(), 0);
+      cmd.bindIndexBuffer(activeScene.getIndexBuff(), 0, vk::IndexType::eUint32);
+      opaqueRenderer->render(cmd, gFrameConsts, activeScene);
     }
     
     { //apply taa 
       taaPass->dispatch(cmd, *rts, gFrameConsts, gFrameConsts.getInvalidateHistory());
     }
 
-    abufferRenderer->render(cmd, rts->getDepth(), gFrameConsts, *scene);
-    abufferResolver->dispatch(cmd, gFrameConsts, abufferRenderer->getListHead(), abufferRenderer->getListBuffer());
-
-    texBlender->blend(cmd, abufferResolver->getTarget(), rts->getColor());
+    transparencyRenderer->render(cmd, rts->getDepth(), gFrameConsts, activeScene, rts->getColor());
 
     {
       //blit to backbuffer
@@ -245,9 +600,93 @@ struct EtnaSampleApp : AppInit
     cameraUpdater.update(camera, dt);
     gFrameConsts.setViewMatrix(camera.getViewMat());
     gFrameConstsUpdater.updateParams(gFrameConsts);
+    gFrameConstsUpdater.updateStreaming(*textureStreamer);
+    gFrameConstsUpdater.updateVirtualTextures(*virtualTextures);
+    gFrameConstsUpdater.updateSceneLoading(sceneLoader.get(), dt);
+    gFrameConstsUpdater.updateWorld(world.get());
+    gFrameConstsUpdater.updateTransparency(*transparencyRenderer);
+
+    if (auto path = gFrameConstsUpdater.takeSceneLoadRequest())
+      loadSceneAsync(*path);
   }
 
 private:
+  scene::GLTFScene &getActiveScene()
+  {
+    return world ? world->getScene() : *scene;
+  }
+
+  // takes the largest streamed textures for virtual texturing, the streamer gets the rest
+  void attachScene()
+  {
+    auto &activeScene = getActiveScene();
+    auto extent = rts->getColor().getExtent2D();
+    virtualTextures = std::make_unique<scene::VirtualTextureSystem>("vt_feedback", activeScene,
+      glm::uvec2 {extent.width, extent.height});
+    textureStreamer = std::make_unique<scene::TextureStreamer>(activeScene);
+    opaqueRenderer->attachToScene(activeScene, *virtualTextures);
+    transparencyRenderer->attachToScene(activeScene, *virtualTextures);
+    worldGeneration = world ? world->getGeneration() : 0;
+  }
+
+  void updateWorld(etna::SyncCommandBuffer &cmd)
+  {
+    if (!world)
+      return;
+
+    world->update(cmd, camera.getPosition());
+    if (world->getGeneration() == worldGeneration)
+      return;
+
+    // the merged scene was rebuilt, draw lists of the renderers point at the previous tile set
+    worldGeneration = world->getGeneration();
+    opaqueRenderer->attachToScene(world->getScene(), *virtualTextures);
+    transparencyRenderer->attachToScene(world->getScene(), *virtualTextures);
+  }
+
+  void updateSceneLoading(etna::SyncCommandBuffer &cmd)
+  {
+    // previous scenes may still be referenced by frames in flight
+    uint32_t framesInFlight = etna::get_context().getNumFramesInFlight();
+    while (!retiredScenes.empty() && retiredScenes.front().frame + framesInFlight <= frameIndex)
+      retiredScenes.pop_front();
+    frameIndex++;
+
+    if (!sceneLoader && queuedScenePath)
+    {
+      sceneLoader = std::make_unique<scene::AsyncSceneLoader>(*queuedScenePath, loadOptions);
+      queuedScenePath.reset();
+    }
+
+    if (!sceneLoader)
+      return;
+
+    if (auto loaded = sceneLoader->update(cmd))
+    {
+      retiredScenes.push_back(RetiredScene {
+        .frame = frameIndex,
+        .scene = std::move(scene),
+        .world = std::move(world),
+        .virtualTextures = std::move(virtualTextures),
+        .textureStreamer = std::move(textureStreamer)
+      });
+      scene = std::move(loaded);
+      attachScene();
+    }
+
+    if (sceneLoader->isFinished())
+      sceneLoader.reset();
+  }
+
+  struct RetiredScene
+  {
+    uint64_t frame;
+    std::unique_ptr<scene::GLTFScene> scene;
+    std::unique_ptr<scene::WorldManager> world;
+    std::unique_ptr<scene::VirtualTextureSystem> virtualTextures;
+    std::unique_ptr<scene::TextureStreamer> textureStreamer;
+  };
+
   const float renderScale = 1.f;
 
   scene::GlobalFrameConstantHandler gFrameConsts;
@@ -256,12 +695,21 @@ private:
 
   std::optional<etna::SyncCommandBuffer> utilCmd;
 
+  scene::SceneLoadOptions loadOptions;
+  std::deque<RetiredScene> retiredScenes;
+  uint64_t frameIndex = 0;
+
   std::unique_ptr<scene::GLTFScene> scene;
+  std::unique_ptr<scene::WorldManager> world; // replaces scene if a world is loaded
+  uint64_t worldGeneration = 0;
+  std::unique_ptr<scene::AsyncSceneLoader> sceneLoader; // refines the scene it returned, destroyed before it
+  std::optional<std::string> queuedScenePath; // requested while sceneLoader was busy
+  std::unique_ptr<scene::VirtualTextureSystem> virtualTextures; // destroyed before the scene it takes textures from
+  std::unique_ptr<scene::TextureStreamer> textureStreamer; // destroyed before the scene it streams into
   std::unique_ptr<scene::SceneRenderer> opaqueRenderer;
-  std::unique_ptr<scene::ABufferRenderer> abufferRenderer;
-  std::unique_ptr<scene::ABufferResolver> abufferResolver;
-  std::unique_ptr<scene::TexBlender> texBlender;
+  std::unique_ptr<scene::TransparencyRenderer> transparencyRenderer;
   std::unique_ptr<renderer::TAA> taaPass;
+  std::unique_ptr<renderer::MipGenerator> mipGenerator;
 
   Camera camera;
   CameraSystem cameraUpdater {1.0f, 0.3f};
@@ -270,9 +718,26 @@ private:
 
 int main(int argc, char **argv)
 {
+  std::string path = "assets/ABeautifulGame/ABeautifulGame_transperent.gltf";
+  bool benchmarkAccessors = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::string_view {argv[i]} == "--bench-accessors")
+      benchmarkAccessors = true;
+    else
+      path = argv[i];
+  }
+
+  // results go to the log, the run takes a few seconds
+  if (benchmarkAccessors)
+    scene::benchmark_accessor_kernels();
+
   EtnaSampleApp etnaApp {1920, 1080, 0.7};
   //etnaApp.loadScene("assets/FlightHelmet/FlightHelmet.gltf");
-  etnaApp.loadScene("assets/ABeautifulGame/ABeautifulGame_transperent.gltf");
+  if (path.ends_with(".world"))
+    etnaApp.loadWorld(path);
+  else
+    etnaApp.loadScene(path);
   etnaApp.mainLoop();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef RENDERER_FRAME_RING_HPP_INCLUDED
+#define RENDERER_FRAME_RING_HPP_INCLUDED
+
+#include <etna/GlobalContext.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer
+{
+
+// Copies of per frame transient resources, one slot per frame in flight. Every frame moves to the next
+// slot with next(), the slot was last used frames in flight ago, so the GPU is done with it and it can be
+// rewritten or replaced without waiting for the frames still running. Resources that are read as history
+// by the next frame need an extra slot, see FrameRing(extra_slots).
+template<typename T>
+struct FrameRing
+{
+  // getNumFramesInFlight() + extra_slots slots of default constructed T
+  explicit FrameRing(uint32_t extra_slots = 0)
+    : slots(etna::get_context().getNumFramesInFlight() + extra_slots)
+  {}
+
+  // moves to the slot of a new frame and returns it
+  T &next()
+  {
+    index = (index + 1) % slots.size();
+    return slots[index];
+  }
+
+  T &get() { return slots[index]; }
+  const T &get() const { return slots[index]; }
+
+  // slot of the frame before the current one
+  const T &previous() const { return slots[(index + slots.size() - 1) % slots.size()]; }
+
+  uint32_t size() const { return uint32_t(slots.size()); }
+
+  // all slots, to recreate or measure the resources
+  auto begin() { return slots.begin(); }
+  auto end() { return slots.end(); }
+  auto begin() const { return slots.begin(); }
+  auto end() const { return slots.end(); }
+
+private:
+  std::vector<T> slots;
+  uint32_t index = 0;
+};
+
+} // namespace renderer
+
+#endif
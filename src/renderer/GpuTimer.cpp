@@ -0,0 +1,74 @@
+#include "GpuTimer.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+namespace renderer
+{
+
+GpuTimer::GpuTimer(uint32_t max_scopes)
+  : maxScopes {max_scopes}
+{
+  auto &ctx = etna::get_context();
+  timestampPeriodNs = ctx.getPhysicalDevice().getProperties().limits.timestampPeriod;
+
+  vk::QueryPoolCreateInfo info {
+    .queryType = vk::QueryType::eTimestamp,
+    .queryCount = 2 * maxScopes
+  };
+
+  frames.resize(ctx.getNumFramesInFlight());
+  for (auto &frame : frames)
+    frame.pool = ctx.getDevice().createQueryPoolUnique(info).value;
+}
+
+void GpuTimer::beginFrame(etna::SyncCommandBuffer &cmd)
+{
+  // the slot of the current frame was submitted frames in flight ago and is complete by now
+  auto &frame = frames[frameIndex++ % frames.size()];
+  if (!frame.scopes.empty())
+  {
+    std::vector<uint64_t> timestamps(2 * frame.scopes.size());
+    auto res = etna::get_context().getDevice().getQueryPoolResults(frame.pool.get(), 0, uint32_t(timestamps.size()),
+      timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    if (res == vk::Result::eSuccess)
+    {
+      for (size_t i = 0; i < frame.scopes.size(); i++)
+        results[frame.scopes[i]] = double(timestamps[2 * i + 1] - timestamps[2 * i]) * timestampPeriodNs * 1e-6;
+    }
+  }
+
+  frame.scopes.clear();
+  cmd.getRenderCmd().resetQueryPool(frame.pool.get(), 0, 2 * maxScopes);
+}
+
+std::optional<uint32_t> GpuTimer::begin(etna::SyncCommandBuffer &cmd, const std::string &name)
+{
+  auto &frame = frames[(frameIndex - 1) % frames.size()];
+  if (frame.scopes.size() >= maxScopes)
+    return std::nullopt;
+
+  uint32_t scope = uint32_t(frame.scopes.size());
+  frame.scopes.push_back(name);
+  cmd.getRenderCmd().writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.pool.get(), 2 * scope);
+  return scope;
+}
+
+void GpuTimer::end(etna::SyncCommandBuffer &cmd, std::optional<uint32_t> scope)
+{
+  if (!scope)
+    return;
+
+  auto &frame = frames[(frameIndex - 1) % frames.size()];
+  cmd.getRenderCmd().writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.pool.get(), 2 * *scope + 1);
+}
+
+std::optional<double> GpuTimer::getMs(const std::string &name) const
+{
+  auto it = results.find(name);
+  if (it == results.end())
+    return std::nullopt;
+  return it->second;
+}
+
+} // namespace renderer
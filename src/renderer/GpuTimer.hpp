@@ -0,0 +1,47 @@
+#ifndef RENDERER_GPU_TIMER_HPP_INCLUDED
+#define RENDERER_GPU_TIMER_HPP_INCLUDED
+
+#include <etna/SyncCommandBuffer.hpp>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer
+{
+
+// GPU durations of named scopes from timestamp queries. Every frame in flight has its own query pool,
+// results are read when the frame comes around again and lag by frames in flight.
+struct GpuTimer
+{
+  explicit GpuTimer(uint32_t max_scopes = 16);
+
+  // Reads the results of the slot and resets its queries. Called once per frame before any scope,
+  // outside of rendering.
+  void beginFrame(etna::SyncCommandBuffer &cmd);
+
+  // nullopt once max_scopes scopes were started this frame
+  std::optional<uint32_t> begin(etna::SyncCommandBuffer &cmd, const std::string &name);
+  void end(etna::SyncCommandBuffer &cmd, std::optional<uint32_t> scope);
+
+  // last measured duration of the scope
+  std::optional<double> getMs(const std::string &name) const;
+
+private:
+  struct Frame
+  {
+    vk::UniqueQueryPool pool;
+    std::vector<std::string> scopes; // written this frame, a query pair each
+  };
+
+  std::vector<Frame> frames;
+  uint64_t frameIndex = 0;
+  uint32_t maxScopes;
+  double timestampPeriodNs = 1.0;
+  std::unordered_map<std::string, double> results;
+};
+
+} // namespace renderer
+
+#endif
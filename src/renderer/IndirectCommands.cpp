@@ -0,0 +1,42 @@
+#include "IndirectCommands.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+namespace renderer
+{
+
+void indirect_args_barrier(etna::SyncCommandBuffer &cmd, const etna::Buffer &args)
+{
+  vk::BufferMemoryBarrier barrier {
+    .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+    .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = args.get(),
+    .offset = 0,
+    .size = VK_WHOLE_SIZE
+  };
+
+  cmd.getRenderCmd().pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+    vk::PipelineStageFlagBits::eDrawIndirect, {}, {}, {barrier}, {});
+}
+
+void dispatch_indirect(etna::SyncCommandBuffer &cmd, const etna::Buffer &args, vk::DeviceSize offset)
+{
+  indirect_args_barrier(cmd, args);
+  cmd.dispatch(0u, 0u, 0u);
+  cmd.getRenderCmd().dispatchIndirect(args.get(), offset);
+}
+
+void draw_indexed_indirect(etna::SyncCommandBuffer &cmd, const etna::Buffer &commands, vk::DeviceSize offset,
+  uint32_t count, uint32_t stride)
+{
+  auto &limits = etna::get_context().getPhysicalDevice().getProperties().limits;
+  ETNA_ASSERTF(count <= limits.maxDrawIndirectCount, "Indirect draw : {} commands, the device limit is {}",
+    count, limits.maxDrawIndirectCount);
+
+  cmd.drawIndexed(0u, 0u, 0u, 0, 0u);
+  cmd.getRenderCmd().drawIndexedIndirect(commands.get(), offset, count, stride);
+}
+
+} // namespace renderer
@@ -0,0 +1,30 @@
+#ifndef RENDERER_INDIRECT_COMMANDS_HPP_INCLUDED
+#define RENDERER_INDIRECT_COMMANDS_HPP_INCLUDED
+
+#include <etna/Buffer.hpp>
+#include <etna/SyncCommandBuffer.hpp>
+
+namespace renderer
+{
+
+// SyncCommandBuffer has no indirect commands and does not track indirect argument reads, these record
+// them on cmd.getRenderCmd(). Before the raw command an empty dispatch or draw goes through cmd, so the
+// barriers for the bound descriptor set are recorded as for a regular one. Indirect arguments are written
+// by compute shaders, their reads get an explicit barrier.
+
+// Makes compute shader writes to args visible to indirect reads. Records a pipeline barrier, call it
+// outside of rendering.
+void indirect_args_barrier(etna::SyncCommandBuffer &cmd, const etna::Buffer &args);
+
+// vk::DispatchIndirectCommand at offset, with the bound compute pipeline and descriptor set. Records
+// indirect_args_barrier for args first.
+void dispatch_indirect(etna::SyncCommandBuffer &cmd, const etna::Buffer &args, vk::DeviceSize offset);
+
+// count vk::DrawIndexedIndirectCommand at offset, inside rendering. indirect_args_barrier has to be recorded
+// for commands before rendering began. Needs the multiDrawIndirect feature for count > 1.
+void draw_indexed_indirect(etna::SyncCommandBuffer &cmd, const etna::Buffer &commands, vk::DeviceSize offset,
+  uint32_t count, uint32_t stride);
+
+} // namespace renderer
+
+#endif
@@ -0,0 +1,112 @@
+#include "MipGenerator.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include <cstring>
+
+namespace renderer
+{
+
+// keep in sync with SPD.glsl
+static constexpr uint32_t SPD_MAX_MIPS = 13;
+static constexpr uint32_t SPD_TILE = 64;
+
+struct SPDPushConsts
+{
+  uint32_t mipsCount;
+  uint32_t filterMode;
+  uint32_t groupsCount;
+};
+
+MipGenerator::MipGenerator(const std::string &prog_prefix)
+{
+  auto &pipelineManager = etna::get_context().getPipelineManager();
+  rgba8Pipeline = pipelineManager.createComputePipeline(prog_prefix + "_rgba8", {});
+  rgba16fPipeline = pipelineManager.createComputePipeline(prog_prefix + "_rgba16f", {});
+  r32fPipeline = pipelineManager.createComputePipeline(prog_prefix + "_r32f", {});
+
+  counter = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(uint32_t),
+    .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+  });
+
+  auto ptr = counter.map();
+  std::memset(ptr, 0, sizeof(uint32_t));
+  counter.unmap();
+}
+
+bool MipGenerator::isFormatSupported(vk::Format format)
+{
+  switch (format)
+  {
+  case vk::Format::eR8G8B8A8Unorm:
+  case vk::Format::eR16G16B16A16Sfloat:
+  case vk::Format::eR32Sfloat:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool MipGenerator::isImageSupported(vk::Format format, uint32_t width, uint32_t height)
+{
+  return isFormatSupported(format) && std::max(width, height) <= (SPD_TILE << 6);
+}
+
+const etna::ComputePipeline &MipGenerator::getPipeline(vk::Format format) const
+{
+  switch (format)
+  {
+  case vk::Format::eR16G16B16A16Sfloat:
+    return rgba16fPipeline;
+  case vk::Format::eR32Sfloat:
+    return r32fPipeline;
+  default:
+    return rgba8Pipeline;
+  }
+}
+
+void MipGenerator::generate(etna::SyncCommandBuffer &cmd, const etna::Image &image, MipFilter filter)
+{
+  const auto &info = image.getInfo();
+  uint32_t mipsCount = info.mipLevels;
+  if (mipsCount <= 1)
+    return;
+
+  ETNA_ASSERTF(isFormatSupported(info.format), "MipGenerator : unsupported format {}", vk::to_string(info.format));
+  ETNA_ASSERTF(std::max(info.extent.width, info.extent.height) <= (SPD_TILE << 6),
+    "MipGenerator : {}x{} image is too large", info.extent.width, info.extent.height);
+
+  const auto &pipeline = getPipeline(info.format);
+  auto pipelineInfo = etna::get_shader_program(pipeline.getShaderProgram());
+
+  std::vector<etna::Binding> bindings;
+  bindings.reserve(SPD_MAX_MIPS + 1);
+  for (uint32_t slot = 0; slot < SPD_MAX_MIPS; slot++)
+  {
+    etna::Image::ViewParams view {};
+    view.baseMip = std::min(slot, mipsCount - 1);
+    view.levelCount = 1;
+    bindings.push_back(etna::Binding {0, image.genBinding({}, vk::ImageLayout::eGeneral, view), slot});
+  }
+  bindings.push_back(etna::Binding {1, counter.genBinding()});
+
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), bindings);
+
+  uint32_t groupsX = (info.extent.width + SPD_TILE - 1) / SPD_TILE;
+  uint32_t groupsY = (info.extent.height + SPD_TILE - 1) / SPD_TILE;
+
+  SPDPushConsts pc {
+    .mipsCount = std::min(mipsCount, SPD_MAX_MIPS),
+    .filterMode = uint32_t(filter),
+    .groupsCount = groupsX * groupsY
+  };
+
+  cmd.bindPipeline(pipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  cmd.pushConstants(pipeline.getShaderProgram(), 0, pc);
+  cmd.dispatch(groupsX, groupsY, 1);
+}
+
+} // namespace renderer
@@ -0,0 +1,47 @@
+#ifndef RENDERER_MIP_GENERATOR_HPP_INCLUDED
+#define RENDERER_MIP_GENERATOR_HPP_INCLUDED
+
+#include <etna/Buffer.hpp>
+#include <etna/Image.hpp>
+#include <etna/ComputePipeline.hpp>
+#include <etna/SyncCommandBuffer.hpp>
+
+#include <string>
+
+namespace renderer
+{
+
+enum class MipFilter : uint32_t
+{
+  Box,
+  BoxSRGB, // unorm image holding sRGB encoded color, averaged in linear space
+  Min, // conservative depth pyramids
+  Max
+};
+
+// Generates the whole mip chain from mip 0 in a single compute dispatch.
+// Works for loaded textures and render target pyramids alike, the image needs eStorage usage,
+// one of the supported formats and a mip 0 of at most 4096x4096.
+struct MipGenerator
+{
+  // expects programs prog_prefix + "_rgba8", "_rgba16f" and "_r32f"
+  MipGenerator(const std::string &prog_prefix);
+
+  void generate(etna::SyncCommandBuffer &cmd, const etna::Image &image, MipFilter filter);
+
+  static bool isFormatSupported(vk::Format format);
+  // format and mip 0 size, callers fall back to blits otherwise
+  static bool isImageSupported(vk::Format format, uint32_t width, uint32_t height);
+
+private:
+  const etna::ComputePipeline &getPipeline(vk::Format format) const;
+
+  etna::ComputePipeline rgba8Pipeline;
+  etna::ComputePipeline rgba16fPipeline;
+  etna::ComputePipeline r32fPipeline;
+  etna::Buffer counter; // finished workgroups, reset by the last one
+};
+
+} // namespace renderer
+
+#endif
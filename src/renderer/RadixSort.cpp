@@ -0,0 +1,145 @@
+#include "RadixSort.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include <algorithm>
+
+namespace renderer
+{
+
+struct RadixSortPushConsts
+{
+  uint32_t count;
+  uint32_t shift;
+  uint32_t keyWords;
+  uint32_t pass;
+};
+
+static uint32_t get_blocks(uint32_t count)
+{
+  return (count + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+}
+
+RadixSort::RadixSort(const std::string &prog_prefix)
+{
+  auto &pipelineManager = etna::get_context().getPipelineManager();
+  countPipeline = pipelineManager.createComputePipeline(prog_prefix + "_count", {});
+  scanPipeline = pipelineManager.createComputePipeline(prog_prefix + "_scan", {});
+  scatterPipeline = pipelineManager.createComputePipeline(prog_prefix + "_scatter", {});
+}
+
+void RadixSort::reserve(uint32_t count, RadixSortKey key_type)
+{
+  capacity = std::max(count, capacity);
+  capacityKeyWords = std::max(uint32_t(key_type), capacityKeyWords);
+}
+
+void RadixSort::growScratch(Scratch &scratch)
+{
+  if (scratch.capacity >= capacity && scratch.capacityKeyWords >= capacityKeyWords)
+    return;
+
+  // the slot was last used frames in flight ago, its buffers can be replaced
+  scratch.capacity = capacity;
+  scratch.capacityKeyWords = capacityKeyWords;
+
+  auto createBuffer = [](uint64_t size) {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = std::max<uint64_t>(size, sizeof(uint32_t)),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+    });
+  };
+
+  uint64_t histogramCount = uint64_t(RADIX_SORT_BINS) * get_blocks(capacity);
+  scratch.keys = createBuffer(uint64_t(capacity) * capacityKeyWords * sizeof(uint32_t));
+  scratch.values = createBuffer(uint64_t(capacity) * sizeof(uint32_t));
+  scratch.histograms = createBuffer(histogramCount * sizeof(uint32_t));
+  scratch.groupSums =
+    createBuffer((histogramCount + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE * sizeof(uint32_t));
+}
+
+uint64_t RadixSort::getMemoryBytes() const
+{
+  uint64_t bytes = 0;
+  for (auto &scratch : scratches)
+    if (scratch.capacity)
+      bytes += scratch.keys.getSize() + scratch.values.getSize() + scratch.histograms.getSize()
+        + scratch.groupSums.getSize();
+  return bytes;
+}
+
+void RadixSort::sort(etna::SyncCommandBuffer &cmd, const etna::Buffer &keys, const etna::Buffer &values,
+  uint32_t count, RadixSortKey key_type)
+{
+  if (count <= 1)
+    return;
+
+  uint32_t keyWords = uint32_t(key_type);
+  reserve(count, key_type);
+  auto &scratch = scratches.next();
+  growScratch(scratch);
+  const etna::Buffer &histograms = scratch.histograms;
+
+  uint32_t blocks = get_blocks(count);
+  uint32_t histogramGroups = (RADIX_SORT_BINS * blocks + RADIX_SORT_BLOCK_SIZE - 1) / RADIX_SORT_BLOCK_SIZE;
+  uint32_t passes = keyWords * 32 / RADIX_SORT_BITS;
+
+  auto countInfo = etna::get_shader_program(countPipeline.getShaderProgram());
+  auto scanInfo = etna::get_shader_program(scanPipeline.getShaderProgram());
+  auto scatterInfo = etna::get_shader_program(scatterPipeline.getShaderProgram());
+
+  auto scanSet = etna::create_descriptor_set(scanInfo.getDescriptorLayoutId(0), {
+    etna::Binding {0, histograms.genBinding()},
+    etna::Binding {1, scratch.groupSums.genBinding()}
+  });
+
+  for (uint32_t pass = 0; pass < passes; pass++)
+  {
+    // even passes read the input, odd ones the scratch
+    bool fromInput = pass % 2 == 0;
+    const etna::Buffer &srcKeys = fromInput ? keys : scratch.keys;
+    const etna::Buffer &srcValues = fromInput ? values : scratch.values;
+    const etna::Buffer &dstKeys = fromInput ? scratch.keys : keys;
+    const etna::Buffer &dstValues = fromInput ? scratch.values : values;
+
+    RadixSortPushConsts params {
+      .count = count,
+      .shift = pass * RADIX_SORT_BITS,
+      .keyWords = keyWords,
+      .pass = 0
+    };
+
+    auto countSet = etna::create_descriptor_set(countInfo.getDescriptorLayoutId(0), {
+      etna::Binding {0, srcKeys.genBinding()},
+      etna::Binding {1, histograms.genBinding()}
+    });
+    cmd.bindPipeline(countPipeline);
+    cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, countInfo.getPipelineLayout(), 0, countSet);
+    cmd.pushConstants(countPipeline.getShaderProgram(), 0, params);
+    cmd.dispatch(blocks, 1u, 1u);
+
+    // group totals are scanned by a single workgroup
+    cmd.bindPipeline(scanPipeline);
+    cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, scanInfo.getPipelineLayout(), 0, scanSet);
+    for (uint32_t scanPass = 0; scanPass < 3; scanPass++)
+    {
+      params.pass = scanPass;
+      cmd.pushConstants(scanPipeline.getShaderProgram(), 0, params);
+      cmd.dispatch(scanPass == 1 ? 1u : histogramGroups, 1u, 1u);
+    }
+
+    auto scatterSet = etna::create_descriptor_set(scatterInfo.getDescriptorLayoutId(0), {
+      etna::Binding {0, srcKeys.genBinding()},
+      etna::Binding {1, srcValues.genBinding()},
+      etna::Binding {2, dstKeys.genBinding()},
+      etna::Binding {3, dstValues.genBinding()},
+      etna::Binding {4, histograms.genBinding()}
+    });
+    cmd.bindPipeline(scatterPipeline);
+    cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, scatterInfo.getPipelineLayout(), 0, scatterSet);
+    cmd.pushConstants(scatterPipeline.getShaderProgram(), 0, params);
+    cmd.dispatch(blocks, 1u, 1u);
+  }
+}
+
+} // namespace renderer
@@ -0,0 +1,71 @@
+#ifndef RENDERER_RADIX_SORT_HPP_INCLUDED
+#define RENDERER_RADIX_SORT_HPP_INCLUDED
+
+#include "FrameRing.hpp"
+
+#include <etna/Buffer.hpp>
+#include <etna/ComputePipeline.hpp>
+#include <etna/SyncCommandBuffer.hpp>
+
+#include <string>
+
+namespace renderer
+{
+
+// keep in sync with RadixSort.glsl
+constexpr uint32_t RADIX_SORT_BITS = 4;
+constexpr uint32_t RADIX_SORT_BINS = 1u << RADIX_SORT_BITS;
+constexpr uint32_t RADIX_SORT_BLOCK_SIZE = 1024;
+
+enum class RadixSortKey : uint32_t
+{
+  Uint32 = 1,
+  Uint64 = 2 // stored as the low uint32 word followed by the high one
+};
+
+// Stable ascending GPU sort of key/value pairs, values are uint32. Least significant digit first, a pass
+// per RADIX_SORT_BITS of the key: a digit histogram of every block of RADIX_SORT_BLOCK_SIZE pairs, a prefix
+// sum of the histograms and a scatter that ranks pairs within their block in shared memory. Passes ping-pong
+// between the input and scratch buffers, their count is even, so the sorted pairs end up in the input.
+// Scratch buffers are kept per frame in flight, a RadixSort runs one sort per frame.
+struct RadixSort
+{
+  // expects programs prog_prefix + "_count", "_scan" and "_scatter"
+  RadixSort(const std::string &prog_prefix);
+
+  // Scratch buffers will hold at least count pairs of key_type. They are grown by sort() as it reaches
+  // each slot, buffers frames in flight still use are never replaced.
+  void reserve(uint32_t count, RadixSortKey key_type);
+
+  // keys and values need storage usage and hold at least count pairs, moves to the scratch of a new frame
+  // and grows it if needed
+  void sort(etna::SyncCommandBuffer &cmd, const etna::Buffer &keys, const etna::Buffer &values, uint32_t count,
+    RadixSortKey key_type);
+
+  uint64_t getMemoryBytes() const;
+
+private:
+  etna::ComputePipeline countPipeline;
+  etna::ComputePipeline scanPipeline;
+  etna::ComputePipeline scatterPipeline;
+
+  struct Scratch
+  {
+    etna::Buffer keys;
+    etna::Buffer values;
+    etna::Buffer histograms;
+    etna::Buffer groupSums; // histogram scan totals
+    uint32_t capacity = 0;
+    uint32_t capacityKeyWords = 0;
+  };
+
+  void growScratch(Scratch &scratch);
+
+  FrameRing<Scratch> scratches;
+  uint32_t capacity = 0; // pairs, requested for every slot
+  uint32_t capacityKeyWords = 0;
+};
+
+} // namespace renderer
+
+#endif
@@ -1,62 +1,354 @@
 #include "ABufferRenderer.hpp"
+#include "VirtualTextures.hpp"
+#include "renderer/IndirectCommands.hpp"
 
 #include <etna/GlobalContext.hpp>
 #include <etna/RenderTargetStates.hpp>
 
+#include <algorithm>
+#include <array>
+
 namespace scene
 {
 
-constexpr uint32_t LIST_MULT = 4;
+// capacity changes are rounded to this many fragments, so the list is not recreated for small changes
+constexpr uint64_t FRAGMENT_GRANULARITY = 1ull << 16;
 
-ABufferResolver::ABufferResolver(const std::string &prog_name, glm::uvec2 resolution)
+void draw_transparent(etna::SyncCommandBuffer &cmd,
+  const etna::GraphicsPipeline &pipeline,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  std::span<const etna::Binding> extra_bindings)
+{
+  cmd.bindVertexBuffer(0, scene.getVertexBuff(), 0);
+  cmd.bindIndexBuffer(scene.getIndexBuff(), 0, vk::IndexType::eUint32);
+  cmd.bindPipeline(pipeline);
+  const auto &progInfo = etna::get_shader_program(pipeline.getShaderProgram());
+
+  for (uint32_t groupId = 0; groupId < draw_list.materialGropus.size(); groupId++)
+  {
+    auto &group = draw_list.materialGropus[groupId];
+    auto &material = scene.getMaterial(group.materialIndex);
+
+    MaterialBindState bindState;
+    auto [baseColorTex, baseColorSampler] = scene.getImageSampler(material.baseColorId);
+    auto [mrTex, mrSampler] = scene.getImageSampler(material.metallicRoughnessId);
+
+    if (!material.baseColorId.has_value())
+      bindState.renderFlags |= uint32_t(RenderFlags::NoBaseColorTex);
+
+    if (!material.metallicRoughnessId.has_value())
+      bindState.renderFlags |= uint32_t(RenderFlags::NoMetallicRougnessTex);
+
+    if (material.packedMetallicRoughness)
+      bindState.renderFlags |= uint32_t(RenderFlags::PackedMetallicRoughness);
+
+    auto baseColorBinding = baseColorTex->genBinding(
+        baseColorSampler, vk::ImageLayout::eShaderReadOnlyOptimal, baseColorTex->fullRangeView());
+
+    auto mrBinding = mrTex->genBinding(
+      mrSampler, vk::ImageLayout::eShaderReadOnlyOptimal, mrTex->fullRangeView());
+
+    std::vector<etna::Binding> bindings {
+      etna::Binding {0, gframe.getBinding()},
+      etna::Binding {1, baseColorBinding},
+      etna::Binding {2, mrBinding}
+    };
+    bindings.insert(bindings.end(), extra_bindings.begin(), extra_bindings.end());
+
+    bindState.vtBaseColor = vt.bindTexture(bindings, 5, material.baseColorId);
+    bindState.vtMetallicRoughness = vt.bindTexture(bindings, 7, material.metallicRoughnessId);
+
+    auto set = etna::create_descriptor_set(progInfo.getDescriptorLayoutId(0), bindings);
+    cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, progInfo.getPipelineLayout(), 0, set);
+
+    for (auto &dc : group.drawCalls)
+    {
+      for (auto &tId : dc.transformIds)
+      {
+        auto &transform = scene.getTransform(tId);
+        
+        //auto normalMat = transform.normalTransform * glm::transpose(glm::inverse(gframe.getParams().view));
+        auto normalMat = glm::transpose(glm::inverse(gframe.getParams().view * transform.modelTransform));
+
+        MaterialPushConstants mpc
+        {
+          .MVP = gframe.getParams().viewProjection * transform.modelTransform,
+          .normalsTransform = normalMat,
+          .baseColorFactor = material.baseColorFactor,
+          .metallic = material.metallicFactor,
+          .rougness = material.roughnessFactor,
+          .alphaCutoff = material.alphaCutoff,
+          .renderFlags = bindState.renderFlags,
+          .vtBaseColor = bindState.vtBaseColor,
+          .vtMetallicRoughness = bindState.vtMetallicRoughness
+        };
+
+        cmd.pushConstants(pipeline.getShaderProgram(), 0, mpc);
+        cmd.drawIndexed(dc.indexCount, 1, dc.firstIndex, dc.vertexOffset, groupId);
+      }
+    }
+  }
+}
+
+TileClassifier::TileClassifier(const std::string &prog_name, glm::uvec2 resolution)
 {
   pipeline = etna::get_context().getPipelineManager().createComputePipeline(prog_name, {});
+
+  for (auto &frame : frames)
+  {
+    frame.args = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = 3 * sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+        |vk::BufferUsageFlagBits::eIndirectBuffer
+        |vk::BufferUsageFlagBits::eTransferDst
+        |vk::BufferUsageFlagBits::eTransferSrc
+    });
+    frame.readback = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferDst,
+      .memoryUsage = VMA_MEMORY_USAGE_GPU_TO_CPU
+    });
+  }
+
   onResolutionChanged(resolution);
 }
 
-void ABufferResolver::onResolutionChanged(glm::uvec2 resolution)
+void TileClassifier::onResolutionChanged(glm::uvec2 new_resolution)
 {
-  etna::ImageCreateInfo info {
-    .format = vk::Format::eR8G8B8A8Unorm,
-    .extent {resolution.x, resolution.y, 1},
-    .imageUsage = vk::ImageUsageFlagBits::eStorage
-      |vk::ImageUsageFlagBits::eTransferDst
-      |vk::ImageUsageFlagBits::eSampled
+  resolution = new_resolution;
+  tilesCount = ((resolution.x + ABUFFER_TILE_SIZE - 1) / ABUFFER_TILE_SIZE)
+    * ((resolution.y + ABUFFER_TILE_SIZE - 1) / ABUFFER_TILE_SIZE);
+
+  auto createBuffer = [&]() {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = tilesCount * sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+        |vk::BufferUsageFlagBits::eTransferDst
+    });
   };
-  resolveTarget = etna::get_context().createImage(std::move(info));
+
+  for (auto &frame : frames)
+  {
+    frame.flags = createBuffer();
+    frame.tiles = createBuffer();
+  }
+}
+
+void TileClassifier::reset(etna::SyncCommandBuffer &cmd)
+{
+  // the slot of the new frame was written frames in flight ago and is complete by now
+  auto &frame = frames.next();
+  if (frame.classified)
+  {
+    lastActiveTiles = *reinterpret_cast<const uint32_t *>(frame.readback.map());
+    frame.readback.unmap();
+    frame.classified = false;
+  }
+
+  cmd.fillBuffer(frame.flags, 0, tilesCount * sizeof(uint32_t), 0u);
+}
+
+void TileClassifier::markAll(etna::SyncCommandBuffer &cmd)
+{
+  cmd.fillBuffer(frames.get().flags, 0, tilesCount * sizeof(uint32_t), 1u);
+}
+
+void TileClassifier::classify(etna::SyncCommandBuffer &cmd)
+{
+  auto &frame = frames.get();
+  cmd.fillBuffer(frame.args, 0, 3 * sizeof(uint32_t), 0u);
+
+  auto pipelineInfo = etna::get_shader_program(pipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+    {0, frame.flags.genBinding()},
+    {1, frame.tiles.genBinding()},
+    {2, frame.args.genBinding()}
+  });
+
+  cmd.bindPipeline(pipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  cmd.pushConstants(pipeline.getShaderProgram(), 0, tilesCount);
+  cmd.dispatch((tilesCount + 63u)/64u, 1u, 1u);
+
+  cmd.copyBuffer(frame.args, frame.readback, {vk::BufferCopy{.srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t)}});
+  frame.classified = true;
+}
+
+ABufferResolver::ABufferResolver(const std::string &prog_prefix)
+{
+  for (size_t i = 0; i < ABUFFER_RESOLVE_LAYERS.size(); i++)
+  {
+    pipelines[i] = etna::get_context().getPipelineManager().createComputePipeline(
+      prog_prefix + "_k" + std::to_string(ABUFFER_RESOLVE_LAYERS[i]), {});
+  }
+}
+
+void ABufferResolver::setLayers(uint32_t new_layers)
+{
+  ETNA_ASSERTF(std::ranges::find(ABUFFER_RESOLVE_LAYERS, new_layers) != ABUFFER_RESOLVE_LAYERS.end(),
+    "A-buffer : no resolve kernel for {} layers", new_layers);
+  layers = new_layers;
+}
+
+void ABufferResolver::dispatch(
+  etna::SyncCommandBuffer &cmd,
+  const etna::Image &listHead, 
+  const etna::Buffer &listSamples,
+  const etna::Image &target,
+  const TileClassifier &tiles)
+{
+  dispatch(cmd, layers, listHead, listSamples, target, tiles);
 }
 
 void ABufferResolver::dispatch(
   etna::SyncCommandBuffer &cmd,
-  const GlobalFrameConstantHandler &gframe, 
+  uint32_t kernel_layers,
   const etna::Image &listHead, 
-  const etna::Buffer &listSamples)
+  const etna::Buffer &listSamples,
+  const etna::Image &target,
+  const TileClassifier &tiles) const
 {
+  auto it = std::ranges::find(ABUFFER_RESOLVE_LAYERS, kernel_layers);
+  ETNA_ASSERTF(it != ABUFFER_RESOLVE_LAYERS.end(), "A-buffer : no resolve kernel for {} layers", kernel_layers);
+  auto &pipeline = pipelines[it - ABUFFER_RESOLVE_LAYERS.begin()];
   auto pipelineInfo = etna::get_shader_program(pipeline.getShaderProgram());
 
   auto listHeadBinding = listHead.genBinding({}, vk::ImageLayout::eGeneral, listHead.fullRangeView());
   auto listSamplesBinding = listSamples.genBinding();
-  auto outputBinding = resolveTarget.genBinding({}, vk::ImageLayout::eGeneral, resolveTarget.fullRangeView());
+  auto outputBinding = target.genBinding({}, vk::ImageLayout::eGeneral, target.fullRangeView());
 
   std::vector<etna::Binding> bindings {
-    {0, gframe.getBinding()},
-    {1, listHeadBinding},
-    {2, listSamplesBinding},
-    {3, outputBinding}
+    {0, listHeadBinding},
+    {1, listSamplesBinding},
+    {2, outputBinding},
+    {3, tiles.getTiles().genBinding()}
   };
 
   auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), bindings);
   cmd.bindPipeline(pipeline);
   cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
-  
-  uint32_t w = resolveTarget.getInfo().extent.width;
-  uint32_t h = resolveTarget.getInfo().extent.height;
+  renderer::dispatch_indirect(cmd, tiles.getArgs(), TileClassifier::DISPATCH_ARGS_OFFSET);
+}
+
+
+FragmentStorage::FragmentStorage(uint32_t entry_size, const ABufferConfig &storage_config)
+  : entrySize {entry_size}, config {storage_config}
+{
+  for (auto &frame : frames)
+  {
+    frame.counterReadback = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferDst,
+      .memoryUsage = VMA_MEMORY_USAGE_GPU_TO_CPU
+    });
+  }
+}
+
+void FragmentStorage::beginFrame(etna::SyncCommandBuffer &cmd)
+{
+  auto &frame = frames.next();
+  readCounter(frame);
+
+  // the buffer of this slot was last used frames in flight ago, it can be replaced right away
+  if (frame.capacity != capacity)
+  {
+    frame.buffer = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = ABUFFER_HEADER_SIZE + capacity * entrySize,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+        |vk::BufferUsageFlagBits::eTransferDst
+        |vk::BufferUsageFlagBits::eTransferSrc
+    });
+    frame.capacity = capacity;
+
+    stats.bufferBytes = 0;
+    for (auto &f : frames)
+      stats.bufferBytes += f.capacity ? ABUFFER_HEADER_SIZE + f.capacity * entrySize : 0;
+  }
+
+  cmd.fillBuffer(frame.buffer, 0, sizeof(uint32_t), 0u);
+  cmd.fillBuffer(frame.buffer, sizeof(uint32_t), sizeof(uint32_t), uint32_t(capacity));
+}
 
-  cmd.dispatch((w + 7u)/8, (h + 3u)/4u, 1u);
+void FragmentStorage::endFrame(etna::SyncCommandBuffer &cmd)
+{
+  // fragments past capacity are counted too, so the readback sees what the frame asked for
+  auto &frame = frames.get();
+  cmd.copyBuffer(frame.buffer, frame.counterReadback,
+    {vk::BufferCopy{.srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t)}});
+  frame.readbackCapacity = frame.capacity;
 }
 
+void FragmentStorage::readCounter(Frame &frame)
+{
+  // the slot of the new frame was written frames in flight ago and is complete by now
+  if (!frame.readbackCapacity)
+    return;
+
+  auto *data = reinterpret_cast<const uint32_t *>(frame.counterReadback.map());
+  uint64_t fragments = data[0];
+  frame.counterReadback.unmap();
+
+  stats.lastFragments = fragments;
+  stats.peakFragments = std::max(stats.peakFragments, fragments);
+  stats.windowPeak = std::max(stats.windowPeak, fragments);
+  if (fragments > frame.readbackCapacity)
+    stats.overflowFrames++;
+
+  auto withHeadroom = [&](uint64_t count) { return uint64_t(double(count) * (1.0 + config.headroom)); };
+
+  if (double(fragments) > double(capacity) * config.growThreshold)
+  {
+    resize(withHeadroom(fragments));
+  }
+  else if (++windowFrames >= config.shrinkWindow)
+  {
+    if (double(withHeadroom(stats.windowPeak)) < double(capacity) * config.shrinkThreshold)
+      resize(withHeadroom(stats.windowPeak));
+    windowFrames = 0;
+    stats.windowPeak = 0;
+  }
+}
 
-ABufferRenderer::ABufferRenderer(const std::string &prog_name, const etna::Image &depthRT)
+void FragmentStorage::resize(uint64_t fragments)
+{
+  // entries are addressed with 32 bit indices, ABUFFER_LIST_END is never a valid one
+  uint64_t maxFragments = std::min<uint64_t>((config.maxBytes - ABUFFER_HEADER_SIZE) / entrySize,
+    ABUFFER_LIST_END - 1);
+  fragments = (fragments + FRAGMENT_GRANULARITY - 1) / FRAGMENT_GRANULARITY * FRAGMENT_GRANULARITY;
+  fragments = std::clamp(fragments, std::min(config.minFragments, maxFragments), maxFragments);
+  if (fragments == capacity)
+    return;
+
+  if (capacity)
+  {
+    spdlog::info("A-buffer : {} -> {} fragments ({} MiB per frame), last frame requested {}",
+      capacity, fragments, (ABUFFER_HEADER_SIZE + fragments * entrySize) >> 20, stats.lastFragments);
+    stats.resizes++;
+  }
+
+  // buffers of the frames are replaced by beginFrame as they come
+  capacity = fragments;
+  stats.capacity = capacity;
+}
+
+void FragmentStorage::reset(uint64_t pixels)
+{
+  // counters read back from now on describe the new resolution
+  for (auto &frame : frames)
+    frame.readbackCapacity = 0;
+  windowFrames = 0;
+  stats.windowPeak = 0;
+
+  capacity = 0;
+  resize(config.initialFragmentsPerPixel * pixels);
+}
+
+ABufferRenderer::ABufferRenderer(const std::string &prog_name, const etna::Image &depthRT,
+  const ABufferConfig &config)
+  : fragments {sizeof(FragmentEntry), config}
 {
   etna::GraphicsPipeline::CreateInfo info {};
 
@@ -74,70 +366,41 @@ ABufferRenderer::ABufferRenderer(const std::string &prog_name, const etna::Image
   onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
 }
 
-void ABufferRenderer::attachToScene(const GLTFScene &scene)
+void ABufferRenderer::attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt)
 {
+  virtualTextures = &vt;
   sceneData = scene.queryDrawCalls([](const GLTFScene::Material &material) {
     return material.mode == GLTFScene::MaterialMode::Blend;
   }); 
 }
 
-uint32_t ABufferRenderer::bindDS(
-  etna::SyncCommandBuffer &cmd, 
-  const GlobalFrameConstantHandler &gframe,
-  const GLTFScene::Material &material, 
-  const GLTFScene &scene)
-{
-  uint32_t renderFlags = 0;
-  
-  auto [baseColorTex, baseColorSampler] = scene.getImageSampler(material.baseColorId);
-  auto [mrTex, mrSampler] = scene.getImageSampler(material.metallicRoughnessId);
-
-  if (!material.baseColorId.has_value())
-    renderFlags |= uint32_t(RenderFlags::NoBaseColorTex);
-
-  if (!material.metallicRoughnessId.has_value())
-    renderFlags |= uint32_t(RenderFlags::NoMetallicRougnessTex);
-
-  auto baseColorBinding = baseColorTex->genBinding(
-      baseColorSampler, vk::ImageLayout::eShaderReadOnlyOptimal, baseColorTex->fullRangeView());
-
-  auto mrBinding = mrTex->genBinding(
-    mrSampler, vk::ImageLayout::eShaderReadOnlyOptimal, mrTex->fullRangeView());
-
-  auto listHeadBinding = listHead.genBinding({}, vk::ImageLayout::eGeneral, listHead.fullRangeView());
-  auto fragmentsBinding = fragmentList.genBinding();
-  
-  std::vector<etna::Binding> bindings {
-    etna::Binding {0, gframe.getBinding()},
-    etna::Binding {1, baseColorBinding},
-    etna::Binding {2, mrBinding},
-    etna::Binding {3, listHeadBinding},
-    etna::Binding {4, fragmentsBinding}
-  };
-
-  const auto &info = etna::get_shader_program(pipeline.getShaderProgram()); 
-  auto set = etna::create_descriptor_set(info.getDescriptorLayoutId(0), bindings);
-  cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, info.getPipelineLayout(), 0, set);
-
-  return renderFlags;
-}
-
 void ABufferRenderer::render(etna::SyncCommandBuffer &cmd,
   const etna::Image &depthRT, 
   const GlobalFrameConstantHandler &gframe,
-  const GLTFScene &scene)
+  const GLTFScene &scene,
+  const TileClassifier &tiles)
 {
+  fragments.beginFrame(cmd);
+  auto &listHead = listHeads.next();
+
   vk::ClearColorValue clearVal {};
   clearVal.setUint32({ABUFFER_LIST_END, ABUFFER_LIST_END, ABUFFER_LIST_END, ABUFFER_LIST_END});
   cmd.clearColorImage(listHead, vk::ImageLayout::eGeneral, clearVal, {
     vk::ImageSubresourceRange {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}
   });
 
-  cmd.fillBuffer(fragmentList, 0, sizeof(uint32_t), 0u);
+  if (sceneData.materialGropus.size())
+    drawFragments(cmd, depthRT, gframe, scene, tiles);
 
-  if (!sceneData.materialGropus.size())
-    return;
+  fragments.endFrame(cmd);
+}
 
+void ABufferRenderer::drawFragments(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const TileClassifier &tiles)
+{
   vk::Extent2D extent {
     depthRT.getInfo().extent.width, 
     depthRT.getInfo().extent.height
@@ -149,115 +412,36 @@ void ABufferRenderer::render(etna::SyncCommandBuffer &cmd,
     .loadOp = vk::AttachmentLoadOp::eLoad
   };
   
-  etna::RenderTargetState rts{cmd, extent, {}, depthAttachment};
-  cmd.bindVertexBuffer(0, scene.getVertexBuff(), 0);
-  cmd.bindIndexBuffer(scene.getIndexBuff(), 0, vk::IndexType::eUint32);
-  cmd.bindPipeline(pipeline);
-  auto progInfo = etna::get_shader_program(pipeline.getShaderProgram());
-  
-  for (auto &group : sceneData.materialGropus)
-  {
-    auto &material = scene.getMaterial(group.materialIndex);
-    auto renderFlags = bindDS(cmd, gframe, material, scene);
-    
-    for (auto &dc : group.drawCalls)
-    {
-      for (auto &tId : dc.transformIds)
-      {
-        auto &transform = scene.getTransform(tId);
-        
-        //auto normalMat = transform.normalTransform * glm::transpose(glm::inverse(gframe.getParams().view));
-        auto normalMat = glm::transpose(glm::inverse(gframe.getParams().view * transform.modelTransform));
-
-        MaterialPushConstants mpc
-        {
-          .MVP = gframe.getParams().viewProjection * transform.modelTransform,
-          .normalsTransform = normalMat,
-          .baseColorFactor = material.baseColorFactor,
-          .metallic = material.metallicFactor,
-          .rougness = material.roughnessFactor,
-          .alphaCutoff = material.alphaCutoff,
-          .renderFlags = renderFlags
-        };
-
-        cmd.pushConstants(pipeline.getShaderProgram(), 0, mpc);
-        cmd.drawIndexed(dc.indexCount, 1, dc.firstIndex, dc.vertexOffset, 0);
-      }
-    }
-  }
-}
-
-void ABufferRenderer::onResolutionChanged(uint32_t w, uint32_t h)
-{
-  etna::ImageCreateInfo listHeadInfo {
-    .format = vk::Format::eR32Uint,
-    .extent {w, h, 1},
-    .imageUsage = vk::ImageUsageFlagBits::eStorage
-      |vk::ImageUsageFlagBits::eTransferDst
-      |vk::ImageUsageFlagBits::eSampled
+  auto &listHead = listHeads.get();
+  std::array<etna::Binding, 3> bindings {
+    etna::Binding {3, listHead.genBinding({}, vk::ImageLayout::eGeneral, listHead.fullRangeView())},
+    etna::Binding {4, fragments.getBuffer().genBinding()},
+    etna::Binding {9, tiles.getFlags().genBinding()}
   };
 
-  listHead = etna::get_context().createImage(std::move(listHeadInfo));
-
-  uint32_t pixels = listHead.getInfo().extent.width * listHead.getInfo().extent.height;
-
-  fragmentList = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = sizeof(uint32_t) + LIST_MULT * pixels * sizeof(FragmentEntry),
-    .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferDst
-  });
+  etna::RenderTargetState rts{cmd, extent, {}, depthAttachment};
+  draw_transparent(cmd, pipeline, gframe, scene, sceneData, *virtualTextures, bindings);
 }
 
-TexBlender::TexBlender(const std::string &name, vk::Format dstFmt)
+void ABufferRenderer::onResolutionChanged(uint32_t w, uint32_t h)
 {
-  vk::SamplerCreateInfo info {
-    .magFilter = vk::Filter::eLinear,
-    .minFilter = vk::Filter::eLinear,
-    .mipmapMode = vk::SamplerMipmapMode::eNearest,
-    .addressModeU = vk::SamplerAddressMode::eClampToEdge,
-    .addressModeV = vk::SamplerAddressMode::eClampToEdge,
-    .addressModeW = vk::SamplerAddressMode::eRepeat,
-    .maxLod = VK_LOD_CLAMP_NONE
-  };
-
-  sampler = etna::get_context().getDevice().createSamplerUnique(info).value;
-
-  vk::PipelineColorBlendAttachmentState blendState {
-    .blendEnable = VK_TRUE,
-    .srcColorBlendFactor = vk::BlendFactor::eSrcColor,
-    .dstColorBlendFactor = vk::BlendFactor::eDstColor,
-    .colorBlendOp = vk::BlendOp::eAdd,
-    .srcAlphaBlendFactor = vk::BlendFactor::eSrcAlpha,
-    .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
-    .alphaBlendOp = vk::BlendOp::eAdd,
-    .colorWriteMask = vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA
-  };
-
-  etna::GraphicsPipeline::CreateInfo pInfo {};
-  pInfo.fragmentShaderOutput.colorAttachmentFormats.push_back(dstFmt);
-  pInfo.blendingConfig.attachments[0] = blendState;
-  pipeline = etna::get_context().getPipelineManager().createGraphicsPipeline(name, pInfo);
+  for (auto &listHead : listHeads)
+  {
+    listHead = etna::get_context().createImage(etna::ImageCreateInfo {
+      .format = vk::Format::eR32Uint,
+      .extent {w, h, 1},
+      .imageUsage = vk::ImageUsageFlagBits::eStorage
+        |vk::ImageUsageFlagBits::eTransferDst
+        |vk::ImageUsageFlagBits::eSampled
+    });
+  }
+  fragments.reset(uint64_t(w) * h);
 }
 
-void TexBlender::blend(etna::SyncCommandBuffer &cmd, const etna::Image &overlay, const etna::Image &dst)
+uint64_t ABufferRenderer::getMemoryBytes() const
 {
-  vk::Extent2D ext {dst.getInfo().extent.width, dst.getInfo().extent.height};
-
-  etna::RenderingAttachment dstAttachment {
-    .view = dst.getView({}),
-    .layout = vk::ImageLayout::eColorAttachmentOptimal,
-    .loadOp = vk::AttachmentLoadOp::eLoad
-  };
-
-  auto pInfo = etna::get_shader_program(pipeline.getShaderProgram()); 
-  auto set = etna::create_descriptor_set(pInfo.getDescriptorLayoutId(0), {
-    {0, overlay.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}
-  });
-
-  etna::RenderTargetState rts {cmd, ext, {dstAttachment}, {}};
-  
-  cmd.bindPipeline(pipeline);
-  cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, pInfo.getPipelineLayout(), 0, set);
-  cmd.draw(3, 1, 0, 0);
+  auto &extent = listHeads.get().getInfo().extent;
+  return fragments.getStats().bufferBytes + listHeads.size() * uint64_t(extent.width) * extent.height * sizeof(uint32_t);
 }
 
 } // namespace scene
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define SCENE_ABUFFER_RENDERER_HPP_INCLUDED
 
 #include "SceneRenderer.hpp"
+#include "renderer/FrameRing.hpp"
+
+#include <array>
+#include <span>
 
 namespace scene
 {
@@ -15,63 +19,207 @@ struct FragmentEntry
   uint32_t link;
 };
 
-struct ABufferResolver
+// entry of the prefix sum layout, fragments of a pixel are stored contiguously and need no link
+struct PackedFragment
 {
-  ABufferResolver(const std::string &prog_name, glm::uvec2 resolution);
+  float depth;
+  uint32_t color;
+};
+
+// fragment buffer header: fragments counter and capacity, entries follow
+constexpr uint32_t ABUFFER_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+// The fragment buffer is sized from fragment counters read back frames in flight later
+struct ABufferConfig
+{
+  uint32_t initialFragmentsPerPixel = 4; // until the first counters are read back
+  float headroom = 0.25f; // capacity kept above the observed high-water mark
+  float growThreshold = 0.9f; // grow once a frame requests more than this part of the capacity
+  // shrink once the high-water mark of a window with headroom stays below this part of the capacity
+  float shrinkThreshold = 0.5f;
+  uint32_t shrinkWindow = 240; // frames
+  uint64_t minFragments = 1ull << 16;
+  uint64_t maxBytes = 1ull << 30;
+};
+
+struct ABufferStats
+{
+  uint64_t capacity = 0; // fragments
+  uint64_t bufferBytes = 0;
+  uint64_t lastFragments = 0; // requested by the last read back frame, may exceed capacity
+  uint64_t windowPeak = 0; // high-water mark of the current shrink window
+  uint64_t peakFragments = 0; // since start
+  uint32_t overflowFrames = 0; // frames that dropped fragments
+  uint32_t resizes = 0;
+};
+
+// Draws the Blend geometry of draw_list with the material inputs of TransparentShading.glsl, bindings
+// 0-2 and 5-8 of set 0. extra_bindings are added to the set of every material. The first instance of
+// every draw is the index of its material group in draw_list. Binds the pipeline and the scene buffers,
+// has to be called inside a render target state.
+void draw_transparent(etna::SyncCommandBuffer &cmd,
+  const etna::GraphicsPipeline &pipeline,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  std::span<const etna::Binding> extra_bindings = {});
+
+// Fragment buffers of an A-buffer layout, one per frame in flight. Counts the fragments frames asked for
+// and adapts the capacity to fit them, the buffer of a frame is replaced when the frame comes to it.
+struct FragmentStorage
+{
+  FragmentStorage(uint32_t entry_size, const ABufferConfig &config);
+
+  // Moves to the buffer of a new frame, adapts the capacity to the counter read back for it and resets
+  // the header, call before the fragments of the frame are counted
+  void beginFrame(etna::SyncCommandBuffer &cmd);
+  // copies the counter for readback once the frame has counted its fragments
+  void endFrame(etna::SyncCommandBuffer &cmd);
+
+  // Starts over with the initial capacity for a new resolution
+  void reset(uint64_t pixels);
+
+  const etna::Buffer &getBuffer() const { return frames.get().buffer; } // of the current frame
+  uint64_t getCapacity() const { return capacity; }
+  const ABufferStats &getStats() const { return stats; }
+
+private:
+  struct Frame
+  {
+    etna::Buffer buffer;
+    uint64_t capacity = 0; // of buffer
+    etna::Buffer counterReadback;
+    uint64_t readbackCapacity = 0; // of the list when the counter was copied, 0 if nothing was
+  };
+
+  void readCounter(Frame &frame);
+  void resize(uint64_t fragments);
+
+  uint32_t entrySize;
+  ABufferConfig config;
+  ABufferStats stats;
+
+  uint64_t capacity = 0; // of the buffers of new frames
+  uint32_t windowFrames = 0;
+  renderer::FrameRing<Frame> frames;
+};
+
+constexpr uint32_t ABUFFER_TILE_SIZE = 8; // pixels, ABUFFER_TILE_SIZE in ABufferTiles.glsl
+
+// Screen tiles touched by transparent fragments. Passes that store fragments flag their tiles, classify()
+// compacts flagged tiles into a list and writes indirect dispatch arguments for it, so the resolve skips
+// tiles without transparency.
+struct TileClassifier
+{
+  TileClassifier(const std::string &prog_name, glm::uvec2 resolution);
 
   void onResolutionChanged(glm::uvec2 resolution);
-  
+
+  // clears the flags before the passes that set them
+  void reset(etna::SyncCommandBuffer &cmd);
+  // flags every tile, for lists not written by the fragment passes
+  void markAll(etna::SyncCommandBuffer &cmd);
+  void classify(etna::SyncCommandBuffer &cmd);
+
+  // VkDispatchIndirectCommand with a workgroup per listed tile
+  static constexpr vk::DeviceSize DISPATCH_ARGS_OFFSET = 0;
+
+  // of the current frame, reset() moves to the buffers of a new one
+  const etna::Buffer &getFlags() const { return frames.get().flags; }
+  const etna::Buffer &getTiles() const { return frames.get().tiles; }
+  const etna::Buffer &getArgs() const { return frames.get().args; }
+  glm::uvec2 getResolution() const { return resolution; }
+
+  uint32_t getTilesCount() const { return tilesCount; }
+  uint32_t getLastActiveTiles() const { return lastActiveTiles; } // read back frames in flight later
+
+private:
+  struct Frame
+  {
+    etna::Buffer flags;
+    etna::Buffer tiles;
+    etna::Buffer args;
+    etna::Buffer readback; // active tiles
+    bool classified = false; // readback was written
+  };
+
+  etna::ComputePipeline pipeline;
+  renderer::FrameRing<Frame> frames;
+  glm::uvec2 resolution {0, 0};
+  uint32_t tilesCount = 0;
+  uint32_t lastActiveTiles = 0;
+};
+
+// Sizes of the sorted register array of the resolve, a kernel is compiled for each. Fragments behind
+// the nearest ones are blended into a single tail layer, see ABufferResolve.glsl.
+constexpr std::array<uint32_t, 4> ABUFFER_RESOLVE_LAYERS {4, 8, 16, 32};
+
+struct ABufferResolver
+{
+  // uses the programs prog_prefix + "_k4", "_k8", "_k16" and "_k32"
+  ABufferResolver(const std::string &prog_prefix);
+
+  // Composites the resolved fragments over target in place, target is the RGBA16F color of the list head
+  // size with storage usage. Only the classified tiles are resolved, other pixels keep their contents.
   void dispatch(
     etna::SyncCommandBuffer &cmd,
-    const GlobalFrameConstantHandler &gframe, 
     const etna::Image &listHead, 
-    const etna::Buffer &listSamples);
+    const etna::Buffer &listSamples,
+    const etna::Image &target,
+    const TileClassifier &tiles);
 
-  const etna::Image &getTarget() const { return resolveTarget; }
+  // resolves with the kernel for layers, one of ABUFFER_RESOLVE_LAYERS
+  void dispatch(
+    etna::SyncCommandBuffer &cmd,
+    uint32_t layers,
+    const etna::Image &listHead, 
+    const etna::Buffer &listSamples,
+    const etna::Image &target,
+    const TileClassifier &tiles) const;
+
+  void setLayers(uint32_t layers);
+  uint32_t getLayers() const { return layers; }
 
 private:
-  etna::ComputePipeline pipeline;
-  etna::Image resolveTarget;
+  std::array<etna::ComputePipeline, ABUFFER_RESOLVE_LAYERS.size()> pipelines;
+  uint32_t layers = 8;
 };
 
 struct ABufferRenderer
 {
-  ABufferRenderer(const std::string &prog_name, const etna::Image &depthRT);
+  ABufferRenderer(const std::string &prog_name, const etna::Image &depthRT, const ABufferConfig &config = {});
 
-  void attachToScene(const GLTFScene &scene);
+  void attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt);
 
+  // flags the tiles that get fragments in tiles, which are not classified here
   void render(etna::SyncCommandBuffer &cmd,
     const etna::Image &depthRT, 
     const GlobalFrameConstantHandler &gframe,
-    const GLTFScene &scene);
+    const GLTFScene &scene,
+    const TileClassifier &tiles);
 
   void onResolutionChanged(uint32_t w, uint32_t h);
 
-  const etna::Image &getListHead() const { return listHead; }
-  const etna::Buffer &getListBuffer() const { return fragmentList; }
+  // lists of the current frame, every render() moves to the ones of a new frame
+  const etna::Image &getListHead() const { return listHeads.get(); }
+  const etna::Buffer &getListBuffer() const { return fragments.getBuffer(); }
+  const ABufferStats &getStats() const { return fragments.getStats(); }
+  uint64_t getMemoryBytes() const;
 
 private:
-
-  uint32_t bindDS(etna::SyncCommandBuffer &cmd, 
+  void drawFragments(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
     const GlobalFrameConstantHandler &gframe,
-    const GLTFScene::Material &material, 
-    const GLTFScene &scene);
+    const GLTFScene &scene,
+    const TileClassifier &tiles);
 
   etna::GraphicsPipeline pipeline;
 
-  etna::Image listHead;
-  etna::Buffer fragmentList;
+  renderer::FrameRing<etna::Image> listHeads;
+  FragmentStorage fragments;
   SortedScene sceneData;
-};
-
-struct TexBlender
-{
-  TexBlender(const std::string &name, vk::Format dstFmt);
-  void blend(etna::SyncCommandBuffer &cmd, const etna::Image &overlay, const etna::Image &dst);
-
-private:
-  etna::GraphicsPipeline pipeline;
-  vk::UniqueSampler sampler;
+  const VirtualTextureSystem *virtualTextures = nullptr;
 };
 
 }
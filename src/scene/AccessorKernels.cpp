@@ -0,0 +1,538 @@
+#include "AccessorKernels.hpp"
+
+#include <etna/Etna.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ACCESSOR_KERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace scene
+{
+
+uint32_t component_size(ComponentType type)
+{
+  switch (type)
+  {
+    case ComponentType::Byte:
+    case ComponentType::UnsignedByte:
+      return 1;
+    case ComponentType::Short:
+    case ComponentType::UnsignedShort:
+      return 2;
+    case ComponentType::UnsignedInt:
+    case ComponentType::Float:
+      return 4;
+  }
+  return 0;
+}
+
+template <typename T>
+static float normalize_integer(T v)
+{
+  constexpr float maxVal = float(std::numeric_limits<T>::max());
+  if constexpr (std::is_signed_v<T>)
+    return std::max(float(v) / maxVal, -1.f);
+  else
+    return float(v) / maxVal;
+}
+
+template <ComponentType type> struct ComponentTraits;
+
+template <> struct ComponentTraits<ComponentType::Byte>
+{
+  using Storage = int8_t;
+  static float load(Storage v, bool normalized) { return normalized ? normalize_integer(v) : float(v); }
+};
+
+template <> struct ComponentTraits<ComponentType::UnsignedByte>
+{
+  using Storage = uint8_t;
+  static float load(Storage v, bool normalized) { return normalized ? normalize_integer(v) : float(v); }
+};
+
+template <> struct ComponentTraits<ComponentType::Short>
+{
+  using Storage = int16_t;
+  static float load(Storage v, bool normalized) { return normalized ? normalize_integer(v) : float(v); }
+};
+
+template <> struct ComponentTraits<ComponentType::UnsignedShort>
+{
+  using Storage = uint16_t;
+  static float load(Storage v, bool normalized) { return normalized ? normalize_integer(v) : float(v); }
+};
+
+template <> struct ComponentTraits<ComponentType::UnsignedInt>
+{
+  using Storage = uint32_t;
+  static float load(Storage v, bool normalized) { return normalized ? normalize_integer(v) : float(v); }
+};
+
+template <> struct ComponentTraits<ComponentType::Float>
+{
+  using Storage = float;
+  static float load(Storage v, bool) { return v; }
+};
+
+template <ComponentType type>
+static void convert_scalar(const AccessorView &src, uint32_t first,
+  uint32_t dst_components, uint8_t *dst, uint32_t dst_stride)
+{
+  using Traits = ComponentTraits<type>;
+  using Storage = typename Traits::Storage;
+
+  const uint32_t components = std::min(src.components, dst_components);
+
+  for (uint32_t i = first; i < src.count; i++)
+  {
+    const uint8_t *in = src.data + size_t(i) * src.stride;
+    float out[4] {0.f, 0.f, 0.f, 0.f};
+
+    for (uint32_t c = 0; c < components; c++)
+    {
+      Storage v;
+      std::memcpy(&v, in + c * sizeof(Storage), sizeof(Storage));
+      out[c] = Traits::load(v, src.normalized);
+    }
+
+    std::memcpy(dst + size_t(i) * dst_stride, out, dst_components * sizeof(float));
+  }
+}
+
+// number of leading elements that can be read with load_bytes wide loads without leaving the accessor
+static uint32_t wide_load_count(const AccessorView &src, uint32_t load_bytes)
+{
+  size_t size = src.byteSize();
+  if (size < load_bytes || src.stride == 0)
+    return 0;
+  return uint32_t(std::min<size_t>(src.count, (size - load_bytes) / src.stride + 1));
+}
+
+#ifdef ACCESSOR_KERNELS_X86
+
+static bool cpu_has_avx2()
+{
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+// loads n floats, zeroes the remaining lanes
+static inline __m128 load_floats(const float *p, uint32_t n)
+{
+  switch (n)
+  {
+    case 1:
+      return _mm_load_ss(p);
+    case 2:
+      return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+    case 3:
+      return _mm_movelh_ps(
+        _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p))),
+        _mm_load_ss(p + 2));
+  }
+  return _mm_loadu_ps(p);
+}
+
+// stores exactly n floats
+static inline void store_floats(float *p, __m128 v, uint32_t n)
+{
+  switch (n)
+  {
+    case 1:
+      _mm_store_ss(p, v);
+      return;
+    case 2:
+      _mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+      return;
+    case 3:
+      _mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+      _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+      return;
+  }
+  _mm_storeu_ps(p, v);
+}
+
+static void convert_float_sse(const AccessorView &src,
+  uint32_t dst_components, uint8_t *dst, uint32_t dst_stride)
+{
+  const uint32_t components = std::min(src.components, dst_components);
+
+  for (uint32_t i = 0; i < src.count; i++)
+  {
+    auto in = reinterpret_cast<const float*>(src.data + size_t(i) * src.stride);
+    auto out = reinterpret_cast<float*>(dst + size_t(i) * dst_stride);
+    store_floats(out, load_floats(in, components), dst_components);
+  }
+}
+
+// Gathers 8 elements per iteration as 32 bit words, unpacks components to SoA registers
+// and shuffles them back to per-vertex vectors. Returns the number of converted elements.
+template <ComponentType type>
+TARGET_AVX2 static uint32_t convert_integer_avx2(const AccessorView &src,
+  uint32_t dst_components, uint8_t *dst, uint32_t dst_stride)
+{
+  using Storage = typename ComponentTraits<type>::Storage;
+  constexpr uint32_t componentBits = sizeof(Storage) * 8;
+  constexpr bool isSigned = std::is_signed_v<Storage>;
+
+  const uint32_t components = std::min(src.components, dst_components);
+  const uint32_t words = (components * sizeof(Storage) + 3) / 4;
+  const uint32_t count = wide_load_count(src, words * 4);
+
+  if (count < 8 || uint64_t(src.stride) * 7 > uint64_t(std::numeric_limits<int32_t>::max()))
+    return 0;
+
+  const __m256i laneOffsets = _mm256_mullo_epi32(
+    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+    _mm256_set1_epi32(int32_t(src.stride)));
+
+  const __m256 scale = _mm256_set1_ps(
+    src.normalized ? 1.f / float(std::numeric_limits<Storage>::max()) : 1.f);
+  const __m256i componentMask = _mm256_set1_epi32(int32_t((1ull << componentBits) - 1));
+
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    auto base = reinterpret_cast<const int*>(src.data + size_t(i) * src.stride);
+    __m256i gathered[2] {
+      _mm256_i32gather_epi32(base, laneOffsets, 1),
+      words > 1 ? _mm256_i32gather_epi32(base + 1, laneOffsets, 1) : _mm256_setzero_si256()
+    };
+
+    __m256 comps[4];
+    for (uint32_t c = 0; c < 4; c++)
+    {
+      if (c >= components)
+      {
+        comps[c] = _mm256_setzero_ps();
+        continue;
+      }
+
+      uint32_t bitOffset = c * componentBits;
+      __m256i word = gathered[bitOffset / 32];
+      int32_t shift = int32_t(bitOffset % 32);
+
+      __m256i value;
+      if constexpr (isSigned)
+      {
+        value = _mm256_sllv_epi32(word, _mm256_set1_epi32(32 - componentBits - shift));
+        value = _mm256_srav_epi32(value, _mm256_set1_epi32(32 - componentBits));
+      }
+      else
+      {
+        value = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_set1_epi32(shift)), componentMask);
+      }
+
+      comps[c] = _mm256_mul_ps(_mm256_cvtepi32_ps(value), scale);
+      if (isSigned && src.normalized)
+        comps[c] = _mm256_max_ps(comps[c], _mm256_set1_ps(-1.f));
+    }
+
+    __m128 lo[4], hi[4];
+    for (uint32_t c = 0; c < 4; c++)
+    {
+      lo[c] = _mm256_castps256_ps128(comps[c]);
+      hi[c] = _mm256_extractf128_ps(comps[c], 1);
+    }
+
+    _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+    _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+
+    for (uint32_t e = 0; e < 4; e++)
+    {
+      store_floats(reinterpret_cast<float*>(dst + size_t(i + e) * dst_stride), lo[e], dst_components);
+      store_floats(reinterpret_cast<float*>(dst + size_t(i + e + 4) * dst_stride), hi[e], dst_components);
+    }
+  }
+
+  return i;
+}
+
+TARGET_AVX2 static uint32_t widen_u16_avx2(const uint16_t *src, uint32_t count, uint32_t *dst)
+{
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu16_epi32(v));
+  }
+  return i;
+}
+
+TARGET_AVX2 static uint32_t widen_u8_avx2(const uint8_t *src, uint32_t count, uint32_t *dst)
+{
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi32(v));
+  }
+  return i;
+}
+
+static uint32_t widen_u16_sse(const uint16_t *src, uint32_t count, uint32_t *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(v, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+  }
+  return i;
+}
+
+static uint32_t widen_u8_sse(const uint8_t *src, uint32_t count, uint32_t *dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+  }
+  return i;
+}
+
+#endif // ACCESSOR_KERNELS_X86
+
+template <ComponentType type>
+static void convert_integer(const AccessorView &src,
+  uint32_t dst_components, uint8_t *dst, uint32_t dst_stride)
+{
+  uint32_t first = 0;
+#ifdef ACCESSOR_KERNELS_X86
+  if (cpu_has_avx2())
+    first = convert_integer_avx2<type>(src, dst_components, dst, dst_stride);
+#endif
+  convert_scalar<type>(src, first, dst_components, dst, dst_stride);
+}
+
+void convert_to_float(const AccessorView &src, uint32_t dst_components, uint8_t *dst, uint32_t dst_stride)
+{
+  dst_components = std::min(dst_components, 4u);
+
+  switch (src.componentType)
+  {
+    case ComponentType::Float:
+#ifdef ACCESSOR_KERNELS_X86
+      convert_float_sse(src, dst_components, dst, dst_stride);
+#else
+      convert_scalar<ComponentType::Float>(src, 0, dst_components, dst, dst_stride);
+#endif
+      return;
+    case ComponentType::Byte:
+      convert_integer<ComponentType::Byte>(src, dst_components, dst, dst_stride);
+      return;
+    case ComponentType::UnsignedByte:
+      convert_integer<ComponentType::UnsignedByte>(src, dst_components, dst, dst_stride);
+      return;
+    case ComponentType::Short:
+      convert_integer<ComponentType::Short>(src, dst_components, dst, dst_stride);
+      return;
+    case ComponentType::UnsignedShort:
+      convert_integer<ComponentType::UnsignedShort>(src, dst_components, dst, dst_stride);
+      return;
+    case ComponentType::UnsignedInt:
+      convert_scalar<ComponentType::UnsignedInt>(src, 0, dst_components, dst, dst_stride);
+      return;
+  }
+  ETNA_ASSERTF(false, "Accessor of component type {} is not supported", uint32_t(src.componentType));
+}
+
+template <typename T>
+static void widen_scalar(const AccessorView &src, uint32_t first, uint32_t *dst)
+{
+  for (uint32_t i = first; i < src.count; i++)
+  {
+    T v;
+    std::memcpy(&v, src.data + size_t(i) * src.stride, sizeof(T));
+    dst[i] = v;
+  }
+}
+
+void widen_indices(const AccessorView &src, uint32_t *dst)
+{
+  uint32_t first = 0;
+
+  switch (src.componentType)
+  {
+    case ComponentType::UnsignedInt:
+      if (src.stride == sizeof(uint32_t))
+        std::memcpy(dst, src.data, size_t(src.count) * sizeof(uint32_t));
+      else
+        widen_scalar<uint32_t>(src, 0, dst);
+      return;
+    case ComponentType::UnsignedShort:
+#ifdef ACCESSOR_KERNELS_X86
+      if (src.stride == sizeof(uint16_t))
+      {
+        auto in = reinterpret_cast<const uint16_t*>(src.data);
+        first = cpu_has_avx2() ? widen_u16_avx2(in, src.count, dst) : widen_u16_sse(in, src.count, dst);
+      }
+#endif
+      widen_scalar<uint16_t>(src, first, dst);
+      return;
+    case ComponentType::UnsignedByte:
+#ifdef ACCESSOR_KERNELS_X86
+      if (src.stride == sizeof(uint8_t))
+        first = cpu_has_avx2() ? widen_u8_avx2(src.data, src.count, dst) : widen_u8_sse(src.data, src.count, dst);
+#endif
+      widen_scalar<uint8_t>(src, first, dst);
+      return;
+    default:
+      break;
+  }
+  ETNA_ASSERTF(false, "Index accessor of component type {} is not supported", uint32_t(src.componentType));
+}
+
+// valid values of each type, random bytes would make float inputs mostly NaN and subnormals
+static void fill_synthetic(const AccessorView &view, uint32_t max_index, std::mt19937 &rng)
+{
+  auto data = const_cast<uint8_t *>(view.data);
+  uint32_t componentSize = component_size(view.componentType);
+  std::uniform_real_distribution<float> unit {-1.f, 1.f};
+
+  for (uint32_t i = 0; i < view.count; i++)
+  {
+    for (uint32_t c = 0; c < view.components; c++)
+    {
+      uint8_t *dst = data + size_t(i) * view.stride + c * componentSize;
+      uint32_t bits = rng();
+      if (view.componentType == ComponentType::Float)
+      {
+        float v = unit(rng);
+        std::memcpy(dst, &v, sizeof(v));
+      }
+      else
+      {
+        if (max_index)
+          bits %= max_index;
+        std::memcpy(dst, &bits, componentSize);
+      }
+    }
+  }
+}
+
+template <typename F>
+static double best_seconds(uint32_t repeats, F &&run)
+{
+  double best = std::numeric_limits<double>::max();
+  for (uint32_t i = 0; i < repeats; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+void benchmark_accessor_kernels(uint32_t count, uint32_t repeats)
+{
+  struct Case
+  {
+    const char *name;
+    ComponentType type;
+    uint32_t components;
+    bool normalized;
+  };
+
+  const Case convertCases[] {
+    {"f32 vec3", ComponentType::Float, 3, false},
+    {"u32 vec3", ComponentType::UnsignedInt, 3, false},
+    {"i16n vec3", ComponentType::Short, 3, true},
+    {"u16n vec2", ComponentType::UnsignedShort, 2, true},
+    {"i8n vec3", ComponentType::Byte, 3, true},
+    {"u8n vec4", ComponentType::UnsignedByte, 4, true}
+  };
+
+  const Case indexCases[] {
+    {"u8 index", ComponentType::UnsignedByte, 1, false},
+    {"u16 index", ComponentType::UnsignedShort, 1, false},
+    {"u32 index", ComponentType::UnsignedInt, 1, false}
+  };
+
+  // interleaved elements sit in a 32 byte vertex, like a position next to a normal and uv
+  constexpr uint32_t INTERLEAVED_STRIDE = 32;
+  constexpr uint32_t DST_STRIDE = 4 * sizeof(float);
+
+  std::mt19937 rng {42};
+  std::vector<uint8_t> src(size_t(count) * INTERLEAVED_STRIDE);
+  std::vector<uint8_t> dst(size_t(count) * DST_STRIDE);
+
+  spdlog::info("Accessor kernels benchmark, {} elements, best of {} runs, AVX2 {}:", count, repeats,
+#ifdef ACCESSOR_KERNELS_X86
+    cpu_has_avx2());
+#else
+    false);
+#endif
+
+  auto report = [&](const Case &c, const AccessorView &view, uint64_t dst_bytes, double seconds) {
+    uint64_t srcBytes = uint64_t(view.count) * view.elementSize();
+    spdlog::info("  {:<10} {:<11} {:7.2f} GB/s read, {:7.2f} GB/s written, {:6.2f} ms", c.name,
+      view.stride == view.elementSize() ? "tight" : "strided", srcBytes / seconds * 1e-9,
+      dst_bytes / seconds * 1e-9, seconds * 1e3);
+  };
+
+  for (auto &c : convertCases)
+  {
+    uint32_t elementSize = c.components * component_size(c.type);
+    for (uint32_t stride : {elementSize, INTERLEAVED_STRIDE})
+    {
+      AccessorView view {
+        .data = src.data(),
+        .count = count,
+        .stride = stride,
+        .components = c.components,
+        .componentType = c.type,
+        .normalized = c.normalized
+      };
+      fill_synthetic(view, 0, rng);
+
+      double seconds = best_seconds(repeats, [&]() {
+        convert_to_float(view, c.components, dst.data(), DST_STRIDE);
+      });
+      report(c, view, uint64_t(count) * c.components * sizeof(float), seconds);
+    }
+  }
+
+  for (auto &c : indexCases)
+  {
+    uint32_t elementSize = component_size(c.type);
+    for (uint32_t stride : {elementSize, 2 * elementSize})
+    {
+      AccessorView view {
+        .data = src.data(),
+        .count = count,
+        .stride = stride,
+        .components = 1,
+        .componentType = c.type
+      };
+      fill_synthetic(view, std::min<uint64_t>(count, uint64_t(1) << (8 * elementSize)) - 1, rng);
+
+      double seconds = best_seconds(repeats, [&]() {
+        widen_indices(view, reinterpret_cast<uint32_t *>(dst.data()));
+      });
+      report(c, view, uint64_t(count) * sizeof(uint32_t), seconds);
+    }
+  }
+}
+
+} // namespace scene
@@ -0,0 +1,52 @@
+#ifndef SCENE_ACCESSOR_KERNELS_HPP_INCLUDED
+#define SCENE_ACCESSOR_KERNELS_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+
+namespace scene
+{
+
+// values match glTF (GL) component type enums
+enum class ComponentType : uint32_t
+{
+  Byte = 5120,
+  UnsignedByte = 5121,
+  Short = 5122,
+  UnsignedShort = 5123,
+  UnsignedInt = 5125,
+  Float = 5126
+};
+
+uint32_t component_size(ComponentType type);
+
+struct AccessorView
+{
+  const uint8_t *data = nullptr;
+  uint32_t count = 0;
+  uint32_t stride = 0; // bytes between consecutive elements, bufferView.byteStride or element size
+  uint32_t components = 0;
+  ComponentType componentType = ComponentType::Float;
+  bool normalized = false;
+
+  uint32_t elementSize() const { return components * component_size(componentType); }
+  size_t byteSize() const { return count ? size_t(count - 1) * stride + elementSize() : 0; }
+};
+
+// Writes src.count vectors of dst_components floats, dst_stride bytes apart.
+// Components missing in src are zero filled, extra src components are dropped.
+// Integer types are converted with glTF normalization rules if src.normalized is set.
+void convert_to_float(const AccessorView &src, uint32_t dst_components, uint8_t *dst, uint32_t dst_stride);
+
+// Widens an UnsignedByte/UnsignedShort/UnsignedInt index accessor into src.count uint32 indices.
+// A tightly packed src may be the tail of dst's own range, every element is read before it is overwritten.
+void widen_indices(const AccessorView &src, uint32_t *dst);
+
+// Times convert_to_float and widen_indices on synthetic inputs of every component type, tightly packed and
+// strided, without file I/O or scene loading around them. Logs the best of repeats runs over count
+// elements as GB/s of source and destination bytes per kernel. Runs on the calling thread.
+void benchmark_accessor_kernels(uint32_t count = 1u << 20, uint32_t repeats = 8);
+
+} // namespace scene
+
+#endif
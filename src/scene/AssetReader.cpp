@@ -0,0 +1,311 @@
+#include "AssetReader.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <etna/Etna.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define SCENE_HAS_IO_URING 1
+#else
+#define SCENE_HAS_IO_URING 0
+#endif
+
+namespace scene
+{
+
+struct AssetReader::Request
+{
+  int fd;
+  uint64_t offset;
+  uint64_t size;
+  uint8_t *dst;
+  uint64_t done;
+  std::function<void()> onDone;
+};
+
+// larger reads are split, io_uring read lengths are 32 bit
+static constexpr uint64_t MAX_READ_SIZE = 64ull << 20;
+
+#if SCENE_HAS_IO_URING
+
+// Minimal io_uring setup without liburing. Submissions are serialized by AssetReader::lock,
+// completions are consumed by a single reaper thread.
+struct IoUring
+{
+  int fd = -1;
+  io_uring_params params {};
+
+  uint8_t *sqRing = nullptr;
+  size_t sqRingSize = 0;
+  uint8_t *cqRing = nullptr;
+  size_t cqRingSize = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqesSize = 0;
+
+  std::thread reaper;
+
+  static std::unique_ptr<IoUring> create(uint32_t entries)
+  {
+    auto ring = std::make_unique<IoUring>();
+    ring->fd = int(syscall(__NR_io_uring_setup, entries, &ring->params));
+    if (ring->fd < 0)
+      return nullptr;
+
+    // IORING_OP_READ came with the same kernel release as this feature bit
+    auto &p = ring->params;
+    if (!(p.features & IORING_FEAT_RW_CUR_POS))
+      return nullptr;
+
+    ring->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+      ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+
+    auto map = [&](size_t size, off_t offset) -> uint8_t* {
+      void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, offset);
+      return ptr == MAP_FAILED ? nullptr : static_cast<uint8_t*>(ptr);
+    };
+
+    ring->sqRing = map(ring->sqRingSize, IORING_OFF_SQ_RING);
+    if (!ring->sqRing)
+      return nullptr;
+
+    if (singleMap)
+    {
+      ring->cqRing = ring->sqRing;
+    }
+    else if (!(ring->cqRing = map(ring->cqRingSize, IORING_OFF_CQ_RING)))
+    {
+      return nullptr;
+    }
+
+    ring->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = reinterpret_cast<io_uring_sqe*>(map(ring->sqesSize, IORING_OFF_SQES));
+    if (!ring->sqes)
+      return nullptr;
+
+    return ring;
+  }
+
+  ~IoUring()
+  {
+    if (sqes)
+      munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing)
+      munmap(cqRing, cqRingSize);
+    if (sqRing)
+      munmap(sqRing, sqRingSize);
+    if (fd >= 0)
+      close(fd);
+  }
+
+  uint32_t &sqField(uint32_t offset) { return *reinterpret_cast<uint32_t*>(sqRing + offset); }
+  uint32_t &cqField(uint32_t offset) { return *reinterpret_cast<uint32_t*>(cqRing + offset); }
+
+  // the caller keeps at most sq_entries operations in flight, so the queue is never full here
+  void push(uint8_t opcode, int file, uint64_t offset, void *dst, uint32_t size, uint64_t user_data)
+  {
+    uint32_t tail = sqField(params.sq_off.tail);
+    uint32_t index = tail & sqField(params.sq_off.ring_mask);
+
+    io_uring_sqe &sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = file;
+    sqe.off = offset;
+    sqe.addr = uint64_t(reinterpret_cast<uintptr_t>(dst));
+    sqe.len = size;
+    sqe.user_data = user_data;
+
+    reinterpret_cast<uint32_t*>(sqRing + params.sq_off.array)[index] = index;
+    std::atomic_ref<uint32_t>(sqField(params.sq_off.tail)).store(tail + 1, std::memory_order_release);
+
+    while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0) < 0)
+      ETNA_ASSERTF(errno == EINTR || errno == EAGAIN, "Asset reader : io_uring submit failed : {}", strerror(errno));
+  }
+
+  void waitCompletions()
+  {
+    syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+  }
+};
+
+#else
+
+struct IoUring
+{
+};
+
+#endif
+
+AssetReader::AssetReader(uint32_t queue_depth)
+  : queueDepth {std::max(queue_depth, 1u)}
+{
+#if SCENE_HAS_IO_URING
+  ring = IoUring::create(queueDepth);
+  if (ring)
+    ring->reaper = std::thread(&AssetReader::reapLoop, this);
+#endif
+
+  if (!ring)
+    spdlog::info("Asset reader : io_uring is not available, reads use pread on the loader pool");
+}
+
+AssetReader::~AssetReader()
+{
+  wait();
+
+#if SCENE_HAS_IO_URING
+  if (ring)
+  {
+    // a no-op without a request stops the reaper
+    {
+      std::lock_guard guard {lock};
+      ring->push(IORING_OP_NOP, -1, 0, nullptr, 0, 0);
+    }
+    ring->reaper.join();
+  }
+#endif
+}
+
+void AssetReader::read(int fd, uint64_t offset, uint64_t size, void *dst, std::function<void()> on_done)
+{
+  auto request = new Request {
+    .fd = fd,
+    .offset = offset,
+    .size = size,
+    .dst = static_cast<uint8_t*>(dst),
+    .done = 0,
+    .onDone = std::move(on_done)
+  };
+
+  {
+    std::lock_guard guard {lock};
+    pending++;
+  }
+
+  if (size == 0)
+  {
+    util::get_thread_pool().submit([this, request]() { complete(request); });
+    return;
+  }
+
+  if (ring)
+  {
+    std::unique_lock guard {lock};
+    done.wait(guard, [&]() { return inFlight < queueDepth; });
+    inFlight++;
+    submitToRing(request);
+    return;
+  }
+
+  util::get_thread_pool().submit([this, request]() {
+    while (request->done < request->size)
+    {
+      ssize_t res = pread(request->fd, request->dst + request->done,
+        std::min(request->size - request->done, MAX_READ_SIZE), off_t(request->offset + request->done));
+      if (res < 0 && errno == EINTR)
+        continue;
+      ETNA_ASSERTF(res > 0, "Asset reader : read of {} bytes at {} failed : {}",
+        request->size, request->offset, res < 0 ? strerror(errno) : "unexpected end of file");
+      request->done += uint64_t(res);
+    }
+    complete(request);
+  });
+}
+
+// called with lock held, the request already counts as in flight
+void AssetReader::submitToRing(Request *request)
+{
+#if SCENE_HAS_IO_URING
+  uint64_t size = std::min(request->size - request->done, MAX_READ_SIZE);
+  ring->push(IORING_OP_READ, request->fd, request->offset + request->done,
+    request->dst + request->done, uint32_t(size), uint64_t(reinterpret_cast<uintptr_t>(request)));
+#else
+  (void)request;
+#endif
+}
+
+void AssetReader::reapLoop()
+{
+#if SCENE_HAS_IO_URING
+  auto &p = ring->params;
+  while (true)
+  {
+    ring->waitCompletions();
+
+    uint32_t head = ring->cqField(p.cq_off.head);
+    uint32_t tail = std::atomic_ref<uint32_t>(ring->cqField(p.cq_off.tail)).load(std::memory_order_acquire);
+    uint32_t mask = ring->cqField(p.cq_off.ring_mask);
+    auto cqes = reinterpret_cast<io_uring_cqe*>(ring->cqRing + p.cq_off.cqes);
+
+    bool stop = false;
+    for (; head != tail; head++)
+    {
+      io_uring_cqe cqe = cqes[head & mask];
+      if (cqe.user_data == 0)
+      {
+        stop = true;
+        continue;
+      }
+
+      auto request = reinterpret_cast<Request*>(uintptr_t(cqe.user_data));
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+      {
+        std::lock_guard guard {lock};
+        submitToRing(request);
+        continue;
+      }
+
+      ETNA_ASSERTF(cqe.res > 0, "Asset reader : read of {} bytes at {} failed : {}",
+        request->size, request->offset, cqe.res < 0 ? strerror(-cqe.res) : "unexpected end of file");
+      request->done += uint64_t(cqe.res);
+
+      std::lock_guard guard {lock};
+      if (request->done < request->size)
+      {
+        submitToRing(request); // short read or a split request
+        continue;
+      }
+
+      inFlight--;
+      done.notify_all();
+      util::get_thread_pool().submit([this, request]() { complete(request); });
+    }
+
+    std::atomic_ref<uint32_t>(ring->cqField(p.cq_off.head)).store(head, std::memory_order_release);
+    if (stop)
+      return;
+  }
+#endif
+}
+
+void AssetReader::complete(Request *request)
+{
+  if (request->onDone)
+    request->onDone();
+  bytesRead += request->size;
+  delete request;
+
+  std::lock_guard guard {lock};
+  pending--;
+  done.notify_all();
+}
+
+void AssetReader::wait()
+{
+  std::unique_lock guard {lock};
+  done.wait(guard, [&]() { return pending == 0; });
+}
+
+} // namespace scene
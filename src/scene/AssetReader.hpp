@@ -0,0 +1,55 @@
+#ifndef SCENE_ASSET_READER_HPP_INCLUDED
+#define SCENE_ASSET_READER_HPP_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace scene
+{
+
+struct IoUring;
+
+// Reads file ranges straight into caller memory, e.g. persistently mapped staging buffers.
+// Reads go through io_uring when the kernel allows it and through pread on the loader pool otherwise.
+// Completion callbacks run on the loader pool, so conversion of one range overlaps reads of the others.
+struct AssetReader
+{
+  explicit AssetReader(uint32_t queue_depth = 64);
+  ~AssetReader(); // waits for queued reads
+
+  AssetReader(const AssetReader &) = delete;
+  AssetReader &operator=(const AssetReader &) = delete;
+
+  // fd must stay open and dst valid until on_done has run. A failed or short read is fatal.
+  void read(int fd, uint64_t offset, uint64_t size, void *dst, std::function<void()> on_done = {});
+
+  // Returns once every queued read and its callback are done. Must not be called from a loader pool thread.
+  void wait();
+
+  bool usesIoUring() const { return ring != nullptr; }
+  uint64_t getBytesRead() const { return bytesRead.load(); }
+
+private:
+  struct Request;
+
+  void submitToRing(Request *request);
+  void reapLoop();
+  void complete(Request *request);
+
+  std::unique_ptr<IoUring> ring;
+  uint32_t queueDepth;
+
+  std::mutex lock;
+  std::condition_variable done;
+  uint32_t pending = 0; // queued reads with callbacks not finished yet
+  uint32_t inFlight = 0; // requests owned by the ring
+  std::atomic<uint64_t> bytesRead = 0;
+};
+
+} // namespace scene
+
+#endif
@@ -0,0 +1,545 @@
+#include "BCEncoder.hpp"
+#include "MipFilter.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <etna/Etna.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace scene
+{
+
+static constexpr uint32_t BLOCK_TEXELS = 16;
+
+// Principal axis of n points of dim components by power iteration
+template <uint32_t dim>
+static std::array<float, dim> principal_axis(const float (*points)[dim], uint32_t n, const float *mean)
+{
+  float cov[dim][dim] {};
+  for (uint32_t i = 0; i < n; i++)
+    for (uint32_t a = 0; a < dim; a++)
+      for (uint32_t b = 0; b < dim; b++)
+        cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+  std::array<float, dim> axis;
+  axis.fill(1.f);
+  for (uint32_t iter = 0; iter < 8; iter++)
+  {
+    std::array<float, dim> next {};
+    for (uint32_t a = 0; a < dim; a++)
+      for (uint32_t b = 0; b < dim; b++)
+        next[a] += cov[a][b] * axis[b];
+
+    float len = 0.f;
+    for (auto v : next)
+      len = std::max(len, std::abs(v));
+    if (len < 1e-6f)
+      break;
+    for (uint32_t a = 0; a < dim; a++)
+      axis[a] = next[a] / len;
+  }
+  return axis;
+}
+
+// Endpoints at the extreme projections of the points on the principal axis
+template <uint32_t dim>
+static void fit_endpoints(const float (*points)[dim], uint32_t n, float *e0, float *e1)
+{
+  float mean[dim] {};
+  for (uint32_t i = 0; i < n; i++)
+    for (uint32_t a = 0; a < dim; a++)
+      mean[a] += points[i][a] / float(n);
+
+  auto axis = principal_axis<dim>(points, n, mean);
+  float axisLen2 = 0.f;
+  for (auto v : axis)
+    axisLen2 += v * v;
+
+  float tMin = 0.f;
+  float tMax = 0.f;
+  if (axisLen2 > 0.f)
+  {
+    tMin = 1e30f;
+    tMax = -1e30f;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      float t = 0.f;
+      for (uint32_t a = 0; a < dim; a++)
+        t += (points[i][a] - mean[a]) * axis[a];
+      t /= axisLen2;
+      tMin = std::min(tMin, t);
+      tMax = std::max(tMax, t);
+    }
+  }
+
+  for (uint32_t a = 0; a < dim; a++)
+  {
+    e0[a] = std::clamp(mean[a] + axis[a] * tMax, 0.f, 255.f);
+    e1[a] = std::clamp(mean[a] + axis[a] * tMin, 0.f, 255.f);
+  }
+}
+
+// Least squares endpoints for fixed interpolation weights w[i] of e1 (1 - w[i] of e0)
+template <uint32_t dim>
+static bool refit_endpoints(const float (*points)[dim], const float *weights, uint32_t n, float *e0, float *e1)
+{
+  float aa = 0.f, ab = 0.f, bb = 0.f;
+  float ax[dim] {};
+  float bx[dim] {};
+  for (uint32_t i = 0; i < n; i++)
+  {
+    float b = weights[i];
+    float a = 1.f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (uint32_t c = 0; c < dim; c++)
+    {
+      ax[c] += a * points[i][c];
+      bx[c] += b * points[i][c];
+    }
+  }
+
+  float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f)
+    return false;
+
+  for (uint32_t c = 0; c < dim; c++)
+  {
+    e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+    e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+  }
+  return true;
+}
+
+// BC1 color part
+
+static uint16_t pack_565(const float *c)
+{
+  uint32_t r = uint32_t(std::lround(c[0] * 31.f / 255.f));
+  uint32_t g = uint32_t(std::lround(c[1] * 63.f / 255.f));
+  uint32_t b = uint32_t(std::lround(c[2] * 31.f / 255.f));
+  return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t v, float *c)
+{
+  uint32_t r = (v >> 11) & 31;
+  uint32_t g = (v >> 5) & 63;
+  uint32_t b = v & 31;
+  c[0] = float((r << 3) | (r >> 2));
+  c[1] = float((g << 2) | (g >> 4));
+  c[2] = float((b << 3) | (b >> 2));
+}
+
+// 4 color mode palette, c0 > c1 is required by the decoder to select it
+static void bc1_palette(uint16_t c0, uint16_t c1, float (*palette)[3])
+{
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  for (uint32_t c = 0; c < 3; c++)
+  {
+    palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+    palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+  }
+}
+
+static float bc1_select_indices(const float (*points)[3], uint16_t c0, uint16_t c1, uint32_t &indices)
+{
+  float palette[4][3];
+  bc1_palette(c0, c1, palette);
+
+  float error = 0.f;
+  indices = 0;
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+  {
+    float best = 1e30f;
+    uint32_t bestId = 0;
+    for (uint32_t p = 0; p < 4; p++)
+    {
+      float d = 0.f;
+      for (uint32_t c = 0; c < 3; c++)
+        d += (points[i][c] - palette[p][c]) * (points[i][c] - palette[p][c]);
+      if (d < best)
+      {
+        best = d;
+        bestId = p;
+      }
+    }
+    indices |= bestId << (2 * i);
+    error += best;
+  }
+  return error;
+}
+
+static void bc1_quantize(const float *e0, const float *e1, uint16_t &c0, uint16_t &c1)
+{
+  c0 = pack_565(e0);
+  c1 = pack_565(e1);
+  if (c0 < c1)
+    std::swap(c0, c1);
+}
+
+static void encode_bc1_color(const uint8_t *texels, uint8_t *dst)
+{
+  float points[BLOCK_TEXELS][3];
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    for (uint32_t c = 0; c < 3; c++)
+      points[i][c] = texels[4 * i + c];
+
+  float e0[3], e1[3];
+  fit_endpoints<3>(points, BLOCK_TEXELS, e0, e1);
+
+  uint16_t c0, c1;
+  bc1_quantize(e0, e1, c0, c1);
+
+  uint32_t indices = 0;
+  float error = 0.f;
+
+  if (c0 == c1)
+  {
+    // 3 color mode, index 0 is c0 for every texel
+    indices = 0;
+  }
+  else
+  {
+    error = bc1_select_indices(points, c0, c1, indices);
+
+    static constexpr float INDEX_WEIGHTS[4] {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+    float weights[BLOCK_TEXELS];
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+      weights[i] = INDEX_WEIGHTS[(indices >> (2 * i)) & 3];
+
+    if (refit_endpoints<3>(points, weights, BLOCK_TEXELS, e0, e1))
+    {
+      uint16_t r0, r1;
+      bc1_quantize(e0, e1, r0, r1);
+      if (r0 != r1)
+      {
+        uint32_t refitIndices = 0;
+        float refitError = bc1_select_indices(points, r0, r1, refitIndices);
+        if (refitError < error)
+        {
+          c0 = r0;
+          c1 = r1;
+          indices = refitIndices;
+        }
+      }
+    }
+  }
+
+  std::memcpy(dst, &c0, 2);
+  std::memcpy(dst + 2, &c1, 2);
+  std::memcpy(dst + 4, &indices, 4);
+}
+
+void encode_bc1_block(const uint8_t *texels, uint8_t *dst)
+{
+  encode_bc1_color(texels, dst);
+}
+
+void encode_bc4_block(const uint8_t *texels, uint32_t channel, uint8_t *dst)
+{
+  uint32_t minV = 255;
+  uint32_t maxV = 0;
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+  {
+    minV = std::min<uint32_t>(minV, texels[4 * i + channel]);
+    maxV = std::max<uint32_t>(maxV, texels[4 * i + channel]);
+  }
+
+  uint64_t indices = 0;
+  if (maxV != minV)
+  {
+    // 8 value mode (a0 > a1): index 0 = a0, 1 = a1, 2..7 interpolate from a0 to a1
+    float palette[8];
+    palette[0] = float(maxV);
+    palette[1] = float(minV);
+    for (uint32_t p = 2; p < 8; p++)
+      palette[p] = (float(8 - p) * maxV + float(p - 1) * minV) / 7.f;
+
+    for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    {
+      float v = texels[4 * i + channel];
+      float best = 1e30f;
+      uint64_t bestId = 0;
+      for (uint32_t p = 0; p < 8; p++)
+      {
+        float d = std::abs(v - palette[p]);
+        if (d < best)
+        {
+          best = d;
+          bestId = p;
+        }
+      }
+      indices |= bestId << (3 * i);
+    }
+  }
+
+  dst[0] = uint8_t(maxV);
+  dst[1] = uint8_t(minV);
+  for (uint32_t b = 0; b < 6; b++)
+    dst[2 + b] = uint8_t(indices >> (8 * b));
+}
+
+void encode_bc3_block(const uint8_t *texels, uint8_t *dst)
+{
+  encode_bc4_block(texels, 3, dst);
+  encode_bc1_color(texels, dst + 8);
+}
+
+void encode_bc5_block(const uint8_t *texels, uint8_t *dst)
+{
+  encode_bc4_block(texels, 0, dst);
+  encode_bc4_block(texels, 1, dst + 8);
+}
+
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4 bit indices
+
+static constexpr uint32_t BC7_WEIGHTS4[16] {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BC7Endpoint
+{
+  uint32_t q[4]; // 7 bit
+  uint32_t p;
+
+  uint32_t value(uint32_t c) const { return (q[c] << 1) | p; }
+};
+
+static BC7Endpoint bc7_quantize(const float *e)
+{
+  BC7Endpoint best {};
+  float bestError = 1e30f;
+  for (uint32_t p = 0; p < 2; p++)
+  {
+    BC7Endpoint ep {};
+    ep.p = p;
+    float error = 0.f;
+    for (uint32_t c = 0; c < 4; c++)
+    {
+      ep.q[c] = uint32_t(std::clamp<long>(std::lround((e[c] - float(p)) * 0.5f), 0, 127));
+      float d = float(ep.value(c)) - e[c];
+      error += d * d;
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      best = ep;
+    }
+  }
+  return best;
+}
+
+static float bc7_select_indices(const float (*points)[4], const BC7Endpoint &e0, const BC7Endpoint &e1,
+  uint8_t *indices)
+{
+  float palette[16][4];
+  for (uint32_t w = 0; w < 16; w++)
+    for (uint32_t c = 0; c < 4; c++)
+      palette[w][c] = float(((64 - BC7_WEIGHTS4[w]) * e0.value(c) + BC7_WEIGHTS4[w] * e1.value(c) + 32) >> 6);
+
+  float error = 0.f;
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+  {
+    float best = 1e30f;
+    uint8_t bestId = 0;
+    for (uint32_t w = 0; w < 16; w++)
+    {
+      float d = 0.f;
+      for (uint32_t c = 0; c < 4; c++)
+        d += (points[i][c] - palette[w][c]) * (points[i][c] - palette[w][c]);
+      if (d < best)
+      {
+        best = d;
+        bestId = uint8_t(w);
+      }
+    }
+    indices[i] = bestId;
+    error += best;
+  }
+  return error;
+}
+
+struct BitWriter
+{
+  uint8_t *dst;
+  uint32_t offset = 0;
+
+  void write(uint32_t value, uint32_t bits)
+  {
+    for (uint32_t b = 0; b < bits; b++, offset++)
+      dst[offset >> 3] |= uint8_t(((value >> b) & 1u) << (offset & 7));
+  }
+};
+
+void encode_bc7_block(const uint8_t *texels, uint8_t *dst)
+{
+  float points[BLOCK_TEXELS][4];
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    for (uint32_t c = 0; c < 4; c++)
+      points[i][c] = texels[4 * i + c];
+
+  float e0[4], e1[4];
+  fit_endpoints<4>(points, BLOCK_TEXELS, e0, e1);
+
+  auto q0 = bc7_quantize(e0);
+  auto q1 = bc7_quantize(e1);
+  uint8_t indices[BLOCK_TEXELS];
+  float error = bc7_select_indices(points, q0, q1, indices);
+
+  float weights[BLOCK_TEXELS];
+  for (uint32_t i = 0; i < BLOCK_TEXELS; i++)
+    weights[i] = float(BC7_WEIGHTS4[indices[i]]) / 64.f;
+
+  if (refit_endpoints<4>(points, weights, BLOCK_TEXELS, e0, e1))
+  {
+    auto r0 = bc7_quantize(e0);
+    auto r1 = bc7_quantize(e1);
+    uint8_t refitIndices[BLOCK_TEXELS];
+    float refitError = bc7_select_indices(points, r0, r1, refitIndices);
+    if (refitError < error)
+    {
+      q0 = r0;
+      q1 = r1;
+      std::memcpy(indices, refitIndices, sizeof(indices));
+    }
+  }
+
+  // the anchor (first) index is stored without its top bit
+  if (indices[0] & 8)
+  {
+    std::swap(q0, q1);
+    for (auto &index : indices)
+      index = uint8_t(15 - index);
+  }
+
+  std::memset(dst, 0, 16);
+  BitWriter writer {dst};
+  writer.write(1u << 6, 7);
+  for (uint32_t c = 0; c < 4; c++)
+  {
+    writer.write(q0.q[c], 7);
+    writer.write(q1.q[c], 7);
+  }
+  writer.write(q0.p, 1);
+  writer.write(q1.p, 1);
+  writer.write(indices[0], 3);
+  for (uint32_t i = 1; i < BLOCK_TEXELS; i++)
+    writer.write(indices[i], 4);
+}
+
+std::vector<uint8_t> encode_image(vk::Format format, const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+  if (format == vk::Format::eR8G8B8A8Unorm)
+    return std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4);
+
+  if (format == vk::Format::eR8G8Unorm || format == vk::Format::eR8Unorm)
+  {
+    // leading channels of every texel
+    uint32_t channels = format == vk::Format::eR8G8Unorm ? 2 : 1;
+    size_t texels = size_t(width) * height;
+    std::vector<uint8_t> result(texels * channels);
+    for (size_t i = 0; i < texels; i++)
+      std::memcpy(result.data() + i * channels, rgba + i * 4, channels);
+    return result;
+  }
+
+  void (*encodeBlock)(const uint8_t *, uint8_t *) = nullptr;
+  uint32_t blockBytes = 16;
+
+  switch (format)
+  {
+  case vk::Format::eBc1RgbUnormBlock: encodeBlock = encode_bc1_block; blockBytes = 8; break;
+  case vk::Format::eBc3UnormBlock: encodeBlock = encode_bc3_block; break;
+  case vk::Format::eBc4UnormBlock:
+    encodeBlock = [](const uint8_t *texels, uint8_t *dst) { encode_bc4_block(texels, 0, dst); };
+    blockBytes = 8;
+    break;
+  case vk::Format::eBc5UnormBlock: encodeBlock = encode_bc5_block; break;
+  case vk::Format::eBc7UnormBlock: encodeBlock = encode_bc7_block; break;
+  default:
+    ETNA_ASSERTF(false, "encode_image : unsupported format {}", vk::to_string(format));
+  }
+
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  std::vector<uint8_t> result(size_t(blocksX) * blocksY * blockBytes);
+
+  auto encodeRow = [&](uint32_t by) {
+    uint8_t texels[BLOCK_TEXELS * 4];
+    for (uint32_t bx = 0; bx < blocksX; bx++)
+    {
+      for (uint32_t y = 0; y < 4; y++)
+      {
+        uint32_t srcY = std::min(by * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++)
+        {
+          uint32_t srcX = std::min(bx * 4 + x, width - 1);
+          std::memcpy(texels + 4 * (y * 4 + x), rgba + 4 * (size_t(srcY) * width + srcX), 4);
+        }
+      }
+      encodeBlock(texels, result.data() + (size_t(by) * blocksX + bx) * blockBytes);
+    }
+  };
+
+  // small mips are not worth the pool round trip
+  if (blocksY * blocksX >= 1024)
+    util::get_thread_pool().parallelFor(blocksY, encodeRow);
+  else
+    for (uint32_t by = 0; by < blocksY; by++)
+      encodeRow(by);
+
+  return result;
+}
+
+TextureData encode_texture(vk::Format format, const uint8_t *rgba, uint32_t width, uint32_t height, bool srgb)
+{
+  TextureData texture {
+    .format = format,
+    .width = width,
+    .height = height
+  };
+
+  uint32_t levelsCount = get_mip_levels_count(width, height);
+  texture.levels.reserve(levelsCount);
+
+  size_t totalSize = 0;
+  for (uint32_t levelId = 0; levelId < levelsCount; levelId++)
+    totalSize += (get_level_size(format, std::max(width >> levelId, 1u), std::max(height >> levelId, 1u)) + 15) & ~size_t(15);
+  texture.bytes.reserve(totalSize);
+
+  std::vector<uint8_t> mip;
+  std::vector<uint8_t> next;
+  const uint8_t *level = rgba;
+  uint32_t levelWidth = width;
+  uint32_t levelHeight = height;
+
+  for (uint32_t levelId = 0; levelId < levelsCount; levelId++)
+  {
+    if (levelId > 0)
+    {
+      uint32_t nextWidth = std::max(levelWidth / 2, 1u);
+      uint32_t nextHeight = std::max(levelHeight / 2, 1u);
+      next.resize(size_t(nextWidth) * nextHeight * 4);
+      downsample_rgba8(level, levelWidth, levelHeight, next.data(), srgb);
+      std::swap(mip, next);
+      level = mip.data();
+      levelWidth = nextWidth;
+      levelHeight = nextHeight;
+    }
+
+    auto encoded = encode_image(format, level, levelWidth, levelHeight);
+
+    size_t offset = (texture.bytes.size() + 15) & ~size_t(15);
+    texture.levels.push_back({offset, encoded.size(), levelWidth, levelHeight});
+    texture.bytes.resize(offset + encoded.size());
+    std::memcpy(texture.bytes.data() + offset, encoded.data(), encoded.size());
+  }
+
+  return texture;
+}
+
+} // namespace scene
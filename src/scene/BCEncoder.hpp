@@ -0,0 +1,41 @@
+#ifndef SCENE_BC_ENCODER_HPP_INCLUDED
+#define SCENE_BC_ENCODER_HPP_INCLUDED
+
+#include "TextureData.hpp"
+
+#include <cstdint>
+
+namespace scene
+{
+
+// Formats produced by the CPU encoder
+inline bool is_bc_encodable(vk::Format format)
+{
+  return format == vk::Format::eBc1RgbUnormBlock
+    || format == vk::Format::eBc3UnormBlock
+    || format == vk::Format::eBc4UnormBlock
+    || format == vk::Format::eBc5UnormBlock
+    || format == vk::Format::eBc7UnormBlock
+    || format == vk::Format::eR8G8B8A8Unorm
+    || format == vk::Format::eR8G8Unorm
+    || format == vk::Format::eR8Unorm;
+}
+
+// Encodes one 4x4 block, texels are 16 RGBA8 values in row order
+void encode_bc1_block(const uint8_t *texels, uint8_t *dst); // 8 bytes, RGB
+void encode_bc3_block(const uint8_t *texels, uint8_t *dst); // 16 bytes, BC1 RGB + BC4 alpha
+void encode_bc4_block(const uint8_t *texels, uint32_t channel, uint8_t *dst); // 8 bytes
+void encode_bc5_block(const uint8_t *texels, uint8_t *dst); // 16 bytes, BC4 red + BC4 green
+void encode_bc7_block(const uint8_t *texels, uint8_t *dst); // 16 bytes, mode 6
+
+// Encodes a width x height RGBA8 image into format (see is_bc_encodable), edge blocks are clamped
+std::vector<uint8_t> encode_image(vk::Format format, const uint8_t *rgba, uint32_t width, uint32_t height);
+
+// Builds the full mip chain of an RGBA8 image with downsample_rgba8 and encodes every level,
+// srgb selects gamma correct filtering of RGB
+TextureData encode_texture(vk::Format format, const uint8_t *rgba, uint32_t width, uint32_t height, 
+  bool srgb = false);
+
+} // namespace scene
+
+#endif
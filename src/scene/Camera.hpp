@@ -24,6 +24,8 @@ struct Camera
     return glm::lookAtRH(position, position + front, up);
   }
 
+  const glm::vec3 &getPosition() const { return position; }
+
   void move(const glm::vec3 &offset)
   {
     position += offset.x * right + offset.y * up + offset.z * front;
@@ -0,0 +1,388 @@
+#include "GLTFFile.hpp"
+#include "GLTFStreamParser.hpp"
+#include "KTX2.hpp"
+#include "util/ThreadPool.hpp"
+#include "util/Memory.hpp"
+
+#include <etna/Etna.hpp>
+#include <nlohmann/json.hpp>
+#include <stb_image.h>
+
+#include <filesystem>
+#include <cstring>
+#include <chrono>
+
+namespace scene
+{
+
+static constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+// tinygltf accepts a zero sized data uri buffer, the real bytes are in GLTFFile::buffers
+static constexpr const char *EMPTY_BUFFER_URI = "data:application/octet-stream;base64,";
+
+struct GLBChunks
+{
+  std::string_view json;
+  std::span<const uint8_t> bin;
+};
+
+static uint32_t read_u32(std::span<const uint8_t> data, size_t offset)
+{
+  uint32_t v;
+  std::memcpy(&v, data.data() + offset, sizeof(v));
+  return v;
+}
+
+static std::optional<GLBChunks> parse_glb(std::span<const uint8_t> data)
+{
+  if (data.size() < 20 || read_u32(data, 0) != GLB_MAGIC)
+    return std::nullopt;
+
+  ETNA_ASSERTF(read_u32(data, 4) == 2, "Unsupported GLB version {}", read_u32(data, 4));
+  size_t length = std::min<size_t>(read_u32(data, 8), data.size());
+
+  GLBChunks chunks {};
+  for (size_t offset = 12; offset + 8 <= length;)
+  {
+    size_t chunkLength = read_u32(data, offset);
+    uint32_t chunkType = read_u32(data, offset + 4);
+    ETNA_ASSERTF(offset + 8 + chunkLength <= length, "GLB chunk out of file bounds");
+
+    auto chunk = data.subspan(offset + 8, chunkLength);
+    if (chunkType == GLB_CHUNK_JSON && chunks.json.empty())
+      chunks.json = {reinterpret_cast<const char*>(chunk.data()), chunk.size()};
+    else if (chunkType == GLB_CHUNK_BIN && chunks.bin.empty())
+      chunks.bin = chunk;
+
+    offset += 8 + ((chunkLength + 3) & ~size_t(3));
+  }
+
+  ETNA_ASSERTF(!chunks.json.empty(), "GLB without JSON chunk");
+  return chunks;
+}
+
+static std::string decode_uri(std::string_view uri)
+{
+  auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+
+  std::string result;
+  result.reserve(uri.size());
+  for (size_t i = 0; i < uri.size(); i++)
+  {
+    if (uri[i] == '%' && i + 2 < uri.size() && hex(uri[i + 1]) >= 0 && hex(uri[i + 2]) >= 0)
+    {
+      result.push_back(char(hex(uri[i + 1]) * 16 + hex(uri[i + 2])));
+      i += 2;
+      continue;
+    }
+    result.push_back(uri[i]);
+  }
+  return result;
+}
+
+static std::vector<uint8_t> base64_decode(std::string_view text)
+{
+  auto value = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+  };
+
+  std::vector<uint8_t> result;
+  result.reserve(text.size() / 4 * 3);
+
+  uint32_t acc = 0;
+  int bits = 0;
+  for (char c : text)
+  {
+    int v = value(c);
+    if (v < 0)
+      continue; // padding and whitespace
+    acc = (acc << 6) | uint32_t(v);
+    bits += 6;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      result.push_back(uint8_t(acc >> bits));
+    }
+  }
+  return result;
+}
+
+// bytes of a "data:<mime>;base64,<payload>" uri
+static std::vector<uint8_t> decode_data_uri(std::string_view uri)
+{
+  auto comma = uri.find(',');
+  ETNA_ASSERTF(comma != std::string_view::npos && uri.substr(0, comma).ends_with(";base64"),
+    "GLTF error : unsupported data uri");
+  return base64_decode(uri.substr(comma + 1));
+}
+
+struct SourceFile
+{
+  std::filesystem::path baseDir;
+  std::string path;
+  std::span<const uint8_t> binChunk;
+  uint64_t binChunkOffset = 0; // in the main file
+  bool isBinary = false;
+};
+
+// Maps an external buffer or takes the GLB BIN chunk
+static std::span<const uint8_t> map_buffer(GLTFFile &file, const SourceFile &src, 
+  size_t buffer_id, const std::string *uri, size_t byte_length)
+{
+  if (!uri)
+  {
+    ETNA_ASSERTF(src.isBinary && buffer_id == 0, "GLTF error : buffer {} has no uri", buffer_id);
+    ETNA_ASSERTF(src.binChunk.size() >= byte_length, "GLTF error : GLB BIN chunk is too short");
+    file.bufferSources[buffer_id] = {src.path, src.binChunkOffset};
+    return src.binChunk.first(byte_length);
+  }
+
+  auto bufferPath = (src.baseDir / decode_uri(*uri)).string();
+  auto bufferFile = MappedFile::open(bufferPath);
+  ETNA_ASSERTF(bufferFile.has_value(), "GLTF error : failed to open buffer {}", bufferPath);
+  ETNA_ASSERTF(bufferFile->getSize() >= byte_length, "GLTF error : buffer {} is too short", bufferPath);
+      
+  auto data = bufferFile->getData().first(byte_length);
+  file.mappings.push_back(std::move(*bufferFile));
+  file.bufferSources[buffer_id] = {bufferPath, 0};
+  return data;
+}
+
+// Images are kept encoded (image.as_is), the texture import decodes them only on a cache miss
+static bool store_image_bytes(tinygltf::Image &image, std::span<const uint8_t> encoded, std::string &err)
+{
+  if (auto header = read_ktx2_header(encoded))
+  {
+    image.width = int(header->pixelWidth);
+    image.height = int(header->pixelHeight);
+    image.mimeType = "image/ktx2";
+  }
+  else
+  {
+    int components = 0;
+    if (!stbi_info_from_memory(encoded.data(), int(encoded.size()), &image.width, &image.height, &components))
+    {
+      err = stbi_failure_reason();
+      return false;
+    }
+  }
+
+  image.component = -1;
+  image.bits = -1;
+  image.pixel_type = -1;
+  image.as_is = true;
+  image.image.assign(encoded.begin(), encoded.end());
+  return true;
+}
+
+// Reads every image source on the loader pool
+static void load_images(GLTFFile &file, const SourceFile &src)
+{
+  auto &model = file.model;
+  util::get_thread_pool().parallelFor(model.images.size(), [&](uint32_t imageId) {
+    auto &image = model.images[imageId];
+
+    std::vector<uint8_t> decodedUri;
+    std::optional<MappedFile> imageFile;
+    std::span<const uint8_t> encoded;
+
+    if (image.bufferView >= 0)
+    {
+      const auto &bufferView = model.bufferViews.at(image.bufferView);
+      encoded = file.buffers.at(bufferView.buffer).subspan(bufferView.byteOffset, bufferView.byteLength);
+    }
+    else if (image.uri.starts_with("data:"))
+    {
+      decodedUri = decode_data_uri(image.uri);
+      encoded = decodedUri;
+    }
+    else
+    {
+      auto imagePath = (src.baseDir / decode_uri(image.uri)).string();
+      imageFile = MappedFile::open(imagePath);
+      ETNA_ASSERTF(imageFile.has_value(), "GLTF error : failed to open image {}", imagePath);
+      encoded = imageFile->getData();
+    }
+
+    std::string err;
+    bool ret = store_image_bytes(image, encoded, err);
+    ETNA_ASSERTF(ret, "GLTF error : unsupported image {} : {}", imageId, err);
+  });
+}
+
+// tinygltf path: buffers and images are resolved on the DOM and hidden from tinygltf before it builds the model
+static void load_with_tinygltf(GLTFFile &file, const SourceFile &src, std::string_view json)
+{
+  auto doc = nlohmann::json::parse(json.begin(), json.end(), nullptr, false);
+  ETNA_ASSERTF(!doc.is_discarded(), "GLTF error : not a valid JSON document");
+
+  auto &docBuffers = doc["buffers"];
+  std::vector<bool> mapped(docBuffers.size(), false);
+  file.buffers.resize(docBuffers.size());
+  file.bufferSources.resize(docBuffers.size());
+
+  for (size_t bufferId = 0; bufferId < docBuffers.size(); bufferId++)
+  {
+    auto &buffer = docBuffers[bufferId];
+    size_t byteLength = buffer.value("byteLength", size_t(0));
+
+    std::optional<std::string> uri;
+    if (buffer.contains("uri"))
+      uri = buffer["uri"].get<std::string>();
+    
+    if (uri && uri->starts_with("data:"))
+      continue; // embedded base64, decoded by tinygltf
+
+    file.buffers[bufferId] = map_buffer(file, src, bufferId, uri ? &*uri : nullptr, byteLength);
+    file.mappedBytes += byteLength;
+    mapped[bufferId] = true;
+
+    buffer["byteLength"] = 0;
+    buffer["uri"] = EMPTY_BUFFER_URI;
+  }
+
+  // images are read by load_images like on the streaming path, tinygltf would look for bufferView images
+  // in the emptied buffers and decode data uris into copies
+  nlohmann::json docImages;
+  if (doc.contains("images"))
+  {
+    docImages = std::move(doc["images"]);
+    doc.erase("images");
+  }
+
+  tinygltf::TinyGLTF loader;
+
+  std::string err;
+  std::string warn;
+  auto rewritten = doc.dump();
+  doc = {};
+
+  auto ret = loader.LoadASCIIFromString(&file.model, &err, &warn, 
+    rewritten.c_str(), uint32_t(rewritten.size()), src.baseDir.string());
+
+  if (!err.empty())
+    ETNA_ASSERTF(false, "GLTF error : {}", err);
+
+  if (!warn.empty())
+    spdlog::warn("GLTF warings : {}", warn);
+
+  ETNA_ASSERT(ret);
+
+  for (size_t bufferId = 0; bufferId < file.buffers.size(); bufferId++)
+  {
+    if (!mapped[bufferId])
+      file.buffers[bufferId] = file.model.buffers[bufferId].data;
+  }
+
+  file.model.images.resize(docImages.size());
+  for (size_t imageId = 0; imageId < docImages.size(); imageId++)
+  {
+    const auto &docImage = docImages[imageId];
+    auto &image = file.model.images[imageId];
+    image.name = docImage.value("name", std::string {});
+    image.uri = docImage.value("uri", std::string {});
+    image.mimeType = docImage.value("mimeType", std::string {});
+    image.bufferView = docImage.value("bufferView", -1);
+  }
+  docImages = {};
+
+  load_images(file, src);
+}
+
+// streaming path: SAX parse straight into the model, then resolve buffers and images ourselves
+static void load_with_stream_parser(GLTFFile &file, const SourceFile &src, std::string_view json)
+{
+  std::vector<size_t> bufferLengths;
+  std::string err;
+  bool ret = parse_gltf_json(json, file.model, bufferLengths, err);
+  ETNA_ASSERTF(ret, "GLTF error : {}", err);
+
+  auto &buffers = file.model.buffers;
+  file.buffers.resize(buffers.size());
+  file.bufferSources.resize(buffers.size());
+
+  for (size_t bufferId = 0; bufferId < buffers.size(); bufferId++)
+  {
+    auto &buffer = buffers[bufferId];
+    if (buffer.uri.starts_with("data:"))
+    {
+      buffer.data = decode_data_uri(buffer.uri);
+      ETNA_ASSERTF(buffer.data.size() >= bufferLengths[bufferId], "GLTF error : buffer {} is too short", bufferId);
+      file.buffers[bufferId] = std::span<const uint8_t>{buffer.data}.first(bufferLengths[bufferId]);
+      continue;
+    }
+
+    file.buffers[bufferId] = map_buffer(file, src, bufferId, 
+      buffer.uri.empty() ? nullptr : &buffer.uri, bufferLengths[bufferId]);
+    file.mappedBytes += bufferLengths[bufferId];
+  }
+
+  load_images(file, src);
+}
+
+GLTFFile open_gltf_file(const std::string &path, GLTFParser parser)
+{
+  GLTFFile file;
+
+  auto mainFile = MappedFile::open(path);
+  ETNA_ASSERTF(mainFile.has_value(), "Failed to open {}", path);
+
+  auto mainData = mainFile->getData();
+  std::string_view json {reinterpret_cast<const char*>(mainData.data()), mainData.size()};
+  
+  SourceFile src {
+    .baseDir = std::filesystem::path(path).parent_path(),
+    .path = path
+  };
+
+  if (auto glb = parse_glb(mainData))
+  {
+    json = glb->json;
+    src.binChunk = glb->bin;
+    src.binChunkOffset = uint64_t(glb->bin.data() - mainData.data());
+    src.isBinary = true;
+  }
+
+  file.jsonBytes = json.size();
+  uint64_t rssBefore = util::get_peak_rss();
+  auto parseStart = std::chrono::steady_clock::now();
+
+  if (parser == GLTFParser::TinyGLTF)
+    load_with_tinygltf(file, src, json);
+  else
+    load_with_stream_parser(file, src, json);
+
+  file.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+  file.parsePeakRssGrowth = util::get_peak_rss() - rssBefore;
+
+  // the main mapping stays alive for the GLB BIN chunk
+  file.mappings.push_back(std::move(*mainFile));
+  return file;
+}
+
+void release_buffer_pages(const GLTFFile &file, std::span<const uint8_t> range)
+{
+  for (const auto &mapping : file.mappings)
+  {
+    auto data = mapping.getData();
+    if (range.data() >= data.data() && range.data() + range.size() <= data.data() + data.size())
+    {
+      release_pages(range);
+      return;
+    }
+  }
+}
+
+} // namespace scene
@@ -0,0 +1,52 @@
+#ifndef SCENE_GLTF_FILE_HPP_INCLUDED
+#define SCENE_GLTF_FILE_HPP_INCLUDED
+
+#include <tiny_gltf.h>
+
+#include "MappedFile.hpp"
+
+#include <vector>
+#include <span>
+#include <string>
+
+namespace scene
+{
+
+enum class GLTFParser
+{
+  TinyGLTF, // nlohmann DOM + tinygltf model, kept for comparison
+  Streaming // single pass SAX parse into the model, see GLTFStreamParser.hpp
+};
+
+// Parsed .gltf/.glb document. External buffers and the GLB BIN chunk are not copied
+// into tinygltf::Buffer::data, buffers[i] points into mapped file pages instead.
+struct GLTFFile
+{
+  tinygltf::Model model;
+
+  std::vector<std::span<const uint8_t>> buffers; // indexed like model.buffers
+  std::vector<MappedFile> mappings;
+
+  // where mapped buffers are stored, for readers that bypass the mapping. Empty path for decoded buffers.
+  struct BufferSource
+  {
+    std::string path;
+    uint64_t offset = 0; // of buffers[i] in the file
+  };
+  std::vector<BufferSource> bufferSources; // indexed like model.buffers
+
+  uint64_t mappedBytes = 0;
+
+  uint64_t jsonBytes = 0;
+  double parseSeconds = 0.0; // JSON parse, buffer and image source resolve
+  uint64_t parsePeakRssGrowth = 0; // VmHWM increase while parsing
+};
+
+GLTFFile open_gltf_file(const std::string &path, GLTFParser parser = GLTFParser::Streaming);
+
+// Drops resident pages of a buffer range once it has been read, ranges of decoded (data URI) buffers are kept
+void release_buffer_pages(const GLTFFile &file, std::span<const uint8_t> range);
+
+} // namespace scene
+
+#endif
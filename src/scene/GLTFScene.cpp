@@ -1,5 +1,15 @@
 #define TINYGLTF_IMPLEMENTATION
 #include "GLTFScene.hpp"
+#include "AccessorKernels.hpp"
+#include "AssetReader.hpp"
+#include "BCEncoder.hpp"
+#include "KTX2.hpp"
+#include "TextureCache.hpp"
+#include "TextureStreamer.hpp"
+#include "util/ThreadPool.hpp"
+#include "util/Memory.hpp"
+#include "util/Hash.hpp"
+#include "renderer/MipGenerator.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -10,9 +20,18 @@
 
 #include <glm/gtx/quaternion.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <vulkan/vulkan_format_traits.hpp>
 
 #include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <string_view>
+#include <chrono>
+#include <numeric>
+#include <limits>
 
 namespace scene 
 {
@@ -117,16 +136,16 @@ static void generate_mips(etna::SyncCommandBuffer &cmd, const etna::Image &image
   }
 }
 
-static etna::Image load_image(etna::SyncCommandBuffer &cmd, const tinygltf::Image &src,
-  std::vector<etna::Buffer> &staging_buffers)
+static void flush_staging_if_full(etna::SyncCommandBuffer &cmd, std::vector<etna::Buffer> &staging_buffers,
+  uint64_t limit = 32 << 20)
 {
-  uint32_t stagingMemSize = 0;
+  uint64_t stagingMemSize = 0;
   for (auto &buff : staging_buffers)
   {
     stagingMemSize += buff.getSize();
   }
 
-  if (stagingMemSize >= 32 << 20)
+  if (!staging_buffers.empty() && stagingMemSize >= limit)
   {
     cmd.end();
     cmd.submit();
@@ -135,60 +154,75 @@ static etna::Image load_image(etna::SyncCommandBuffer &cmd, const tinygltf::Imag
     cmd.reset();
     cmd.begin();
   }
+}
 
+// Uploads levels [first_level, levels.size()) of a prepared mip chain as is. Missing levels of
+// uncompressed formats are generated on the GPU, with the compute mip generator when it supports
+// the format and size and blits otherwise.
+etna::Image upload_texture(etna::SyncCommandBuffer &cmd, const TextureData &texture, uint32_t first_level,
+  bool srgb, renderer::MipGenerator *mip_generator, std::vector<etna::Buffer> &staging_buffers)
+{
+  bool compressed = vk::blockExtent(texture.format)[0] > 1;
+  uint32_t levelsCount = uint32_t(texture.levels.size()) - first_level;
+  bool gpuMips = !compressed && texture.levels.size() == 1;
+  const auto &base = texture.levels[first_level];
+  bool computeMips = gpuMips && mip_generator
+    && renderer::MipGenerator::isImageSupported(texture.format, base.width, base.height);
+
+  auto createInfo = etna::ImageCreateInfo::image2D(base.width, base.height, texture.format);
+  if (!gpuMips)
+    createInfo.mipLevels = levelsCount;
+  if (computeMips)
+    createInfo.imageUsage |= vk::ImageUsageFlagBits::eStorage;
+  auto image = etna::get_context().createImage(std::move(createInfo));
 
-  auto image = etna::get_context().createImage(
-    etna::ImageCreateInfo::image2D(src.width, src.height, vk::Format::eR8G8B8A8Unorm));
-  
-  auto &info = image.getInfo();
-
+  // cached textures are copied straight from the mapped KTX2 file
+  auto [begin, end] = texture.getLevelsRange(first_level);
+  auto bytes = texture.getBytes().subspan(begin, end - begin);
   auto stagingBuf = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = vk::blockSize(info.format) * info.extent.width * info.extent.height,
+    .size = bytes.size(),
     .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
     .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
   });
 
-  ETNA_ASSERT(stagingBuf.getSize() == src.image.size() * sizeof(src.image[0]));
-
   auto ptr = stagingBuf.map();
-  std::memcpy(ptr, src.image.data(), src.image.size() * sizeof(src.image[0]));
+  std::memcpy(ptr, bytes.data(), bytes.size());
   stagingBuf.unmap();
 
-  //cmd.reset();
-  //cmd.begin();
+  cmd.copyBufferToImage(stagingBuf, image, vk::ImageLayout::eTransferDstOptimal, 
+    get_copy_regions(texture, first_level));
 
-  cmd.copyBufferToImage(stagingBuf, image, vk::ImageLayout::eTransferDstOptimal, {
-    vk::BufferImageCopy {
-      .bufferOffset = 0,
-      .bufferRowLength = info.extent.width,
-      .bufferImageHeight = info.extent.height,
-      .imageSubresource {image.getAspectMaskByFormat(), 0, 0, 1},
-      .imageOffset {0, 0, 0},
-      .imageExtent = info.extent
-    }
-  });
+  if (computeMips)
+    mip_generator->generate(cmd, image, srgb ? renderer::MipFilter::BoxSRGB : renderer::MipFilter::Box);
+  else if (gpuMips)
+    generate_mips(cmd, image);
 
-  generate_mips(cmd, image);
-  //cmd.end();
-  //cmd.submit();
-  //etna::get_context().getQueue().waitIdle();
-  
-  //cmd.reset();
   staging_buffers.emplace_back(std::move(stagingBuf));
   return image;
 }
 
-static etna::Image create_stub_rexture(etna::SyncCommandBuffer &cmd)
+bool is_texture_streamed(const TextureData &texture, const SceneLoadOptions &options)
+{
+  bool gpuMips = texture.levels.size() == 1 && texture.format == vk::Format::eR8G8B8A8Unorm;
+  return options.streamTextures && !gpuMips;
+}
+
+etna::Image record_stub_texture(etna::SyncCommandBuffer &cmd)
 {
   auto createInfo = etna::ImageCreateInfo::image2D(1, 1, vk::Format::eR8G8B8A8Unorm);
   auto image = etna::get_context().createImage(std::move(createInfo));
 
   vk::ClearColorValue color{1.f, 0.f, 0.f, 0.f};
-
-  cmd.begin();
   cmd.clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, color, {
     vk::ImageSubresourceRange {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}
   });
+  return image;
+}
+
+static etna::Image create_stub_rexture(etna::SyncCommandBuffer &cmd)
+{
+  cmd.begin();
+  auto image = record_stub_texture(cmd);
   cmd.end();
   cmd.submit();
   etna::get_context().getQueue().waitIdle();
@@ -229,7 +263,7 @@ remap_min_filter(int val)
   return {vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear};
 }
 
-static vk::UniqueSampler create_sampler(const tinygltf::Sampler &desc)
+static vk::SamplerCreateInfo get_sampler_info(const tinygltf::Sampler &desc)
 {
   auto magFilter = (desc.magFilter == TINYGLTF_TEXTURE_FILTER_NEAREST)? 
     vk::Filter::eNearest : vk::Filter::eLinear; 
@@ -246,89 +280,584 @@ static vk::UniqueSampler create_sampler(const tinygltf::Sampler &desc)
     .maxLod = VK_LOD_CLAMP_NONE
   };
 
-  return etna::get_context().getDevice().createSamplerUnique(info).value;
+  return info;
 }
 
-std::span<const float> get_span(const tinygltf::Model &model, const tinygltf::Accessor &accessor)
+static vk::UniqueSampler create_sampler(const tinygltf::Sampler &desc)
+{
+  return etna::get_context().getDevice().createSamplerUnique(get_sampler_info(desc)).value;
+}
+
+static AccessorView get_accessor_view(const GLTFFile &file, const tinygltf::Accessor &accessor)
 {
-  ETNA_ASSERT(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
   ETNA_ASSERT(accessor.sparse.isSparse == false);
   ETNA_ASSERT(accessor.bufferView >= 0);
 
-  auto &bufferView = model.bufferViews[accessor.bufferView];
-  auto &buffer = model.buffers[bufferView.buffer];
+  auto &bufferView = file.model.bufferViews[accessor.bufferView];
+  auto buffer = file.buffers[bufferView.buffer];
+
+  AccessorView view {
+    .count = uint32_t(accessor.count),
+    .components = uint32_t(tinygltf::GetNumComponentsInType(uint32_t(accessor.type))),
+    .componentType = ComponentType(accessor.componentType),
+    .normalized = accessor.normalized
+  };
+
+  uint32_t byteStride = bufferView.byteStride;
+  view.stride = byteStride ? byteStride : view.elementSize();
   
-  uint32_t components = tinygltf::GetNumComponentsInType(uint32_t(accessor.type));
-  uint32_t floatsCount = accessor.count * components;
+  size_t byteOffset = accessor.byteOffset + bufferView.byteOffset;
+  ETNA_ASSERT(byteOffset + view.byteSize() <= buffer.size());
+  view.data = buffer.data() + byteOffset;
   
-  uint32_t byteOffset = accessor.byteOffset + bufferView.byteOffset;
-  const uint8_t *ptr = buffer.data.data();
+  return view;
+}
+
+struct VertexRange
+{
+  AccessorView pos;
+  std::optional<AccessorView> norm;
+  std::optional<AccessorView> uv;
+
+  uint32_t stagingOffset = 0; // in vertices, staging is laid out with unwelded counts
+  uint32_t vertexCount = 0; // after welding
+  uint32_t vertexOffset = 0; // in the final vertex buffer
+  uint32_t users = 0;
+  std::vector<uint32_t> remap; // accessor vertex -> welded vertex, empty if not welded
+};
+
+struct PrimitiveJob
+{
+  AccessorView indices;
+  uint32_t rangeId;
+  uint32_t meshId;
+  uint32_t drawCallId;
+};
+
+// phase one result: every primitive knows where its vertices and indices go
+struct GeometryPlan
+{
+  std::vector<VertexRange> ranges;
+  std::vector<PrimitiveJob> primitives;
+  uint32_t stagingVertices = 0;
+  uint32_t indexCount = 0;
+};
+
+// primitives that share POSITION/NORMAL/TEXCOORD_0 accessors share the emitted vertex range
+using VertexRangeKey = std::tuple<int, int, int>;
+
+struct VertexBytesHash
+{
+  size_t operator()(const Vertex &v) const
+  {
+    return std::hash<std::string_view>{}(
+      std::string_view{reinterpret_cast<const char*>(&v), sizeof(Vertex)});
+  }
+};
+
+struct VertexBytesEqual
+{
+  bool operator()(const Vertex &a, const Vertex &b) const
+  {
+    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+  }
+};
+
+// merges bit-identical vertices in place, returns accessor->welded remap
+static std::vector<uint32_t> weld_vertices(std::span<Vertex> verts, uint32_t &welded_count)
+{
+  std::vector<uint32_t> remap;
+  remap.reserve(verts.size());
+
+  std::unordered_map<Vertex, uint32_t, VertexBytesHash, VertexBytesEqual> unique;
+  unique.reserve(verts.size());
+
+  welded_count = 0;
+  for (uint32_t vertId = 0; vertId < verts.size(); vertId++)
+  {
+    const Vertex vert = verts[vertId];
+    auto [it, inserted] = unique.emplace(vert, welded_count);
+    if (inserted)
+      verts[welded_count++] = vert;
+    remap.push_back(it->second);
+  }
 
-  return std::span{reinterpret_cast<const float*>(ptr + byteOffset), floatsCount};
+  return remap;
 }
 
-static std::variant<std::span<const uint16_t>, std::span<const uint32_t>>
-get_indicies(const tinygltf::Model &model, const tinygltf::Accessor &accessor)
+static GeometryPlan plan_geometry(const GLTFFile &file, 
+  std::vector<GLTFScene::Mesh> &sceneMeshes,
+  SceneLoadStats &stats)
 {
-  ETNA_ASSERT(accessor.sparse.isSparse == false);
-  ETNA_ASSERT(accessor.bufferView >= 0);
+  const auto &model = file.model;
+  GeometryPlan plan;
+  std::map<VertexRangeKey, uint32_t> rangeIds;
 
-  auto &bufferView = model.bufferViews[accessor.bufferView];
-  auto &buffer = model.buffers[bufferView.buffer];
-  
-  uint32_t components = tinygltf::GetNumComponentsInType(uint32_t(accessor.type));
-  ETNA_ASSERT(components == 1);
-  uint32_t compSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
-  ETNA_ASSERT(compSize == 2 || compSize == 4);  
-  uint32_t byteOffset = accessor.byteOffset + bufferView.byteOffset;
-  const uint8_t *ptr = buffer.data.data();
+  sceneMeshes.reserve(model.meshes.size());
 
-  if (compSize == 2)
+  for (const auto &mesh : model.meshes)
   {
-    return std::span{reinterpret_cast<const uint16_t*>(ptr + byteOffset), accessor.count};
+    GLTFScene::Mesh sceneMesh;
+    for (const auto &primitive : mesh.primitives)
+    {
+      auto posAccessorIt = primitive.attributes.find("POSITION");
+      auto uvAccessorIt = primitive.attributes.find("TEXCOORD_0");
+      auto normAccessorIt = primitive.attributes.find("NORMAL");
+
+      ETNA_ASSERT(posAccessorIt != primitive.attributes.end());
+      ETNA_ASSERT(primitive.indices >= 0);
+      ETNA_ASSERT(primitive.material >= 0);
+
+      VertexRangeKey rangeKey {
+        posAccessorIt->second,
+        normAccessorIt != primitive.attributes.end() ? normAccessorIt->second : -1,
+        uvAccessorIt != primitive.attributes.end() ? uvAccessorIt->second : -1
+      };
+
+      auto [rangeIt, inserted] = rangeIds.emplace(rangeKey, uint32_t(plan.ranges.size()));
+      if (inserted)
+      {
+        VertexRange range {
+          .pos = get_accessor_view(file, model.accessors[posAccessorIt->second])
+        };
+
+        if (normAccessorIt != primitive.attributes.end())
+          range.norm = get_accessor_view(file, model.accessors[normAccessorIt->second]);
+        if (uvAccessorIt != primitive.attributes.end())
+          range.uv = get_accessor_view(file, model.accessors[uvAccessorIt->second]);
+
+        ETNA_ASSERT(!range.norm.has_value() || range.norm->count >= range.pos.count);
+        ETNA_ASSERT(!range.uv.has_value() || range.uv->count >= range.pos.count);
+
+        range.stagingOffset = plan.stagingVertices;
+        range.vertexCount = range.pos.count;
+        plan.stagingVertices += range.pos.count;
+
+        stats.emittedVertices += range.pos.count;
+        stats.convertedBytes += range.pos.byteSize();
+        stats.convertedBytes += range.norm.has_value() ? range.norm->byteSize() : 0;
+        stats.convertedBytes += range.uv.has_value() ? range.uv->byteSize() : 0;
+
+        plan.ranges.push_back(std::move(range));
+      }
+      plan.ranges[rangeIt->second].users++;
+
+      const auto &indices = model.accessors[primitive.indices];
+      ETNA_ASSERT(indices.sparse.isSparse == false);
+
+      PrimitiveJob job {
+        .indices = get_accessor_view(file, indices),
+        .rangeId = rangeIt->second,
+        .meshId = uint32_t(sceneMeshes.size()),
+        .drawCallId = uint32_t(sceneMesh.drawCalls.size())
+      };
+      ETNA_ASSERT(job.indices.components == 1);
+      stats.convertedBytes += job.indices.byteSize();
+
+      GLTFScene::Mesh::DrawCall drawCall {
+        .firstIndex = plan.indexCount,
+        .indexCount = job.indices.count,
+        .vertexOffset = 0, // known after welding
+        .materialId = uint32_t(primitive.material)
+      };
+
+      // min/max are required for POSITION accessors
+      const auto &posAccessor = model.accessors[posAccessorIt->second];
+      if (posAccessor.minValues.size() == 3 && posAccessor.maxValues.size() == 3)
+      {
+        drawCall.boundsMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+        drawCall.boundsMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+      }
+      sceneMesh.drawCalls.push_back(drawCall);
+
+      plan.indexCount += job.indices.count;
+      plan.primitives.push_back(job);
+    }
+    sceneMeshes.push_back(std::move(sceneMesh));
   }
-  
-  return std::span{reinterpret_cast<const uint32_t*>(ptr + byteOffset), accessor.count};
+
+  return plan;
 }
 
-static std::tuple<etna::Buffer, etna::Buffer> load_verts_data(
-  etna::SyncCommandBuffer &cmd, 
-  const std::vector<Vertex> &vertsData,
-  const std::vector<uint32_t> &indexData)
+// Converts the range through a cached scratch buffer and writes staging memory sequentially,
+// staging is usually write-combined and should be neither read nor written with gaps.
+// dst points to the range start in staging.
+static void fill_vertex_range(VertexRange &range, bool weld, Vertex *dst)
 {
-  auto vertBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = sizeof(Vertex) * vertsData.size(),
-    .bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  constexpr uint32_t CHUNK_VERTICES = 4096;
+  static const float zeros[4] {0.f, 0.f, 0.f, 0.f};
+
+  thread_local std::vector<Vertex> scratch;
+
+  auto convertChunk = [&](uint32_t first, uint32_t count, Vertex *dst) {
+    auto subrange = [&](AccessorView view) {
+      view.data += size_t(first) * view.stride;
+      view.count = count;
+      return view;
+    };
+
+    // zero stride view broadcasts zeros for missing attributes
+    AccessorView zeroView {
+      .data = reinterpret_cast<const uint8_t*>(zeros),
+      .count = count,
+      .stride = 0,
+      .components = 4,
+      .componentType = ComponentType::Float
+    };
+
+    auto out = reinterpret_cast<uint8_t*>(dst);
+    convert_to_float(subrange(range.pos), 3, out + offsetof(Vertex, pos), sizeof(Vertex));
+    convert_to_float(range.norm.has_value() ? subrange(*range.norm) : zeroView, 3,
+      out + offsetof(Vertex, norm), sizeof(Vertex));
+    convert_to_float(range.uv.has_value() ? subrange(*range.uv) : zeroView, 2,
+      out + offsetof(Vertex, uv), sizeof(Vertex));
+  };
+
+  const uint32_t vertexCount = range.pos.count;
+
+  if (weld)
+  {
+    scratch.resize(vertexCount);
+    convertChunk(0, vertexCount, scratch.data());
+    range.remap = weld_vertices(scratch, range.vertexCount);
+    std::memcpy(dst, scratch.data(), range.vertexCount * sizeof(Vertex));
+    return;
+  }
+
+  scratch.resize(std::min(vertexCount, CHUNK_VERTICES));
+  for (uint32_t first = 0; first < vertexCount; first += CHUNK_VERTICES)
+  {
+    uint32_t count = std::min(vertexCount - first, CHUNK_VERTICES);
+    convertChunk(first, count, scratch.data());
+    std::memcpy(dst + first, scratch.data(), count * sizeof(Vertex));
+  }
+}
+
+// dst points to the first index of the draw call in staging
+static void fill_indices(const PrimitiveJob &job, const VertexRange &range, uint32_t *dst)
+{
+  if (range.remap.empty())
+  {
+    widen_indices(job.indices, dst);
+    return;
+  }
+
+  thread_local std::vector<uint32_t> scratch;
+  scratch.resize(job.indices.count);
+  widen_indices(job.indices, scratch.data());
+
+  for (auto &index : scratch)
+    index = range.remap.at(index);
+
+  std::memcpy(dst, scratch.data(), scratch.size() * sizeof(uint32_t));
+}
+
+// Phase two: fills vertex and index staging memory on the loader pool
+static void fill_geometry(GeometryPlan &plan, const SceneLoadOptions &options,
+  const std::vector<GLTFScene::Mesh> &sceneMeshes, SceneLoadStats &stats, Vertex *vertices, uint32_t *indices)
+{
+  auto &pool = util::get_thread_pool();
+  auto fillStart = std::chrono::steady_clock::now();
+
+  pool.parallelFor(plan.ranges.size(), [&](uint32_t rangeId) {
+    auto &range = plan.ranges[rangeId];
+    fill_vertex_range(range, options.weldVertices, vertices + range.stagingOffset);
   });
 
-  auto indexBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = sizeof(uint32_t) * indexData.size(),
-    .bufferUsage = vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  // remap tables are ready, indices may be written now
+  pool.parallelFor(plan.primitives.size(), [&](uint32_t primId) {
+    const auto &job = plan.primitives[primId];
+    uint32_t firstIndex = sceneMeshes[job.meshId].drawCalls[job.drawCallId].firstIndex;
+    fill_indices(job, plan.ranges[job.rangeId], indices + firstIndex);
+  });
+
+  stats.conversionSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - fillStart).count();
+  stats.workerThreads = pool.getThreadsCount() + 1;
+}
+
+// Places the (welded) ranges one after another and points draw calls at them.
+// Returns the copies from staging to the compacted vertex buffer and its vertex count.
+static std::tuple<std::vector<vk::BufferCopy>, uint32_t> compact_vertex_ranges(GeometryPlan &plan,
+  std::vector<GLTFScene::Mesh> &sceneMeshes, SceneLoadStats &stats)
+{
+  // welded ranges leave gaps in staging, they are skipped by the copy
+  std::vector<vk::BufferCopy> vertexRegions;
+  uint32_t vertexCount = 0;
+
+  for (auto &range : plan.ranges)
+  {
+    range.vertexOffset = vertexCount;
+    vertexCount += range.vertexCount;
+    stats.weldedVertices += range.pos.count - range.vertexCount;
+    stats.sharedVertices += uint64_t(range.users - 1) * range.vertexCount;
+
+    vk::DeviceSize srcOffset = sizeof(Vertex) * range.stagingOffset;
+    vk::DeviceSize dstOffset = sizeof(Vertex) * range.vertexOffset;
+    vk::DeviceSize size = sizeof(Vertex) * range.vertexCount;
+
+    if (size == 0)
+      continue;
+
+    if (!vertexRegions.empty() 
+      && vertexRegions.back().srcOffset + vertexRegions.back().size == srcOffset
+      && vertexRegions.back().dstOffset + vertexRegions.back().size == dstOffset)
+    {
+      vertexRegions.back().size += size;
+      continue;
+    }
+
+    vertexRegions.push_back(vk::BufferCopy {
+      .srcOffset = srcOffset, 
+      .dstOffset = dstOffset, 
+      .size = size
+    });
+  }
+
+  for (const auto &job : plan.primitives)
+    sceneMeshes[job.meshId].drawCalls[job.drawCallId].vertexOffset = plan.ranges[job.rangeId].vertexOffset;
+
+  return {std::move(vertexRegions), vertexCount};
+}
+
+// interleaved float POSITION/NORMAL/TEXCOORD_0 with the Vertex stride, the range may be copied as is
+static bool is_runtime_layout(const VertexRange &range)
+{
+  auto isFloat = [](const AccessorView &view, uint32_t components) {
+    return view.componentType == ComponentType::Float && view.components == components 
+      && view.stride == sizeof(Vertex);
+  };
+
+  return range.norm.has_value() && range.uv.has_value()
+    && isFloat(range.pos, 3) && isFloat(*range.norm, 3) && isFloat(*range.uv, 2)
+    && range.norm->data == range.pos.data + offsetof(Vertex, norm)
+    && range.uv->data == range.pos.data + offsetof(Vertex, uv);
+}
+
+// Phase two for GeometryReads::Direct, accessor bytes are read from the buffer files with AssetReader
+// instead of being faulted in through the mappings:
+//  - ranges in the Vertex layout are read straight into vertex staging unless welded, other ranges read
+//    their attribute spans into a scratch block and are converted into staging when the reads complete;
+//  - tightly packed indices are read into their staging range, narrower types into its tail and widened
+//    in place. Remaps of welded ranges are applied in place once every range is filled.
+// Buffers without a file (data URIs) go through the mapped path. Reads and conversions overlap on the
+// loader pool, index staging is read back and should be host cached.
+static void fill_geometry_direct(const GLTFFile &file, GeometryPlan &plan, const SceneLoadOptions &options,
+  const std::vector<GLTFScene::Mesh> &sceneMeshes, SceneLoadStats &stats, Vertex *vertices, uint32_t *indices)
+{
+  auto &pool = util::get_thread_pool();
+  auto fillStart = std::chrono::steady_clock::now();
+
+  std::map<std::string, int> openFiles;
+  std::vector<int> bufferFds(file.buffers.size(), -1);
+  for (size_t bufferId = 0; bufferId < file.buffers.size(); bufferId++)
+  {
+    const auto &source = file.bufferSources[bufferId];
+    if (source.path.empty())
+      continue;
+    auto [it, inserted] = openFiles.emplace(source.path, -1);
+    if (inserted)
+      it->second = ::open(source.path.c_str(), O_RDONLY | O_CLOEXEC);
+    bufferFds[bufferId] = it->second;
+  }
+
+  struct FileRange
+  {
+    int fd;
+    uint64_t offset;
+  };
+
+  // nullopt for bytes of decoded buffers and files that failed to open
+  auto locate = [&](const uint8_t *ptr) -> std::optional<FileRange> {
+    for (size_t bufferId = 0; bufferId < file.buffers.size(); bufferId++)
+    {
+      auto buffer = file.buffers[bufferId];
+      if (bufferFds[bufferId] >= 0 && ptr >= buffer.data() && ptr < buffer.data() + buffer.size())
+        return FileRange {bufferFds[bufferId], file.bufferSources[bufferId].offset + uint64_t(ptr - buffer.data())};
+    }
+    return std::nullopt;
+  };
+
+  struct RangeScratch
+  {
+    std::vector<uint8_t> bytes; // attribute spans, 16 byte aligned
+    std::atomic<uint32_t> remaining {0};
+  };
+
+  AssetReader reader;
+  std::vector<std::unique_ptr<RangeScratch>> scratch(plan.ranges.size());
+  std::vector<uint32_t> mappedRanges;
+
+  for (uint32_t rangeId = 0; rangeId < plan.ranges.size(); rangeId++)
+  {
+    auto &range = plan.ranges[rangeId];
+    Vertex *dst = vertices + range.stagingOffset;
+
+    std::vector<AccessorView*> views {&range.pos};
+    if (range.norm)
+      views.push_back(&*range.norm);
+    if (range.uv)
+      views.push_back(&*range.uv);
+
+    std::vector<FileRange> locations;
+    for (auto view : views)
+    {
+      if (auto location = locate(view->data))
+        locations.push_back(*location);
+    }
+
+    if (locations.size() != views.size())
+    {
+      mappedRanges.push_back(rangeId);
+      continue;
+    }
+
+    if (!options.weldVertices && is_runtime_layout(range))
+    {
+      reader.read(locations[0].fd, locations[0].offset, sizeof(Vertex) * range.pos.count, dst);
+      continue;
+    }
+
+    // the views are pointed at the scratch block, the conversion does not touch the mappings
+    auto &block = scratch[rangeId];
+    block = std::make_unique<RangeScratch>();
+    size_t blockSize = 0;
+    std::vector<size_t> offsets;
+    for (auto view : views)
+    {
+      offsets.push_back(blockSize);
+      blockSize = (blockSize + view->byteSize() + 15) & ~size_t(15);
+    }
+    block->bytes.resize(blockSize);
+    block->remaining = uint32_t(views.size());
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+      uint64_t size = views[i]->byteSize();
+      views[i]->data = block->bytes.data() + offsets[i];
+      reader.read(locations[i].fd, locations[i].offset, size, block->bytes.data() + offsets[i], 
+        [&range, &block, dst, weld = options.weldVertices]() {
+          if (--block->remaining > 0)
+            return;
+          fill_vertex_range(range, weld, dst);
+          block.reset();
+        });
+    }
+  }
+
+  // the calling thread converts ranges without files while the reads are in flight
+  pool.parallelFor(uint32_t(mappedRanges.size()), [&](uint32_t i) {
+    auto &range = plan.ranges[mappedRanges[i]];
+    fill_vertex_range(range, options.weldVertices, vertices + range.stagingOffset);
   });
 
+  std::vector<bool> readIndices(plan.primitives.size(), false);
+  for (uint32_t primId = 0; primId < plan.primitives.size(); primId++)
+  {
+    const auto &job = plan.primitives[primId];
+    uint32_t elementSize = job.indices.elementSize();
+    auto location = locate(job.indices.data);
+    if (!location || job.indices.stride != elementSize)
+      continue;
+
+    uint32_t *dst = indices + sceneMeshes[job.meshId].drawCalls[job.drawCallId].firstIndex;
+    uint64_t size = uint64_t(job.indices.count) * elementSize;
+    auto tail = reinterpret_cast<uint8_t*>(dst) + uint64_t(job.indices.count) * sizeof(uint32_t) - size;
+
+    if (job.indices.componentType == ComponentType::UnsignedInt)
+    {
+      reader.read(location->fd, location->offset, size, dst);
+    }
+    else
+    {
+      reader.read(location->fd, location->offset, size, tail, [view = job.indices, tail, dst]() mutable {
+        view.data = tail;
+        widen_indices(view, dst);
+      });
+    }
+    readIndices[primId] = true;
+  }
+
+  reader.wait();
+  for (auto [path, fd] : openFiles)
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  // every remap table is ready now
+  pool.parallelFor(uint32_t(plan.primitives.size()), [&](uint32_t primId) {
+    const auto &job = plan.primitives[primId];
+    const auto &range = plan.ranges[job.rangeId];
+    uint32_t *dst = indices + sceneMeshes[job.meshId].drawCalls[job.drawCallId].firstIndex;
+
+    if (!readIndices[primId])
+    {
+      fill_indices(job, range, dst);
+      return;
+    }
+
+    if (!range.remap.empty())
+    {
+      for (uint32_t i = 0; i < job.indices.count; i++)
+        dst[i] = range.remap.at(dst[i]);
+    }
+  });
+
+  stats.directReadBytes = reader.getBytesRead();
+  stats.directReadIoUring = reader.usesIoUring();
+  stats.conversionSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - fillStart).count();
+  stats.workerThreads = pool.getThreadsCount() + 1;
+}
+
+// Fills staging buffers, then copies the compacted ranges to device local buffers
+static std::tuple<etna::Buffer, etna::Buffer> load_geometry(
+  etna::SyncCommandBuffer &cmd,
+  const GLTFFile &file,
+  GeometryPlan &plan,
+  const SceneLoadOptions &options,
+  std::vector<GLTFScene::Mesh> &sceneMeshes,
+  SceneLoadStats &stats)
+{
   auto stagingVerts = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = vertBuff.getSize(),
+    .size = sizeof(Vertex) * plan.stagingVertices,
     .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
     .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
   });
 
+  // direct reads widen and remap indices in staging, it is read back then
+  bool direct = options.geometryReads == GeometryReads::Direct;
   auto stagingIndex = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
-    .size = indexBuff.getSize(),
+    .size = sizeof(uint32_t) * plan.indexCount,
     .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
-    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    .memoryUsage = direct ? VMA_MEMORY_USAGE_GPU_TO_CPU : VMA_MEMORY_USAGE_CPU_TO_GPU
   });
 
-  auto mem = stagingVerts.map();
-  std::memcpy(mem, vertsData.data(), stagingVerts.getSize());
+  auto vertsPtr = reinterpret_cast<Vertex*>(stagingVerts.map());
+  auto indexPtr = reinterpret_cast<uint32_t*>(stagingIndex.map());
+  if (direct)
+    fill_geometry_direct(file, plan, options, sceneMeshes, stats, vertsPtr, indexPtr);
+  else
+    fill_geometry(plan, options, sceneMeshes, stats, vertsPtr, indexPtr);
   stagingVerts.unmap();
-
-  mem = stagingIndex.map();
-  std::memcpy(mem, indexData.data(), indexBuff.getSize());
   stagingIndex.unmap();
 
+  auto [vertexRegions, vertexCount] = compact_vertex_ranges(plan, sceneMeshes, stats);
+
+  auto vertBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(Vertex) * vertexCount,
+    .bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  auto indexBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(uint32_t) * plan.indexCount,
+    .bufferUsage = vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
   cmd.reset();
   cmd.begin();
-  cmd.copyBuffer(stagingVerts, vertBuff, {vk::BufferCopy {.size = vertBuff.getSize()}});
+  cmd.copyBuffer(stagingVerts, vertBuff, vertexRegions);
   cmd.copyBuffer(stagingIndex, indexBuff, {vk::BufferCopy{.size = indexBuff.getSize()}});
   cmd.end();
   cmd.submit();
@@ -339,88 +868,426 @@ static std::tuple<etna::Buffer, etna::Buffer> load_verts_data(
   return {std::move(vertBuff), std::move(indexBuff)};
 }
 
-static GLTFScene::Mesh::DrawCall process_prim(
-  const tinygltf::Model &model,
-  const tinygltf::Primitive &primitive, 
-  std::vector<Vertex> &vertexData,
-  std::vector<uint32_t> &indexData)
+// Submits what record adds to cmd and waits for it, so staging used by the batch may be freed
+template <typename F>
+static void submit_and_wait(etna::SyncCommandBuffer &cmd, F &&record)
+{
+  cmd.reset();
+  cmd.begin();
+  record();
+  cmd.end();
+  cmd.submit();
+  etna::get_context().getQueue().waitIdle();
+  cmd.reset();
+}
+
+// load_geometry for SceneLoadOptions::hostMemoryCap. Ranges and then primitives are filled in batches
+// of bounded staging, each batch is copied and waited for before the next one and the buffer pages it
+// read are dropped. Welded sizes are only known after the fill, so ranges are copied to a device local
+// buffer laid out like staging and compacted on the GPU at the end.
+static std::tuple<etna::Buffer, etna::Buffer> load_geometry_bounded(
+  etna::SyncCommandBuffer &cmd,
+  const GLTFFile &file,
+  GeometryPlan &plan,
+  const SceneLoadOptions &options,
+  std::vector<GLTFScene::Mesh> &sceneMeshes,
+  SceneLoadStats &stats)
+{
+  // a single range or primitive larger than this is filled whole
+  const uint64_t batchBytes = std::max<uint64_t>(options.hostMemoryCap / 4, 1 << 20);
+
+  auto &pool = util::get_thread_pool();
+  double fillSeconds = 0.0;
+
+  auto createStaging = [](uint64_t size) {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size,
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    });
+  };
+
+  auto unweldedVerts = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(Vertex) * plan.stagingVertices,
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  for (uint32_t first = 0; first < plan.ranges.size();)
+  {
+    uint32_t last = first;
+    uint64_t bytes = 0;
+    while (last < plan.ranges.size()
+      && (last == first || bytes + sizeof(Vertex) * plan.ranges[last].pos.count <= batchBytes))
+    {
+      bytes += sizeof(Vertex) * plan.ranges[last++].pos.count;
+    }
+
+    auto staging = createStaging(bytes);
+    auto dst = reinterpret_cast<Vertex*>(staging.map());
+    uint32_t batchOffset = plan.ranges[first].stagingOffset;
+
+    auto fillStart = std::chrono::steady_clock::now();
+    pool.parallelFor(last - first, [&](uint32_t i) {
+      auto &range = plan.ranges[first + i];
+      fill_vertex_range(range, options.weldVertices, dst + (range.stagingOffset - batchOffset));
+    });
+    fillSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+    staging.unmap();
+
+    submit_and_wait(cmd, [&]() {
+      cmd.copyBuffer(staging, unweldedVerts, {vk::BufferCopy{.dstOffset = sizeof(Vertex) * batchOffset, .size = bytes}});
+    });
+
+    for (uint32_t rangeId = first; rangeId < last; rangeId++)
+    {
+      const auto &range = plan.ranges[rangeId];
+      release_buffer_pages(file, {range.pos.data, range.pos.byteSize()});
+      if (range.norm)
+        release_buffer_pages(file, {range.norm->data, range.norm->byteSize()});
+      if (range.uv)
+        release_buffer_pages(file, {range.uv->data, range.uv->byteSize()});
+    }
+    first = last;
+  }
+
+  auto indexBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(uint32_t) * plan.indexCount,
+    .bufferUsage = vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  // primitives are planned in index buffer order, a batch is a contiguous index range
+  for (uint32_t first = 0; first < plan.primitives.size();)
+  {
+    uint32_t last = first;
+    uint64_t bytes = 0;
+    while (last < plan.primitives.size()
+      && (last == first || bytes + sizeof(uint32_t) * plan.primitives[last].indices.count <= batchBytes))
+    {
+      bytes += sizeof(uint32_t) * plan.primitives[last++].indices.count;
+    }
+
+    auto firstIndexOf = [&](const PrimitiveJob &job) {
+      return sceneMeshes[job.meshId].drawCalls[job.drawCallId].firstIndex;
+    };
+
+    auto staging = createStaging(bytes);
+    auto dst = reinterpret_cast<uint32_t*>(staging.map());
+    uint32_t batchFirstIndex = firstIndexOf(plan.primitives[first]);
+
+    auto fillStart = std::chrono::steady_clock::now();
+    pool.parallelFor(last - first, [&](uint32_t i) {
+      const auto &job = plan.primitives[first + i];
+      fill_indices(job, plan.ranges[job.rangeId], dst + (firstIndexOf(job) - batchFirstIndex));
+    });
+    fillSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+    staging.unmap();
+
+    submit_and_wait(cmd, [&]() {
+      cmd.copyBuffer(staging, indexBuff, 
+        {vk::BufferCopy{.dstOffset = sizeof(uint32_t) * batchFirstIndex, .size = bytes}});
+    });
+
+    for (uint32_t primId = first; primId < last; primId++)
+      release_buffer_pages(file, {plan.primitives[primId].indices.data, plan.primitives[primId].indices.byteSize()});
+    first = last;
+  }
+
+  stats.conversionSeconds = fillSeconds;
+  stats.workerThreads = pool.getThreadsCount() + 1;
+
+  auto [vertexRegions, vertexCount] = compact_vertex_ranges(plan, sceneMeshes, stats);
+  for (auto &range : plan.ranges)
+    range.remap = {};
+
+  auto vertBuff = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(Vertex) * vertexCount,
+    .bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  submit_and_wait(cmd, [&]() {
+    cmd.copyBuffer(unweldedVerts, vertBuff, vertexRegions);
+  });
+
+  return {std::move(vertBuff), std::move(indexBuff)};
+}
+
+enum class TextureRole : uint8_t
 {
-  auto posAccessorIt = primitive.attributes.find("POSITION");
-  auto uvAccessorIt = primitive.attributes.find("TEXCOORD_0");
-  auto normAccessorIt = primitive.attributes.find("NORMAL");
+  Color,
+  Normal,
+  Data, // metallic-roughness and occlusion, glTF layout
+  MetallicRoughness, // repacked, R = roughness, G = metallic
+  Occlusion, // repacked, R = occlusion
+  OcclusionMetallicRoughness // ORM, glTF layout with opaque alpha, stored in BC7 to keep the channels apart
+};
+
+static bool is_repacked(TextureRole role)
+{
+  return role == TextureRole::MetallicRoughness || role == TextureRole::Occlusion;
+}
 
-  ETNA_ASSERT(posAccessorIt != primitive.attributes.end());
-  
-  std::optional<tinygltf::Accessor> pos = model.accessors[posAccessorIt->second];
-  std::optional<tinygltf::Accessor> norm;
-  std::optional<tinygltf::Accessor> uv;
+// KTX2 images are loadable only if they hold plain (not Basis Universal or supercompressed) data,
+// BC payloads only with TextureCompression::BC
+static bool is_image_loadable(const tinygltf::Image &image, const SceneLoadOptions &options)
+{
+  if (!is_ktx2(image.image))
+    return !image.image.empty();
+  auto header = read_ktx2_header(image.image);
+  if (!header || is_ktx2_basis(*header) || header->supercompressionScheme != 0)
+    return false;
+  return options.textureCompression == TextureCompression::BC
+    || std::string_view {vk::compressionScheme(vk::Format(header->vkFormat))} != "BC";
+}
 
-  if (normAccessorIt != primitive.attributes.end())
+// KHR_texture_basisu source if it can be loaded, the fallback source otherwise
+static int get_texture_source(const tinygltf::Model &model, const tinygltf::Texture &texture,
+  const SceneLoadOptions &options)
+{
+  auto ext = texture.extensions.find("KHR_texture_basisu");
+  if (ext != texture.extensions.end() && ext->second.Has("source"))
   {
-    norm = model.accessors[normAccessorIt->second];
-    ETNA_ASSERT(norm->sparse.isSparse == false);
+    int source = ext->second.Get("source").GetNumberAsInt();
+    if (source >= 0 && size_t(source) < model.images.size() && is_image_loadable(model.images[source], options))
+      return source;
   }
+  return texture.source;
+}
 
-  if (uvAccessorIt != primitive.attributes.end())
+static std::vector<TextureRole> get_image_roles(const tinygltf::Model &model, const SceneLoadOptions &options)
+{
+  enum : uint32_t
   {
-    uv = model.accessors[uvAccessorIt->second];
-    ETNA_ASSERT(uv->sparse.isSparse == false);
+    USE_COLOR = 1,
+    USE_NORMAL = 2,
+    USE_METALLIC_ROUGHNESS = 4,
+    USE_OCCLUSION = 8
+  };
+
+  std::vector<uint32_t> uses(model.images.size(), 0);
+  auto mark = [&](int texture_id, uint32_t use) {
+    if (texture_id < 0)
+      return;
+    int source = get_texture_source(model, model.textures.at(texture_id), options);
+    if (source >= 0)
+      uses.at(source) |= use;
+  };
+
+  for (const auto &mat : model.materials)
+  {
+    mark(mat.pbrMetallicRoughness.baseColorTexture.index, USE_COLOR);
+    mark(mat.emissiveTexture.index, USE_COLOR);
+    mark(mat.normalTexture.index, USE_NORMAL);
+    mark(mat.pbrMetallicRoughness.metallicRoughnessTexture.index, USE_METALLIC_ROUGHNESS);
+    mark(mat.occlusionTexture.index, USE_OCCLUSION);
   }
 
-  ETNA_ASSERT(pos->componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-  ETNA_ASSERT(norm->componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-  ETNA_ASSERT(uv->componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+  // an image with several roles takes the first one in TextureRole order, only decoded images with scalar
+  // uses are repacked, KTX2 payloads are uploaded as stored
+  std::vector<TextureRole> roles(model.images.size(), TextureRole::Data);
+  for (uint32_t imageId = 0; imageId < model.images.size(); imageId++)
+  {
+    uint32_t use = uses[imageId];
+    bool repack = options.repackMaterialTextures && !is_ktx2(model.images[imageId].image);
+
+    if (use & USE_COLOR)
+      roles[imageId] = TextureRole::Color;
+    else if (use & USE_NORMAL)
+      roles[imageId] = TextureRole::Normal;
+    else if (repack && use == USE_METALLIC_ROUGHNESS)
+      roles[imageId] = TextureRole::MetallicRoughness;
+    else if (repack && use == USE_OCCLUSION)
+      roles[imageId] = TextureRole::Occlusion;
+    else if (repack && use == (USE_METALLIC_ROUGHNESS | USE_OCCLUSION))
+      roles[imageId] = TextureRole::OcclusionMetallicRoughness;
+  }
+  return roles;
+}
 
-  std::span<const float> posData{};
-  std::span<const float> normData{};
-  std::span<const float> uvData{};
+// moves roughness and metallic from G and B to R and G
+static void repack_metallic_roughness(uint8_t *rgba, size_t texels)
+{
+  for (size_t i = 0; i < texels; i++)
+  {
+    uint8_t *texel = rgba + 4 * i;
+    texel[0] = texel[1];
+    texel[1] = texel[2];
+    texel[2] = 0;
+    texel[3] = 255;
+  }
+}
 
-  if (pos.has_value())
-    posData = get_span(model, *pos);
-  if (norm.has_value())
-    normData = get_span(model, *norm);
-  if (uv.has_value())
-    uvData = get_span(model, *uv);
+static vk::Format select_texture_format(TextureRole role, std::span<const uint8_t> rgba, 
+  const SceneLoadOptions &options)
+{
+  switch (role)
+  {
+  case TextureRole::Normal:
+    return vk::Format::eBc5UnormBlock; // xy only, z has to be reconstructed
+  case TextureRole::Data:
+    return vk::Format::eBc1RgbUnormBlock; // keeps glTF layout, G = roughness, B = metallic
+  case TextureRole::MetallicRoughness:
+    return vk::Format::eBc5UnormBlock; // independent endpoints, no crosstalk between the channels
+  case TextureRole::Occlusion:
+    return vk::Format::eBc4UnormBlock;
+  case TextureRole::OcclusionMetallicRoughness:
+    return vk::Format::eBc7UnormBlock; // BC1 shares endpoints between the three scalar channels
+  case TextureRole::Color:
+    break;
+  }
 
-  uint32_t vertexOffset = vertexData.size();
-  uint32_t vertexCount = pos->count;
+  if (options.bc7Color)
+    return vk::Format::eBc7UnormBlock;
 
-  for (uint32_t vertId = 0; vertId < vertexCount; vertId++)
+  for (size_t i = 3; i < rgba.size(); i += 4)
   {
-    Vertex vert {
-      .pos {0.f, 0.f, 0.f},
-      .norm {0.f, 0.f, 0.f},
-      .uv {0.f, 0.f}
-    };
+    if (rgba[i] != 255)
+      return vk::Format::eBc3UnormBlock;
+  }
+  return vk::Format::eBc1RgbUnormBlock;
+}
 
-    if (!posData.empty())
-      vert.pos = glm::vec3{posData[3*vertId], posData[3*vertId + 1], posData[3*vertId + 2]};
-    if (!normData.empty())
-      vert.norm = glm::vec3{normData[3*vertId], normData[3*vertId + 1], normData[3*vertId + 2]};
-    if (!uvData.empty())
-      vert.uv = glm::vec2{uvData[2*vertId], uvData[2*vertId + 1]};
+// ORM keeps R, G and B, an opaque alpha lets BC7 spend its bits on them
+static void clear_alpha(uint8_t *rgba, size_t texels)
+{
+  for (size_t i = 0; i < texels; i++)
+    rgba[4 * i + 3] = 255;
+}
 
-    vertexData.push_back(vert);
+// uncompressed format of the role, textures with fewer channels get CPU mips
+static vk::Format select_uncompressed_format(TextureRole role)
+{
+  switch (role)
+  {
+  case TextureRole::MetallicRoughness:
+    return vk::Format::eR8G8Unorm;
+  case TextureRole::Occlusion:
+    return vk::Format::eR8Unorm;
+  default:
+    return vk::Format::eR8G8B8A8Unorm;
   }
+}
 
-  uint32_t firstIndex = indexData.size();
-  
-  ETNA_ASSERT(primitive.indices >= 0);
-  const auto &indices = model.accessors[primitive.indices];
-  ETNA_ASSERT(indices.sparse.isSparse == false);
+static uint64_t get_chain_size(vk::Format format, uint32_t width, uint32_t height)
+{
+  uint64_t size = 0;
+  for (uint32_t level = 0; level < get_mip_levels_count(width, height); level++)
+    size += get_level_size(format, std::max(width >> level, 1u), std::max(height >> level, 1u));
+  return size;
+}
+
+static uint64_t get_texture_settings_hash(TextureRole role, const SceneLoadOptions &options)
+{
+  uint64_t h = util::hash_combine(uint64_t(role), uint64_t(options.textureCompression));
+  return util::hash_combine(h, uint64_t(options.bc7Color));
+}
+
+// CPU side of the texture import on the loader pool. KTX2 payloads are parsed, other images are
+// looked up in the cache and decoded, mipped and encoded only on a miss.
+// Prepares the images listed in image_ids, other entries of the result stay empty.
+// Stats are accumulated, so batches may be prepared one after another.
+static std::vector<std::optional<TextureData>> prepare_textures(const tinygltf::Model &model,
+  const SceneLoadOptions &options, SceneLoadStats &stats, std::span<const uint32_t> image_ids)
+{
+  std::vector<std::optional<TextureData>> textures(model.images.size());
+  auto roles = get_image_roles(model, options);
+  auto encodeStart = std::chrono::steady_clock::now();
+
+  std::optional<TextureCache> cache;
+  if (!options.textureCacheDir.empty())
+    cache.emplace(options.textureCacheDir);
+
+  util::get_thread_pool().parallelFor(uint32_t(image_ids.size()), [&](uint32_t i) {
+    uint32_t imageId = image_ids[i];
+    const auto &image = model.images[imageId];
+    if (is_ktx2(image.image))
+    {
+      if (!is_image_loadable(image, options))
+        return;
+
+      std::string err;
+      textures[imageId] = read_ktx2(image.image, err);
+      ETNA_ASSERTF(textures[imageId].has_value(), "GLTF error : image {} : {}", imageId, err);
+      return;
+    }
+
+    uint64_t cacheKey = 0;
+    if (cache)
+    {
+      cacheKey = TextureCache::makeKey(image.image, get_texture_settings_hash(roles[imageId], options));
+      if ((textures[imageId] = cache->load(cacheKey)))
+        return;
+    }
+
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::unique_ptr<uint8_t, decltype(&stbi_image_free)> pixels {
+      stbi_load_from_memory(image.image.data(), int(image.image.size()), &width, &height, &components, 4),
+      &stbi_image_free
+    };
+    ETNA_ASSERTF(pixels, "GLTF error : failed to decode image {} : {}", imageId, stbi_failure_reason());
+
+    if (roles[imageId] == TextureRole::MetallicRoughness)
+      repack_metallic_roughness(pixels.get(), size_t(width) * size_t(height));
+    else if (roles[imageId] == TextureRole::OcclusionMetallicRoughness)
+      clear_alpha(pixels.get(), size_t(width) * size_t(height));
+
+    std::span<const uint8_t> rgba {pixels.get(), size_t(width) * size_t(height) * 4};
+    bool srgb = roles[imageId] == TextureRole::Color;
+
+    if (options.textureCompression == TextureCompression::BC)
+    {
+      auto format = select_texture_format(roles[imageId], rgba, options);
+      textures[imageId] = encode_texture(format, rgba.data(), uint32_t(width), uint32_t(height), srgb);
+    }
+    else if (cache || is_repacked(roles[imageId]))
+    {
+      auto format = select_uncompressed_format(roles[imageId]);
+      textures[imageId] = encode_texture(format, rgba.data(), uint32_t(width), uint32_t(height), srgb);
+    }
+    else
+    {
+      // single level, the rest of the chain is blitted on the GPU
+      textures[imageId] = TextureData {
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .width = uint32_t(width),
+        .height = uint32_t(height),
+        .levels = {{0, rgba.size(), uint32_t(width), uint32_t(height)}},
+        .bytes = std::vector<uint8_t>(rgba.begin(), rgba.end())
+      };
+    }
 
-  uint32_t indexCount = indices.count;
-  auto indexInput = get_indicies(model, indices);
+    if (cache)
+      cache->store(cacheKey, *textures[imageId]);
+  });
 
-  std::visit([&](auto &&span){
-    for (uint32_t indexI = 0; indexI < indexCount; indexI++)
-      indexData.push_back(span[indexI]);
-  }, indexInput);
+  stats.textureEncodeSeconds += 
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
 
-  return GLTFScene::Mesh::DrawCall {firstIndex, indexCount, vertexOffset, 0}; 
+  // repacked images against what the glTF layout would take with the same settings
+  auto gltfFormat = options.textureCompression == TextureCompression::BC 
+    ? select_texture_format(TextureRole::Data, {}, options) 
+    : vk::Format::eR8G8B8A8Unorm;
+  for (uint32_t imageId = 0; imageId < textures.size(); imageId++)
+  {
+    if (!is_repacked(roles[imageId]) || !textures[imageId].has_value())
+      continue;
+    const auto &texture = *textures[imageId];
+    stats.repackedImages++;
+    stats.repackedBytes += texture.getPayloadSize();
+    stats.repackedBytesGLTF += get_chain_size(gltfFormat, texture.width, texture.height);
+  }
+
+  if (cache)
+  {
+    stats.textureCacheHits += cache->getHits();
+    stats.textureCacheMisses += cache->getMisses();
+  }
+  return textures;
 }
 
-static std::vector<GLTFScene::Material> load_materials(const tinygltf::Model &model)
+static std::vector<GLTFScene::Material> load_materials(const tinygltf::Model &model, 
+  const std::vector<TextureRole> &roles, const SceneLoadOptions &options)
 {
   std::vector<GLTFScene::Material> materials;
 
@@ -431,9 +1298,15 @@ static std::vector<GLTFScene::Material> load_materials(const tinygltf::Model &mo
     if (src.pbrMetallicRoughness.baseColorTexture.index >= 0)
       mat.baseColorId = uint32_t(src.pbrMetallicRoughness.baseColorTexture.index);
     if (src.pbrMetallicRoughness.metallicRoughnessTexture.index >= 0)
+    {
       mat.metallicRoughnessId = src.pbrMetallicRoughness.metallicRoughnessTexture.index;
+      int source = get_texture_source(model, model.textures.at(*mat.metallicRoughnessId), options);
+      mat.packedMetallicRoughness = source >= 0 && roles.at(source) == TextureRole::MetallicRoughness;
+    }
     if (src.normalTexture.index >= 0) // TODO: normal texture parameters
       mat.normalTexId = uint32_t(src.normalTexture.index);
+    if (src.occlusionTexture.index >= 0)
+      mat.occlusionTexId = uint32_t(src.occlusionTexture.index);
 
     if (src.alphaMode == "OPAQUE")
       mat.mode = GLTFScene::MaterialMode::Opaque;
@@ -460,43 +1333,8 @@ static std::vector<GLTFScene::Material> load_materials(const tinygltf::Model &mo
   return materials;
 }
 
-std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd)
+static std::vector<GLTFScene::Node> load_nodes(const tinygltf::Model &model)
 {
-  tinygltf::Model model;
-  tinygltf::TinyGLTF loader;
-  
-  std::string err;
-  std::string warn;
-
-  auto ret = loader.LoadASCIIFromFile(&model, &err, &warn, path);
-
-  if (!err.empty())
-    ETNA_ASSERTF(false, "GLTF error : {}", err);
-
-  if (!warn.empty())
-    spdlog::warn("GLTF warings : {}", warn);
-
-  ETNA_ASSERT(ret);
-  
-  std::vector<Vertex> vertexData;
-  std::vector<uint32_t> indexData;
-  std::vector<GLTFScene::Mesh> sceneMeshes;
-
-  for (const auto &mesh : model.meshes)
-  {
-    GLTFScene::Mesh sceneMesh;
-    for (const auto &prim : mesh.primitives)
-    {
-      auto dc = process_prim(model, prim, vertexData, indexData);
-      ETNA_ASSERT(prim.material >= 0);
-      dc.materialId = prim.material;
-      sceneMesh.drawCalls.push_back(dc);
-    }
-    sceneMeshes.push_back(std::move(sceneMesh));
-  }
-
-  auto [vertsBuff, indexBuff] = load_verts_data(cmd, vertexData, indexData);
-
   std::vector<GLTFScene::Node> sceneNodes;
   sceneNodes.reserve(model.nodes.size());
   
@@ -540,7 +1378,96 @@ std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommand
 
     sceneNodes.push_back(std::move(sceneNode));  
   }
-  
+
+  return sceneNodes;
+}
+
+// host memory an image takes while it is imported: encoded bytes, decoded RGBA8 pixels,
+// the prepared chain and its staging copy
+static uint64_t get_import_size(const tinygltf::Image &image)
+{
+  if (is_ktx2(image.image))
+    return 3 * image.image.size();
+  uint64_t chain = get_chain_size(vk::Format::eR8G8B8A8Unorm, uint32_t(image.width), uint32_t(image.height));
+  return image.image.size() + uint64_t(image.width) * uint64_t(image.height) * 4 + 2 * chain;
+}
+
+// Groups images so each group fits batch_bytes, a single image larger than that forms its own group.
+// Without a limit all images go into a single group.
+static std::vector<std::vector<uint32_t>> plan_texture_batches(const tinygltf::Model &model, uint64_t batch_bytes)
+{
+  std::vector<std::vector<uint32_t>> batches;
+  uint64_t bytes = 0;
+  for (uint32_t imageId = 0; imageId < model.images.size(); imageId++)
+  {
+    uint64_t size = batch_bytes ? get_import_size(model.images[imageId]) : 0;
+    if (batches.empty() || (bytes + size > batch_bytes && !batches.back().empty()))
+    {
+      batches.emplace_back();
+      bytes = 0;
+    }
+    batches.back().push_back(imageId);
+    bytes += size;
+  }
+  return batches;
+}
+
+std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd,
+  const SceneLoadOptions &options)
+{
+  const bool bounded = options.hostMemoryCap != 0;
+
+  util::reset_peak_rss();
+  auto file = open_gltf_file(path, options.parser);
+  const auto &model = file.model;
+
+  spdlog::info("GLTF parse ({}) : {} KiB JSON in {:.2f} ms, {:.1f} MB/s, peak RSS +{} MiB",
+    options.parser == GLTFParser::Streaming ? "streaming" : "tinygltf",
+    file.jsonBytes >> 10,
+    file.parseSeconds * 1e3,
+    file.parseSeconds > 0.0 ? file.jsonBytes / file.parseSeconds * 1e-6 : 0.0,
+    file.parsePeakRssGrowth >> 20);
+
+  std::vector<GLTFScene::Mesh> sceneMeshes;
+  SceneLoadStats stats {};
+  stats.mappedBytes = file.mappedBytes;
+  stats.parsePeakRss = util::get_peak_rss();
+
+  spdlog::info("GLTF buffers : {} MiB mapped from {} files", 
+    file.mappedBytes >> 20, file.mappings.size());
+
+  util::reset_peak_rss();
+  auto plan = plan_geometry(file, sceneMeshes, stats);
+
+  // accessors are read once by the fill phase, let the kernel read ahead
+  for (auto buffer : file.buffers)
+    advise_sequential(buffer);
+
+  auto [vertsBuff, indexBuff] = bounded
+    ? load_geometry_bounded(cmd, file, plan, options, sceneMeshes, stats)
+    : load_geometry(cmd, file, plan, options, sceneMeshes, stats);
+  stats.geometryPeakRss = util::get_peak_rss();
+
+  spdlog::info("GLTF vertices : {} emitted, {} shared, {} welded, {} KiB saved",
+    stats.emittedVertices, 
+    stats.sharedVertices, 
+    stats.weldedVertices,
+    stats.savedBytes() >> 10);
+
+  if (stats.conversionSeconds > 0.0)
+    spdlog::info("GLTF geometry fill : {} primitives, {} MiB in {:.2f} ms on {} threads, {:.2f} GB/s",
+      plan.primitives.size(),
+      stats.convertedBytes >> 20,
+      stats.conversionSeconds * 1e3,
+      stats.workerThreads,
+      stats.convertedBytes / stats.conversionSeconds * 1e-9);
+
+  if (stats.directReadBytes)
+    spdlog::info("GLTF geometry reads : {} MiB read into staging with {}",
+      stats.directReadBytes >> 20, stats.directReadIoUring ? "io_uring" : "pread");
+  plan = {}; // remap tables of welded ranges
+
+  auto sceneNodes = load_nodes(model);
 
   std::unique_ptr<GLTFScene> scene{new GLTFScene{}};
   scene->indexBuffer = std::move(indexBuff);
@@ -557,22 +1484,93 @@ std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommand
       model.scenes[0].nodes.end());
   }
 
+  util::reset_peak_rss();
+  auto roles = get_image_roles(model, options);
   if (model.images.size())
   {
+    // with a cap images are prepared and uploaded in batches, a batch is released before the next one
+    auto batches = plan_texture_batches(model, options.hostMemoryCap / 2);
+    uint64_t stagingLimit = bounded ? std::min<uint64_t>(options.hostMemoryCap / 4, 32 << 20) : 32 << 20;
+
     cmd.reset();
     cmd.begin();
 
     std::vector<etna::Buffer> stagingBuffers;
-    scene->images.reserve(model.images.size());
-    for (auto &src : model.images)
-      scene->images.emplace_back(load_image(cmd, src, stagingBuffers));
+    scene->images.resize(model.images.size());
+    scene->streamSources.resize(model.images.size());
+    for (const auto &batch : batches)
+    {
+      auto textures = prepare_textures(model, options, stats, batch);
+
+      for (auto imageId : batch)
+      {
+        const auto &src = model.images[imageId];
+        uint64_t rgba8Size = get_chain_size(vk::Format::eR8G8B8A8Unorm, uint32_t(src.width), uint32_t(src.height));
+        stats.textureBytesRGBA8 += rgba8Size;
+
+        if (textures[imageId].has_value())
+        {
+          auto &texture = *textures[imageId];
+          bool gpuMips = texture.levels.size() == 1 && texture.format == vk::Format::eR8G8B8A8Unorm;
+
+          // streamed textures start with the mip tail, the full chain is kept for TextureStreamer
+          bool streamed = is_texture_streamed(texture, options);
+          uint32_t firstLevel = streamed ? get_stream_tail_level(texture, options.streamTailSize) : 0;
+          stats.textureBytes += gpuMips ? rgba8Size : texture.getPayloadSize(firstLevel);
+
+          bool srgb = roles[imageId] == TextureRole::Color;
+          flush_staging_if_full(cmd, stagingBuffers, stagingLimit);
+          scene->images[imageId] =
+            upload_texture(cmd, texture, firstLevel, srgb, options.mipGenerator, stagingBuffers);
+          
+          if (streamed)
+            scene->streamSources[imageId] = std::move(texture);
+          textures[imageId].reset();
+        }
+        else
+        {
+          // never referenced, see get_texture_source
+          spdlog::warn("GLTF image {} : unsupported KTX2 payload, textures use their fallback source", imageId);
+        }
+
+        if (bounded)
+        {
+          // encoded bytes are not needed once the image is prepared
+          auto &encoded = file.model.images[imageId].image;
+          encoded.clear();
+          encoded.shrink_to_fit();
+        }
+      }
+
+      if (bounded)
+        flush_staging_if_full(cmd, stagingBuffers, 0);
+    }
     
     cmd.end();
     cmd.submit();
     etna::get_context().getQueue().waitIdle();
     stagingBuffers.clear();
     cmd.reset();
+
+    spdlog::info("GLTF textures : {} images, {} MiB uploaded ({} MiB as RGBA8), CPU prepare {:.2f} ms, "
+      "cache {} hits {} misses",
+      model.images.size(),
+      stats.textureBytes >> 20,
+      stats.textureBytesRGBA8 >> 20,
+      stats.textureEncodeSeconds * 1e3,
+      stats.textureCacheHits,
+      stats.textureCacheMisses);
+
+    if (stats.repackedImages)
+      spdlog::info("GLTF texture repack : {} scalar images, {} KiB in glTF layout, {} KiB repacked",
+        stats.repackedImages,
+        stats.repackedBytesGLTF >> 10,
+        stats.repackedBytes >> 10);
+
+    if (bounded)
+      spdlog::info("GLTF textures : {} batches", batches.size());
   }
+  stats.texturePeakRss = util::get_peak_rss();
 
   scene->stubTexture = create_stub_rexture(cmd);
 
@@ -587,15 +1585,131 @@ std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommand
   {
     scene->imageSamplers.reserve(model.textures.size());
     for (auto &src : model.textures)
-      scene->imageSamplers.push_back({src.source, src.sampler});
+      scene->imageSamplers.push_back({get_texture_source(model, src, options), src.sampler});
   }
 
-  scene->materials = load_materials(model);
+  scene->materials = load_materials(model, roles, options);
   scene->initTransforms();
 
+  // phase peaks are process wide if the kernel does not allow a reset, the max is the load peak then
+  stats.peakRss = std::max({stats.parsePeakRss, stats.geometryPeakRss, stats.texturePeakRss, util::get_peak_rss()});
+  spdlog::info("GLTF load : peak RSS {} MiB (parse {} MiB, geometry {} MiB, textures {} MiB), cap {}",
+    stats.peakRss >> 20,
+    stats.parsePeakRss >> 20,
+    stats.geometryPeakRss >> 20,
+    stats.texturePeakRss >> 20,
+    bounded ? std::to_string(options.hostMemoryCap >> 20) + " MiB" : std::string {"none"});
+
   return scene;
 }
 
+std::unique_ptr<PreparedScene> prepare_scene(const std::string &path, const SceneLoadOptions &options)
+{
+  auto file = open_gltf_file(path, options.parser);
+  const auto &model = file.model;
+
+  auto prepared = std::make_unique<PreparedScene>();
+  auto &stats = prepared->stats;
+  stats.mappedBytes = file.mappedBytes;
+
+  auto plan = plan_geometry(file, prepared->meshes, stats);
+  for (auto buffer : file.buffers)
+    advise_sequential(buffer);
+
+  // the same fill as load_geometry into host memory, the compaction copy is done here as well
+  std::vector<Vertex> staging(plan.stagingVertices);
+  prepared->indices.resize(plan.indexCount);
+  if (options.geometryReads == GeometryReads::Direct)
+    fill_geometry_direct(file, plan, options, prepared->meshes, stats, staging.data(), prepared->indices.data());
+  else
+    fill_geometry(plan, options, prepared->meshes, stats, staging.data(), prepared->indices.data());
+
+  auto [vertexRegions, vertexCount] = compact_vertex_ranges(plan, prepared->meshes, stats);
+  prepared->vertices.resize(vertexCount);
+  for (const auto &region : vertexRegions)
+  {
+    std::memcpy(reinterpret_cast<uint8_t*>(prepared->vertices.data()) + region.dstOffset,
+      reinterpret_cast<const uint8_t*>(staging.data()) + region.srcOffset, region.size);
+  }
+
+  prepared->nodes = load_nodes(model);
+  if (model.scenes.size())
+    prepared->rootNodes.assign(model.scenes[0].nodes.begin(), model.scenes[0].nodes.end());
+
+  auto roles = get_image_roles(model, options);
+  if (model.images.size())
+  {
+    std::vector<uint32_t> imageIds(model.images.size());
+    std::iota(imageIds.begin(), imageIds.end(), 0u);
+    prepared->textures = prepare_textures(model, options, stats, imageIds);
+  }
+
+  prepared->srgbImages.reserve(model.images.size());
+  for (uint32_t imageId = 0; imageId < model.images.size(); imageId++)
+  {
+    const auto &src = model.images[imageId];
+    stats.textureBytesRGBA8 += get_chain_size(vk::Format::eR8G8B8A8Unorm, uint32_t(src.width), uint32_t(src.height));
+    prepared->srgbImages.push_back(roles[imageId] == TextureRole::Color);
+  }
+
+  for (auto &src : model.samplers)
+    prepared->samplers.push_back(get_sampler_info(src));
+  for (auto &src : model.textures)
+    prepared->imageSamplers.push_back({get_texture_source(model, src, options), src.sampler});
+
+  prepared->materials = load_materials(model, roles, options);
+  return prepared;
+}
+
+bool get_scene_bounds(const tinygltf::Model &model, glm::vec3 &bounds_min, glm::vec3 &bounds_max)
+{
+  auto nodes = load_nodes(model);
+  bounds_min = glm::vec3(std::numeric_limits<float>::max());
+  bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+  bool found = false;
+
+  auto visit = [&](uint32_t node_id, const glm::mat4 &parent, auto &&cb) -> void
+  {
+    const auto &node = nodes.at(node_id);
+    glm::mat4 transform = parent * node.transform;
+
+    if (node.meshIndex.has_value())
+    {
+      for (const auto &primitive : model.meshes.at(*node.meshIndex).primitives)
+      {
+        auto it = primitive.attributes.find("POSITION");
+        if (it == primitive.attributes.end())
+          continue;
+
+        const auto &accessor = model.accessors.at(it->second);
+        if (accessor.minValues.size() != 3 || accessor.maxValues.size() != 3)
+          continue;
+
+        glm::vec3 lo {accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]};
+        glm::vec3 hi {accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]};
+        for (uint32_t corner = 0; corner < 8; corner++)
+        {
+          glm::vec3 pos {(corner & 1) ? hi.x : lo.x, (corner & 2) ? hi.y : lo.y, (corner & 4) ? hi.z : lo.z};
+          glm::vec3 worldPos {transform * glm::vec4(pos, 1.f)};
+          bounds_min = glm::min(bounds_min, worldPos);
+          bounds_max = glm::max(bounds_max, worldPos);
+        }
+        found = true;
+      }
+    }
+
+    for (auto childId : node.childNodes)
+      cb(childId, transform, cb);
+  };
+
+  if (model.scenes.size())
+  {
+    for (auto rootId : model.scenes[0].nodes)
+      visit(uint32_t(rootId), glm::identity<glm::mat4>(), visit);
+  }
+  return found;
+}
+
 void GLTFScene::initTransforms()
 {
   worldTransforms.clear();
@@ -669,6 +1783,8 @@ SortedScene GLTFScene::buildSortedScene(const std::unordered_set<uint32_t> &quer
             .firstIndex = dc.firstIndex,
             .indexCount = dc.indexCount,
             .vertexOffset = dc.vertexOffset,
+            .boundsMin = dc.boundsMin,
+            .boundsMax = dc.boundsMax,
             .transformIds {*node.worldTransformIndex}
           }
         ); 
@@ -4,6 +4,8 @@
 #include <tiny_gltf.h>
 
 #include "Camera.hpp"
+#include "GLTFFile.hpp"
+#include "TextureData.hpp"
 
 #include <etna/Buffer.hpp>
 #include <etna/Image.hpp>
@@ -12,6 +14,11 @@
 
 #include <unordered_set>
 
+namespace renderer
+{
+struct MipGenerator;
+}
+
 namespace scene
 {
 
@@ -33,6 +40,10 @@ struct SortedScene
     uint32_t indexCount;
     uint32_t vertexOffset;
 
+    // object space, like GLTFScene::Mesh::DrawCall
+    glm::vec3 boundsMin {0.f};
+    glm::vec3 boundsMax {0.f};
+
     std::vector<uint32_t> transformIds;
   };
 
@@ -47,6 +58,87 @@ struct SortedScene
 
 //static_assert(sizeof(Vertex) > 10);
 
+enum class TextureCompression
+{
+  None, // RGBA8, mips generated on the GPU. KTX2 images with BC payloads are skipped for their fallback source.
+  BC // CPU encoded per texture role, see select_texture_format
+};
+
+enum class GeometryReads
+{
+  Mapped, // accessors are converted straight from the buffer file mappings
+  Direct // buffer file ranges are read into staging with AssetReader, see fill_geometry_direct
+};
+
+struct SceneLoadOptions
+{
+  bool weldVertices = false; // merge bit-identical vertices of each emitted vertex range
+  GLTFParser parser = GLTFParser::Streaming;
+  GeometryReads geometryReads = GeometryReads::Mapped; // hostMemoryCap loads always use the mappings
+
+  // KTX2 images are uploaded as stored, this only affects decoded PNG/JPEG images. Use BC only if the
+  // textureCompressionBC device feature is enabled.
+  TextureCompression textureCompression = TextureCompression::None;
+  bool bc7Color = true; // BC7 for color textures, otherwise BC1 (opaque) or BC3 (with alpha)
+
+  // images used only as metallic-roughness are stored as RG (roughness, metallic) in R8G8 or BC5,
+  // images used only as occlusion as R in R8 or BC4. ORM images with both uses keep the glTF layout and
+  // are compressed with BC7 instead of BC1.
+  bool repackMaterialTextures = true;
+
+  // fully mipped textures are cached here as KTX2, keyed by source bytes and the settings above.
+  // Empty disables the cache, uncompressed mips are then generated on the GPU.
+  std::string textureCacheDir;
+
+  // GPU mips are generated with a single compute dispatch per texture if set, with blits otherwise
+  renderer::MipGenerator *mipGenerator = nullptr;
+
+  // only levels up to streamTailSize texels are uploaded for textures with CPU mip chains,
+  // the rest is left to TextureStreamer
+  bool streamTextures = false;
+  uint32_t streamTailSize = 128;
+
+  // If not zero, load_scene bounds host memory to about this many bytes: geometry is converted and
+  // uploaded in batches, images are prepared in batches and their encoded bytes and staging are released
+  // after each one, buffer pages are dropped once read. Every batch waits for the GPU.
+  // prepare_scene keeps the whole scene in host memory and ignores it, so AsyncSceneLoader and
+  // WorldManager loads are not bounded.
+  uint64_t hostMemoryCap = 0;
+};
+
+struct SceneLoadStats
+{
+  uint64_t emittedVertices = 0; // written to the vertex buffer before welding
+  uint64_t sharedVertices = 0; // not written, range reused from a primitive with the same accessors
+  uint64_t weldedVertices = 0; // removed by welding
+
+  uint64_t convertedBytes = 0; // accessor bytes read by conversion kernels
+  double conversionSeconds = 0.0; // wall time of the parallel fill phase
+  uint32_t workerThreads = 0;
+
+  uint64_t mappedBytes = 0; // glTF buffer bytes read from file mappings instead of heap copies
+  uint64_t directReadBytes = 0; // read by GeometryReads::Direct
+  bool directReadIoUring = false;
+  uint64_t peakRss = 0; // process VmHWM after the scene is uploaded
+
+  // VmHWM of each load_scene phase, see util::reset_peak_rss
+  uint64_t parsePeakRss = 0;
+  uint64_t geometryPeakRss = 0;
+  uint64_t texturePeakRss = 0;
+
+  uint64_t textureBytes = 0; // texture memory of all mip chains as uploaded
+  uint64_t textureBytesRGBA8 = 0; // the same textures with full RGBA8 mip chains
+  double textureEncodeSeconds = 0.0; // CPU decode, mip generation, block compression and cache IO
+  uint32_t textureCacheHits = 0;
+  uint32_t textureCacheMisses = 0;
+
+  uint32_t repackedImages = 0; // see SceneLoadOptions::repackMaterialTextures
+  uint64_t repackedBytes = 0; // their mip chains as uploaded
+  uint64_t repackedBytesGLTF = 0; // the same images in the glTF channel layout
+
+  uint64_t savedBytes() const { return (sharedVertices + weldedVertices) * sizeof(Vertex); }
+};
+
 struct GLTFScene
 {
   enum MaterialMode
@@ -64,6 +156,10 @@ struct GLTFScene
       uint32_t indexCount;
       uint32_t vertexOffset;
       uint32_t materialId;
+
+      // object space bounds from the POSITION accessor
+      glm::vec3 boundsMin {0.f};
+      glm::vec3 boundsMax {0.f};
     };
 
     std::vector<DrawCall> drawCalls;
@@ -90,6 +186,9 @@ struct GLTFScene
     float metallicFactor = 0.1f;
     float roughnessFactor = 0.9f; 
     float alphaCutoff = 0.5f;
+
+    // metallic-roughness image is repacked, roughness is in R and metallic in G instead of G and B
+    bool packedMetallicRoughness = false;
   };
 
   struct Transform
@@ -138,15 +237,17 @@ struct GLTFScene
     if (!tex_id)
       return {&stubTexture.value(), samplers.at(0).get()};
     auto [imageId, smpId] = getImageSamplerId(*tex_id); 
-    return {&images.at(imageId), samplers.at(smpId).get()};
+    return {&getImage(imageId), getSampler(smpId)};
   }
 
+  // textures without a loadable image (-1 in imageSamplers) get the stub, like WorldManager tiles
   const etna::Image &getImage(uint32_t id) const {
-    return images.at(id);
+    return id < images.size() ? images[id] : *stubTexture;
   }
 
+  // textures without a sampler (-1) get the default one
   vk::Sampler getSampler(uint32_t id) const {
-    return samplers.at(id).get();
+    return samplers.at(id < samplers.size() ? id : 0).get();
   }
 
   const etna::Image &getStubTexture() const {
@@ -189,16 +290,62 @@ private:
 
   std::vector<etna::Image> images;
   std::vector<vk::UniqueSampler> samplers;
-  std::vector<std::tuple<uint32_t, uint32_t>> imageSamplers; 
+  // image and sampler ids per texture, uint32_t(-1) if there is no loadable image or no sampler
+  std::vector<std::tuple<uint32_t, uint32_t>> imageSamplers;
   std::optional<etna::Image> stubTexture;
+
+  // full mip chains of streamed images, nullopt for images uploaded whole
+  std::vector<std::optional<TextureData>> streamSources;
   
   etna::Buffer vertexBuffer;
   etna::Buffer indexBuffer;
 
-  friend std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd);
+  friend std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd,
+    const SceneLoadOptions &options);
+  friend struct TextureStreamer;
+  friend struct VirtualTextureSystem;
+  friend struct AsyncSceneLoader;
+  friend struct WorldManager;
+};
+
+std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd,
+  const SceneLoadOptions &options = {});
+
+// CPU side of a scene load, holds no GPU objects, see AsyncSceneLoader
+struct PreparedScene
+{
+  std::vector<Vertex> vertices; // compacted, draw calls point into it
+  std::vector<uint32_t> indices;
+  std::vector<GLTFScene::Mesh> meshes;
+  std::vector<GLTFScene::Node> nodes;
+  std::vector<uint32_t> rootNodes;
+  std::vector<GLTFScene::Material> materials;
+
+  std::vector<std::optional<TextureData>> textures; // nullopt for unsupported KTX2 payloads
+  std::vector<bool> srgbImages;
+  std::vector<vk::SamplerCreateInfo> samplers;
+  std::vector<std::tuple<uint32_t, uint32_t>> imageSamplers;
+
+  SceneLoadStats stats;
 };
 
-std::unique_ptr<GLTFScene> load_scene(const std::string &path, etna::SyncCommandBuffer &cmd);
+// Parses the file, converts geometry and prepares textures. Safe to call from any thread,
+// the loader pool is used for the parallel parts. Geometry is read as options.geometryReads says,
+// options.hostMemoryCap is ignored.
+std::unique_ptr<PreparedScene> prepare_scene(const std::string &path, const SceneLoadOptions &options = {});
+
+// World space bounds of the default scene from the POSITION accessor bounds. False if no mesh has them.
+bool get_scene_bounds(const tinygltf::Model &model, glm::vec3 &bounds_min, glm::vec3 &bounds_max);
+
+// Records the upload of levels [first_level, levels.size()) into cmd, staging is appended to staging_buffers
+etna::Image upload_texture(etna::SyncCommandBuffer &cmd, const TextureData &texture, uint32_t first_level,
+  bool srgb, renderer::MipGenerator *mip_generator, std::vector<etna::Buffer> &staging_buffers);
+
+// true if only the mip tail of texture is uploaded at load and the rest is left to TextureStreamer
+bool is_texture_streamed(const TextureData &texture, const SceneLoadOptions &options);
+
+// records the clear of the 1x1 texture bound in place of missing material textures
+etna::Image record_stub_texture(etna::SyncCommandBuffer &cmd);
 
 //SortedScene 
 
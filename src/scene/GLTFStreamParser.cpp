@@ -0,0 +1,551 @@
+#include "GLTFStreamParser.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <vector>
+
+namespace scene
+{
+
+using json = nlohmann::json;
+
+namespace
+{
+
+enum class Frame : uint8_t
+{
+  Skip, // unknown subtree, everything inside is ignored
+  Root,
+  Buffers, Buffer,
+  BufferViews, BufferView,
+  Accessors, Accessor,
+  Meshes, Mesh, Primitives, Primitive, Attributes,
+  Nodes, Node,
+  Scenes, Scene,
+  Images, Image,
+  Samplers, Sampler,
+  Textures, Texture, TextureExtensions, TextureBasisu,
+  Materials, Material, PbrMetallicRoughness, TextureInfo, NormalTextureInfo, OcclusionTextureInfo,
+  DoubleArray, IntArray, StringArray
+};
+
+struct FrameState
+{
+  Frame frame;
+  void *target = nullptr; // output of array and texture info frames
+};
+
+static int parse_accessor_type(std::string_view type)
+{
+  if (type == "SCALAR") return TINYGLTF_TYPE_SCALAR;
+  if (type == "VEC2") return TINYGLTF_TYPE_VEC2;
+  if (type == "VEC3") return TINYGLTF_TYPE_VEC3;
+  if (type == "VEC4") return TINYGLTF_TYPE_VEC4;
+  if (type == "MAT2") return TINYGLTF_TYPE_MAT2;
+  if (type == "MAT3") return TINYGLTF_TYPE_MAT3;
+  if (type == "MAT4") return TINYGLTF_TYPE_MAT4;
+  return -1;
+}
+
+struct GLTFSaxHandler : json::json_sax_t
+{
+  GLTFSaxHandler(tinygltf::Model &m, std::vector<size_t> &lengths) 
+    : model {m}, bufferLengths {lengths} 
+  { 
+    stack.reserve(16); 
+  }
+
+  bool null() override { return true; }
+  bool boolean(bool val) override;
+  bool number_integer(json::number_integer_t val) override { return number(double(val)); }
+  bool number_unsigned(json::number_unsigned_t val) override { return number(double(val)); }
+  bool number_float(json::number_float_t val, const json::string_t &) override { return number(val); }
+  bool string(json::string_t &val) override;
+  bool binary(json::binary_t &) override { return true; }
+
+  bool start_object(std::size_t) override;
+  bool key(json::string_t &val) override { key_.swap(val); return true; }
+  bool end_object() override { stack.pop_back(); return true; }
+
+  bool start_array(std::size_t) override;
+  bool end_array() override { stack.pop_back(); return true; }
+
+  bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) override
+  {
+    error = ex.what();
+    return false;
+  }
+
+  tinygltf::Model &model;
+  std::vector<size_t> &bufferLengths; // tinygltf::Buffer has no byteLength field
+  std::string error;
+
+private:
+  bool number(double val);
+
+  void push(Frame frame, void *target = nullptr) { stack.push_back({frame, target}); }
+
+  template <typename T>
+  void pushArray(Frame frame, std::vector<T> &target)
+  {
+    target.clear();
+    push(frame, &target);
+  }
+
+  FrameState &top() { return stack.back(); }
+  bool is(std::string_view name) const { return key_ == name; }
+
+  tinygltf::Primitive &primitive() { return model.meshes.back().primitives.back(); }
+
+  std::vector<FrameState> stack;
+  std::string key_;
+};
+
+bool GLTFSaxHandler::number(double val)
+{
+  if (stack.empty())
+    return true;
+
+  auto &state = top();
+  int ival = int(val);
+
+  switch (state.frame)
+  {
+  case Frame::DoubleArray:
+    static_cast<std::vector<double>*>(state.target)->push_back(val);
+    break;
+  case Frame::IntArray:
+    static_cast<std::vector<int>*>(state.target)->push_back(ival);
+    break;
+  case Frame::Root:
+    if (is("scene")) model.defaultScene = ival;
+    break;
+  case Frame::Buffer:
+    if (is("byteLength")) bufferLengths.back() = size_t(val);
+    break;
+  case Frame::BufferView:
+  {
+    auto &view = model.bufferViews.back();
+    if (is("buffer")) view.buffer = ival;
+    else if (is("byteOffset")) view.byteOffset = size_t(val);
+    else if (is("byteLength")) view.byteLength = size_t(val);
+    else if (is("byteStride")) view.byteStride = size_t(val);
+    else if (is("target")) view.target = ival;
+    break;
+  }
+  case Frame::Accessor:
+  {
+    auto &accessor = model.accessors.back();
+    if (is("bufferView")) accessor.bufferView = ival;
+    else if (is("byteOffset")) accessor.byteOffset = size_t(val);
+    else if (is("componentType")) accessor.componentType = ival;
+    else if (is("count")) accessor.count = size_t(val);
+    break;
+  }
+  case Frame::Primitive:
+    if (is("indices")) primitive().indices = ival;
+    else if (is("material")) primitive().material = ival;
+    else if (is("mode")) primitive().mode = ival;
+    break;
+  case Frame::Attributes:
+    primitive().attributes[key_] = ival;
+    break;
+  case Frame::Node:
+  {
+    auto &node = model.nodes.back();
+    if (is("mesh")) node.mesh = ival;
+    else if (is("camera")) node.camera = ival;
+    else if (is("skin")) node.skin = ival;
+    break;
+  }
+  case Frame::Image:
+    if (is("bufferView")) model.images.back().bufferView = ival;
+    break;
+  case Frame::Sampler:
+  {
+    auto &sampler = model.samplers.back();
+    if (is("magFilter")) sampler.magFilter = ival;
+    else if (is("minFilter")) sampler.minFilter = ival;
+    else if (is("wrapS")) sampler.wrapS = ival;
+    else if (is("wrapT")) sampler.wrapT = ival;
+    break;
+  }
+  case Frame::Texture:
+    if (is("source")) model.textures.back().source = ival;
+    else if (is("sampler")) model.textures.back().sampler = ival;
+    break;
+  case Frame::TextureBasisu:
+    if (is("source"))
+    {
+      tinygltf::Value::Object ext {{"source", tinygltf::Value(ival)}};
+      model.textures.back().extensions["KHR_texture_basisu"] = tinygltf::Value(std::move(ext));
+    }
+    break;
+  case Frame::Material:
+    if (is("alphaCutoff")) model.materials.back().alphaCutoff = val;
+    break;
+  case Frame::PbrMetallicRoughness:
+  {
+    auto &pbr = model.materials.back().pbrMetallicRoughness;
+    if (is("metallicFactor")) pbr.metallicFactor = val;
+    else if (is("roughnessFactor")) pbr.roughnessFactor = val;
+    break;
+  }
+  case Frame::TextureInfo:
+  {
+    auto &info = *static_cast<tinygltf::TextureInfo*>(state.target);
+    if (is("index")) info.index = ival;
+    else if (is("texCoord")) info.texCoord = ival;
+    break;
+  }
+  case Frame::NormalTextureInfo:
+  {
+    auto &info = *static_cast<tinygltf::NormalTextureInfo*>(state.target);
+    if (is("index")) info.index = ival;
+    else if (is("texCoord")) info.texCoord = ival;
+    else if (is("scale")) info.scale = val;
+    break;
+  }
+  case Frame::OcclusionTextureInfo:
+  {
+    auto &info = *static_cast<tinygltf::OcclusionTextureInfo*>(state.target);
+    if (is("index")) info.index = ival;
+    else if (is("texCoord")) info.texCoord = ival;
+    else if (is("strength")) info.strength = val;
+    break;
+  }
+  default:
+    break;
+  }
+  return true;
+}
+
+bool GLTFSaxHandler::boolean(bool val)
+{
+  if (stack.empty())
+    return true;
+
+  if (top().frame == Frame::Accessor && is("normalized"))
+    model.accessors.back().normalized = val;
+  else if (top().frame == Frame::Material && is("doubleSided"))
+    model.materials.back().doubleSided = val;
+  return true;
+}
+
+bool GLTFSaxHandler::string(json::string_t &val)
+{
+  if (stack.empty())
+    return true;
+
+  auto &state = top();
+  switch (state.frame)
+  {
+  case Frame::StringArray:
+    static_cast<std::vector<std::string>*>(state.target)->push_back(std::move(val));
+    break;
+  case Frame::Buffer:
+    if (is("uri")) model.buffers.back().uri = std::move(val);
+    else if (is("name")) model.buffers.back().name = std::move(val);
+    break;
+  case Frame::Accessor:
+    if (is("type")) model.accessors.back().type = parse_accessor_type(val);
+    else if (is("name")) model.accessors.back().name = std::move(val);
+    break;
+  case Frame::Mesh:
+    if (is("name")) model.meshes.back().name = std::move(val);
+    break;
+  case Frame::Node:
+    if (is("name")) model.nodes.back().name = std::move(val);
+    break;
+  case Frame::Image:
+    if (is("uri")) model.images.back().uri = std::move(val);
+    else if (is("mimeType")) model.images.back().mimeType = std::move(val);
+    else if (is("name")) model.images.back().name = std::move(val);
+    break;
+  case Frame::Material:
+    if (is("alphaMode")) model.materials.back().alphaMode = std::move(val);
+    else if (is("name")) model.materials.back().name = std::move(val);
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+bool GLTFSaxHandler::start_object(std::size_t)
+{
+  if (stack.empty())
+  {
+    push(Frame::Root);
+    return true;
+  }
+
+  switch (top().frame)
+  {
+  case Frame::Buffers:
+    model.buffers.emplace_back();
+    bufferLengths.push_back(0);
+    push(Frame::Buffer);
+    break;
+  case Frame::BufferViews: model.bufferViews.emplace_back(); push(Frame::BufferView); break;
+  case Frame::Accessors: model.accessors.emplace_back(); push(Frame::Accessor); break;
+  case Frame::Meshes: model.meshes.emplace_back(); push(Frame::Mesh); break;
+  case Frame::Nodes: model.nodes.emplace_back(); push(Frame::Node); break;
+  case Frame::Scenes: model.scenes.emplace_back(); push(Frame::Scene); break;
+  case Frame::Images: model.images.emplace_back(); push(Frame::Image); break;
+  case Frame::Samplers: model.samplers.emplace_back(); push(Frame::Sampler); break;
+  case Frame::Textures: model.textures.emplace_back(); push(Frame::Texture); break;
+  case Frame::Materials: model.materials.emplace_back(); push(Frame::Material); break;
+  case Frame::Primitives:
+  {
+    auto &prim = model.meshes.back().primitives.emplace_back();
+    prim.mode = TINYGLTF_MODE_TRIANGLES;
+    push(Frame::Primitive);
+    break;
+  }
+  case Frame::Accessor:
+    if (is("sparse"))
+      model.accessors.back().sparse.isSparse = true; // rejected by the loader, contents are not needed
+    push(Frame::Skip);
+    break;
+  case Frame::Primitive:
+    push(is("attributes") ? Frame::Attributes : Frame::Skip);
+    break;
+  case Frame::Texture:
+    push(is("extensions") ? Frame::TextureExtensions : Frame::Skip);
+    break;
+  case Frame::TextureExtensions:
+    push(is("KHR_texture_basisu") ? Frame::TextureBasisu : Frame::Skip);
+    break;
+  case Frame::Material:
+  {
+    auto &mat = model.materials.back();
+    if (is("pbrMetallicRoughness")) push(Frame::PbrMetallicRoughness);
+    else if (is("normalTexture")) push(Frame::NormalTextureInfo, &mat.normalTexture);
+    else if (is("occlusionTexture")) push(Frame::OcclusionTextureInfo, &mat.occlusionTexture);
+    else if (is("emissiveTexture")) push(Frame::TextureInfo, &mat.emissiveTexture);
+    else push(Frame::Skip);
+    break;
+  }
+  case Frame::PbrMetallicRoughness:
+  {
+    auto &pbr = model.materials.back().pbrMetallicRoughness;
+    if (is("baseColorTexture")) push(Frame::TextureInfo, &pbr.baseColorTexture);
+    else if (is("metallicRoughnessTexture")) push(Frame::TextureInfo, &pbr.metallicRoughnessTexture);
+    else push(Frame::Skip);
+    break;
+  }
+  default:
+    push(Frame::Skip);
+    break;
+  }
+  return true;
+}
+
+bool GLTFSaxHandler::start_array(std::size_t)
+{
+  if (stack.empty())
+  {
+    error = "glTF document root is not an object";
+    return false;
+  }
+
+  switch (top().frame)
+  {
+  case Frame::Root:
+    if (is("buffers")) push(Frame::Buffers);
+    else if (is("bufferViews")) push(Frame::BufferViews);
+    else if (is("accessors")) push(Frame::Accessors);
+    else if (is("meshes")) push(Frame::Meshes);
+    else if (is("nodes")) push(Frame::Nodes);
+    else if (is("scenes")) push(Frame::Scenes);
+    else if (is("images")) push(Frame::Images);
+    else if (is("samplers")) push(Frame::Samplers);
+    else if (is("textures")) push(Frame::Textures);
+    else if (is("materials")) push(Frame::Materials);
+    else if (is("extensionsUsed")) pushArray(Frame::StringArray, model.extensionsUsed);
+    else if (is("extensionsRequired")) pushArray(Frame::StringArray, model.extensionsRequired);
+    else push(Frame::Skip);
+    break;
+  case Frame::Mesh:
+    if (is("primitives")) push(Frame::Primitives);
+    else if (is("weights")) pushArray(Frame::DoubleArray, model.meshes.back().weights);
+    else push(Frame::Skip);
+    break;
+  case Frame::Accessor:
+    if (is("min")) pushArray(Frame::DoubleArray, model.accessors.back().minValues);
+    else if (is("max")) pushArray(Frame::DoubleArray, model.accessors.back().maxValues);
+    else push(Frame::Skip);
+    break;
+  case Frame::Node:
+  {
+    auto &node = model.nodes.back();
+    if (is("children")) pushArray(Frame::IntArray, node.children);
+    else if (is("matrix")) pushArray(Frame::DoubleArray, node.matrix);
+    else if (is("rotation")) pushArray(Frame::DoubleArray, node.rotation);
+    else if (is("scale")) pushArray(Frame::DoubleArray, node.scale);
+    else if (is("translation")) pushArray(Frame::DoubleArray, node.translation);
+    else if (is("weights")) pushArray(Frame::DoubleArray, node.weights);
+    else push(Frame::Skip);
+    break;
+  }
+  case Frame::Scene:
+    if (is("nodes")) pushArray(Frame::IntArray, model.scenes.back().nodes);
+    else push(Frame::Skip);
+    break;
+  case Frame::Material:
+    if (is("emissiveFactor")) pushArray(Frame::DoubleArray, model.materials.back().emissiveFactor);
+    else push(Frame::Skip);
+    break;
+  case Frame::PbrMetallicRoughness:
+    if (is("baseColorFactor"))
+      pushArray(Frame::DoubleArray, model.materials.back().pbrMetallicRoughness.baseColorFactor);
+    else
+      push(Frame::Skip);
+    break;
+  default:
+    push(Frame::Skip);
+    break;
+  }
+  return true;
+}
+
+// index into a list of count entries, -1 where optional is allowed to mean "none"
+static bool check_index(int index, size_t count, bool optional, std::string_view what, size_t owner,
+  std::string &err)
+{
+  if ((index == -1 && optional) || (index >= 0 && size_t(index) < count))
+    return true;
+  err = "invalid " + std::string(what) + " index " + std::to_string(index) + " in element " + std::to_string(owner);
+  return false;
+}
+
+// TinyGLTF rejected dangling indices and out of range views, the loader relies on both
+static bool validate_model(const tinygltf::Model &model, const std::vector<size_t> &buffer_lengths,
+  std::string &err)
+{
+  for (size_t i = 0; i < model.bufferViews.size(); i++)
+  {
+    const auto &view = model.bufferViews[i];
+    if (!check_index(view.buffer, model.buffers.size(), false, "buffer", i, err))
+      return false;
+    if (view.byteOffset + view.byteLength > buffer_lengths[view.buffer])
+    {
+      err = "bufferView " + std::to_string(i) + " is out of its buffer range";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.accessors.size(); i++)
+  {
+    const auto &accessor = model.accessors[i];
+    if (!check_index(accessor.bufferView, model.bufferViews.size(), true, "bufferView", i, err))
+      return false;
+
+    int componentSize = tinygltf::GetComponentSizeInBytes(uint32_t(accessor.componentType));
+    int components = tinygltf::GetNumComponentsInType(uint32_t(accessor.type));
+    if (componentSize <= 0 || components <= 0)
+    {
+      err = "accessor " + std::to_string(i) + " has an invalid type";
+      return false;
+    }
+
+    if (accessor.bufferView < 0 || accessor.count == 0)
+      continue;
+
+    const auto &view = model.bufferViews[accessor.bufferView];
+    size_t elementSize = size_t(componentSize) * size_t(components);
+    size_t stride = view.byteStride ? view.byteStride : elementSize;
+    if (accessor.byteOffset + (accessor.count - 1) * stride + elementSize > view.byteLength)
+    {
+      err = "accessor " + std::to_string(i) + " is out of its bufferView range";
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.meshes.size(); i++)
+  {
+    for (const auto &prim : model.meshes[i].primitives)
+    {
+      if (!check_index(prim.indices, model.accessors.size(), true, "indices accessor", i, err)
+        || !check_index(prim.material, model.materials.size(), true, "material", i, err))
+        return false;
+      for (const auto &[name, accessor] : prim.attributes)
+      {
+        if (!check_index(accessor, model.accessors.size(), false, name + " accessor", i, err))
+          return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < model.nodes.size(); i++)
+  {
+    const auto &node = model.nodes[i];
+    if (!check_index(node.mesh, model.meshes.size(), true, "mesh", i, err))
+      return false;
+    for (int child : node.children)
+    {
+      if (!check_index(child, model.nodes.size(), false, "child node", i, err))
+        return false;
+    }
+  }
+
+  for (size_t i = 0; i < model.scenes.size(); i++)
+  {
+    for (int node : model.scenes[i].nodes)
+    {
+      if (!check_index(node, model.nodes.size(), false, "scene node", i, err))
+        return false;
+    }
+  }
+  if (!check_index(model.defaultScene, model.scenes.size(), true, "default scene", 0, err))
+    return false;
+
+  for (size_t i = 0; i < model.images.size(); i++)
+  {
+    if (!check_index(model.images[i].bufferView, model.bufferViews.size(), true, "bufferView", i, err))
+      return false;
+  }
+
+  // KHR_texture_basisu sources are checked where they are read, see get_texture_source
+  for (size_t i = 0; i < model.textures.size(); i++)
+  {
+    const auto &texture = model.textures[i];
+    if (!check_index(texture.source, model.images.size(), true, "image", i, err)
+      || !check_index(texture.sampler, model.samplers.size(), true, "sampler", i, err))
+      return false;
+  }
+
+  for (size_t i = 0; i < model.materials.size(); i++)
+  {
+    const auto &mat = model.materials[i];
+    const auto &pbr = mat.pbrMetallicRoughness;
+    for (int texture : {pbr.baseColorTexture.index, pbr.metallicRoughnessTexture.index, mat.normalTexture.index,
+      mat.occlusionTexture.index, mat.emissiveTexture.index})
+    {
+      if (!check_index(texture, model.textures.size(), true, "texture", i, err))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+bool parse_gltf_json(std::string_view json, tinygltf::Model &model, 
+  std::vector<size_t> &buffer_lengths, std::string &err)
+{
+  buffer_lengths.clear();
+  GLTFSaxHandler handler {model, buffer_lengths};
+  bool ok = json::sax_parse(json.begin(), json.end(), &handler);
+  if (!ok)
+  {
+    err = handler.error.empty() ? std::string("malformed glTF JSON") : handler.error;
+    return false;
+  }
+  return validate_model(model, buffer_lengths, err);
+}
+
+} // namespace scene
@@ -0,0 +1,24 @@
+#ifndef SCENE_GLTF_STREAM_PARSER_HPP_INCLUDED
+#define SCENE_GLTF_STREAM_PARSER_HPP_INCLUDED
+
+#include <tiny_gltf.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scene
+{
+
+// Single pass SAX parse of a glTF JSON document straight into model, no intermediate DOM.
+// Fills the subset of the schema the scene loader reads (buffers, buffer views, accessors, meshes,
+// nodes, scenes, images, samplers, textures with KHR_texture_basisu, materials), everything else is skipped.
+// Buffers and images are left unresolved: only uri/bufferView are set, buffer_lengths[i]
+// receives byteLength of model.buffers[i].
+// Fails like TinyGLTF does on dangling indices and on buffer views or accessors out of their buffer range.
+bool parse_gltf_json(std::string_view json, tinygltf::Model &model, 
+  std::vector<size_t> &buffer_lengths, std::string &err);
+
+} // namespace scene
+
+#endif
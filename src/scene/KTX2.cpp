@@ -0,0 +1,288 @@
+#include "KTX2.hpp"
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace scene
+{
+
+static constexpr uint8_t KTX2_IDENTIFIER[12] {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+static constexpr size_t KTX2_HEADER_SIZE = 80;
+static constexpr size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+// Khronos Data Format color models and channel ids
+static constexpr uint32_t KHR_DF_MODEL_RGBSDA = 1;
+static constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+static constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+static constexpr uint32_t KHR_DF_MODEL_BC4 = 131;
+static constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+static constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+static constexpr uint32_t KHR_DF_CHANNEL_RED = 0;
+static constexpr uint32_t KHR_DF_CHANNEL_GREEN = 1;
+static constexpr uint32_t KHR_DF_CHANNEL_BLUE = 2;
+static constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+static constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+static constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+
+template <typename T>
+static T read_value(std::span<const uint8_t> data, size_t offset)
+{
+  T v;
+  std::memcpy(&v, data.data() + offset, sizeof(T));
+  return v;
+}
+
+template <typename T>
+static void write_value(std::vector<uint8_t> &dst, size_t offset, T v)
+{
+  std::memcpy(dst.data() + offset, &v, sizeof(T));
+}
+
+bool is_ktx2(std::span<const uint8_t> data)
+{
+  return data.size() >= KTX2_HEADER_SIZE && std::memcmp(data.data(), KTX2_IDENTIFIER, 12) == 0;
+}
+
+std::optional<KTX2Header> read_ktx2_header(std::span<const uint8_t> data)
+{
+  if (!is_ktx2(data))
+    return std::nullopt;
+
+  KTX2Header header;
+  std::memcpy(&header, data.data() + 12, sizeof(header));
+  return header;
+}
+
+// Validates the header and the level index, levels keep their file offsets
+static std::optional<TextureData> parse_ktx2(std::span<const uint8_t> data, std::string &err)
+{
+  auto header = read_ktx2_header(data);
+  if (!header)
+  {
+    err = "not a KTX2 file";
+    return std::nullopt;
+  }
+
+  if (is_ktx2_basis(*header))
+  {
+    err = "Basis Universal KTX2 payloads are not supported";
+    return std::nullopt;
+  }
+
+  if (header->supercompressionScheme != 0)
+  {
+    err = "supercompressed KTX2 files are not supported";
+    return std::nullopt;
+  }
+
+  if (header->pixelDepth > 1 || header->layerCount > 1 || header->faceCount != 1 || header->pixelHeight == 0)
+  {
+    err = "only 2D KTX2 textures are supported";
+    return std::nullopt;
+  }
+
+  TextureData texture {
+    .format = vk::Format(header->vkFormat),
+    .width = header->pixelWidth,
+    .height = header->pixelHeight
+  };
+
+  uint32_t levelCount = std::max(header->levelCount, 1u);
+  if (KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE > data.size())
+  {
+    err = "KTX2 level index is out of file bounds";
+    return std::nullopt;
+  }
+
+  for (uint32_t level = 0; level < levelCount; level++)
+  {
+    size_t entry = KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    auto byteOffset = read_value<uint64_t>(data, entry);
+    auto byteLength = read_value<uint64_t>(data, entry + 8);
+
+    uint32_t width = std::max(texture.width >> level, 1u);
+    uint32_t height = std::max(texture.height >> level, 1u);
+
+    if (byteOffset + byteLength > data.size() || byteLength != get_level_size(texture.format, width, height))
+    {
+      err = "KTX2 level " + std::to_string(level) + " has invalid size";
+      return std::nullopt;
+    }
+
+    texture.levels.push_back({size_t(byteOffset), size_t(byteLength), width, height});
+  }
+
+  return texture;
+}
+
+std::optional<TextureData> read_ktx2(std::span<const uint8_t> data, std::string &err)
+{
+  auto texture = parse_ktx2(data, err);
+  if (!texture)
+    return std::nullopt;
+
+  // levels are packed in order, with offsets aligned for buffer to image copies
+  size_t totalSize = 0;
+  for (auto &level : texture->levels)
+    totalSize = ((totalSize + 15) & ~size_t(15)) + level.size;
+
+  texture->bytes.resize(totalSize);
+  size_t offset = 0;
+  for (auto &level : texture->levels)
+  {
+    offset = (offset + 15) & ~size_t(15);
+    std::memcpy(texture->bytes.data() + offset, data.data() + level.offset, level.size);
+    level.offset = offset;
+    offset += level.size;
+  }
+
+  return texture;
+}
+
+std::optional<TextureData> read_ktx2(MappedFile &&file, std::string &err)
+{
+  // level data of files written by write_ktx2 is aligned to lcm(block size, 4) as copies require
+  auto texture = parse_ktx2(file.getData(), err);
+  if (texture)
+    texture->mapping = std::move(file);
+  return texture;
+}
+
+struct DFDSample
+{
+  uint32_t bitOffset;
+  uint32_t bitLength;
+  uint32_t channel;
+  uint32_t upper;
+};
+
+static std::vector<uint32_t> build_dfd(vk::Format format)
+{
+  uint32_t model = KHR_DF_MODEL_RGBSDA;
+  uint32_t transfer = KHR_DF_TRANSFER_LINEAR;
+  std::vector<DFDSample> samples;
+
+  switch (format)
+  {
+  case vk::Format::eBc1RgbUnormBlock:
+    model = KHR_DF_MODEL_BC1A;
+    samples = {{0, 64, KHR_DF_CHANNEL_RED, UINT32_MAX}};
+    break;
+  case vk::Format::eBc3UnormBlock:
+    model = KHR_DF_MODEL_BC3;
+    samples = {{0, 64, KHR_DF_CHANNEL_ALPHA, UINT32_MAX}, {64, 64, KHR_DF_CHANNEL_RED, UINT32_MAX}};
+    break;
+  case vk::Format::eBc4UnormBlock:
+    model = KHR_DF_MODEL_BC4;
+    samples = {{0, 64, KHR_DF_CHANNEL_RED, UINT32_MAX}};
+    break;
+  case vk::Format::eBc5UnormBlock:
+    model = KHR_DF_MODEL_BC5;
+    samples = {{0, 64, KHR_DF_CHANNEL_RED, UINT32_MAX}, {64, 64, KHR_DF_CHANNEL_GREEN, UINT32_MAX}};
+    break;
+  case vk::Format::eBc7UnormBlock:
+    model = KHR_DF_MODEL_BC7;
+    samples = {{0, 128, KHR_DF_CHANNEL_RED, UINT32_MAX}};
+    break;
+  case vk::Format::eR8G8B8A8Srgb:
+    transfer = KHR_DF_TRANSFER_SRGB;
+    [[fallthrough]];
+  case vk::Format::eR8G8B8A8Unorm:
+    samples = {{0, 8, KHR_DF_CHANNEL_RED, 255}, {8, 8, KHR_DF_CHANNEL_GREEN, 255},
+      {16, 8, KHR_DF_CHANNEL_BLUE, 255}, {24, 8, KHR_DF_CHANNEL_ALPHA, 255}};
+    break;
+  case vk::Format::eR8G8Unorm:
+    samples = {{0, 8, KHR_DF_CHANNEL_RED, 255}, {8, 8, KHR_DF_CHANNEL_GREEN, 255}};
+    break;
+  case vk::Format::eR8Unorm:
+    samples = {{0, 8, KHR_DF_CHANNEL_RED, 255}};
+    break;
+  default:
+    break; // unknown layout, descriptor without samples
+  }
+
+  auto blockExtent = vk::blockExtent(format);
+  uint32_t blockSize = vk::blockSize(format);
+  uint32_t descriptorBlockSize = 24 + 16 * uint32_t(samples.size());
+
+  std::vector<uint32_t> dfd {
+    4 + descriptorBlockSize, // dfdTotalSize
+    0, // vendorId = Khronos, descriptorType = basic
+    2u | (descriptorBlockSize << 16), // versionNumber = KDF 1.3
+    model | (KHR_DF_PRIMARIES_BT709 << 8) | (transfer << 16),
+    uint32_t(blockExtent[0] - 1) | (uint32_t(blockExtent[1] - 1) << 8),
+    blockSize, // bytesPlane0
+    0
+  };
+
+  for (auto &sample : samples)
+  {
+    dfd.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+    dfd.push_back(0); // sample position
+    dfd.push_back(0); // lower
+    dfd.push_back(sample.upper);
+  }
+  return dfd;
+}
+
+std::vector<uint8_t> write_ktx2(const TextureData &texture)
+{
+  uint32_t levelCount = uint32_t(texture.levels.size());
+  auto dfd = build_dfd(texture.format);
+
+  size_t dfdOffset = KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+  size_t dfdSize = dfd.size() * sizeof(uint32_t);
+  size_t alignment = std::lcm<size_t>(vk::blockSize(texture.format), 4);
+
+  // level data goes from the smallest mip to the largest, as recommended by the spec
+  std::vector<size_t> levelOffsets(levelCount);
+  size_t fileSize = dfdOffset + dfdSize;
+  for (uint32_t level = levelCount; level-- > 0;)
+  {
+    fileSize = (fileSize + alignment - 1) / alignment * alignment;
+    levelOffsets[level] = fileSize;
+    fileSize += texture.levels[level].size;
+  }
+
+  std::vector<uint8_t> file(fileSize, 0);
+  std::memcpy(file.data(), KTX2_IDENTIFIER, 12);
+
+  KTX2Header header {
+    .vkFormat = uint32_t(texture.format),
+    .typeSize = 1,
+    .pixelWidth = texture.width,
+    .pixelHeight = texture.height,
+    .pixelDepth = 0,
+    .layerCount = 0,
+    .faceCount = 1,
+    .levelCount = levelCount,
+    .supercompressionScheme = 0
+  };
+  std::memcpy(file.data() + 12, &header, sizeof(header));
+
+  write_value<uint32_t>(file, 48, uint32_t(dfdOffset));
+  write_value<uint32_t>(file, 52, uint32_t(dfdSize));
+  // no key/value data and no supercompression global data, offsets 56..79 stay zero
+
+  for (uint32_t level = 0; level < levelCount; level++)
+  {
+    size_t entry = KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+    auto levelData = texture.getLevelData(level);
+    write_value<uint64_t>(file, entry, levelOffsets[level]);
+    write_value<uint64_t>(file, entry + 8, levelData.size());
+    write_value<uint64_t>(file, entry + 16, levelData.size());
+    std::memcpy(file.data() + levelOffsets[level], levelData.data(), levelData.size());
+  }
+
+  std::memcpy(file.data() + dfdOffset, dfd.data(), dfdSize);
+  return file;
+}
+
+} // namespace scene
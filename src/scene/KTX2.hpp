@@ -0,0 +1,43 @@
+#ifndef SCENE_KTX2_HPP_INCLUDED
+#define SCENE_KTX2_HPP_INCLUDED
+
+#include "TextureData.hpp"
+
+#include <optional>
+#include <string>
+
+namespace scene
+{
+
+struct KTX2Header
+{
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+};
+
+bool is_ktx2(std::span<const uint8_t> data);
+
+// nullopt if data is not a KTX2 file
+std::optional<KTX2Header> read_ktx2_header(std::span<const uint8_t> data);
+
+// Basis Universal payloads (vkFormat == VK_FORMAT_UNDEFINED) need a transcoder and are not supported
+inline bool is_ktx2_basis(const KTX2Header &header) { return header.vkFormat == 0; }
+
+// Reads a 2D, non supercompressed KTX2 file. Returns nullopt with err set for anything else.
+std::optional<TextureData> read_ktx2(std::span<const uint8_t> data, std::string &err);
+
+// Same as above without a copy, levels point into the mapping which is moved into the result
+std::optional<TextureData> read_ktx2(MappedFile &&file, std::string &err);
+
+std::vector<uint8_t> write_ktx2(const TextureData &texture);
+
+} // namespace scene
+
+#endif
@@ -0,0 +1,98 @@
+#include "MappedFile.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace scene
+{
+
+std::optional<MappedFile> MappedFile::open(const std::string &path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return std::nullopt;
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0)
+  {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  MappedFile file;
+  file.size = size_t(info.st_size);
+
+  if (file.size)
+  {
+    void *ptr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+      ::close(fd);
+      return std::nullopt;
+    }
+    file.data = static_cast<const uint8_t*>(ptr);
+  }
+
+  ::close(fd); // mapping keeps the file referenced
+  return file;
+}
+
+MappedFile::~MappedFile()
+{
+  reset();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+  : data {std::exchange(other.data, nullptr)}, size {std::exchange(other.size, 0)}
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+  if (this != &other)
+  {
+    reset();
+    data = std::exchange(other.data, nullptr);
+    size = std::exchange(other.size, 0);
+  }
+  return *this;
+}
+
+void MappedFile::reset()
+{
+  if (data)
+    munmap(const_cast<uint8_t*>(data), size);
+  data = nullptr;
+  size = 0;
+}
+
+void advise_sequential(std::span<const uint8_t> range)
+{
+  if (range.empty())
+    return;
+
+  const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(range.data()) & ~(pageSize - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(range.data()) + range.size();
+
+  madvise(reinterpret_cast<void*>(begin), end - begin, MADV_SEQUENTIAL);
+  madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+void release_pages(std::span<const uint8_t> range)
+{
+  if (range.empty())
+    return;
+
+  const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(range.data()) & ~(pageSize - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(range.data()) + range.size();
+
+  madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+}
+
+} // namespace scene
@@ -0,0 +1,46 @@
+#ifndef SCENE_MAPPED_FILE_HPP_INCLUDED
+#define SCENE_MAPPED_FILE_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <optional>
+
+namespace scene
+{
+
+// Read-only memory mapping of a whole file
+struct MappedFile
+{
+  static std::optional<MappedFile> open(const std::string &path);
+
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  std::span<const uint8_t> getData() const { return {data, size}; }
+  size_t getSize() const { return size; }
+
+private:
+  void reset();
+
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+};
+
+// hints the kernel that range will be read once front to back (MADV_SEQUENTIAL|MADV_WILLNEED)
+void advise_sequential(std::span<const uint8_t> range);
+
+// drops resident pages of a read-only file mapping, they are read again on the next access.
+// Pages only partially covered by range are dropped as well. Must not be used on anonymous memory.
+void release_pages(std::span<const uint8_t> range);
+
+} // namespace scene
+
+#endif
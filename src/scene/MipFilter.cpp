@@ -0,0 +1,141 @@
+#include "MipFilter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace scene
+{
+
+static constexpr uint32_t LINEAR_TO_SRGB_STEPS = 4096;
+
+struct SrgbTables
+{
+  std::array<float, 256> toLinear;
+  std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1> toSrgb;
+
+  SrgbTables()
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      float c = float(i) / 255.f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (uint32_t i = 0; i <= LINEAR_TO_SRGB_STEPS; i++)
+    {
+      float l = float(i) / float(LINEAR_TO_SRGB_STEPS);
+      float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+      toSrgb[i] = uint8_t(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+    }
+  }
+};
+
+static const SrgbTables &get_srgb_tables()
+{
+  static SrgbTables tables;
+  return tables;
+}
+
+static void downsample_row_srgb(const uint8_t *row0, const uint8_t *row1, uint32_t width, 
+  uint8_t *dst, uint32_t dst_width)
+{
+  const auto &tables = get_srgb_tables();
+
+  for (uint32_t x = 0; x < dst_width; x++)
+  {
+    uint32_t x0 = std::min(2 * x, width - 1);
+    uint32_t x1 = std::min(2 * x + 1, width - 1);
+    const uint8_t *texels[4] {row0 + 4 * x0, row0 + 4 * x1, row1 + 4 * x0, row1 + 4 * x1};
+
+#if defined(__SSE2__)
+    __m128 sum = _mm_setzero_ps();
+    for (auto t : texels)
+      sum = _mm_add_ps(sum, _mm_set_ps(float(t[3]) / 255.f, tables.toLinear[t[2]], 
+        tables.toLinear[t[1]], tables.toLinear[t[0]]));
+
+    __m128 avg = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+    __m128 scale = _mm_set_ps(255.f, float(LINEAR_TO_SRGB_STEPS), float(LINEAR_TO_SRGB_STEPS), float(LINEAR_TO_SRGB_STEPS));
+    alignas(16) int32_t idx[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx), _mm_cvtps_epi32(_mm_mul_ps(avg, scale)));
+
+    dst[4 * x + 0] = tables.toSrgb[idx[0]];
+    dst[4 * x + 1] = tables.toSrgb[idx[1]];
+    dst[4 * x + 2] = tables.toSrgb[idx[2]];
+    dst[4 * x + 3] = uint8_t(idx[3]);
+#else
+    float sum[4] {};
+    for (auto t : texels)
+    {
+      for (uint32_t c = 0; c < 3; c++)
+        sum[c] += tables.toLinear[t[c]];
+      sum[3] += float(t[3]) / 255.f;
+    }
+    for (uint32_t c = 0; c < 3; c++)
+      dst[4 * x + c] = tables.toSrgb[uint32_t(sum[c] * 0.25f * LINEAR_TO_SRGB_STEPS + 0.5f)];
+    dst[4 * x + 3] = uint8_t(sum[3] * 0.25f * 255.f + 0.5f);
+#endif
+  }
+}
+
+static void downsample_row_linear(const uint8_t *row0, const uint8_t *row1, uint32_t width, 
+  uint8_t *dst, uint32_t dst_width)
+{
+  uint32_t x = 0;
+
+#if defined(__SSE2__)
+  // two destination texels from 4 + 4 source texels per iteration, (a + b + c + d + 2) / 4
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(2);
+  for (; 2 * x + 3 < width && x + 1 < dst_width; x += 2)
+  {
+    __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+    __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+    __m128i sum = _mm_unpacklo_epi64(lo, hi);
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_packus_epi16(sum, zero));
+  }
+#endif
+
+  for (; x < dst_width; x++)
+  {
+    uint32_t x0 = std::min(2 * x, width - 1);
+    uint32_t x1 = std::min(2 * x + 1, width - 1);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+      uint32_t sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+      dst[4 * x + c] = uint8_t((sum + 2) / 4);
+    }
+  }
+}
+
+void downsample_rgba8(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst, bool srgb)
+{
+  uint32_t dstWidth = std::max(width / 2, 1u);
+  uint32_t dstHeight = std::max(height / 2, 1u);
+
+  for (uint32_t y = 0; y < dstHeight; y++)
+  {
+    const uint8_t *row0 = src + 4 * size_t(width) * std::min(2 * y, height - 1);
+    const uint8_t *row1 = src + 4 * size_t(width) * std::min(2 * y + 1, height - 1);
+    uint8_t *dstRow = dst + 4 * size_t(dstWidth) * y;
+
+    if (srgb)
+      downsample_row_srgb(row0, row1, width, dstRow, dstWidth);
+    else
+      downsample_row_linear(row0, row1, width, dstRow, dstWidth);
+  }
+}
+
+} // namespace scene
@@ -0,0 +1,15 @@
+#ifndef SCENE_MIP_FILTER_HPP_INCLUDED
+#define SCENE_MIP_FILTER_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace scene
+{
+
+// 2x2 box filter of a width x height RGBA8 image into max(width/2, 1) x max(height/2, 1) texels.
+// With srgb set RGB is averaged in linear space and encoded back, alpha is always linear.
+void downsample_rgba8(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst, bool srgb);
+
+} // namespace scene
+
+#endif
@@ -0,0 +1,349 @@
+#include "SceneLoader.hpp"
+#include "TextureStreamer.hpp"
+#include "util/Memory.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include <cstring>
+#include <utility>
+
+namespace scene
+{
+
+// geometry is copied in chunks of this size, so a large vertex buffer does not take a single step
+static constexpr uint64_t GEOMETRY_CHUNK_SIZE = 4ull << 20;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool has_gpu_mips(const TextureData &texture)
+{
+  return texture.levels.size() == 1 && texture.format == vk::Format::eR8G8B8A8Unorm;
+}
+
+AsyncSceneLoader::AsyncSceneLoader(const std::string &scene_path, const SceneLoadOptions &load_options,
+  const AsyncSceneLoaderConfig &loader_config)
+  : path {scene_path}, options {load_options}, config {loader_config}
+{
+  startTime = std::chrono::steady_clock::now();
+  preparing = std::async(std::launch::async, [path = path, options = options]() {
+    return prepare_scene(path, options);
+  });
+}
+
+AsyncSceneLoader::~AsyncSceneLoader()
+{
+  if (preparing.valid())
+    preparing.wait();
+
+  // staging buffers and replaced images may still be read by frames in flight
+  if (!retired.empty())
+    etna::get_context().getQueue().waitIdle();
+}
+
+std::unique_ptr<GLTFScene> AsyncSceneLoader::update(etna::SyncCommandBuffer &cmd)
+{
+  frameIndex++;
+
+  uint32_t framesInFlight = etna::get_context().getNumFramesInFlight();
+  while (!retired.empty() && retired.front().frame + framesInFlight <= frameIndex)
+    retired.pop_front();
+
+  if (state == State::Preparing)
+  {
+    if (preparing.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return nullptr;
+
+    prepared = preparing.get();
+    spdlog::info("Async scene load : {} prepared in {:.2f} ms", path, elapsed_ms(startTime));
+
+    createScene(cmd);
+    planSteps();
+    state = State::Uploading;
+  }
+
+  if (state == State::Done)
+    return nullptr;
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t frameBytes = 0;
+  bool handOut = false;
+
+  // at least one step per frame, a budget smaller than a single step still makes progress
+  do
+  {
+    const auto &step = steps[nextStep++];
+    if (step.kind == StepKind::HandOut)
+    {
+      handOut = true;
+      break;
+    }
+    frameBytes += runStep(cmd, step);
+  }
+  while (nextStep < steps.size()
+    && frameBytes < config.uploadBytesPerFrame
+    && elapsed_ms(start) < config.uploadBudgetMs);
+
+  uploadedBytes += frameBytes;
+  lastUploadMs = elapsed_ms(start);
+  maxUploadMs = std::max(maxUploadMs, lastUploadMs);
+  uploadFrames++;
+
+  bool finished = nextStep == steps.size();
+  if (handOut)
+  {
+    auto &stats = prepared->stats;
+    stats.peakRss = util::get_peak_rss();
+    spdlog::info("Async scene load : {} ready in {:.2f} ms, {} frames of uploads, {} MiB of textures, "
+      "upload per frame max {:.2f} ms (budget {:.2f} ms, {} MiB), peak RSS {} MiB",
+      path,
+      elapsed_ms(startTime),
+      uploadFrames,
+      stats.textureBytes >> 20,
+      maxUploadMs,
+      config.uploadBudgetMs,
+      config.uploadBytesPerFrame >> 20,
+      stats.peakRss >> 20);
+  }
+  else if (finished)
+  {
+    spdlog::info("Async scene load : {} placeholders refined, {} frames of uploads, upload per frame max {:.2f} ms",
+      path, uploadFrames, maxUploadMs);
+  }
+
+  if (finished)
+  {
+    state = State::Done;
+    prepared.reset();
+  }
+  else if (handOut)
+  {
+    state = State::Refining;
+  }
+
+  if (!handOut)
+    return nullptr;
+
+  return std::move(scene);
+}
+
+void AsyncSceneLoader::createScene(etna::SyncCommandBuffer &cmd)
+{
+  scene.reset(new GLTFScene{});
+  target = scene.get();
+
+  target->meshes = std::move(prepared->meshes);
+  target->nodes = std::move(prepared->nodes);
+  target->rootNodes = std::move(prepared->rootNodes);
+  target->materials = std::move(prepared->materials);
+  target->imageSamplers = std::move(prepared->imageSamplers);
+
+  target->samplers.reserve(prepared->samplers.size());
+  for (const auto &info : prepared->samplers)
+    target->samplers.emplace_back(etna::get_context().getDevice().createSamplerUnique(info).value);
+
+  target->vertexBuffer = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(Vertex) * prepared->vertices.size(),
+    .bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  target->indexBuffer = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(uint32_t) * prepared->indices.size(),
+    .bufferUsage = vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  // images are filled as their uploads complete, until then they are never referenced
+  target->images.resize(prepared->textures.size());
+  target->streamSources.resize(prepared->textures.size());
+  target->stubTexture = record_stub_texture(cmd);
+  target->initTransforms();
+}
+
+void AsyncSceneLoader::addTextureUpload(uint32_t image_id, uint32_t first_level, bool last)
+{
+  const auto &texture = *prepared->textures[image_id];
+  uint32_t uploadId = uint32_t(textureUploads.size());
+  textureUploads.push_back(TextureUpload {.imageId = image_id, .firstLevel = first_level, .last = last});
+
+  if (has_gpu_mips(texture))
+  {
+    steps.push_back(Step {.kind = StepKind::TextureWhole, .uploadId = uploadId, .size = texture.levels[0].size});
+    return;
+  }
+
+  // smallest level first, the last step of an upload copies first_level and publishes the image
+  for (uint32_t level = uint32_t(texture.levels.size()); level-- > first_level;)
+  {
+    steps.push_back(Step {
+      .kind = StepKind::TextureLevel,
+      .uploadId = uploadId,
+      .level = level,
+      .size = texture.levels[level].size
+    });
+  }
+}
+
+void AsyncSceneLoader::planSteps()
+{
+  uint64_t vertexBytes = sizeof(Vertex) * prepared->vertices.size();
+  for (uint64_t offset = 0; offset < vertexBytes; offset += GEOMETRY_CHUNK_SIZE)
+  {
+    steps.push_back(Step {
+      .kind = StepKind::Vertices,
+      .offset = offset,
+      .size = std::min(GEOMETRY_CHUNK_SIZE, vertexBytes - offset)
+    });
+  }
+
+  uint64_t indexBytes = sizeof(uint32_t) * prepared->indices.size();
+  for (uint64_t offset = 0; offset < indexBytes; offset += GEOMETRY_CHUNK_SIZE)
+  {
+    steps.push_back(Step {
+      .kind = StepKind::Indices,
+      .offset = offset,
+      .size = std::min(GEOMETRY_CHUNK_SIZE, indexBytes - offset)
+    });
+  }
+
+  auto &stats = prepared->stats;
+  std::vector<uint32_t> refinedImages;
+  for (uint32_t imageId = 0; imageId < prepared->textures.size(); imageId++)
+  {
+    if (!prepared->textures[imageId].has_value())
+    {
+      spdlog::warn("GLTF image {} : unsupported KTX2 payload, textures use their fallback source", imageId);
+      continue;
+    }
+
+    const auto &texture = *prepared->textures[imageId];
+    if (has_gpu_mips(texture))
+    {
+      uint32_t levels = get_mip_levels_count(texture.width, texture.height);
+      for (uint32_t level = 0; level < levels; level++)
+        stats.textureBytes += get_level_size(texture.format, std::max(texture.width >> level, 1u),
+          std::max(texture.height >> level, 1u));
+      addTextureUpload(imageId, 0, true);
+      continue;
+    }
+
+    // streamed textures start with their mip tail as in load_scene, TextureStreamer refines them
+    if (is_texture_streamed(texture, options))
+    {
+      uint32_t tailLevel = get_stream_tail_level(texture, options.streamTailSize);
+      stats.textureBytes += texture.getPayloadSize(tailLevel);
+      addTextureUpload(imageId, tailLevel, true);
+      continue;
+    }
+
+    stats.textureBytes += texture.getPayloadSize(0);
+    uint32_t placeholderLevel = config.placeholderSize
+      ? get_stream_tail_level(texture, config.placeholderSize)
+      : 0;
+
+    addTextureUpload(imageId, placeholderLevel, placeholderLevel == 0);
+    if (placeholderLevel > 0)
+      refinedImages.push_back(imageId);
+  }
+
+  steps.push_back(Step {.kind = StepKind::HandOut});
+
+  for (auto imageId : refinedImages)
+    addTextureUpload(imageId, 0, true);
+
+  for (const auto &step : steps)
+    totalBytes += step.size;
+}
+
+etna::Buffer AsyncSceneLoader::createStaging(std::span<const uint8_t> bytes)
+{
+  auto staging = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = bytes.size(),
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+  });
+
+  auto ptr = staging.map();
+  std::memcpy(ptr, bytes.data(), bytes.size());
+  staging.unmap();
+  return staging;
+}
+
+uint64_t AsyncSceneLoader::runStep(etna::SyncCommandBuffer &cmd, const Step &step)
+{
+  switch (step.kind)
+  {
+  case StepKind::Vertices:
+  case StepKind::Indices:
+  {
+    bool vertices = step.kind == StepKind::Vertices;
+    auto src = vertices
+      ? reinterpret_cast<const uint8_t*>(prepared->vertices.data())
+      : reinterpret_cast<const uint8_t*>(prepared->indices.data());
+
+    auto staging = createStaging({src + step.offset, step.size});
+    cmd.copyBuffer(staging, vertices ? target->vertexBuffer : target->indexBuffer,
+      {vk::BufferCopy{.srcOffset = 0, .dstOffset = step.offset, .size = step.size}});
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(staging)});
+    break;
+  }
+  case StepKind::TextureWhole:
+  {
+    auto &upload = textureUploads[step.uploadId];
+    std::vector<etna::Buffer> staging;
+    upload.image = upload_texture(cmd, *prepared->textures[upload.imageId], 0,
+      prepared->srgbImages[upload.imageId], options.mipGenerator, staging);
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(staging.front())});
+    finishTexture(upload);
+    break;
+  }
+  case StepKind::TextureLevel:
+  {
+    auto &upload = textureUploads[step.uploadId];
+    const auto &texture = *prepared->textures[upload.imageId];
+
+    if (step.level + 1 == texture.levels.size())
+    {
+      const auto &base = texture.levels[upload.firstLevel];
+      auto createInfo = etna::ImageCreateInfo::image2D(base.width, base.height, texture.format);
+      createInfo.mipLevels = uint32_t(texture.levels.size()) - upload.firstLevel;
+      upload.image = etna::get_context().createImage(std::move(createInfo));
+    }
+
+    auto staging = createStaging(texture.getLevelData(step.level));
+    auto region = get_copy_regions(texture, upload.firstLevel)[step.level - upload.firstLevel];
+    region.bufferOffset = 0;
+    cmd.copyBufferToImage(staging, upload.image, vk::ImageLayout::eTransferDstOptimal, {region});
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(staging)});
+
+    if (step.level == upload.firstLevel)
+      finishTexture(upload);
+    break;
+  }
+  case StepKind::HandOut:
+    break;
+  }
+  return step.size;
+}
+
+void AsyncSceneLoader::finishTexture(TextureUpload &upload)
+{
+  // after hand out the placeholder may still be used by frames in flight
+  retired.push_back(Retired {
+    .frame = frameIndex,
+    .image = std::exchange(target->images[upload.imageId], std::move(upload.image))
+  });
+
+  if (!upload.last)
+    return;
+
+  auto &texture = prepared->textures[upload.imageId];
+  if (is_texture_streamed(*texture, options))
+    target->streamSources[upload.imageId] = std::move(texture);
+  texture.reset();
+}
+
+} // namespace scene
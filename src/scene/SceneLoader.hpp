@@ -0,0 +1,131 @@
+#ifndef SCENE_SCENE_LOADER_HPP_INCLUDED
+#define SCENE_SCENE_LOADER_HPP_INCLUDED
+
+#include "GLTFScene.hpp"
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+
+namespace scene
+{
+
+struct AsyncSceneLoaderConfig
+{
+  float uploadBudgetMs = 2.f; // CPU time spent recording uploads per frame
+  uint64_t uploadBytesPerFrame = 32ull << 20; // staging filled per frame
+  // If not zero, textures that are not streamed are first uploaded from the level that fits this size,
+  // the scene is handed out then and full chains follow. Streamed textures always start from their tail.
+  uint32_t placeholderSize = 64;
+};
+
+// Loads a scene while frames keep rendering.
+//  - prepare_scene runs on a worker thread: parsing, geometry conversion, texture decoding and encoding.
+//  - GPU resources are then created and filled from update() in steps recorded into the frame command
+//    buffer, a step is a buffer chunk or a texture level. Steps stop once the per-frame time or byte
+//    budget is spent, at least one step is taken per frame.
+//  - The scene is returned from update() once it can be rendered, callers swap it in as a whole.
+struct AsyncSceneLoader
+{
+  enum class State
+  {
+    Preparing, // worker thread
+    Uploading, // before the scene is handed out
+    Refining, // placeholders of the handed out scene are being replaced
+    Done
+  };
+
+  AsyncSceneLoader(const std::string &path, const SceneLoadOptions &options,
+    const AsyncSceneLoaderConfig &loader_config = {});
+
+  // Waits for preparation, it can not be cancelled. While refining, the loader must be destroyed
+  // before the scene it returned.
+  ~AsyncSceneLoader();
+
+  AsyncSceneLoader(const AsyncSceneLoader &) = delete;
+  AsyncSceneLoader &operator=(const AsyncSceneLoader &) = delete;
+
+  // Records the next upload steps into cmd. Returns the scene once, when it is ready to be rendered.
+  std::unique_ptr<GLTFScene> update(etna::SyncCommandBuffer &cmd);
+
+  State getState() const { return state; }
+  const std::string &getPath() const { return path; }
+
+  // true once nothing recorded by the loader is in flight, it may be destroyed without a wait
+  bool isFinished() const { return state == State::Done && retired.empty(); }
+
+  float getProgress() const { return totalBytes ? float(double(uploadedBytes) / double(totalBytes)) : 0.f; }
+  double getLastUploadMs() const { return lastUploadMs; }
+  double getMaxUploadMs() const { return maxUploadMs; }
+
+private:
+  enum class StepKind
+  {
+    Vertices,
+    Indices,
+    TextureWhole, // single level with GPU mips, see upload_texture
+    TextureLevel,
+    HandOut
+  };
+
+  struct Step
+  {
+    StepKind kind;
+    uint32_t uploadId = 0; // TextureWhole, TextureLevel
+    uint32_t level = 0; // TextureLevel
+    uint64_t offset = 0; // Vertices, Indices
+    uint64_t size = 0;
+  };
+
+  struct TextureUpload
+  {
+    uint32_t imageId;
+    uint32_t firstLevel;
+    bool last; // no refinement follows, the source is released or handed to TextureStreamer
+    etna::Image image;
+  };
+
+  struct Retired
+  {
+    uint64_t frame;
+    etna::Buffer staging;
+    etna::Image image;
+  };
+
+  void createScene(etna::SyncCommandBuffer &cmd);
+  void planSteps();
+  void addTextureUpload(uint32_t image_id, uint32_t first_level, bool last);
+  uint64_t runStep(etna::SyncCommandBuffer &cmd, const Step &step);
+  void finishTexture(TextureUpload &upload);
+  etna::Buffer createStaging(std::span<const uint8_t> bytes);
+
+  std::string path;
+  SceneLoadOptions options;
+  AsyncSceneLoaderConfig config;
+
+  State state = State::Preparing;
+  std::future<std::unique_ptr<PreparedScene>> preparing;
+  std::chrono::steady_clock::time_point startTime;
+
+  std::unique_ptr<PreparedScene> prepared;
+  std::unique_ptr<GLTFScene> scene; // until handed out
+  GLTFScene *target = nullptr; // the scene being filled, also after it is handed out
+
+  std::vector<Step> steps;
+  size_t nextStep = 0;
+  std::vector<TextureUpload> textureUploads;
+
+  std::deque<Retired> retired;
+  uint64_t frameIndex = 0;
+
+  uint64_t totalBytes = 0;
+  uint64_t uploadedBytes = 0;
+  uint32_t uploadFrames = 0;
+  double lastUploadMs = 0.0;
+  double maxUploadMs = 0.0;
+};
+
+} // namespace scene
+
+#endif
@@ -1,4 +1,5 @@
 #include "SceneRenderer.hpp"
+#include "VirtualTextures.hpp"
 
 #include <etna/GlobalContext.hpp>
 
@@ -132,19 +133,17 @@ RenderTargetState::RenderTargetState(uint32_t w, uint32_t h)
 
 void RenderTargetState::onResolutionChanged(uint32_t new_w, uint32_t new_h)
 {
-  for (uint32_t i = 0; i < 2; i++)
+  for (auto &frame : frames)
   {
-    depth[i] = etna::get_context().createImage(
-    etna::ImageCreateInfo::depthRT(new_w, new_h, vk::Format::eD24UnormS8Uint));
-    color[i] = etna::get_context().createImage(
+    frame.depth = etna::get_context().createImage(
+      etna::ImageCreateInfo::depthRT(new_w, new_h, vk::Format::eD24UnormS8Uint));
+    frame.color = etna::get_context().createImage(
       etna::ImageCreateInfo::colorRT(new_w, new_h, baseColorFmt));
-  }
-
-  currentColor = etna::get_context().createImage(
+    frame.currentColor = etna::get_context().createImage(
       etna::ImageCreateInfo::colorRT(new_w, new_h, baseColorFmt));
-
-  velocity = etna::get_context().createImage(
-    etna::ImageCreateInfo::colorRT(new_w, new_h, vk::Format::eR16G16Sfloat));  
+    frame.velocity = etna::get_context().createImage(
+      etna::ImageCreateInfo::colorRT(new_w, new_h, vk::Format::eR16G16Sfloat));
+  }
 }
 
 SceneRenderer::SceneRenderer(const std::string &prog_name,
@@ -184,8 +183,9 @@ SceneRenderer::SceneRenderer(const std::string &prog_name,
   depthPipeline = etna::get_context().getPipelineManager().createGraphicsPipeline(depth_prog_name, info);
 }
 
-void SceneRenderer::attachToScene(const GLTFScene &scene)
+void SceneRenderer::attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt)
 {
+  virtualTextures = &vt;
   sceneData = scene.queryDrawCalls([](const GLTFScene::Material &material) {
     return material.mode == GLTFScene::MaterialMode::Opaque;
   }); 
@@ -212,22 +212,25 @@ static float castUint32ToFloat(uint32_t i)
   return *reinterpret_cast<const float*>(&i);
 }
 
-uint32_t SceneRenderer::bindDS(
+MaterialBindState SceneRenderer::bindDS(
   etna::SyncCommandBuffer &cmd, 
   const GlobalFrameConstantHandler &gframe,
   const GLTFScene::Material &material, 
   const GLTFScene &scene)
 {
-  uint32_t renderFlags = 0;
+  MaterialBindState state;
   
   auto [baseColorTex, baseColorSampler] = get_image_texture(scene, material.baseColorId);
   auto [mrTex, mrSampler] = get_image_texture(scene, material.metallicRoughnessId);
 
   if (!material.baseColorId.has_value())
-    renderFlags |= uint32_t(RenderFlags::NoBaseColorTex);
+    state.renderFlags |= uint32_t(RenderFlags::NoBaseColorTex);
 
   if (!material.metallicRoughnessId.has_value())
-    renderFlags |= uint32_t(RenderFlags::NoMetallicRougnessTex);
+    state.renderFlags |= uint32_t(RenderFlags::NoMetallicRougnessTex);
+
+  if (material.packedMetallicRoughness)
+    state.renderFlags |= uint32_t(RenderFlags::PackedMetallicRoughness);
 
   auto baseColorBinding = baseColorTex->genBinding(
       baseColorSampler, vk::ImageLayout::eShaderReadOnlyOptimal, baseColorTex->fullRangeView());
@@ -241,11 +244,14 @@ uint32_t SceneRenderer::bindDS(
     etna::Binding {2, mrBinding}
   };
 
+  state.vtBaseColor = virtualTextures->bindTexture(bindings, 5, material.baseColorId);
+  state.vtMetallicRoughness = virtualTextures->bindTexture(bindings, 7, material.metallicRoughnessId);
+
   const auto &info = etna::get_shader_program(pipeline.getShaderProgram()); 
   auto set = etna::create_descriptor_set(info.getDescriptorLayoutId(0), bindings);
   cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, info.getPipelineLayout(), 0, set);
 
-  return renderFlags;
+  return state;
 }
 
 struct DepthPushConstants
@@ -292,7 +298,7 @@ void SceneRenderer::render(etna::SyncCommandBuffer &cmd,
   for (auto &group : sceneData.materialGropus)
   {
     auto &material = scene.getMaterial(group.materialIndex);
-    auto renderFlags = bindDS(cmd, gframe, material, scene);
+    auto bindState = bindDS(cmd, gframe, material, scene);
     
     for (auto &dc : group.drawCalls)
     {
@@ -312,7 +318,9 @@ void SceneRenderer::render(etna::SyncCommandBuffer &cmd,
           .metallic = material.metallicFactor,
           .rougness = material.roughnessFactor,
           .alphaCutoff = material.alphaCutoff,
-          .renderFlags = renderFlags
+          .renderFlags = bindState.renderFlags,
+          .vtBaseColor = bindState.vtBaseColor,
+          .vtMetallicRoughness = bindState.vtMetallicRoughness
         };
 
         cmd.pushConstants(pipeline.getShaderProgram(), 0, mpc);
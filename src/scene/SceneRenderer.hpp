@@ -4,10 +4,12 @@
 #include <etna/Etna.hpp>
 #include <array>
 #include "GLTFScene.hpp"
+#include "renderer/FrameRing.hpp"
 
 namespace scene
 {
 
+struct VirtualTextureSystem;
 
 struct GlobalFrameConstants
 {
@@ -84,7 +86,8 @@ private:
 enum class RenderFlags : uint32_t
 {
   NoBaseColorTex = 1,
-  NoMetallicRougnessTex = 2
+  NoMetallicRougnessTex = 2,
+  PackedMetallicRoughness = 4 // roughness in R, metallic in G, see SceneLoadOptions::repackMaterialTextures
 };
 
 struct RenderTargetInfo
@@ -93,34 +96,41 @@ struct RenderTargetInfo
   vk::Format depthRT;
 };
 
+// Render targets of a frame, one set per frame in flight. The previous frame's depth and TAA target are
+// read as history, so the ring has an extra slot and the next frame never writes them.
 struct RenderTargetState
 {
   RenderTargetState(uint32_t w, uint32_t h);
 
   void onResolutionChanged(uint32_t new_w, uint32_t new_h);
 
-  const etna::Image &getDepth() const { return depth[historyIndex]; }
-  const etna::Image &getColor() const { return currentColor; }
-  const etna::Image &getVelocity() const { return velocity; }
-  const etna::Image &getTAATarget() const {return color[historyIndex]; }
+  const etna::Image &getDepth() const { return frames.get().depth; }
+  const etna::Image &getColor() const { return frames.get().currentColor; }
+  const etna::Image &getVelocity() const { return frames.get().velocity; }
+  const etna::Image &getTAATarget() const {return frames.get().color; }
 
-  const etna::Image &getDepthHistory() const { return depth[(historyIndex + 1) % 2]; }
-  const etna::Image &getColorHistory() const { return color[(historyIndex + 1) % 2]; }
+  const etna::Image &getDepthHistory() const { return frames.previous().depth; }
+  const etna::Image &getColorHistory() const { return frames.previous().color; }
 
-  vk::Format getDepthFmt() const { return depth[historyIndex].getInfo().format; }
-  vk::Format getColorFmt() const { return color[historyIndex].getInfo().format; }
-  vk::Format getVelocityFmt() const { return velocity.getInfo().format; }
+  vk::Format getDepthFmt() const { return getDepth().getInfo().format; }
+  vk::Format getColorFmt() const { return getTAATarget().getInfo().format; }
+  vk::Format getVelocityFmt() const { return getVelocity().getInfo().format; }
 
   static constexpr vk::Format baseColorFmt = vk::Format::eR16G16B16A16Sfloat;
 
-  void nextFrame() { historyIndex = (historyIndex + 1) % 2; }
+  // moves to the targets of a new frame, the current ones become history
+  void nextFrame() { frames.next(); }
   
 private:
-  uint32_t historyIndex = 0;
-  std::array<etna::Image, 2> depth;
-  std::array<etna::Image, 2> color;
-  etna::Image velocity;
-  etna::Image currentColor;
+  struct Frame
+  {
+    etna::Image depth;
+    etna::Image color; // TAA target
+    etna::Image velocity;
+    etna::Image currentColor;
+  };
+
+  renderer::FrameRing<Frame> frames {1};
 };
 
 struct MaterialPushConstants
@@ -133,10 +143,20 @@ struct MaterialPushConstants
   float rougness;
   float alphaCutoff;
   uint32_t renderFlags;
+  glm::uvec4 vtBaseColor; // see VT.glsl
+  glm::uvec4 vtMetallicRoughness;
 };
 
 static_assert(sizeof(MaterialPushConstants) <= 256);
 
+// per material values written by bindDS of the scene renderers
+struct MaterialBindState
+{
+  uint32_t renderFlags = 0;
+  glm::uvec4 vtBaseColor {0};
+  glm::uvec4 vtMetallicRoughness {0};
+};
+
 //base layout
 
 struct SceneRenderer
@@ -145,7 +165,7 @@ struct SceneRenderer
     const std::string &depth_prog_name,
     const RenderTargetInfo &rtInfo);
 
-  void attachToScene(const GLTFScene &scene);
+  void attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt);
   
   void depthPrepass(etna::SyncCommandBuffer &cmd, 
     const GlobalFrameConstantHandler &gframe, const GLTFScene &scene);
@@ -155,7 +175,7 @@ struct SceneRenderer
 
 private:
 
-  uint32_t bindDS(etna::SyncCommandBuffer &cmd, 
+  MaterialBindState bindDS(etna::SyncCommandBuffer &cmd, 
     const GlobalFrameConstantHandler &gframe,
     const GLTFScene::Material &material, 
     const GLTFScene &scene);
@@ -164,6 +184,7 @@ private:
   etna::GraphicsPipeline depthPipeline;
   etna::GraphicsPipeline pipeline;
   SortedScene sceneData;
+  const VirtualTextureSystem *virtualTextures = nullptr;
 };
 
 
@@ -0,0 +1,87 @@
+#include "TextureCache.hpp"
+#include "KTX2.hpp"
+#include "util/Hash.hpp"
+
+#include <etna/Etna.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+namespace scene
+{
+
+// bump when encoders or mip filters change to invalidate old entries
+static constexpr uint64_t TEXTURE_CACHE_VERSION = 1;
+
+TextureCache::TextureCache(std::filesystem::path cache_dir)
+  : dir {std::move(cache_dir)}
+{
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec)
+    spdlog::warn("Texture cache : failed to create {} : {}", dir.string(), ec.message());
+}
+
+uint64_t TextureCache::makeKey(std::span<const uint8_t> source, uint64_t settings_hash)
+{
+  return util::hash_combine(util::hash_bytes(source, TEXTURE_CACHE_VERSION), settings_hash);
+}
+
+std::filesystem::path TextureCache::getPath(uint64_t key) const
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.ktx2", (unsigned long long)key);
+  return dir / name;
+}
+
+std::optional<TextureData> TextureCache::load(uint64_t key)
+{
+  auto file = MappedFile::open(getPath(key).string());
+  if (!file)
+  {
+    misses++;
+    return std::nullopt;
+  }
+
+  std::string err;
+  auto texture = read_ktx2(std::move(*file), err);
+  if (!texture)
+  {
+    spdlog::warn("Texture cache : ignoring {} : {}", getPath(key).string(), err);
+    misses++;
+    return std::nullopt;
+  }
+
+  hits++;
+  return texture;
+}
+
+void TextureCache::store(uint64_t key, const TextureData &texture)
+{
+  auto path = getPath(key);
+  auto bytes = write_ktx2(texture);
+
+  // write then rename, concurrent loaders never see a partial file
+  auto tmpPath = path;
+  tmpPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!out)
+    {
+      spdlog::warn("Texture cache : failed to write {}", tmpPath.string());
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec)
+  {
+    spdlog::warn("Texture cache : failed to store {} : {}", path.string(), ec.message());
+    std::filesystem::remove(tmpPath, ec);
+  }
+}
+
+} // namespace scene
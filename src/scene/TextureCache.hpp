@@ -0,0 +1,39 @@
+#ifndef SCENE_TEXTURE_CACHE_HPP_INCLUDED
+#define SCENE_TEXTURE_CACHE_HPP_INCLUDED
+
+#include "TextureData.hpp"
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <filesystem>
+
+namespace scene
+{
+
+// On-disk cache of fully mipped (and possibly block compressed) textures, stored as KTX2 files
+// named after a hash of the source image bytes and the import settings.
+struct TextureCache
+{
+  explicit TextureCache(std::filesystem::path dir);
+
+  static uint64_t makeKey(std::span<const uint8_t> source, uint64_t settings_hash);
+
+  // levels of a hit point into the mapped cache file
+  std::optional<TextureData> load(uint64_t key);
+  void store(uint64_t key, const TextureData &texture);
+
+  uint32_t getHits() const { return hits; }
+  uint32_t getMisses() const { return misses; }
+
+private:
+  std::filesystem::path getPath(uint64_t key) const;
+
+  std::filesystem::path dir;
+  std::atomic<uint32_t> hits = 0;
+  std::atomic<uint32_t> misses = 0;
+};
+
+} // namespace scene
+
+#endif
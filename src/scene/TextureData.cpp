@@ -0,0 +1,45 @@
+#include "TextureData.hpp"
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace scene
+{
+
+size_t get_level_size(vk::Format format, uint32_t width, uint32_t height)
+{
+  auto extent = vk::blockExtent(format);
+  size_t blocksX = (width + extent[0] - 1) / extent[0];
+  size_t blocksY = (height + extent[1] - 1) / extent[1];
+  return blocksX * blocksY * vk::blockSize(format);
+}
+
+uint32_t get_mip_levels_count(uint32_t width, uint32_t height)
+{
+  return std::bit_width(std::max(std::max(width, height), 1u));
+}
+
+std::vector<vk::BufferImageCopy> get_copy_regions(const TextureData &texture, uint32_t first_level)
+{
+  size_t base = texture.getLevelsRange(first_level).first;
+
+  std::vector<vk::BufferImageCopy> regions;
+  regions.reserve(texture.levels.size() - first_level);
+  for (uint32_t level = first_level; level < texture.levels.size(); level++)
+  {
+    const auto &src = texture.levels[level];
+    regions.push_back(vk::BufferImageCopy {
+      .bufferOffset = src.offset - base,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource {vk::ImageAspectFlagBits::eColor, level - first_level, 0, 1},
+      .imageOffset {0, 0, 0},
+      .imageExtent {src.width, src.height, 1}
+    });
+  }
+  return regions;
+}
+
+} // namespace scene
@@ -0,0 +1,81 @@
+#ifndef SCENE_TEXTURE_DATA_HPP_INCLUDED
+#define SCENE_TEXTURE_DATA_HPP_INCLUDED
+
+#include <vulkan/vulkan.hpp>
+
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <utility>
+
+namespace scene
+{
+
+// CPU side texture payload, ready to be copied to a staging buffer as is
+struct TextureData
+{
+  struct Level
+  {
+    size_t offset; // in bytes, multiple of the format block size
+    size_t size;
+    uint32_t width;
+    uint32_t height;
+  };
+
+  vk::Format format = vk::Format::eUndefined;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  std::vector<Level> levels; // levels[0] is the full resolution image
+  std::vector<uint8_t> bytes;
+  MappedFile mapping; // used instead of bytes when levels point into a mapped file
+
+  std::span<const uint8_t> getBytes() const
+  {
+    return bytes.empty() ? mapping.getData() : std::span<const uint8_t>{bytes};
+  }
+
+  std::span<const uint8_t> getLevelData(uint32_t level) const 
+  { 
+    return getBytes().subspan(levels[level].offset, levels[level].size); 
+  }
+
+  // bytes of levels [first_level, levels.size())
+  size_t getPayloadSize(uint32_t first_level = 0) const
+  {
+    size_t size = 0;
+    for (uint32_t level = first_level; level < levels.size(); level++)
+      size += levels[level].size;
+    return size;
+  }
+
+  // smallest byte range [begin, end) holding levels [first_level, levels.size()),
+  // KTX2 files store the smallest levels first so a mip tail is contiguous
+  std::pair<size_t, size_t> getLevelsRange(uint32_t first_level) const
+  {
+    size_t begin = SIZE_MAX;
+    size_t end = 0;
+    for (uint32_t level = first_level; level < levels.size(); level++)
+    {
+      begin = std::min(begin, levels[level].offset);
+      end = std::max(end, levels[level].offset + levels[level].size);
+    }
+    return {std::min(begin, end), end};
+  }
+};
+
+// bytes of a width x height image of a (possibly block compressed) format
+size_t get_level_size(vk::Format format, uint32_t width, uint32_t height);
+
+uint32_t get_mip_levels_count(uint32_t width, uint32_t height);
+
+// Copies of levels [first_level, levels.size()) to mips [0, levels.size() - first_level) of an image,
+// buffer offsets are relative to the start of getLevelsRange(first_level)
+std::vector<vk::BufferImageCopy> get_copy_regions(const TextureData &texture, uint32_t first_level);
+
+} // namespace scene
+
+#endif
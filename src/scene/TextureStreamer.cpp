@@ -0,0 +1,288 @@
+#include "TextureStreamer.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace scene
+{
+
+uint32_t get_stream_tail_level(const TextureData &texture, uint32_t max_size)
+{
+  for (uint32_t level = 0; level < texture.levels.size(); level++)
+  {
+    if (std::max(texture.levels[level].width, texture.levels[level].height) <= max_size)
+      return level;
+  }
+  return uint32_t(texture.levels.size()) - 1;
+}
+
+TextureStreamer::TextureStreamer(GLTFScene &streamed_scene, const TextureStreamerConfig &streamer_config)
+  : scene {streamed_scene}, config {streamer_config}
+{
+  states.resize(scene.streamSources.size());
+  for (uint32_t imageId = 0; imageId < states.size(); imageId++)
+  {
+    if (!scene.streamSources[imageId].has_value())
+      continue;
+
+    const auto &src = *scene.streamSources[imageId];
+    uint32_t firstLevel = uint32_t(src.levels.size()) - scene.images[imageId].getInfo().mipLevels;
+
+    auto &state = states[imageId];
+    state.tailLevel = firstLevel;
+    state.residentLevel = firstLevel;
+    state.targetLevel = firstLevel;
+    state.desiredLevel = firstLevel;
+
+    residentBytes += getResidentSize(imageId, firstLevel);
+    streamedCount++;
+  }
+
+  spdlog::info("Texture streaming : {} textures, {} MiB of mip tails resident, budget {} MiB",
+    streamedCount, residentBytes >> 20, config.budgetBytes >> 20);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  // upload jobs write into staging memory owned by this object
+  for (auto &job : jobs)
+  {
+    while (!job->ready.load(std::memory_order_acquire))
+      std::this_thread::yield();
+    job->staging.unmap();
+  }
+  etna::get_context().getQueue().waitIdle();
+}
+
+uint64_t TextureStreamer::getResidentSize(uint32_t image_id, uint32_t first_level) const
+{
+  return scene.streamSources[image_id]->getPayloadSize(first_level);
+}
+
+void TextureStreamer::update(etna::SyncCommandBuffer &cmd, const GlobalFrameConstants &frame)
+{
+  frameIndex++;
+
+  // images and staging buffers retired this many frames ago are no longer used by the GPU
+  uint32_t framesInFlight = etna::get_context().getNumFramesInFlight();
+  while (!retired.empty() && retired.front().frame + framesInFlight <= frameIndex)
+    retired.pop_front();
+
+  if (streamedCount == 0)
+    return;
+
+  finishJobs(cmd);
+  estimateLevels(frame);
+  schedule();
+}
+
+void TextureStreamer::estimateLevels(const GlobalFrameConstants &frame)
+{
+  for (auto &state : states)
+    state.desiredLevel = state.tailLevel;
+
+  float tanY = frame.projectionParams.x;
+  float tanX = tanY * frame.projectionParams.y;
+  float znear = frame.projectionParams.z;
+  float planeScaleX = std::sqrt(1.f + tanX * tanX);
+  float planeScaleY = std::sqrt(1.f + tanY * tanY);
+
+  auto request = [&](std::optional<uint32_t> tex_id, float pixels) {
+    if (!tex_id.has_value())
+      return;
+
+    auto [imageId, samplerId] = scene.getImageSamplerId(*tex_id);
+    if (imageId >= states.size() || !scene.streamSources[imageId].has_value())
+      return;
+
+    auto &state = states[imageId];
+    const auto &src = *scene.streamSources[imageId];
+    float level = std::log2(float(std::max(src.width, src.height)) / std::max(pixels, 1.f)) + config.lodBias;
+    level = std::clamp(std::floor(level), 0.f, float(state.tailLevel));
+
+    state.desiredLevel = std::min(state.desiredLevel, uint32_t(level));
+    state.lastUsedFrame = frameIndex;
+  };
+
+  scene.traverseNodes([&](const glm::mat4 &transform, const GLTFScene::Mesh::DrawCall &dc,
+    const GLTFScene::Material &material) {
+    float scale = std::max({
+      glm::length(glm::vec3(transform[0])),
+      glm::length(glm::vec3(transform[1])),
+      glm::length(glm::vec3(transform[2]))
+    });
+    float radius = 0.5f * glm::length(dc.boundsMax - dc.boundsMin) * scale;
+    glm::vec3 center = 0.5f * (dc.boundsMin + dc.boundsMax);
+    glm::vec3 viewPos = glm::vec3(frame.view * transform * glm::vec4(center, 1.f));
+    float depth = -viewPos.z;
+
+    // bounding sphere against the near and the side planes
+    if (depth + radius < znear)
+      return;
+    if (std::abs(viewPos.x) - tanX * depth > radius * planeScaleX)
+      return;
+    if (std::abs(viewPos.y) - tanY * depth > radius * planeScaleY)
+      return;
+
+    // projected diameter in pixels, texture coordinates are assumed to span the bounds once
+    float dist = std::max(depth - radius, znear);
+    float pixels = radius * frame.viewport.y / (dist * tanY);
+
+    request(material.baseColorId, pixels);
+    request(material.metallicRoughnessId, pixels);
+    request(material.normalTexId, pixels);
+    request(material.occlusionTexId, pixels);
+  });
+}
+
+void TextureStreamer::schedule()
+{
+  stagedBytes = 0;
+
+  // the budget may have been lowered
+  if (residentBytes > config.budgetBytes)
+    evictFor(residentBytes - config.budgetBytes, UINT32_MAX);
+
+  std::vector<uint32_t> requests;
+  for (uint32_t imageId = 0; imageId < states.size(); imageId++)
+  {
+    const auto &state = states[imageId];
+    if (scene.streamSources[imageId].has_value() && !state.pending && state.desiredLevel < state.residentLevel)
+      requests.push_back(imageId);
+  }
+
+  // largest quality deficit first
+  std::sort(requests.begin(), requests.end(), [&](uint32_t a, uint32_t b) {
+    return states[a].residentLevel - states[a].desiredLevel > states[b].residentLevel - states[b].desiredLevel;
+  });
+
+  for (auto imageId : requests)
+  {
+    if (stagedBytes >= config.uploadBytesPerFrame)
+      break;
+
+    auto &state = states[imageId];
+    uint64_t current = getResidentSize(imageId, state.residentLevel);
+
+    // stream as much of the desired range as the budget allows after evictions
+    uint32_t target = state.desiredLevel;
+    for (; target < state.residentLevel; target++)
+    {
+      uint64_t required = residentBytes - current + getResidentSize(imageId, target);
+      if (required <= config.budgetBytes || evictFor(required - config.budgetBytes, imageId))
+        break;
+    }
+
+    if (target < state.residentLevel)
+      submitJob(imageId, target);
+  }
+}
+
+bool TextureStreamer::evictFor(uint64_t bytes, uint32_t requester)
+{
+  uint64_t freed = 0;
+  while (freed < bytes)
+  {
+    // least recently used texture holding more than it needs, visible textures keep their desired level
+    uint32_t victim = UINT32_MAX;
+    uint32_t victimLevel = 0;
+    for (uint32_t imageId = 0; imageId < states.size(); imageId++)
+    {
+      const auto &state = states[imageId];
+      if (!scene.streamSources[imageId].has_value() || state.pending || imageId == requester)
+        continue;
+
+      uint32_t keepLevel = state.lastUsedFrame == frameIndex ? state.desiredLevel : state.tailLevel;
+      if (state.residentLevel >= keepLevel)
+        continue;
+
+      if (victim == UINT32_MAX || state.lastUsedFrame < states[victim].lastUsedFrame)
+      {
+        victim = imageId;
+        victimLevel = keepLevel;
+      }
+    }
+
+    if (victim == UINT32_MAX)
+      return false;
+
+    freed += getResidentSize(victim, states[victim].residentLevel) - getResidentSize(victim, victimLevel);
+    submitJob(victim, victimLevel);
+  }
+  return true;
+}
+
+void TextureStreamer::submitJob(uint32_t image_id, uint32_t first_level)
+{
+  const auto &src = *scene.streamSources[image_id];
+  auto [begin, end] = src.getLevelsRange(first_level);
+  auto bytes = src.getBytes().subspan(begin, end - begin);
+
+  auto job = std::make_unique<UploadJob>();
+  job->imageId = image_id;
+  job->firstLevel = first_level;
+  job->staging = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = bytes.size(),
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+  });
+
+  auto &state = states[image_id];
+  residentBytes = residentBytes - getResidentSize(image_id, state.targetLevel) + getResidentSize(image_id, first_level);
+  state.targetLevel = first_level;
+  state.pending = true;
+  stagedBytes += bytes.size();
+
+  // the copy reads the mapped cache file, page faults stay off the render thread
+  util::get_thread_pool().submit([job = job.get(), dst = job->staging.map(), bytes]() {
+    std::memcpy(dst, bytes.data(), bytes.size());
+    job->ready.store(true, std::memory_order_release);
+  });
+
+  jobs.push_back(std::move(job));
+}
+
+void TextureStreamer::finishJobs(etna::SyncCommandBuffer &cmd)
+{
+  for (auto it = jobs.begin(); it != jobs.end();)
+  {
+    auto &job = **it;
+    if (!job.ready.load(std::memory_order_acquire))
+    {
+      it++;
+      continue;
+    }
+
+    job.staging.unmap();
+
+    const auto &src = *scene.streamSources[job.imageId];
+    const auto &base = src.levels[job.firstLevel];
+    auto createInfo = etna::ImageCreateInfo::image2D(base.width, base.height, src.format);
+    createInfo.mipLevels = uint32_t(src.levels.size()) - job.firstLevel;
+    auto image = etna::get_context().createImage(std::move(createInfo));
+
+    cmd.copyBufferToImage(job.staging, image, vk::ImageLayout::eTransferDstOptimal, 
+      get_copy_regions(src, job.firstLevel));
+
+    // the old image may still be used by frames in flight
+    retired.push_back(Retired {
+      .frame = frameIndex,
+      .image = std::exchange(scene.images[job.imageId], std::move(image)),
+      .staging = std::move(job.staging)
+    });
+
+    auto &state = states[job.imageId];
+    state.residentLevel = job.firstLevel;
+    state.pending = false;
+
+    it = jobs.erase(it);
+  }
+}
+
+} // namespace scene
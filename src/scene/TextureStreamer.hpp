@@ -0,0 +1,95 @@
+#ifndef SCENE_TEXTURE_STREAMER_HPP_INCLUDED
+#define SCENE_TEXTURE_STREAMER_HPP_INCLUDED
+
+#include "GLTFScene.hpp"
+#include "SceneRenderer.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+namespace scene
+{
+
+struct TextureStreamerConfig
+{
+  uint64_t budgetBytes = 256ull << 20; // VRAM for the mip chains of streamed textures
+  uint64_t uploadBytesPerFrame = 16ull << 20; // staging handed to upload jobs per frame
+  float lodBias = 0.f; // added to the estimated level, positive values stream less
+};
+
+// Streams the high mips of textures loaded with SceneLoadOptions::streamTextures.
+// The desired level of every texture is estimated on the CPU from the screen size of the draw calls
+// using it, textures not seen for a while are shrunk back to their mip tail in LRU order when the
+// budget is exceeded. Staging buffers are filled by upload jobs on the loader pool, images with
+// the new resident range are created and swapped in once a job is done.
+struct TextureStreamer
+{
+  TextureStreamer(GLTFScene &streamed_scene, const TextureStreamerConfig &streamer_config = {});
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // Call before any scene texture is bound in this frame
+  void update(etna::SyncCommandBuffer &cmd, const GlobalFrameConstants &frame);
+
+  void setConfig(const TextureStreamerConfig &new_config) { config = new_config; }
+  const TextureStreamerConfig &getConfig() const { return config; }
+
+  uint64_t getResidentBytes() const { return residentBytes; }
+  uint32_t getPendingUploads() const { return uint32_t(jobs.size()); }
+  uint32_t getStreamedTextures() const { return streamedCount; }
+
+private:
+  struct TextureState
+  {
+    uint32_t tailLevel = 0; // always resident
+    uint32_t residentLevel = 0; // first level of the current image
+    uint32_t targetLevel = 0; // residentLevel once the pending job is done
+    uint32_t desiredLevel = 0;
+    uint64_t lastUsedFrame = 0;
+    bool pending = false;
+  };
+
+  struct UploadJob
+  {
+    uint32_t imageId;
+    uint32_t firstLevel;
+    etna::Buffer staging;
+    std::atomic<bool> ready = false;
+  };
+
+  struct Retired
+  {
+    uint64_t frame;
+    etna::Image image;
+    etna::Buffer staging;
+  };
+
+  void estimateLevels(const GlobalFrameConstants &frame);
+  void schedule();
+  bool evictFor(uint64_t bytes, uint32_t requester);
+  void submitJob(uint32_t image_id, uint32_t first_level);
+  void finishJobs(etna::SyncCommandBuffer &cmd);
+  uint64_t getResidentSize(uint32_t image_id, uint32_t first_level) const;
+
+  GLTFScene &scene;
+  TextureStreamerConfig config;
+
+  std::vector<TextureState> states;
+  uint32_t streamedCount = 0;
+  uint64_t residentBytes = 0; // counts pending targets
+  uint64_t stagedBytes = 0; // this frame
+
+  std::deque<std::unique_ptr<UploadJob>> jobs;
+  std::deque<Retired> retired;
+  uint64_t frameIndex = 0;
+};
+
+// first level not larger than max_size texels on either side, the mip tail start
+uint32_t get_stream_tail_level(const TextureData &texture, uint32_t max_size);
+
+} // namespace scene
+
+#endif
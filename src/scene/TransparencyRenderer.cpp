@@ -0,0 +1,1215 @@
+#include "TransparencyRenderer.hpp"
+#include "VirtualTextures.hpp"
+#include "renderer/IndirectCommands.hpp"
+
+#include <etna/GlobalContext.hpp>
+#include <etna/RenderTargetStates.hpp>
+
+#include <algorithm>
+
+namespace scene
+{
+
+// of a new sample in the moving average of GPU times
+static constexpr double STATS_AVERAGE_WEIGHT = 0.05;
+
+static const vk::PipelineColorBlendAttachmentState ADDITIVE_BLEND {
+  .blendEnable = VK_TRUE,
+  .srcColorBlendFactor = vk::BlendFactor::eOne,
+  .dstColorBlendFactor = vk::BlendFactor::eOne,
+  .colorBlendOp = vk::BlendOp::eAdd,
+  .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+  .dstAlphaBlendFactor = vk::BlendFactor::eOne,
+  .alphaBlendOp = vk::BlendOp::eAdd,
+  .colorWriteMask = vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA
+};
+
+// revealage is the product of 1 - alpha over all fragments
+static const vk::PipelineColorBlendAttachmentState REVEALAGE_BLEND {
+  .blendEnable = VK_TRUE,
+  .srcColorBlendFactor = vk::BlendFactor::eZero,
+  .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcColor,
+  .colorBlendOp = vk::BlendOp::eAdd,
+  .srcAlphaBlendFactor = vk::BlendFactor::eZero,
+  .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+  .alphaBlendOp = vk::BlendOp::eAdd,
+  .colorWriteMask = vk::ColorComponentFlagBits::eR
+};
+
+// premultiplied color over the target in draw order
+static const vk::PipelineColorBlendAttachmentState PREMULTIPLIED_OVER_BLEND {
+  .blendEnable = VK_TRUE,
+  .srcColorBlendFactor = vk::BlendFactor::eOne,
+  .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+  .colorBlendOp = vk::BlendOp::eAdd,
+  .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+  .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+  .alphaBlendOp = vk::BlendOp::eAdd,
+  .colorWriteMask = vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA
+};
+
+static constexpr vk::Format ACCUM_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+static constexpr vk::Format REVEALAGE_FORMAT = vk::Format::eR16Sfloat;
+static constexpr vk::Format MOMENTS_FORMAT = vk::Format::eR32G32B32A32Sfloat;
+static constexpr vk::Format ABSORBANCE_FORMAT = vk::Format::eR32Sfloat;
+
+const char *get_transparency_mode_name(TransparencyMode mode)
+{
+  switch (mode)
+  {
+  case TransparencyMode::ABuffer: return "A-buffer";
+  case TransparencyMode::ABufferPrefixSum: return "A-buffer prefix sum";
+  case TransparencyMode::ABufferDeferred: return "A-buffer deferred";
+  case TransparencyMode::WeightedBlended: return "Weighted blended";
+  case TransparencyMode::Moments: return "Moments";
+  case TransparencyMode::KBuffer: return "K-buffer";
+  case TransparencyMode::SortedInstances: return "Sorted instances";
+  }
+  return "";
+}
+
+// depth tested against the opaque depth, transparent geometry writes no depth
+static etna::GraphicsPipeline create_transparent_pipeline(const std::string &prog_name, const etna::Image &depthRT,
+  std::initializer_list<std::tuple<vk::Format, vk::PipelineColorBlendAttachmentState>> outputs)
+{
+  etna::GraphicsPipeline::CreateInfo info {};
+
+  info.vertexShaderInput = scene::Vertex::getDesc();
+  info.fragmentShaderOutput.colorAttachmentFormats.clear();
+  info.fragmentShaderOutput.depthAttachmentFormat = depthRT.getInfo().format;
+  info.blendingConfig.attachments.clear();
+
+  for (auto [format, blendState] : outputs)
+  {
+    info.fragmentShaderOutput.colorAttachmentFormats.push_back(format);
+    info.blendingConfig.attachments.push_back(blendState);
+  }
+
+  info.depthConfig.depthWriteEnable = VK_FALSE;
+  info.depthConfig.depthCompareOp = vk::CompareOp::eLess;
+
+  return etna::get_context().getPipelineManager().createGraphicsPipeline(prog_name, info);
+}
+
+static etna::Image create_oit_target(vk::Format format, uint32_t w, uint32_t h)
+{
+  etna::ImageCreateInfo info {
+    .format = format,
+    .extent {w, h, 1},
+    .imageUsage = vk::ImageUsageFlagBits::eColorAttachment
+      |vk::ImageUsageFlagBits::eStorage
+  };
+  return etna::get_context().createImage(std::move(info));
+}
+
+static etna::RenderingAttachment clear_attachment(const etna::Image &image, vk::ClearColorValue value)
+{
+  return etna::RenderingAttachment {
+    .view = image.getView({}),
+    .layout = vk::ImageLayout::eColorAttachmentOptimal,
+    .loadOp = vk::AttachmentLoadOp::eClear,
+    .clearValue = value
+  };
+}
+
+static etna::RenderingAttachment depth_attachment(const etna::Image &depthRT)
+{
+  return etna::RenderingAttachment {
+    .view = depthRT.getView({}),
+    .layout = vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+    .loadOp = vk::AttachmentLoadOp::eLoad
+  };
+}
+
+static etna::Binding storage_binding(uint32_t binding, const etna::Image &image)
+{
+  return etna::Binding {binding, image.genBinding({}, vk::ImageLayout::eGeneral, image.fullRangeView())};
+}
+
+static vk::Extent2D get_extent(const etna::Image &image)
+{
+  return {image.getInfo().extent.width, image.getInfo().extent.height};
+}
+
+static void dispatch_resolve(etna::SyncCommandBuffer &cmd, const etna::ComputePipeline &pipeline,
+  const std::vector<etna::Binding> &bindings, const etna::Image &target)
+{
+  auto pipelineInfo = etna::get_shader_program(pipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), bindings);
+  cmd.bindPipeline(pipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+
+  auto extent = get_extent(target);
+  cmd.dispatch((extent.width + 7u)/8u, (extent.height + 3u)/4u, 1u);
+}
+
+PrefixSumABufferRenderer::PrefixSumABufferRenderer(const std::string &prog_prefix, const etna::Image &depthRT,
+  const ABufferConfig &config)
+  : fragments {sizeof(PackedFragment), config}
+{
+  auto &pipelineManager = etna::get_context().getPipelineManager();
+  countPipeline = create_transparent_pipeline(prog_prefix + "_count", depthRT, {});
+  storePipeline = create_transparent_pipeline(prog_prefix + "_store", depthRT, {});
+  scanPipeline = pipelineManager.createComputePipeline(prog_prefix + "_scan", {});
+  resolvePipeline = pipelineManager.createComputePipeline(prog_prefix + "_resolve", {});
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void PrefixSumABufferRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  pixels = w * h;
+
+  auto createBuffer = [](uint64_t size) {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+        |vk::BufferUsageFlagBits::eTransferDst
+    });
+  };
+
+  for (auto &frame : frames)
+  {
+    frame.counts = createBuffer(pixels * sizeof(uint32_t));
+    frame.offsets = createBuffer(pixels * sizeof(uint32_t));
+    frame.blockSums = createBuffer((pixels + ABUFFER_SCAN_BLOCK_SIZE - 1) / ABUFFER_SCAN_BLOCK_SIZE * sizeof(uint32_t));
+  }
+  fragments.reset(pixels);
+}
+
+uint64_t PrefixSumABufferRenderer::getMemoryBytes() const
+{
+  uint64_t blocks = (pixels + ABUFFER_SCAN_BLOCK_SIZE - 1) / ABUFFER_SCAN_BLOCK_SIZE;
+  return fragments.getStats().bufferBytes + frames.size() * (2 * uint64_t(pixels) + blocks) * sizeof(uint32_t);
+}
+
+void PrefixSumABufferRenderer::scan(etna::SyncCommandBuffer &cmd)
+{
+  struct ScanParams
+  {
+    uint32_t pass;
+    uint32_t count;
+  };
+
+  auto &frame = frames.get();
+
+  auto pipelineInfo = etna::get_shader_program(scanPipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+    {0, frame.counts.genBinding()},
+    {1, frame.offsets.genBinding()},
+    {2, frame.blockSums.genBinding()},
+    {3, fragments.getBuffer().genBinding()}
+  });
+
+  cmd.bindPipeline(scanPipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+
+  // block totals are scanned by a single workgroup
+  uint32_t blocks = (pixels + ABUFFER_SCAN_BLOCK_SIZE - 1) / ABUFFER_SCAN_BLOCK_SIZE;
+  for (uint32_t pass = 0; pass < 3; pass++)
+  {
+    cmd.pushConstants(scanPipeline.getShaderProgram(), 0, ScanParams {.pass = pass, .count = pixels});
+    cmd.dispatch(pass == 1 ? 1u : blocks, 1u, 1u);
+  }
+}
+
+void PrefixSumABufferRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  const etna::Image &target,
+  TileClassifier &tiles)
+{
+  fragments.beginFrame(cmd);
+  auto &frame = frames.next();
+  cmd.fillBuffer(frame.counts, 0, pixels * sizeof(uint32_t), 0u);
+
+  if (draw_list.materialGropus.size())
+  {
+    std::array<etna::Binding, 2> bindings {
+      etna::Binding {3, frame.counts.genBinding()},
+      etna::Binding {9, tiles.getFlags().genBinding()}
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {}, depth_attachment(depthRT)};
+    draw_transparent(cmd, countPipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  // the scan writes the fragments count of the frame into the header
+  scan(cmd);
+
+  if (draw_list.materialGropus.size())
+  {
+    std::array<etna::Binding, 2> bindings {
+      etna::Binding {3, frame.offsets.genBinding()},
+      etna::Binding {4, fragments.getBuffer().genBinding()}
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {}, depth_attachment(depthRT)};
+    draw_transparent(cmd, storePipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  fragments.endFrame(cmd);
+  tiles.classify(cmd);
+
+  auto pipelineInfo = etna::get_shader_program(resolvePipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+    etna::Binding {0, frame.counts.genBinding()},
+    etna::Binding {1, frame.offsets.genBinding()},
+    etna::Binding {2, fragments.getBuffer().genBinding()},
+    storage_binding(3, target),
+    etna::Binding {4, tiles.getTiles().genBinding()}
+  });
+
+  cmd.bindPipeline(resolvePipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  renderer::dispatch_indirect(cmd, tiles.getArgs(), TileClassifier::DISPATCH_ARGS_OFFSET);
+}
+
+const etna::Buffer &MaterialTable::write(const GLTFScene &scene, const SortedScene &draw_list)
+{
+  if (draw_list.materialGropus.size() > MATERIAL_TABLE_TEXTURED_GROUPS && !limitWarned)
+  {
+    limitWarned = true;
+    spdlog::warn("Transparency : {} Blend material groups, only {} are shaded with textures from the material table",
+      draw_list.materialGropus.size(), MATERIAL_TABLE_TEXTURED_GROUPS);
+  }
+
+  // the table of this slot was last read frames in flight ago, it can be rewritten or replaced
+  auto &table = tables.next();
+  uint64_t size = std::max<uint64_t>(draw_list.materialGropus.size(), 1) * sizeof(MaterialTableEntry);
+  if (table.getSize() < size)
+  {
+    table = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    });
+  }
+
+  auto *dst = reinterpret_cast<MaterialTableEntry *>(table.map());
+  for (uint32_t i = 0; i < draw_list.materialGropus.size(); i++)
+  {
+    auto &material = scene.getMaterial(draw_list.materialGropus[i].materialIndex);
+
+    uint32_t renderFlags = 0;
+    if (!material.baseColorId.has_value())
+      renderFlags |= uint32_t(RenderFlags::NoBaseColorTex);
+    if (!material.metallicRoughnessId.has_value())
+      renderFlags |= uint32_t(RenderFlags::NoMetallicRougnessTex);
+    if (material.packedMetallicRoughness)
+      renderFlags |= uint32_t(RenderFlags::PackedMetallicRoughness);
+    if (i >= MATERIAL_TABLE_TEXTURED_GROUPS)
+      renderFlags |= uint32_t(RenderFlags::NoBaseColorTex)|uint32_t(RenderFlags::NoMetallicRougnessTex);
+
+    dst[i] = MaterialTableEntry {
+      .baseColorFactor = material.baseColorFactor,
+      .metallic = material.metallicFactor,
+      .roughness = material.roughnessFactor,
+      .alphaCutoff = material.alphaCutoff,
+      .renderFlags = renderFlags
+    };
+  }
+
+  table.unmap();
+  return table;
+}
+
+void MaterialTable::bindTextures(std::vector<etna::Binding> &bindings, uint32_t binding,
+  const GLTFScene &scene, const SortedScene &draw_list)
+{
+  for (uint32_t i = 0; i < MATERIAL_TABLE_TEXTURED_GROUPS; i++)
+  {
+    std::optional<uint32_t> baseColorId;
+    std::optional<uint32_t> metallicRoughnessId;
+    if (i < draw_list.materialGropus.size())
+    {
+      auto &material = scene.getMaterial(draw_list.materialGropus[i].materialIndex);
+      baseColorId = material.baseColorId;
+      metallicRoughnessId = material.metallicRoughnessId;
+    }
+
+    auto [baseColorTex, baseColorSampler] = scene.getImageSampler(baseColorId);
+    auto [mrTex, mrSampler] = scene.getImageSampler(metallicRoughnessId);
+    bindings.push_back(etna::Binding {binding, baseColorTex->genBinding(
+      baseColorSampler, vk::ImageLayout::eShaderReadOnlyOptimal, baseColorTex->fullRangeView()), 2 * i});
+    bindings.push_back(etna::Binding {binding, mrTex->genBinding(
+      mrSampler, vk::ImageLayout::eShaderReadOnlyOptimal, mrTex->fullRangeView()), 2 * i + 1});
+  }
+}
+
+DeferredABufferRenderer::DeferredABufferRenderer(const std::string &prog_prefix, const etna::Image &depthRT,
+  const ABufferConfig &config)
+  : fragments {sizeof(DeferredFragment), config}
+{
+  pipeline = create_transparent_pipeline(prog_prefix + "_render", depthRT, {});
+  resolvePipeline = etna::get_context().getPipelineManager().createComputePipeline(prog_prefix + "_resolve", {});
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void DeferredABufferRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  for (auto &listHead : listHeads)
+  {
+    listHead = etna::get_context().createImage(etna::ImageCreateInfo {
+      .format = vk::Format::eR32Uint,
+      .extent {w, h, 1},
+      .imageUsage = vk::ImageUsageFlagBits::eStorage
+        |vk::ImageUsageFlagBits::eTransferDst
+    });
+  }
+  fragments.reset(uint64_t(w) * h);
+}
+
+uint64_t DeferredABufferRenderer::getMemoryBytes() const
+{
+  auto extent = get_extent(listHeads.get());
+  return fragments.getStats().bufferBytes + listHeads.size() * uint64_t(extent.width) * extent.height * sizeof(uint32_t);
+}
+
+void DeferredABufferRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  const etna::Image &target,
+  TileClassifier &tiles)
+{
+  fragments.beginFrame(cmd);
+  auto &listHead = listHeads.next();
+
+  vk::ClearColorValue clearVal {};
+  clearVal.setUint32({ABUFFER_LIST_END, ABUFFER_LIST_END, ABUFFER_LIST_END, ABUFFER_LIST_END});
+  cmd.clearColorImage(listHead, vk::ImageLayout::eGeneral, clearVal, {
+    vk::ImageSubresourceRange {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}
+  });
+
+  if (draw_list.materialGropus.size())
+  {
+    std::array<etna::Binding, 3> bindings {
+      storage_binding(3, listHead),
+      etna::Binding {4, fragments.getBuffer().genBinding()},
+      etna::Binding {9, tiles.getFlags().genBinding()}
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {}, depth_attachment(depthRT)};
+    draw_transparent(cmd, pipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  fragments.endFrame(cmd);
+  tiles.classify(cmd);
+
+  std::vector<etna::Binding> bindings {
+    etna::Binding {0, gframe.getBinding()},
+    storage_binding(1, listHead),
+    etna::Binding {2, fragments.getBuffer().genBinding()},
+    etna::Binding {3, materials.write(scene, draw_list).genBinding()},
+    storage_binding(5, target),
+    etna::Binding {6, tiles.getTiles().genBinding()}
+  };
+
+  MaterialTable::bindTextures(bindings, 4, scene, draw_list);
+
+  auto pipelineInfo = etna::get_shader_program(resolvePipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), bindings);
+  cmd.bindPipeline(resolvePipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  renderer::dispatch_indirect(cmd, tiles.getArgs(), TileClassifier::DISPATCH_ARGS_OFFSET);
+}
+
+HalfResolutionTransparency::HalfResolutionTransparency(const std::string &prog_prefix, const etna::Image &depthRT)
+  : depthFormat {depthRT.getInfo().format}
+{
+  etna::GraphicsPipeline::CreateInfo info {};
+  info.fragmentShaderOutput.colorAttachmentFormats.clear();
+  info.fragmentShaderOutput.depthAttachmentFormat = depthFormat;
+  info.blendingConfig.attachments.clear();
+  info.depthConfig.depthTestEnable = VK_TRUE;
+  info.depthConfig.depthWriteEnable = VK_TRUE;
+  info.depthConfig.depthCompareOp = vk::CompareOp::eAlways;
+
+  auto &pipelineManager = etna::get_context().getPipelineManager();
+  depthPipeline = pipelineManager.createGraphicsPipeline(prog_prefix + "_depth_downsample", info);
+  upsamplePipeline = pipelineManager.createComputePipeline(prog_prefix + "_upsample", {});
+
+  // all reads are texel fetches
+  vk::SamplerCreateInfo samplerInfo {
+    .magFilter = vk::Filter::eNearest,
+    .minFilter = vk::Filter::eNearest,
+    .mipmapMode = vk::SamplerMipmapMode::eNearest,
+    .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeW = vk::SamplerAddressMode::eClampToEdge
+  };
+  sampler = etna::get_context().getDevice().createSamplerUnique(samplerInfo).value;
+
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void HalfResolutionTransparency::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  uint32_t halfW = std::max((w + 1) / 2, 1u);
+  uint32_t halfH = std::max((h + 1) / 2, 1u);
+  for (auto &frame : frames)
+  {
+    frame.depth = etna::get_context().createImage(etna::ImageCreateInfo::depthRT(halfW, halfH, depthFormat));
+    frame.target = etna::get_context().createImage(etna::ImageCreateInfo {
+      .format = RenderTargetState::baseColorFmt,
+      .extent {halfW, halfH, 1},
+      .imageUsage = vk::ImageUsageFlagBits::eStorage
+        |vk::ImageUsageFlagBits::eSampled
+        |vk::ImageUsageFlagBits::eTransferDst
+    });
+  }
+}
+
+uint64_t HalfResolutionTransparency::getMemoryBytes() const
+{
+  auto extent = get_extent(frames.get().target);
+  return frames.size() * uint64_t(extent.width) * extent.height * (4 * sizeof(uint16_t) + sizeof(uint32_t));
+}
+
+void HalfResolutionTransparency::downsampleDepth(etna::SyncCommandBuffer &cmd, const etna::Image &depthRT)
+{
+  auto &frame = frames.next();
+
+  etna::Image::ViewParams depthView {};
+  depthView.aspect = vk::ImageAspectFlagBits::eDepth;
+
+  auto pipelineInfo = etna::get_shader_program(depthPipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+    etna::Binding {0, depthRT.genBinding(sampler.get(), vk::ImageLayout::eDepthStencilReadOnlyOptimal, depthView)}
+  });
+
+  etna::RenderingAttachment depthAttachment {
+    .view = frame.depth.getView({}),
+    .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+    .loadOp = vk::AttachmentLoadOp::eDontCare
+  };
+
+  etna::RenderTargetState rts {cmd, get_extent(frame.depth), {}, depthAttachment};
+  cmd.bindPipeline(depthPipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, pipelineInfo.getPipelineLayout(), 0, set);
+  cmd.draw(3, 1, 0, 0);
+}
+
+void HalfResolutionTransparency::clearTarget(etna::SyncCommandBuffer &cmd)
+{
+  // texels of tiles that are not resolved are read by the upsample of neighbouring tiles
+  cmd.clearColorImage(frames.get().target, vk::ImageLayout::eGeneral, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f}, {
+    vk::ImageSubresourceRange {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}
+  });
+}
+
+void HalfResolutionTransparency::upsample(etna::SyncCommandBuffer &cmd,
+  const GlobalFrameConstantHandler &gframe,
+  const etna::Image &depthRT,
+  const etna::Image &color,
+  const TileClassifier &tiles)
+{
+  auto &frame = frames.get();
+
+  etna::Image::ViewParams depthView {};
+  depthView.aspect = vk::ImageAspectFlagBits::eDepth;
+
+  auto pipelineInfo = etna::get_shader_program(upsamplePipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+    etna::Binding {0, gframe.getBinding()},
+    etna::Binding {1, depthRT.genBinding(sampler.get(), vk::ImageLayout::eDepthStencilReadOnlyOptimal, depthView)},
+    etna::Binding {2, frame.depth.genBinding(sampler.get(), vk::ImageLayout::eDepthStencilReadOnlyOptimal, depthView)},
+    etna::Binding {3, frame.target.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+    storage_binding(4, color),
+    etna::Binding {5, tiles.getTiles().genBinding()}
+  });
+
+  cmd.bindPipeline(upsamplePipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  renderer::dispatch_indirect(cmd, tiles.getArgs(), TileClassifier::DISPATCH_ARGS_OFFSET);
+}
+
+WeightedBlendedRenderer::WeightedBlendedRenderer(const std::string &prog_name,
+  const std::string &resolve_prog_name, const etna::Image &depthRT)
+{
+  pipeline = create_transparent_pipeline(prog_name, depthRT, {
+    {ACCUM_FORMAT, ADDITIVE_BLEND},
+    {REVEALAGE_FORMAT, REVEALAGE_BLEND}
+  });
+  resolvePipeline = etna::get_context().getPipelineManager().createComputePipeline(resolve_prog_name, {});
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void WeightedBlendedRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  for (auto &frame : frames)
+  {
+    frame.accum = create_oit_target(ACCUM_FORMAT, w, h);
+    frame.revealage = create_oit_target(REVEALAGE_FORMAT, w, h);
+  }
+}
+
+uint64_t WeightedBlendedRenderer::getMemoryBytes() const
+{
+  auto extent = get_extent(frames.get().accum);
+  return frames.size() * uint64_t(extent.width) * extent.height * (4 * sizeof(uint16_t) + sizeof(uint16_t));
+}
+
+void WeightedBlendedRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  const etna::Image &target)
+{
+  auto &frame = frames.next();
+
+  {
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {
+      clear_attachment(frame.accum, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f}),
+      clear_attachment(frame.revealage, vk::ClearColorValue {1.f, 1.f, 1.f, 1.f})
+    }, depth_attachment(depthRT)};
+
+    if (draw_list.materialGropus.size())
+      draw_transparent(cmd, pipeline, gframe, scene, draw_list, vt);
+  }
+
+  dispatch_resolve(cmd, resolvePipeline, {
+    storage_binding(0, frame.accum),
+    storage_binding(1, frame.revealage),
+    storage_binding(2, target)
+  }, target);
+}
+
+MomentRenderer::MomentRenderer(const std::string &generate_prog_name, const std::string &accumulate_prog_name,
+  const std::string &resolve_prog_name, const etna::Image &depthRT)
+{
+  generatePipeline = create_transparent_pipeline(generate_prog_name, depthRT, {
+    {MOMENTS_FORMAT, ADDITIVE_BLEND},
+    {ABSORBANCE_FORMAT, ADDITIVE_BLEND}
+  });
+  accumulatePipeline = create_transparent_pipeline(accumulate_prog_name, depthRT, {
+    {ACCUM_FORMAT, ADDITIVE_BLEND}
+  });
+  resolvePipeline = etna::get_context().getPipelineManager().createComputePipeline(resolve_prog_name, {});
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void MomentRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  for (auto &frame : frames)
+  {
+    frame.moments = create_oit_target(MOMENTS_FORMAT, w, h);
+    frame.absorbance = create_oit_target(ABSORBANCE_FORMAT, w, h);
+    frame.accum = create_oit_target(ACCUM_FORMAT, w, h);
+  }
+}
+
+uint64_t MomentRenderer::getMemoryBytes() const
+{
+  auto extent = get_extent(frames.get().accum);
+  return frames.size() * uint64_t(extent.width) * extent.height * (4 * sizeof(float) + sizeof(float) + 4 * sizeof(uint16_t));
+}
+
+void MomentRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  const etna::Image &target)
+{
+  auto &frame = frames.next();
+
+  {
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {
+      clear_attachment(frame.moments, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f}),
+      clear_attachment(frame.absorbance, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f})
+    }, depth_attachment(depthRT)};
+
+    if (draw_list.materialGropus.size())
+      draw_transparent(cmd, generatePipeline, gframe, scene, draw_list, vt);
+  }
+
+  {
+    std::array<etna::Binding, 2> bindings {
+      storage_binding(3, frame.moments),
+      storage_binding(4, frame.absorbance)
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {
+      clear_attachment(frame.accum, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f})
+    }, depth_attachment(depthRT)};
+
+    if (draw_list.materialGropus.size())
+      draw_transparent(cmd, accumulatePipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  dispatch_resolve(cmd, resolvePipeline, {
+    storage_binding(0, frame.accum),
+    storage_binding(1, frame.absorbance),
+    storage_binding(2, target)
+  }, target);
+}
+
+KBufferRenderer::KBufferRenderer(const std::string &depth_prog_name, const std::string &store_prog_name,
+  const std::string &resolve_prog_name, const etna::Image &depthRT)
+{
+  depthPipeline = create_transparent_pipeline(depth_prog_name, depthRT, {});
+  storePipeline = create_transparent_pipeline(store_prog_name, depthRT, {
+    {ACCUM_FORMAT, ADDITIVE_BLEND},
+    {REVEALAGE_FORMAT, REVEALAGE_BLEND}
+  });
+  resolvePipeline = etna::get_context().getPipelineManager().createComputePipeline(resolve_prog_name, {});
+  onResolutionChanged(depthRT.getInfo().extent.width, depthRT.getInfo().extent.height);
+}
+
+void KBufferRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  layersBytes = uint64_t(w) * h * KBUFFER_LAYERS * sizeof(uint32_t);
+
+  auto createLayers = [&]() {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = layersBytes,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+        |vk::BufferUsageFlagBits::eTransferDst
+    });
+  };
+
+  for (auto &frame : frames)
+  {
+    frame.depths = createLayers();
+    frame.colors = createLayers();
+    frame.accum = create_oit_target(ACCUM_FORMAT, w, h);
+    frame.revealage = create_oit_target(REVEALAGE_FORMAT, w, h);
+  }
+}
+
+uint64_t KBufferRenderer::getMemoryBytes() const
+{
+  auto extent = get_extent(frames.get().accum);
+  return frames.size() * (2 * layersBytes + uint64_t(extent.width) * extent.height * (4 * sizeof(uint16_t) + sizeof(uint16_t)));
+}
+
+void KBufferRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const VirtualTextureSystem &vt,
+  const etna::Image &target)
+{
+  auto &frame = frames.next();
+
+  // colors are not cleared, the resolve only reads layers with a depth and the store pass writes all of them
+  cmd.fillBuffer(frame.depths, 0, layersBytes, 0xffffffffu);
+
+  if (draw_list.materialGropus.size())
+  {
+    std::array<etna::Binding, 1> bindings {
+      etna::Binding {3, frame.depths.genBinding()}
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {}, depth_attachment(depthRT)};
+    draw_transparent(cmd, depthPipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  {
+    std::array<etna::Binding, 2> bindings {
+      etna::Binding {3, frame.depths.genBinding()},
+      etna::Binding {4, frame.colors.genBinding()}
+    };
+
+    etna::RenderTargetState rts {cmd, get_extent(depthRT), {
+      clear_attachment(frame.accum, vk::ClearColorValue {0.f, 0.f, 0.f, 0.f}),
+      clear_attachment(frame.revealage, vk::ClearColorValue {1.f, 1.f, 1.f, 1.f})
+    }, depth_attachment(depthRT)};
+
+    if (draw_list.materialGropus.size())
+      draw_transparent(cmd, storePipeline, gframe, scene, draw_list, vt, bindings);
+  }
+
+  dispatch_resolve(cmd, resolvePipeline, {
+    etna::Binding {0, frame.depths.genBinding()},
+    etna::Binding {1, frame.colors.genBinding()},
+    storage_binding(2, frame.accum),
+    storage_binding(3, frame.revealage),
+    storage_binding(4, target)
+  }, target);
+}
+
+SortedInstanceRenderer::SortedInstanceRenderer(const std::string &prog_prefix, const std::string &sort_prog_prefix,
+  const etna::Image &depthRT)
+  : sorter {sort_prog_prefix}
+{
+  pipeline = create_transparent_pipeline(prog_prefix, depthRT, {
+    {RenderTargetState::baseColorFmt, PREMULTIPLIED_OVER_BLEND}
+  });
+  auto &pipelineManager = etna::get_context().getPipelineManager();
+  keysPipeline = pipelineManager.createComputePipeline(prog_prefix + "_keys", {});
+  commandsPipeline = pipelineManager.createComputePipeline(prog_prefix + "_commands", {});
+}
+
+void SortedInstanceRenderer::attachToScene(const SortedScene &draw_list)
+{
+  instancesCount = 0;
+  for (auto &group : draw_list.materialGropus)
+    for (auto &dc : group.drawCalls)
+      instancesCount += uint32_t(dc.transformIds.size());
+
+  // buffers are grown by render() as it reaches each slot, frames in flight may still use the current ones
+  sorter.reserve(std::max(instancesCount, 1u), renderer::RadixSortKey::Uint32);
+}
+
+void SortedInstanceRenderer::growFrame(Frame &frame)
+{
+  uint64_t capacity = std::max(instancesCount, 1u);
+  if (frame.commands.getSize() >= capacity * sizeof(vk::DrawIndexedIndirectCommand))
+    return;
+
+  auto createBuffer = [](uint64_t size, vk::BufferUsageFlags usage) {
+    return etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer|usage
+    });
+  };
+
+  frame.keys = createBuffer(capacity * sizeof(uint32_t), {});
+  frame.sortedIds = createBuffer(capacity * sizeof(uint32_t), {});
+  frame.commands = createBuffer(capacity * sizeof(vk::DrawIndexedIndirectCommand),
+    vk::BufferUsageFlagBits::eIndirectBuffer);
+}
+
+uint64_t SortedInstanceRenderer::getMemoryBytes() const
+{
+  uint64_t bytes = sorter.getMemoryBytes();
+  for (auto &frame : frames)
+    bytes += frame.instances.getSize() + frame.keys.getSize() + frame.sortedIds.getSize() + frame.commands.getSize();
+  return bytes;
+}
+
+const etna::Buffer &SortedInstanceRenderer::writeInstances(const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene, const SortedScene &draw_list)
+{
+  // the table of this slot was last read frames in flight ago, it can be rewritten or replaced
+  auto &table = frames.get().instances;
+  uint64_t size = std::max(instancesCount, 1u) * sizeof(BlendInstance);
+  if (table.getSize() < size)
+  {
+    table = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size,
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    });
+  }
+
+  auto *dst = reinterpret_cast<BlendInstance *>(table.map());
+  const auto &view = gframe.getParams().view;
+  for (uint32_t groupId = 0; groupId < draw_list.materialGropus.size(); groupId++)
+  {
+    for (auto &dc : draw_list.materialGropus[groupId].drawCalls)
+    {
+      for (auto &tId : dc.transformIds)
+      {
+        auto &transform = scene.getTransform(tId);
+        *dst++ = BlendInstance {
+          .model = transform.modelTransform,
+          .normalTransform = glm::transpose(glm::inverse(view * transform.modelTransform)),
+          .center = glm::vec4 {0.5f * (dc.boundsMin + dc.boundsMax), 1.f},
+          .firstIndex = dc.firstIndex,
+          .indexCount = dc.indexCount,
+          .vertexOffset = dc.vertexOffset,
+          .materialGroup = groupId
+        };
+      }
+    }
+  }
+
+  table.unmap();
+  return table;
+}
+
+void SortedInstanceRenderer::dispatchInstances(etna::SyncCommandBuffer &cmd, const etna::ComputePipeline &pipeline,
+  const std::vector<etna::Binding> &bindings)
+{
+  auto pipelineInfo = etna::get_shader_program(pipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), bindings);
+  cmd.bindPipeline(pipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+  cmd.pushConstants(pipeline.getShaderProgram(), 0, instancesCount);
+  cmd.dispatch((instancesCount + 63u)/64u, 1u, 1u);
+}
+
+void SortedInstanceRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const SortedScene &draw_list,
+  const etna::Image &target)
+{
+  if (!instancesCount)
+    return;
+
+  // the slot was last used frames in flight ago, its buffers can be replaced
+  auto &frame = frames.next();
+  growFrame(frame);
+  const auto &instances = writeInstances(gframe, scene, draw_list);
+
+  dispatchInstances(cmd, keysPipeline, {
+    etna::Binding {0, gframe.getBinding()},
+    etna::Binding {1, instances.genBinding()},
+    etna::Binding {2, frame.keys.genBinding()},
+    etna::Binding {3, frame.sortedIds.genBinding()}
+  });
+
+  sorter.sort(cmd, frame.keys, frame.sortedIds, instancesCount, renderer::RadixSortKey::Uint32);
+
+  dispatchInstances(cmd, commandsPipeline, {
+    etna::Binding {0, instances.genBinding()},
+    etna::Binding {1, frame.sortedIds.genBinding()},
+    etna::Binding {2, frame.commands.genBinding()}
+  });
+  renderer::indirect_args_barrier(cmd, frame.commands);
+
+  std::vector<etna::Binding> bindings {
+    etna::Binding {0, gframe.getBinding()},
+    etna::Binding {1, instances.genBinding()},
+    etna::Binding {2, materials.write(scene, draw_list).genBinding()}
+  };
+  MaterialTable::bindTextures(bindings, 3, scene, draw_list);
+
+  etna::RenderTargetState rts {cmd, get_extent(depthRT), {
+    etna::RenderingAttachment {
+      .view = target.getView({}),
+      .layout = vk::ImageLayout::eColorAttachmentOptimal,
+      .loadOp = vk::AttachmentLoadOp::eLoad
+    }
+  }, depth_attachment(depthRT)};
+
+  const auto &progInfo = etna::get_shader_program(pipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(progInfo.getDescriptorLayoutId(0), bindings);
+  cmd.bindVertexBuffer(0, scene.getVertexBuff(), 0);
+  cmd.bindIndexBuffer(scene.getIndexBuff(), 0, vk::IndexType::eUint32);
+  cmd.bindPipeline(pipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, progInfo.getPipelineLayout(), 0, set);
+  renderer::draw_indexed_indirect(cmd, frame.commands, 0, instancesCount, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+TransparencyRenderer::TransparencyRenderer(const etna::Image &depthRT)
+  : resolution {depthRT.getInfo().extent.width, depthRT.getInfo().extent.height}
+{
+  abufferRenderer = std::make_unique<ABufferRenderer>("abuffer_render", depthRT);
+  halfRes = std::make_unique<HalfResolutionTransparency>("transparency", depthRT);
+  halfResABufferRenderer = std::make_unique<ABufferRenderer>("abuffer_render", halfRes->getDepth());
+  halfResTiles = std::make_unique<TileClassifier>("abuffer_tiles", glm::uvec2 {
+    halfRes->getDepth().getInfo().extent.width, halfRes->getDepth().getInfo().extent.height
+  });
+  abufferResolver = std::make_unique<ABufferResolver>("abuffer_resolve");
+  tiles = std::make_unique<TileClassifier>("abuffer_tiles", resolution);
+  syntheticPipeline = etna::get_context().getPipelineManager().createComputePipeline("abuffer_synthetic", {});
+  prefixSumRenderer = std::make_unique<PrefixSumABufferRenderer>("abuffer_prefix", depthRT);
+  deferredRenderer = std::make_unique<DeferredABufferRenderer>("abuffer_deferred", depthRT);
+  weightedRenderer = std::make_unique<WeightedBlendedRenderer>("oit_weighted", "oit_weighted_resolve", depthRT);
+  momentRenderer = std::make_unique<MomentRenderer>(
+    "oit_moments_generate", "oit_moments_accumulate", "oit_moments_resolve", depthRT);
+  kbufferRenderer = std::make_unique<KBufferRenderer>(
+    "oit_kbuffer_depth", "oit_kbuffer_store", "oit_kbuffer_resolve", depthRT);
+  sortedRenderer = std::make_unique<SortedInstanceRenderer>("sorted_blend", "radix_sort", depthRT);
+}
+
+void TransparencyRenderer::attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt)
+{
+  virtualTextures = &vt;
+  abufferRenderer->attachToScene(scene, vt);
+  halfResABufferRenderer->attachToScene(scene, vt);
+  sceneData = scene.queryDrawCalls([](const GLTFScene::Material &material) {
+    return material.mode == GLTFScene::MaterialMode::Blend;
+  });
+  sortedRenderer->attachToScene(sceneData);
+}
+
+void TransparencyRenderer::onResolutionChanged(uint32_t w, uint32_t h)
+{
+  resolution = {w, h};
+  abufferRenderer->onResolutionChanged(w, h);
+  halfRes->onResolutionChanged(w, h);
+  auto &halfExtent = halfRes->getDepth().getInfo().extent;
+  halfResABufferRenderer->onResolutionChanged(halfExtent.width, halfExtent.height);
+  halfResTiles->onResolutionChanged({halfExtent.width, halfExtent.height});
+  tiles->onResolutionChanged(resolution);
+  prefixSumRenderer->onResolutionChanged(w, h);
+  deferredRenderer->onResolutionChanged(w, h);
+  weightedRenderer->onResolutionChanged(w, h);
+  momentRenderer->onResolutionChanged(w, h);
+  kbufferRenderer->onResolutionChanged(w, h);
+  modeFrames = 0; // timings at the previous resolution are still in flight
+}
+
+void TransparencyRenderer::setMode(TransparencyMode new_mode)
+{
+  if (!benchmark)
+    switchMode(new_mode);
+}
+
+void TransparencyRenderer::switchMode(TransparencyMode new_mode)
+{
+  if (new_mode == mode)
+    return;
+  mode = new_mode;
+  modeFrames = 0;
+}
+
+void TransparencyRenderer::startBenchmark(uint32_t frames_per_mode)
+{
+  if (benchmark)
+    return;
+
+  benchmark = Benchmark {
+    .framesPerMode = std::max(frames_per_mode, 1u),
+    .restoreMode = mode
+  };
+  switchMode(TransparencyMode(0));
+  modeFrames = 0;
+}
+
+uint64_t TransparencyRenderer::getMemoryBytes(TransparencyMode m) const
+{
+  switch (m)
+  {
+  case TransparencyMode::ABuffer:
+  {
+    uint64_t bytes = getABufferRenderer().getMemoryBytes();
+    return halfResolution ? bytes + halfRes->getMemoryBytes() : bytes;
+  }
+  case TransparencyMode::ABufferPrefixSum: return prefixSumRenderer->getMemoryBytes();
+  case TransparencyMode::ABufferDeferred: return deferredRenderer->getMemoryBytes();
+  case TransparencyMode::WeightedBlended: return weightedRenderer->getMemoryBytes();
+  case TransparencyMode::Moments: return momentRenderer->getMemoryBytes();
+  case TransparencyMode::KBuffer: return kbufferRenderer->getMemoryBytes();
+  case TransparencyMode::SortedInstances: return sortedRenderer->getMemoryBytes();
+  }
+  return 0;
+}
+
+void TransparencyRenderer::updateStats()
+{
+  for (uint32_t i = 0; i < TRANSPARENCY_MODES_COUNT; i++)
+    stats[i].memoryBytes = getMemoryBytes(TransparencyMode(i));
+
+  // timestamps are read frames in flight later, until then they belong to the previous mode
+  if (modeFrames++ <= etna::get_context().getNumFramesInFlight())
+    return;
+
+  auto ms = timer.getMs(get_transparency_mode_name(mode));
+  if (!ms)
+    return;
+
+  auto &modeStats = stats[uint32_t(mode)];
+  modeStats.lastGpuMs = *ms;
+  modeStats.avgGpuMs = modeStats.samples
+    ? modeStats.avgGpuMs + (*ms - modeStats.avgGpuMs) * STATS_AVERAGE_WEIGHT
+    : *ms;
+  modeStats.samples++;
+
+  if (!benchmark)
+    return;
+
+  uint32_t index = benchmark->modeIndex;
+  benchmark->sumMs[index] += *ms;
+  if (++benchmark->samples[index] < benchmark->framesPerMode)
+    return;
+
+  if (++benchmark->modeIndex < TRANSPARENCY_MODES_COUNT)
+  {
+    switchMode(TransparencyMode(benchmark->modeIndex));
+    return;
+  }
+
+  spdlog::info("Transparency benchmark, {} frames per mode at {}x{}, {} Blend material groups:",
+    benchmark->framesPerMode, resolution.x, resolution.y, sceneData.materialGropus.size());
+  for (uint32_t i = 0; i < TRANSPARENCY_MODES_COUNT; i++)
+  {
+    spdlog::info("  {:<18} {:8.3f} ms {:8.2f} MiB", get_transparency_mode_name(TransparencyMode(i)),
+      benchmark->sumMs[i] / benchmark->samples[i], double(stats[i].memoryBytes) / double(1 << 20));
+  }
+
+  switchMode(benchmark->restoreMode);
+  benchmark.reset();
+}
+
+void TransparencyRenderer::startResolveBenchmark()
+{
+  if (resolveBenchmark)
+    return;
+
+  uint64_t maxFragments = uint64_t(RESOLVE_BENCHMARK_SIZE) * RESOLVE_BENCHMARK_SIZE * RESOLVE_BENCHMARK_DEPTHS.back();
+  auto &ctx = etna::get_context();
+
+  resolveBenchmark = std::make_unique<ResolveBenchmark>(ResolveBenchmark {
+    .listHead = ctx.createImage(etna::ImageCreateInfo {
+      .format = vk::Format::eR32Uint,
+      .extent {RESOLVE_BENCHMARK_SIZE, RESOLVE_BENCHMARK_SIZE, 1},
+      .imageUsage = vk::ImageUsageFlagBits::eStorage
+    }),
+    .fragmentList = ctx.createBuffer(etna::Buffer::CreateInfo {
+      .size = ABUFFER_HEADER_SIZE + maxFragments * sizeof(FragmentEntry),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer
+    }),
+    .target = ctx.createImage(etna::ImageCreateInfo {
+      .format = RenderTargetState::baseColorFmt,
+      .extent {RESOLVE_BENCHMARK_SIZE, RESOLVE_BENCHMARK_SIZE, 1},
+      .imageUsage = vk::ImageUsageFlagBits::eStorage
+    }),
+    .tiles = std::make_unique<TileClassifier>("abuffer_tiles",
+      glm::uvec2 {RESOLVE_BENCHMARK_SIZE, RESOLVE_BENCHMARK_SIZE})
+  });
+}
+
+static std::string get_resolve_scope_name(uint32_t depth, uint32_t layers)
+{
+  return fmt::format("resolve d{} k{}", depth, layers);
+}
+
+void TransparencyRenderer::updateResolveBenchmark(etna::SyncCommandBuffer &cmd)
+{
+  if (!resolveBenchmark)
+    return;
+
+  auto &bench = *resolveBenchmark;
+
+  // all runs are recorded into one frame, their timestamps are read frames in flight later
+  if (!bench.recordFrame)
+  {
+    bench.tiles->reset(cmd);
+    bench.tiles->markAll(cmd);
+    bench.tiles->classify(cmd);
+
+    for (uint32_t depth : RESOLVE_BENCHMARK_DEPTHS)
+    {
+      auto pipelineInfo = etna::get_shader_program(syntheticPipeline.getShaderProgram());
+      auto set = etna::create_descriptor_set(pipelineInfo.getDescriptorLayoutId(0), {
+        storage_binding(0, bench.listHead),
+        etna::Binding {1, bench.fragmentList.genBinding()}
+      });
+
+      cmd.bindPipeline(syntheticPipeline);
+      cmd.bindDescriptorSet(vk::PipelineBindPoint::eCompute, pipelineInfo.getPipelineLayout(), 0, set);
+      cmd.pushConstants(syntheticPipeline.getShaderProgram(), 0, depth);
+      cmd.dispatch((RESOLVE_BENCHMARK_SIZE + 7u)/8u, (RESOLVE_BENCHMARK_SIZE + 3u)/4u, 1u);
+
+      for (uint32_t layers : ABUFFER_RESOLVE_LAYERS)
+      {
+        auto scope = timer.begin(cmd, get_resolve_scope_name(depth, layers));
+        abufferResolver->dispatch(cmd, layers, bench.listHead, bench.fragmentList, bench.target, *bench.tiles);
+        timer.end(cmd, scope);
+      }
+    }
+
+    bench.recordFrame = frameIndex;
+    return;
+  }
+
+  if (*bench.recordFrame + etna::get_context().getNumFramesInFlight() > frameIndex)
+    return;
+
+  spdlog::info("A-buffer resolve benchmark, {}x{} pixels, ms per resolve:",
+    RESOLVE_BENCHMARK_SIZE, RESOLVE_BENCHMARK_SIZE);
+
+  std::string header = "  fragments";
+  for (uint32_t layers : ABUFFER_RESOLVE_LAYERS)
+    header += fmt::format(" {:>8}", fmt::format("K={}", layers));
+  spdlog::info("{}", header);
+
+  for (uint32_t depth : RESOLVE_BENCHMARK_DEPTHS)
+  {
+    std::string row = fmt::format("  {:>9}", depth);
+    for (uint32_t layers : ABUFFER_RESOLVE_LAYERS)
+    {
+      auto ms = timer.getMs(get_resolve_scope_name(depth, layers));
+      row += ms ? fmt::format(" {:8.3f}", *ms) : fmt::format(" {:>8}", "-");
+    }
+    spdlog::info("{}", row);
+  }
+
+  // the recording frame is complete, nothing references the resources anymore
+  resolveBenchmark.reset();
+}
+
+void TransparencyRenderer::setHalfResolution(bool enable)
+{
+  if (enable == halfResolution)
+    return;
+  halfResolution = enable;
+  modeFrames = 0; // timings of the other resolution are still in flight
+}
+
+void TransparencyRenderer::renderABuffer(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const etna::Image &color)
+{
+  if (!halfResolution)
+  {
+    abufferRenderer->render(cmd, depthRT, gframe, scene, *tiles);
+    tiles->classify(cmd);
+    abufferResolver->dispatch(cmd, abufferRenderer->getListHead(), abufferRenderer->getListBuffer(), color, *tiles);
+    return;
+  }
+
+  halfRes->downsampleDepth(cmd, depthRT);
+  halfResTiles->reset(cmd);
+  halfResABufferRenderer->render(cmd, halfRes->getDepth(), gframe, scene, *halfResTiles);
+  halfResTiles->classify(cmd);
+
+  halfRes->clearTarget(cmd);
+  abufferResolver->dispatch(cmd, halfResABufferRenderer->getListHead(), halfResABufferRenderer->getListBuffer(),
+    halfRes->getTarget(), *halfResTiles);
+  halfRes->upsample(cmd, gframe, depthRT, color, *halfResTiles);
+}
+
+void TransparencyRenderer::render(etna::SyncCommandBuffer &cmd,
+  const etna::Image &depthRT,
+  const GlobalFrameConstantHandler &gframe,
+  const GLTFScene &scene,
+  const etna::Image &color)
+{
+  frameIndex++;
+  timer.beginFrame(cmd);
+  updateStats();
+  updateResolveBenchmark(cmd);
+
+  auto scope = timer.begin(cmd, get_transparency_mode_name(mode));
+
+  tiles->reset(cmd);
+
+  switch (mode)
+  {
+  case TransparencyMode::ABuffer:
+    renderABuffer(cmd, depthRT, gframe, scene, color);
+    break;
+  case TransparencyMode::ABufferPrefixSum:
+    prefixSumRenderer->render(cmd, depthRT, gframe, scene, sceneData, *virtualTextures, color, *tiles);
+    break;
+  case TransparencyMode::ABufferDeferred:
+    deferredRenderer->render(cmd, depthRT, gframe, scene, sceneData, *virtualTextures, color, *tiles);
+    break;
+  case TransparencyMode::WeightedBlended:
+    weightedRenderer->render(cmd, depthRT, gframe, scene, sceneData, *virtualTextures, color);
+    break;
+  case TransparencyMode::Moments:
+    momentRenderer->render(cmd, depthRT, gframe, scene, sceneData, *virtualTextures, color);
+    break;
+  case TransparencyMode::KBuffer:
+    kbufferRenderer->render(cmd, depthRT, gframe, scene, sceneData, *virtualTextures, color);
+    break;
+  case TransparencyMode::SortedInstances:
+    sortedRenderer->render(cmd, depthRT, gframe, scene, sceneData, color);
+    break;
+  }
+
+  timer.end(cmd, scope);
+}
+
+} // namespace scene
@@ -0,0 +1,483 @@
+#ifndef SCENE_TRANSPARENCY_RENDERER_HPP_INCLUDED
+#define SCENE_TRANSPARENCY_RENDERER_HPP_INCLUDED
+
+#include "ABufferRenderer.hpp"
+#include "renderer/GpuTimer.hpp"
+#include "renderer/RadixSort.hpp"
+
+#include <array>
+#include <memory>
+#include <optional>
+
+namespace scene
+{
+
+enum class TransparencyMode
+{
+  ABuffer, // per pixel fragment lists, sorted in the resolve
+  ABufferPrefixSum, // contiguous per pixel fragments placed by a prefix sum of fragment counts
+  ABufferDeferred, // per pixel lists of surface attributes, the nearest fragments are shaded in the resolve
+  WeightedBlended, // single pass, fixed two targets per pixel, approximate order
+  Moments, // moment-based transmittance, two geometry passes
+  KBuffer, // nearest KBUFFER_LAYERS fragments sorted, the rest blended like WeightedBlended
+  SortedInstances // instances sorted back to front on the GPU and blended by the hardware
+};
+
+constexpr uint32_t TRANSPARENCY_MODES_COUNT = 7;
+
+const char *get_transparency_mode_name(TransparencyMode mode);
+
+constexpr uint32_t KBUFFER_LAYERS = 8; // OIT_K in OIT.glsl
+constexpr uint32_t ABUFFER_SCAN_BLOCK_SIZE = 1024; // counts scanned by a workgroup, see ABuffer.glsl
+constexpr uint32_t ABUFFER_DEFERRED_LAYERS = 8; // fragments shaded per pixel, see ABufferDeferred.glsl
+constexpr uint32_t MATERIAL_TABLE_TEXTURED_GROUPS = 32; // material groups with textures, see MaterialTable.glsl
+
+// fragments per pixel of the synthetic lists of the resolve benchmark
+constexpr std::array<uint32_t, 7> RESOLVE_BENCHMARK_DEPTHS {1, 2, 4, 8, 16, 32, 64};
+constexpr uint32_t RESOLVE_BENCHMARK_SIZE = 256; // pixels, square
+
+// All modes draw the same Blend draw list, their resolves composite premultiplied color and coverage over
+// target in place, like ABufferResolver. target is the RGBA16F color with storage usage. The A-buffers
+// resolve the classified tiles only, other modes resolve the whole target.
+
+// A-buffer with contiguous per pixel storage. A count pass counts the fragments of every pixel, a compute
+// prefix sum turns the counts into offsets and a store pass writes 8 byte entries without links, so the
+// resolve reads the fragments of a pixel sequentially. The count pass flags tiles. Uses the programs prog_prefix + "_count", "_scan",
+// "_store" and "_resolve".
+struct PrefixSumABufferRenderer
+{
+  PrefixSumABufferRenderer(const std::string &prog_prefix, const etna::Image &depthRT,
+    const ABufferConfig &config = {});
+
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const VirtualTextureSystem &vt,
+    const etna::Image &target,
+    TileClassifier &tiles);
+
+  const ABufferStats &getStats() const { return fragments.getStats(); }
+  uint64_t getMemoryBytes() const;
+
+private:
+  void scan(etna::SyncCommandBuffer &cmd);
+
+  etna::GraphicsPipeline countPipeline;
+  etna::GraphicsPipeline storePipeline;
+  etna::ComputePipeline scanPipeline;
+  etna::ComputePipeline resolvePipeline;
+
+  struct Frame
+  {
+    etna::Buffer counts;
+    etna::Buffer offsets;
+    etna::Buffer blockSums;
+  };
+
+  renderer::FrameRing<Frame> frames;
+  FragmentStorage fragments;
+  uint32_t pixels = 0;
+};
+
+// entry of the deferred A-buffer, see ABufferDeferred.glsl
+struct DeferredFragment
+{
+  float depth;
+  uint32_t link;
+  glm::vec2 uv;
+  uint32_t normal;
+  uint32_t material;
+};
+
+// see MaterialTable.glsl
+struct MaterialTableEntry
+{
+  glm::vec4 baseColorFactor;
+  float metallic;
+  float roughness;
+  float alphaCutoff;
+  uint32_t renderFlags;
+};
+
+// Parameters of the material groups of a draw list in one storage buffer, for passes that shade several
+// groups without per group bindings. Textures of the first MATERIAL_TABLE_TEXTURED_GROUPS groups are bound
+// as one sampler array and sampled from the regular images, virtual texture pages are not used, groups past
+// them are shaded with their factors.
+struct MaterialTable
+{
+  // moves to the table of a new frame and writes it
+  const etna::Buffer &write(const GLTFScene &scene, const SortedScene &draw_list);
+
+  // adds the sampler array elements of binding, slots without a material group get the stub image
+  static void bindTextures(std::vector<etna::Binding> &bindings, uint32_t binding,
+    const GLTFScene &scene, const SortedScene &draw_list);
+
+private:
+  renderer::FrameRing<etna::Buffer> tables;
+  bool limitWarned = false;
+};
+
+// A-buffer that stores surface attributes instead of shaded colors: depth, material group, UV and a packed
+// normal. The fragment pass samples no textures, the resolve keeps the ABUFFER_DEFERRED_LAYERS nearest
+// fragments of a pixel and shades only them from the MaterialTable, fragments behind are dropped. Flags
+// tiles like ABufferRenderer. Uses the programs prog_prefix + "_render" and "_resolve".
+struct DeferredABufferRenderer
+{
+  DeferredABufferRenderer(const std::string &prog_prefix, const etna::Image &depthRT,
+    const ABufferConfig &config = {});
+
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const VirtualTextureSystem &vt,
+    const etna::Image &target,
+    TileClassifier &tiles);
+
+  const ABufferStats &getStats() const { return fragments.getStats(); }
+  uint64_t getMemoryBytes() const;
+
+private:
+  etna::GraphicsPipeline pipeline;
+  etna::ComputePipeline resolvePipeline;
+
+  renderer::FrameRing<etna::Image> listHeads;
+  FragmentStorage fragments;
+  MaterialTable materials;
+};
+
+// Resources of the half resolution A-buffer. downsampleDepth() keeps the farthest opaque depth of every 2x2
+// quad, so transparent fragments pass the depth test if any covered pixel sees them. The half resolution
+// resolve composites into a target cleared to zero and upsample() composites it over the full resolution
+// color with nearest-depth upsampling, over the classified half resolution tiles only.
+// Uses the programs prog_prefix + "_depth_downsample" and "_upsample".
+struct HalfResolutionTransparency
+{
+  // depthRT is the full resolution opaque depth
+  HalfResolutionTransparency(const std::string &prog_prefix, const etna::Image &depthRT);
+
+  void onResolutionChanged(uint32_t w, uint32_t h); // full resolution
+
+  // moves to the images of a new frame, call first every frame
+  void downsampleDepth(etna::SyncCommandBuffer &cmd, const etna::Image &depthRT);
+  void clearTarget(etna::SyncCommandBuffer &cmd);
+  void upsample(etna::SyncCommandBuffer &cmd,
+    const GlobalFrameConstantHandler &gframe,
+    const etna::Image &depthRT,
+    const etna::Image &color,
+    const TileClassifier &tiles);
+
+  const etna::Image &getDepth() const { return frames.get().depth; }
+  const etna::Image &getTarget() const { return frames.get().target; }
+  uint64_t getMemoryBytes() const;
+
+private:
+  etna::GraphicsPipeline depthPipeline;
+  etna::ComputePipeline upsamplePipeline;
+  vk::UniqueSampler sampler;
+
+  struct Frame
+  {
+    etna::Image depth;
+    etna::Image target; // premultiplied color and coverage
+  };
+
+  vk::Format depthFormat; // of the full resolution depth
+  renderer::FrameRing<Frame> frames;
+};
+
+// Weighted blended OIT, McGuire and Bavoil 2013
+struct WeightedBlendedRenderer
+{
+  WeightedBlendedRenderer(const std::string &prog_name, const std::string &resolve_prog_name,
+    const etna::Image &depthRT);
+
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const VirtualTextureSystem &vt,
+    const etna::Image &target);
+
+  uint64_t getMemoryBytes() const;
+
+private:
+  struct Frame
+  {
+    etna::Image accum;
+    etna::Image revealage;
+  };
+
+  etna::GraphicsPipeline pipeline;
+  etna::ComputePipeline resolvePipeline;
+  renderer::FrameRing<Frame> frames;
+};
+
+// Moment-based OIT, Muenstermann et al. 2018. The first pass sums four power moments of the depth
+// distribution, the second one weights shaded fragments by the transmittance reconstructed from them.
+struct MomentRenderer
+{
+  MomentRenderer(const std::string &generate_prog_name, const std::string &accumulate_prog_name,
+    const std::string &resolve_prog_name, const etna::Image &depthRT);
+
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const VirtualTextureSystem &vt,
+    const etna::Image &target);
+
+  uint64_t getMemoryBytes() const;
+
+private:
+  etna::GraphicsPipeline generatePipeline;
+  etna::GraphicsPipeline accumulatePipeline;
+  etna::ComputePipeline resolvePipeline;
+
+  struct Frame
+  {
+    etna::Image moments;
+    etna::Image absorbance;
+    etna::Image accum;
+  };
+
+  renderer::FrameRing<Frame> frames;
+};
+
+// K-buffer with tail blending. The first pass keeps the KBUFFER_LAYERS nearest depths per pixel
+// with an atomicMin insertion chain, the second one stores colors of fragments that made it and blends
+// the others into weighted blended targets, the resolve composites the layers over the tail.
+struct KBufferRenderer
+{
+  KBufferRenderer(const std::string &depth_prog_name, const std::string &store_prog_name,
+    const std::string &resolve_prog_name, const etna::Image &depthRT);
+
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const VirtualTextureSystem &vt,
+    const etna::Image &target);
+
+  uint64_t getMemoryBytes() const;
+
+private:
+  etna::GraphicsPipeline depthPipeline;
+  etna::GraphicsPipeline storePipeline;
+  etna::ComputePipeline resolvePipeline;
+
+  struct Frame
+  {
+    etna::Buffer depths;
+    etna::Buffer colors;
+    etna::Image accum;
+    etna::Image revealage;
+  };
+
+  renderer::FrameRing<Frame> frames;
+  uint64_t layersBytes = 0; // of each buffer
+};
+
+// see SortedBlend.glsl
+struct BlendInstance
+{
+  glm::mat4 model;
+  glm::mat4 normalTransform;
+  glm::vec4 center;
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  uint32_t vertexOffset;
+  uint32_t materialGroup;
+};
+
+// Blend instances drawn with ordinary hardware blending, for scenes where transparent objects rarely
+// intersect. Every frame a compute pass writes a key per instance from the view depth of its bounds center,
+// RadixSort orders them back to front and a second pass turns the sorted ids into indirect draw commands,
+// drawn by a single indirect draw over the color target. The order is per instance, intersecting or self
+// overlapping instances blend out of order. Shades from the MaterialTable. Uses the programs prog_prefix,
+// prog_prefix + "_keys", "_commands" and the RadixSort programs of sort_prog_prefix.
+struct SortedInstanceRenderer
+{
+  SortedInstanceRenderer(const std::string &prog_prefix, const std::string &sort_prog_prefix,
+    const etna::Image &depthRT);
+
+  // one instance per transform of every draw call of draw_list
+  void attachToScene(const SortedScene &draw_list);
+
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const SortedScene &draw_list,
+    const etna::Image &target);
+
+  uint32_t getInstancesCount() const { return instancesCount; }
+  uint64_t getMemoryBytes() const;
+
+private:
+  const etna::Buffer &writeInstances(const GlobalFrameConstantHandler &gframe, const GLTFScene &scene,
+    const SortedScene &draw_list);
+  void dispatchInstances(etna::SyncCommandBuffer &cmd, const etna::ComputePipeline &pipeline,
+    const std::vector<etna::Binding> &bindings);
+
+  struct Frame
+  {
+    etna::Buffer instances; // BlendInstance
+    etna::Buffer keys;
+    etna::Buffer sortedIds;
+    etna::Buffer commands;
+  };
+
+  void growFrame(Frame &frame);
+
+  etna::GraphicsPipeline pipeline;
+  etna::ComputePipeline keysPipeline;
+  etna::ComputePipeline commandsPipeline;
+  renderer::RadixSort sorter;
+  MaterialTable materials;
+
+  renderer::FrameRing<Frame> frames;
+  uint32_t instancesCount = 0;
+};
+
+struct TransparencyStats
+{
+  double lastGpuMs = 0.0; // draw and resolve
+  double avgGpuMs = 0.0;
+  uint32_t samples = 0;
+  uint64_t memoryBytes = 0; // buffers and targets of the mode
+};
+
+// Renders Blend materials with a runtime selected technique. Resources of all modes stay allocated, so
+// switching is immediate and the modes can be compared on the same frames.
+// Uses the programs abuffer_render, abuffer_resolve_k*, abuffer_prefix_*, abuffer_deferred_*,
+// abuffer_synthetic, abuffer_tiles, transparency_*, oit_*, sorted_blend* and radix_sort_* created by the
+// application.
+struct TransparencyRenderer
+{
+  TransparencyRenderer(const etna::Image &depthRT);
+
+  void attachToScene(const GLTFScene &scene, const VirtualTextureSystem &vt);
+  void onResolutionChanged(uint32_t w, uint32_t h);
+
+  // Composites the transparent layers over color, the RGBA16F color target with storage usage.
+  // Expects cmd out of any render pass.
+  void render(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const etna::Image &color);
+
+  // tiles with transparent fragments, classified in the A-buffer modes only
+  const TileClassifier &getTiles() const { return halfResolution ? *halfResTiles : *tiles; }
+
+  void setMode(TransparencyMode new_mode);
+  TransparencyMode getMode() const { return mode; }
+
+  // Renders frames_per_mode measured frames in every mode, logs the results and returns to the
+  // current mode. Mode changes are ignored meanwhile.
+  void startBenchmark(uint32_t frames_per_mode);
+  bool isBenchmarkRunning() const { return benchmark.has_value(); }
+
+  // Times the linked list resolve with every ABUFFER_RESOLVE_LAYERS kernel on synthetic lists of
+  // RESOLVE_BENCHMARK_DEPTHS fragments per pixel and logs the results
+  void startResolveBenchmark();
+  bool isResolveBenchmarkRunning() const { return resolveBenchmark != nullptr; }
+
+  // Renders and resolves the linked list A-buffer at half resolution, see HalfResolutionTransparency
+  void setHalfResolution(bool enable);
+  bool getHalfResolution() const { return halfResolution; }
+
+  // sorted layers of the linked list A-buffer resolve, one of ABUFFER_RESOLVE_LAYERS
+  void setResolveLayers(uint32_t layers) { abufferResolver->setLayers(layers); }
+  uint32_t getResolveLayers() const { return abufferResolver->getLayers(); }
+
+  const TransparencyStats &getStats(TransparencyMode m) const { return stats[uint32_t(m)]; }
+  const ABufferStats &getABufferStats() const { return getABufferRenderer().getStats(); }
+  const ABufferStats &getPrefixSumStats() const { return prefixSumRenderer->getStats(); }
+  const ABufferStats &getDeferredStats() const { return deferredRenderer->getStats(); }
+  uint32_t getSortedInstancesCount() const { return sortedRenderer->getInstancesCount(); }
+
+private:
+  struct Benchmark
+  {
+    uint32_t framesPerMode;
+    uint32_t modeIndex = 0;
+    TransparencyMode restoreMode;
+    std::array<double, TRANSPARENCY_MODES_COUNT> sumMs {};
+    std::array<uint32_t, TRANSPARENCY_MODES_COUNT> samples {};
+  };
+
+  struct ResolveBenchmark
+  {
+    etna::Image listHead;
+    etna::Buffer fragmentList;
+    etna::Image target;
+    std::unique_ptr<TileClassifier> tiles; // all tiles
+    std::optional<uint64_t> recordFrame;
+  };
+
+  void switchMode(TransparencyMode new_mode);
+  void renderABuffer(etna::SyncCommandBuffer &cmd,
+    const etna::Image &depthRT,
+    const GlobalFrameConstantHandler &gframe,
+    const GLTFScene &scene,
+    const etna::Image &color);
+  const ABufferRenderer &getABufferRenderer() const
+  {
+    return halfResolution ? *halfResABufferRenderer : *abufferRenderer;
+  }
+  void updateStats();
+  void updateResolveBenchmark(etna::SyncCommandBuffer &cmd);
+  uint64_t getMemoryBytes(TransparencyMode m) const;
+
+  std::unique_ptr<ABufferRenderer> abufferRenderer;
+  std::unique_ptr<ABufferResolver> abufferResolver;
+  std::unique_ptr<PrefixSumABufferRenderer> prefixSumRenderer;
+  std::unique_ptr<DeferredABufferRenderer> deferredRenderer;
+  std::unique_ptr<WeightedBlendedRenderer> weightedRenderer;
+  std::unique_ptr<MomentRenderer> momentRenderer;
+  std::unique_ptr<KBufferRenderer> kbufferRenderer;
+  std::unique_ptr<SortedInstanceRenderer> sortedRenderer;
+  std::unique_ptr<TileClassifier> tiles;
+
+  std::unique_ptr<HalfResolutionTransparency> halfRes;
+  std::unique_ptr<ABufferRenderer> halfResABufferRenderer;
+  std::unique_ptr<TileClassifier> halfResTiles;
+  bool halfResolution = false;
+
+  SortedScene sceneData;
+  const VirtualTextureSystem *virtualTextures = nullptr;
+  glm::uvec2 resolution {0, 0};
+
+  etna::ComputePipeline syntheticPipeline;
+  std::unique_ptr<ResolveBenchmark> resolveBenchmark;
+  uint64_t frameIndex = 0;
+
+  TransparencyMode mode = TransparencyMode::ABuffer;
+  uint32_t modeFrames = 0; // rendered in the current mode
+
+  renderer::GpuTimer timer {64}; // the resolve benchmark records all its runs in one frame
+  std::array<TransparencyStats, TRANSPARENCY_MODES_COUNT> stats;
+  std::optional<Benchmark> benchmark;
+};
+
+} // namespace scene
+
+#endif
@@ -0,0 +1,184 @@
+#include "VTFile.hpp"
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace scene
+{
+
+static constexpr char VT_FILE_MAGIC[4] {'V', 'T', 'X', '1'};
+
+struct VTFileHeader
+{
+  char magic[4];
+  uint32_t vkFormat;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelsCount;
+  uint32_t pageBytes;
+};
+
+static uint32_t get_pages_count(uint32_t size)
+{
+  return (size + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+// levels down to the first one covered by a single page
+static uint32_t get_vt_levels_count(uint32_t width, uint32_t height, uint32_t texture_levels)
+{
+  uint32_t count = 1;
+  while (count < texture_levels && std::max(width >> (count - 1), height >> (count - 1)) > VT_PAGE_SIZE)
+    count++;
+  return count;
+}
+
+static size_t get_data_offset(uint32_t levels_count)
+{
+  size_t offset = sizeof(VTFileHeader) + levels_count * sizeof(VTFile::Level);
+  return (offset + 15) & ~size_t(15);
+}
+
+bool VTFile::canBuild(const TextureData &texture)
+{
+  if (texture.levels.empty() || vk::blockExtent(texture.format)[0] > VT_PAGE_BORDER)
+    return false;
+  uint32_t levelsCount = get_vt_levels_count(texture.width, texture.height, uint32_t(texture.levels.size()));
+  return levelsCount <= VT_MAX_LEVELS 
+    && get_pages_count(texture.width) <= VT_MAX_PAGES 
+    && get_pages_count(texture.height) <= VT_MAX_PAGES
+    && std::max(texture.levels[levelsCount - 1].width, texture.levels[levelsCount - 1].height) <= VT_PAGE_SIZE;
+}
+
+std::vector<uint8_t> VTFile::build(const TextureData &texture)
+{
+  auto blockExtent = vk::blockExtent(texture.format);
+  uint32_t blockSize = vk::blockSize(texture.format);
+  uint32_t pageBlocks = VT_PAGE_STRIDE / blockExtent[0];
+  uint32_t borderBlocks = VT_PAGE_BORDER / blockExtent[0];
+  uint32_t payloadBlocks = VT_PAGE_SIZE / blockExtent[0];
+  size_t pageBytes = get_level_size(texture.format, VT_PAGE_STRIDE, VT_PAGE_STRIDE);
+
+  uint32_t levelsCount = get_vt_levels_count(texture.width, texture.height, uint32_t(texture.levels.size()));
+  std::vector<Level> levels;
+  uint32_t pagesCount = 0;
+  for (uint32_t level = 0; level < levelsCount; level++)
+  {
+    Level info {
+      .pagesX = get_pages_count(texture.levels[level].width),
+      .pagesY = get_pages_count(texture.levels[level].height),
+      .firstPage = pagesCount
+    };
+    pagesCount += info.pagesX * info.pagesY;
+    levels.push_back(info);
+  }
+
+  size_t dataOffset = get_data_offset(levelsCount);
+  std::vector<uint8_t> file(dataOffset + pagesCount * pageBytes);
+
+  VTFileHeader header {
+    .magic = {VT_FILE_MAGIC[0], VT_FILE_MAGIC[1], VT_FILE_MAGIC[2], VT_FILE_MAGIC[3]},
+    .vkFormat = uint32_t(texture.format),
+    .width = texture.width,
+    .height = texture.height,
+    .levelsCount = levelsCount,
+    .pageBytes = uint32_t(pageBytes)
+  };
+  std::memcpy(file.data(), &header, sizeof(header));
+  std::memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(Level));
+
+  for (uint32_t level = 0; level < levelsCount; level++)
+  {
+    const auto &src = texture.levels[level];
+    auto srcData = texture.getLevelData(level);
+    uint32_t blocksX = (src.width + blockExtent[0] - 1) / blockExtent[0];
+    uint32_t blocksY = (src.height + blockExtent[1] - 1) / blockExtent[1];
+
+    for (uint32_t py = 0; py < levels[level].pagesY; py++)
+    {
+      for (uint32_t px = 0; px < levels[level].pagesX; px++)
+      {
+        uint32_t pageId = levels[level].firstPage + py * levels[level].pagesX + px;
+        uint8_t *dst = file.data() + dataOffset + pageId * pageBytes;
+
+        // borders and pages past the level edge wrap around, as the repeat sampler would
+        for (uint32_t by = 0; by < pageBlocks; by++)
+        {
+          uint32_t srcY = (py * payloadBlocks + by + blocksY - borderBlocks) % blocksY;
+          const uint8_t *srcRow = srcData.data() + size_t(srcY) * blocksX * blockSize;
+          for (uint32_t bx = 0; bx < pageBlocks; bx++)
+          {
+            uint32_t srcX = (px * payloadBlocks + bx + blocksX - borderBlocks) % blocksX;
+            std::memcpy(dst, srcRow + size_t(srcX) * blockSize, blockSize);
+            dst += blockSize;
+          }
+        }
+      }
+    }
+  }
+
+  return file;
+}
+
+std::optional<VTFile> VTFile::open(const std::string &path, std::string &err)
+{
+  auto mapping = MappedFile::open(path);
+  if (!mapping)
+  {
+    err = "failed to open " + path;
+    return std::nullopt;
+  }
+
+  auto data = mapping->getData();
+  VTFileHeader header;
+  if (data.size() < sizeof(header))
+  {
+    err = "truncated header";
+    return std::nullopt;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, VT_FILE_MAGIC, 4) != 0 || header.levelsCount == 0 
+    || header.levelsCount > VT_MAX_LEVELS)
+  {
+    err = "not a VT file";
+    return std::nullopt;
+  }
+
+  VTFile file;
+  file.format = vk::Format(header.vkFormat);
+  file.width = header.width;
+  file.height = header.height;
+  file.pageBytes = header.pageBytes;
+  file.dataOffset = get_data_offset(header.levelsCount);
+  file.levels.resize(header.levelsCount);
+
+  if (file.dataOffset > data.size())
+  {
+    err = "truncated level index";
+    return std::nullopt;
+  }
+  std::memcpy(file.levels.data(), data.data() + sizeof(header), header.levelsCount * sizeof(Level));
+
+  const auto &last = file.levels.back();
+  size_t pagesCount = last.firstPage + last.pagesX * last.pagesY;
+  if (file.pageBytes != get_level_size(file.format, VT_PAGE_STRIDE, VT_PAGE_STRIDE)
+    || file.dataOffset + pagesCount * file.pageBytes > data.size())
+  {
+    err = "page data is out of file bounds";
+    return std::nullopt;
+  }
+
+  file.mapping = std::move(*mapping);
+  return file;
+}
+
+std::span<const uint8_t> VTFile::getPage(uint32_t level, uint32_t x, uint32_t y) const
+{
+  const auto &info = levels[level];
+  size_t pageId = info.firstPage + y * info.pagesX + x;
+  return mapping.getData().subspan(dataOffset + pageId * pageBytes, pageBytes);
+}
+
+} // namespace scene
@@ -0,0 +1,62 @@
+#ifndef SCENE_VT_FILE_HPP_INCLUDED
+#define SCENE_VT_FILE_HPP_INCLUDED
+
+#include "TextureData.hpp"
+
+#include <optional>
+#include <string>
+
+namespace scene
+{
+
+// keep in sync with VT.glsl
+constexpr uint32_t VT_PAGE_SIZE = 128; // texels of payload per page side
+constexpr uint32_t VT_PAGE_BORDER = 4; // texels of border on each side, one block of BC formats
+constexpr uint32_t VT_PAGE_STRIDE = VT_PAGE_SIZE + 2 * VT_PAGE_BORDER;
+constexpr uint32_t VT_MAX_LEVELS = 16;
+constexpr uint32_t VT_MAX_PAGES = 512; // per side of level 0
+
+// Tiled texture for virtual texturing. Every level is split into VT_PAGE_SIZE pages with borders
+// wrapped from the neighbours, levels go down to the first one that fits a single page.
+// Pages have the same size in bytes and are stored level by level, row by row, so any page
+// is read with a single pread or straight from a mapping.
+struct VTFile
+{
+  struct Level
+  {
+    uint32_t pagesX;
+    uint32_t pagesY;
+    uint32_t firstPage;
+  };
+
+  // nullopt with err set if the file is missing or malformed
+  static std::optional<VTFile> open(const std::string &path, std::string &err);
+
+  // tiles texture into the file layout, the texture needs a complete mip chain
+  static std::vector<uint8_t> build(const TextureData &texture);
+
+  // false if the texture is too large or has no levels to tile
+  static bool canBuild(const TextureData &texture);
+
+  vk::Format getFormat() const { return format; }
+  uint32_t getWidth() const { return width; }
+  uint32_t getHeight() const { return height; }
+  uint32_t getLevelsCount() const { return uint32_t(levels.size()); }
+  const Level &getLevel(uint32_t level) const { return levels[level]; }
+  size_t getPageBytes() const { return pageBytes; }
+
+  std::span<const uint8_t> getPage(uint32_t level, uint32_t x, uint32_t y) const;
+
+private:
+  vk::Format format = vk::Format::eUndefined;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t pageBytes = 0;
+  size_t dataOffset = 0;
+  std::vector<Level> levels;
+  MappedFile mapping;
+};
+
+} // namespace scene
+
+#endif
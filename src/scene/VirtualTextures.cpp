@@ -0,0 +1,623 @@
+#include "VirtualTextures.hpp"
+#include "util/Hash.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <etna/GlobalContext.hpp>
+#include <etna/RenderTargetStates.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace scene
+{
+
+static constexpr uint32_t VT_NO_PAGE = UINT32_MAX; // also VT_FEEDBACK_NONE in VT.glsl
+static constexpr uint32_t VT_NO_SLOT = UINT32_MAX;
+static constexpr uint32_t VT_MAX_TEXTURES = 1u << 10;
+static constexpr size_t FEEDBACK_HEADER_SIZE = 4 * sizeof(uint32_t);
+
+// same layout as vt_pack_page in VT.glsl
+struct VTPage
+{
+  uint32_t vtId;
+  uint32_t level;
+  uint32_t x;
+  uint32_t y;
+};
+
+static uint32_t pack_page(const VTPage &page)
+{
+  return (page.vtId << 22) | (page.level << 18) | (page.x << 9) | page.y;
+}
+
+static VTPage unpack_page(uint32_t page)
+{
+  return {page >> 22, (page >> 18) & 0xF, (page >> 9) & 0x1FF, page & 0x1FF};
+}
+
+// uvec4(page cache x, page cache y, mapped level, valid) as R8G8B8A8Uint
+static uint32_t pack_page_table_entry(uint32_t slot_x, uint32_t slot_y, uint32_t level)
+{
+  return slot_x | (slot_y << 8) | (level << 16) | (1u << 24);
+}
+
+static std::optional<VTFile> open_or_build(const std::filesystem::path &path, const TextureData &texture)
+{
+  std::string err;
+  if (std::filesystem::exists(path))
+  {
+    auto file = VTFile::open(path.string(), err);
+    if (file)
+      return file;
+    spdlog::warn("Virtual textures : {} is invalid ({}), rebuilding", path.string(), err);
+  }
+
+  auto bytes = VTFile::build(texture);
+
+  // write then rename like the texture cache, a partial file is never opened
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size()));
+    if (!out)
+    {
+      spdlog::warn("Virtual textures : failed to write {}", tmpPath.string());
+      return std::nullopt;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec)
+  {
+    spdlog::warn("Virtual textures : failed to store {} : {}", path.string(), ec.message());
+    return std::nullopt;
+  }
+
+  auto file = VTFile::open(path.string(), err);
+  if (!file)
+    spdlog::warn("Virtual textures : failed to open {} : {}", path.string(), err);
+  return file;
+}
+
+VirtualTextureSystem::VirtualTextureSystem(const std::string &feedback_prog_name, GLTFScene &vt_scene,
+  glm::uvec2 resolution, const VirtualTextureConfig &vt_config)
+  : scene {vt_scene}, config {vt_config}
+{
+  ETNA_ASSERT(config.cachePagesPerSide > 0 && config.cachePagesPerSide <= 256);
+  auto &ctx = etna::get_context();
+
+  std::error_code ec;
+  std::filesystem::create_directories(config.cacheDir, ec);
+
+  virtualIds.resize(scene.images.size());
+  for (uint32_t imageId = 0; imageId < scene.streamSources.size(); imageId++)
+  {
+    auto &src = scene.streamSources[imageId];
+    if (!src.has_value() || std::max(src->width, src->height) < config.minSize || !VTFile::canBuild(*src))
+      continue;
+
+    if (textures.size() >= VT_MAX_TEXTURES)
+    {
+      spdlog::warn("Virtual textures : more than {} candidates, the rest stays streamed", VT_MAX_TEXTURES);
+      break;
+    }
+
+    // the file is named after the content, stale tilings are never picked up
+    char name[32];
+    uint64_t key = util::hash_combine(util::hash_bytes(src->getLevelData(0)), uint64_t(src->format));
+    std::snprintf(name, sizeof(name), "%016llx.vtex", static_cast<unsigned long long>(key));
+
+    auto file = open_or_build(std::filesystem::path(config.cacheDir) / name, *src);
+    if (!file)
+      continue;
+
+    auto cacheIt = cacheIds.find(file->getFormat());
+    if (cacheIt == cacheIds.end())
+    {
+      uint32_t side = config.cachePagesPerSide * VT_PAGE_STRIDE;
+      uint32_t slots = config.cachePagesPerSide * config.cachePagesPerSide;
+      caches.push_back(PageCache {
+        .image = ctx.createImage(etna::ImageCreateInfo::image2D(side, side, file->getFormat())),
+        .pagesPerSide = config.cachePagesPerSide,
+        .slotPages = std::vector<uint32_t>(slots, VT_NO_PAGE),
+        .slotLastUsed = std::vector<uint64_t>(slots, 0)
+      });
+      cacheIt = cacheIds.emplace(file->getFormat(), uint32_t(caches.size() - 1)).first;
+    }
+
+    // page table levels are power of two sized, so every level covers the pages of its virtual level
+    const auto &base = file->getLevel(0);
+    uint32_t tableW = std::bit_ceil(base.pagesX);
+    uint32_t tableH = std::bit_ceil(base.pagesY);
+    ETNA_ASSERT(file->getLevelsCount() <= uint32_t(std::bit_width(std::max(tableW, tableH))));
+
+    auto tableInfo = etna::ImageCreateInfo::image2D(tableW, tableH, vk::Format::eR8G8B8A8Uint);
+    tableInfo.mipLevels = file->getLevelsCount();
+
+    VirtualTexture vt {
+      .imageId = imageId,
+      .file = std::move(*file),
+      .cacheId = cacheIt->second,
+      .pageTable = ctx.createImage(std::move(tableInfo))
+    };
+
+    for (uint32_t level = 0; level < vt.file.getLevelsCount(); level++)
+    {
+      const auto &l = vt.file.getLevel(level);
+      vt.slots.emplace_back(l.pagesX * l.pagesY, VT_NO_SLOT);
+    }
+
+    // the regular image keeps its mip tail as the fallback, the streamer no longer sees the texture
+    src.reset();
+    virtualIds[imageId] = uint32_t(textures.size());
+    textures.push_back(std::move(vt));
+  }
+
+  stubPageCache = ctx.createImage(etna::ImageCreateInfo::image2D(1, 1, vk::Format::eR8G8B8A8Unorm));
+  stubPageTable = ctx.createImage(etna::ImageCreateInfo::image2D(1, 1, vk::Format::eR8G8B8A8Uint));
+
+  // borders are in the pages, clamping only matters at the page cache edges
+  vk::SamplerCreateInfo cacheSamplerInfo {
+    .magFilter = vk::Filter::eLinear,
+    .minFilter = vk::Filter::eLinear,
+    .mipmapMode = vk::SamplerMipmapMode::eNearest,
+    .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+    .maxLod = 0.f
+  };
+  pageCacheSampler = ctx.getDevice().createSamplerUnique(cacheSamplerInfo).value;
+
+  vk::SamplerCreateInfo tableSamplerInfo {
+    .magFilter = vk::Filter::eNearest,
+    .minFilter = vk::Filter::eNearest,
+    .mipmapMode = vk::SamplerMipmapMode::eNearest,
+    .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+    .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+    .maxLod = VK_LOD_CLAMP_NONE
+  };
+  pageTableSampler = ctx.getDevice().createSamplerUnique(tableSamplerInfo).value;
+
+  etna::GraphicsPipeline::CreateInfo info {};
+  info.vertexShaderInput = scene::Vertex::getDesc();
+  info.fragmentShaderOutput.colorAttachmentFormats.clear();
+  info.fragmentShaderOutput.depthAttachmentFormat = vk::Format::eD32Sfloat;
+  info.blendingConfig.attachments.clear();
+  info.depthConfig.depthWriteEnable = VK_TRUE;
+  info.depthConfig.depthCompareOp = vk::CompareOp::eLess;
+  feedbackPipeline = ctx.getPipelineManager().createGraphicsPipeline(feedback_prog_name, info);
+
+  sceneData = scene.queryDrawCalls([](const GLTFScene::Material &) { return true; });
+  onResolutionChanged(resolution);
+
+  spdlog::info("Virtual textures : {} textures, {} page caches of {}x{} pages",
+    textures.size(), caches.size(), config.cachePagesPerSide, config.cachePagesPerSide);
+}
+
+VirtualTextureSystem::~VirtualTextureSystem()
+{
+  // load batches write into staging memory owned by this object
+  for (auto &batch : batches)
+  {
+    while (!batch->ready.load(std::memory_order_acquire))
+      std::this_thread::yield();
+    batch->staging.unmap();
+  }
+  etna::get_context().getQueue().waitIdle();
+}
+
+void VirtualTextureSystem::onResolutionChanged(glm::uvec2 resolution)
+{
+  auto &ctx = etna::get_context();
+  feedbackResolution = glm::max(resolution / config.feedbackDivisor, glm::uvec2(1));
+
+  feedbackDepth = ctx.createImage(etna::ImageCreateInfo::depthRT(
+    feedbackResolution.x, feedbackResolution.y, vk::Format::eD32Sfloat));
+
+  size_t pixels = size_t(feedbackResolution.x) * feedbackResolution.y;
+  feedbackBuffers.clear();
+  for (uint32_t i = 0; i < ctx.getNumFramesInFlight(); i++)
+  {
+    auto buffer = ctx.createBuffer(etna::Buffer::CreateInfo {
+      .size = FEEDBACK_HEADER_SIZE + pixels * sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_GPU_TO_CPU
+    });
+
+    // the shader only writes covered pixels, the rest stays VT_NO_PAGE
+    auto *data = reinterpret_cast<uint32_t *>(buffer.map());
+    std::memset(data, 0xFF, FEEDBACK_HEADER_SIZE + pixels * sizeof(uint32_t));
+    data[0] = feedbackResolution.x;
+    buffer.unmap();
+
+    feedbackBuffers.push_back(std::move(buffer));
+  }
+}
+
+std::optional<uint32_t> VirtualTextureSystem::getVirtualId(std::optional<uint32_t> tex_id) const
+{
+  if (!tex_id.has_value())
+    return std::nullopt;
+  auto [imageId, samplerId] = scene.getImageSamplerId(*tex_id);
+  return imageId < virtualIds.size() ? virtualIds[imageId] : std::nullopt;
+}
+
+glm::uvec4 VirtualTextureSystem::getShaderParams(std::optional<uint32_t> vt_id) const
+{
+  if (!vt_id.has_value())
+    return glm::uvec4(0);
+  const auto &file = textures[*vt_id].file;
+  return glm::uvec4(*vt_id, file.getWidth(), file.getHeight(), file.getLevelsCount());
+}
+
+glm::uvec4 VirtualTextureSystem::bindTexture(std::vector<etna::Binding> &bindings, uint32_t first_binding,
+  std::optional<uint32_t> tex_id) const
+{
+  auto vtId = getVirtualId(tex_id);
+  const etna::Image *pages = &stubPageCache;
+  const etna::Image *pageTable = &stubPageTable;
+
+  if (vtId.has_value())
+  {
+    pages = &caches[textures[*vtId].cacheId].image;
+    pageTable = &textures[*vtId].pageTable;
+  }
+
+  bindings.push_back(etna::Binding {first_binding, pages->genBinding(
+    pageCacheSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal, pages->fullRangeView())});
+  bindings.push_back(etna::Binding {first_binding + 1, pageTable->genBinding(
+    pageTableSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal, pageTable->fullRangeView())});
+  return getShaderParams(vtId);
+}
+
+void VirtualTextureSystem::update(etna::SyncCommandBuffer &cmd)
+{
+  frameIndex++;
+
+  // staging buffers retired this many frames ago are no longer used by the GPU
+  uint32_t framesInFlight = etna::get_context().getNumFramesInFlight();
+  while (!retired.empty() && retired.front().frame + framesInFlight <= frameIndex)
+    retired.pop_front();
+
+  if (textures.empty())
+    return;
+
+  finishLoads(cmd);
+  readFeedback();
+  startLoads();
+  uploadPageTables(cmd);
+}
+
+void VirtualTextureSystem::readFeedback()
+{
+  // the slot of the current frame was last written frames in flight ago and is complete by now
+  auto &buffer = feedbackBuffers[frameIndex % feedbackBuffers.size()];
+  auto *data = reinterpret_cast<uint32_t *>(buffer.map());
+  size_t pixels = size_t(feedbackResolution.x) * feedbackResolution.y;
+
+  std::unordered_set<uint32_t> pages;
+  uint32_t last = VT_NO_PAGE;
+  for (size_t i = 0; i < pixels; i++)
+  {
+    uint32_t page = data[4 + i];
+    if (page != VT_NO_PAGE && page != last)
+      pages.insert(page);
+    last = page;
+  }
+
+  std::memset(data + 4, 0xFF, pixels * sizeof(uint32_t));
+  buffer.unmap();
+
+  missingPages.clear();
+  for (auto page : pages)
+    requestPage(page);
+
+  // the last level is the fallback of every page and is never evicted
+  for (uint32_t vtId = 0; vtId < textures.size(); vtId++)
+    requestPage(pack_page({vtId, textures[vtId].file.getLevelsCount() - 1, 0, 0}));
+}
+
+void VirtualTextureSystem::requestPage(uint32_t page)
+{
+  auto p = unpack_page(page);
+  if (p.vtId >= textures.size())
+    return;
+
+  const auto &vt = textures[p.vtId];
+  const auto &file = vt.file;
+  if (p.level >= file.getLevelsCount() || p.x >= file.getLevel(p.level).pagesX || p.y >= file.getLevel(p.level).pagesY)
+    return;
+
+  // ancestors keep the fallback chain warm, so pages are never sampled from far coarser levels
+  for (;;)
+  {
+    uint32_t packed = pack_page(p);
+    if (auto it = residentPages.find(packed); it != residentPages.end())
+      caches[vt.cacheId].slotLastUsed[it->second] = frameIndex;
+    else if (!loadingPages.contains(packed))
+      missingPages.insert(packed);
+
+    if (p.level + 1 >= file.getLevelsCount())
+      break;
+
+    const auto &parent = file.getLevel(p.level + 1);
+    p.level++;
+    p.x = std::min(p.x / 2, parent.pagesX - 1);
+    p.y = std::min(p.y / 2, parent.pagesY - 1);
+  }
+}
+
+std::optional<uint32_t> VirtualTextureSystem::allocateSlot(PageCache &cache)
+{
+  std::optional<uint32_t> victim;
+  for (uint32_t slot = 0; slot < cache.slotPages.size(); slot++)
+  {
+    uint32_t page = cache.slotPages[slot];
+    if (page == VT_NO_PAGE)
+      return slot;
+
+    // loading and pinned pages, and pages used by this frame stay
+    auto p = unpack_page(page);
+    if (loadingPages.contains(page) || cache.slotLastUsed[slot] == frameIndex
+      || p.level + 1 == textures[p.vtId].file.getLevelsCount())
+      continue;
+
+    if (!victim.has_value() || cache.slotLastUsed[slot] < cache.slotLastUsed[*victim])
+      victim = slot;
+  }
+
+  if (!victim.has_value())
+    return std::nullopt;
+
+  uint32_t page = cache.slotPages[*victim];
+  auto p = unpack_page(page);
+  auto &vt = textures[p.vtId];
+  vt.slots[p.level][p.y * vt.file.getLevel(p.level).pagesX + p.x] = VT_NO_SLOT;
+  vt.dirty = true;
+  residentPages.erase(page);
+  cache.slotPages[*victim] = VT_NO_PAGE;
+  return victim;
+}
+
+void VirtualTextureSystem::startLoads()
+{
+  if (missingPages.empty())
+    return;
+
+  // coarse levels first, they are the fallback of everything finer
+  std::vector<uint32_t> requests(missingPages.begin(), missingPages.end());
+  std::sort(requests.begin(), requests.end(), [](uint32_t a, uint32_t b) {
+    auto pa = unpack_page(a);
+    auto pb = unpack_page(b);
+    return pa.level != pb.level ? pa.level > pb.level : a < b;
+  });
+
+  auto batch = std::make_unique<LoadBatch>();
+  size_t stagingSize = 0;
+  for (auto page : requests)
+  {
+    if (batch->pages.size() >= config.pagesPerFrame)
+      break;
+
+    auto p = unpack_page(page);
+    auto &vt = textures[p.vtId];
+    auto &cache = caches[vt.cacheId];
+    auto slot = allocateSlot(cache);
+    if (!slot.has_value())
+      continue; // the cache of this format is full with pages in use
+
+    cache.slotPages[*slot] = page;
+    cache.slotLastUsed[*slot] = frameIndex;
+    loadingPages.emplace(page, *slot);
+
+    stagingSize = (stagingSize + 15) & ~size_t(15);
+    batch->pages.push_back(PageLoad {page, *slot, stagingSize});
+    stagingSize += vt.file.getPageBytes();
+  }
+
+  if (batch->pages.empty())
+    return;
+
+  batch->staging = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+    .size = stagingSize,
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+  });
+  pendingPages += uint32_t(batch->pages.size());
+
+  // page faults on the mapped files stay off the render thread
+  util::get_thread_pool().submit([this, batch = batch.get(), dst = batch->staging.map()]() {
+    for (auto &load : batch->pages)
+    {
+      auto p = unpack_page(load.page);
+      auto src = textures[p.vtId].file.getPage(p.level, p.x, p.y);
+      std::memcpy(dst + load.stagingOffset, src.data(), src.size());
+    }
+    batch->ready.store(true, std::memory_order_release);
+  });
+
+  batches.push_back(std::move(batch));
+}
+
+void VirtualTextureSystem::finishLoads(etna::SyncCommandBuffer &cmd)
+{
+  for (auto it = batches.begin(); it != batches.end();)
+  {
+    auto &batch = **it;
+    if (!batch.ready.load(std::memory_order_acquire))
+    {
+      it++;
+      continue;
+    }
+
+    batch.staging.unmap();
+
+    std::vector<std::vector<vk::BufferImageCopy>> regions(caches.size());
+    for (auto &load : batch.pages)
+    {
+      auto p = unpack_page(load.page);
+      auto &vt = textures[p.vtId];
+      uint32_t side = caches[vt.cacheId].pagesPerSide;
+
+      regions[vt.cacheId].push_back(vk::BufferImageCopy {
+        .bufferOffset = load.stagingOffset,
+        .imageSubresource {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
+        .imageOffset {int32_t(load.slot % side * VT_PAGE_STRIDE), int32_t(load.slot / side * VT_PAGE_STRIDE), 0},
+        .imageExtent {VT_PAGE_STRIDE, VT_PAGE_STRIDE, 1}
+      });
+
+      loadingPages.erase(load.page);
+      residentPages.emplace(load.page, load.slot);
+      vt.slots[p.level][p.y * vt.file.getLevel(p.level).pagesX + p.x] = load.slot;
+      vt.dirty = true;
+    }
+
+    for (uint32_t cacheId = 0; cacheId < caches.size(); cacheId++)
+    {
+      if (!regions[cacheId].empty())
+        cmd.copyBufferToImage(batch.staging, caches[cacheId].image, vk::ImageLayout::eTransferDstOptimal,
+          regions[cacheId]);
+    }
+
+    pendingPages -= uint32_t(batch.pages.size());
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(batch.staging)});
+    it = batches.erase(it);
+  }
+}
+
+void VirtualTextureSystem::uploadPageTables(etna::SyncCommandBuffer &cmd)
+{
+  for (auto &vt : textures)
+  {
+    if (!vt.dirty)
+      continue;
+    vt.dirty = false;
+
+    const auto &tableExtent = vt.pageTable.getInfo().extent;
+    uint32_t side = caches[vt.cacheId].pagesPerSide;
+    uint32_t levelsCount = vt.file.getLevelsCount();
+
+    std::vector<size_t> offsets(levelsCount);
+    size_t size = 0;
+    for (uint32_t level = 0; level < levelsCount; level++)
+    {
+      offsets[level] = size;
+      size += size_t(std::max(tableExtent.width >> level, 1u)) * std::max(tableExtent.height >> level, 1u);
+    }
+
+    auto staging = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = size * sizeof(uint32_t),
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    });
+    auto *entries = reinterpret_cast<uint32_t *>(staging.map());
+
+    // from coarse to fine, missing pages take the entry of their parent
+    std::vector<vk::BufferImageCopy> regions;
+    for (uint32_t level = levelsCount; level-- > 0;)
+    {
+      uint32_t w = std::max(tableExtent.width >> level, 1u);
+      uint32_t h = std::max(tableExtent.height >> level, 1u);
+      const auto &pages = vt.file.getLevel(level);
+      uint32_t *dst = entries + offsets[level];
+
+      for (uint32_t y = 0; y < h; y++)
+      {
+        for (uint32_t x = 0; x < w; x++)
+        {
+          uint32_t entry = 0;
+          if (x < pages.pagesX && y < pages.pagesY)
+          {
+            uint32_t slot = vt.slots[level][y * pages.pagesX + x];
+            if (slot != VT_NO_SLOT)
+            {
+              entry = pack_page_table_entry(slot % side, slot / side, level);
+            }
+            else if (level + 1 < levelsCount)
+            {
+              const auto &parent = vt.file.getLevel(level + 1);
+              uint32_t parentW = std::max(tableExtent.width >> (level + 1), 1u);
+              uint32_t px = std::min(x / 2, parent.pagesX - 1);
+              uint32_t py = std::min(y / 2, parent.pagesY - 1);
+              entry = entries[offsets[level + 1] + py * parentW + px];
+            }
+          }
+          dst[y * w + x] = entry;
+        }
+      }
+
+      regions.push_back(vk::BufferImageCopy {
+        .bufferOffset = offsets[level] * sizeof(uint32_t),
+        .imageSubresource {vk::ImageAspectFlagBits::eColor, level, 0, 1},
+        .imageExtent {w, h, 1}
+      });
+    }
+
+    staging.unmap();
+    cmd.copyBufferToImage(staging, vt.pageTable, vk::ImageLayout::eTransferDstOptimal, regions);
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(staging)});
+  }
+}
+
+struct FeedbackPushConstants
+{
+  glm::mat4 MVP;
+  glm::uvec4 vtBaseColor;
+  glm::uvec4 vtMetallicRoughness;
+  glm::vec4 lodBias;
+};
+
+void VirtualTextureSystem::renderFeedback(etna::SyncCommandBuffer &cmd, const GlobalFrameConstantHandler &gframe)
+{
+  if (textures.empty() || !sceneData.materialGropus.size())
+    return;
+
+  auto &buffer = feedbackBuffers[frameIndex % feedbackBuffers.size()];
+  const auto &info = etna::get_shader_program(feedbackPipeline.getShaderProgram());
+  auto set = etna::create_descriptor_set(info.getDescriptorLayoutId(0), {
+    etna::Binding {0, buffer.genBinding()}
+  });
+
+  etna::RenderingAttachment depthAttachment {
+    .view = feedbackDepth.getView({}),
+    .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+    .loadOp = vk::AttachmentLoadOp::eClear,
+    .clearValue = vk::ClearDepthStencilValue {.depth = 1.f}
+  };
+
+  etna::RenderTargetState rts {cmd, vk::Extent2D {feedbackResolution.x, feedbackResolution.y}, {}, depthAttachment};
+  cmd.bindVertexBuffer(0, scene.getVertexBuff(), 0);
+  cmd.bindIndexBuffer(scene.getIndexBuff(), 0, vk::IndexType::eUint32);
+  cmd.bindPipeline(feedbackPipeline);
+  cmd.bindDescriptorSet(vk::PipelineBindPoint::eGraphics, info.getPipelineLayout(), 0, set);
+
+  // every draw writes depth so surfaces without virtual textures still occlude
+  FeedbackPushConstants pc {.lodBias = glm::vec4(std::log2(float(config.feedbackDivisor)), 0.f, 0.f, 0.f)};
+  for (auto &group : sceneData.materialGropus)
+  {
+    auto &material = scene.getMaterial(group.materialIndex);
+    pc.vtBaseColor = getShaderParams(getVirtualId(material.baseColorId));
+    pc.vtMetallicRoughness = getShaderParams(getVirtualId(material.metallicRoughnessId));
+
+    for (auto &dc : group.drawCalls)
+    {
+      for (auto &tId : dc.transformIds)
+      {
+        pc.MVP = gframe.getParams().viewProjection * scene.getTransform(tId).modelTransform;
+        cmd.pushConstants(feedbackPipeline.getShaderProgram(), 0, pc);
+        cmd.drawIndexed(dc.indexCount, 1, dc.firstIndex, dc.vertexOffset, 0);
+      }
+    }
+  }
+}
+
+} // namespace scene
@@ -0,0 +1,144 @@
+#ifndef SCENE_VIRTUAL_TEXTURES_HPP_INCLUDED
+#define SCENE_VIRTUAL_TEXTURES_HPP_INCLUDED
+
+#include "GLTFScene.hpp"
+#include "SceneRenderer.hpp"
+#include "VTFile.hpp"
+
+#include <etna/GraphicsPipeline.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace scene
+{
+
+struct VirtualTextureConfig
+{
+  std::string cacheDir = "cache/textures"; // tiled .vtex files are written here
+  uint32_t minSize = 4096; // streamed textures this large or larger become virtual
+  uint32_t cachePagesPerSide = 32; // page cache of each format holds this squared pages
+  uint32_t pagesPerFrame = 32; // page loads started per frame
+  uint32_t feedbackDivisor = 8; // feedback pass resolution relative to the render resolution
+};
+
+// Software virtual texturing for textures that do not fit in VRAM even with mip streaming.
+//  - Textures are tiled into VTFile pages on disk, the files are mapped.
+//  - Every format has a page cache image, pages are placed into fixed slots and evicted in LRU order.
+//  - Every virtual texture has a page table image with a mip per virtual level, missing pages point
+//    to the finest resident ancestor, the single page of the last level is never evicted.
+//  - A low resolution feedback pass writes the page wanted by each pixel into a host visible buffer,
+//    it is read back once the frame is done, frames in flight later.
+//  - Pages are copied from the mapping into staging on the loader pool and uploaded when ready.
+struct VirtualTextureSystem
+{
+  // Takes the streamed textures of scene that are at least config.minSize large,
+  // create it before TextureStreamer
+  VirtualTextureSystem(const std::string &feedback_prog_name, GLTFScene &scene,
+    glm::uvec2 resolution, const VirtualTextureConfig &config = {});
+  ~VirtualTextureSystem();
+
+  VirtualTextureSystem(const VirtualTextureSystem &) = delete;
+  VirtualTextureSystem &operator=(const VirtualTextureSystem &) = delete;
+
+  void onResolutionChanged(glm::uvec2 resolution);
+
+  // Reads back feedback of the oldest frame in flight, starts page loads and uploads finished pages.
+  // Call before any material is bound in this frame.
+  void update(etna::SyncCommandBuffer &cmd);
+
+  // expects cmd out of any render pass, binds the scene vertex and index buffers
+  void renderFeedback(etna::SyncCommandBuffer &cmd, const GlobalFrameConstantHandler &gframe);
+
+  // Appends page cache and page table bindings of a material texture at first_binding and
+  // first_binding + 1, stubs for regular textures. Returns the shader parameters, see VT.glsl.
+  glm::uvec4 bindTexture(std::vector<etna::Binding> &bindings, uint32_t first_binding,
+    std::optional<uint32_t> tex_id) const;
+
+  uint32_t getVirtualTexturesCount() const { return uint32_t(textures.size()); }
+  uint32_t getResidentPages() const { return uint32_t(residentPages.size()); }
+  uint32_t getPendingPages() const { return pendingPages; }
+
+private:
+  struct PageCache
+  {
+    etna::Image image;
+    uint32_t pagesPerSide;
+    std::vector<uint32_t> slotPages; // packed page id per slot, VT_NO_PAGE if free
+    std::vector<uint64_t> slotLastUsed;
+  };
+
+  struct VirtualTexture
+  {
+    uint32_t imageId;
+    VTFile file;
+    uint32_t cacheId;
+    etna::Image pageTable;
+    std::vector<std::vector<uint32_t>> slots; // resident slot per page of every level
+    bool dirty = true;
+  };
+
+  struct PageLoad
+  {
+    uint32_t page;
+    uint32_t slot;
+    size_t stagingOffset;
+  };
+
+  struct LoadBatch
+  {
+    std::vector<PageLoad> pages;
+    etna::Buffer staging;
+    std::atomic<bool> ready = false;
+  };
+
+  struct Retired
+  {
+    uint64_t frame;
+    etna::Buffer staging;
+  };
+
+  std::optional<uint32_t> getVirtualId(std::optional<uint32_t> tex_id) const;
+  glm::uvec4 getShaderParams(std::optional<uint32_t> vt_id) const;
+  void readFeedback();
+  void requestPage(uint32_t page);
+  void startLoads();
+  void finishLoads(etna::SyncCommandBuffer &cmd);
+  void uploadPageTables(etna::SyncCommandBuffer &cmd);
+  std::optional<uint32_t> allocateSlot(PageCache &cache);
+
+  GLTFScene &scene;
+  VirtualTextureConfig config;
+
+  std::vector<VirtualTexture> textures;
+  std::vector<std::optional<uint32_t>> virtualIds; // per scene image
+  std::vector<PageCache> caches;
+  std::unordered_map<vk::Format, uint32_t> cacheIds;
+
+  std::unordered_map<uint32_t, uint32_t> residentPages; // packed page id -> slot
+  std::unordered_set<uint32_t> missingPages; // requested this frame, neither resident nor loading
+  std::unordered_map<uint32_t, uint32_t> loadingPages; // packed page id -> slot
+  uint32_t pendingPages = 0;
+
+  std::deque<std::unique_ptr<LoadBatch>> batches;
+  std::deque<Retired> retired;
+  uint64_t frameIndex = 0;
+
+  etna::GraphicsPipeline feedbackPipeline;
+  etna::Image feedbackDepth;
+  std::vector<etna::Buffer> feedbackBuffers; // one per frame in flight
+  glm::uvec2 feedbackResolution;
+  SortedScene sceneData;
+
+  etna::Image stubPageCache;
+  etna::Image stubPageTable;
+  vk::UniqueSampler pageCacheSampler;
+  vk::UniqueSampler pageTableSampler;
+};
+
+} // namespace scene
+
+#endif
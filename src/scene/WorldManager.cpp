@@ -0,0 +1,531 @@
+#include "WorldManager.hpp"
+#include "util/Hash.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace scene
+{
+
+static uint64_t get_cell_key(int32_t x, int32_t z)
+{
+  return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(z));
+}
+
+static int32_t get_cell(float coord, float cell_size)
+{
+  return int32_t(std::floor(coord / cell_size));
+}
+
+static float get_distance(const glm::vec3 &pos, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max)
+{
+  return glm::length(glm::max(glm::max(bounds_min - pos, pos - bounds_max), glm::vec3(0.f)));
+}
+
+// textures of different tiles with the same key share a single image
+static uint64_t get_image_key(const TextureData &texture, bool srgb)
+{
+  uint64_t key = util::hash_bytes(texture.getLevelData(0));
+  key = util::hash_combine(key, uint64_t(texture.format));
+  key = util::hash_combine(key, (uint64_t(texture.width) << 32) | texture.height);
+  key = util::hash_combine(key, texture.levels.size());
+  return util::hash_combine(key, srgb ? 1 : 0);
+}
+
+std::vector<WorldTile> load_world_index(const std::string &path)
+{
+  std::ifstream file {path};
+  ETNA_ASSERTF(file.is_open(), "World : failed to open {}", path);
+  auto dir = std::filesystem::path(path).parent_path();
+
+  std::vector<WorldTile> tiles;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream stream {line};
+    std::string tilePath;
+    if (!(stream >> tilePath) || tilePath.starts_with('#'))
+      continue;
+
+    WorldTile tile {.path = (dir / tilePath).string()};
+    auto &lo = tile.boundsMin;
+    auto &hi = tile.boundsMax;
+    if (stream >> lo.x >> lo.y >> lo.z >> hi.x >> hi.y >> hi.z)
+    {
+      tiles.push_back(std::move(tile));
+      continue;
+    }
+
+    // only the JSON is parsed, buffers are mapped and never touched
+    auto gltf = open_gltf_file(tile.path);
+    if (!get_scene_bounds(gltf.model, lo, hi))
+    {
+      spdlog::warn("World : {} has no position bounds, skipped", tile.path);
+      continue;
+    }
+    tiles.push_back(std::move(tile));
+  }
+
+  spdlog::info("World : {} tiles listed in {}", tiles.size(), path);
+  return tiles;
+}
+
+WorldManager::WorldManager(std::vector<WorldTile> world_tiles, const SceneLoadOptions &load_options,
+  const WorldConfig &world_config)
+  : options {load_options}, config {world_config}, vertexPool {config.vertexPoolSize}, indexPool {config.indexPoolSize}
+{
+  ETNA_ASSERT(config.loadRadius <= config.unloadRadius && config.cellSize > 0.f);
+  // draw call offsets are 32 bit
+  ETNA_ASSERT(config.vertexPoolSize <= UINT32_MAX && config.indexPoolSize <= UINT32_MAX);
+
+  // the merged scene changes with every tile, a streamer would have to follow it
+  options.streamTextures = false;
+
+  tiles.reserve(world_tiles.size());
+  for (auto &desc : world_tiles)
+  {
+    uint32_t tileId = uint32_t(tiles.size());
+    for (int32_t x = get_cell(desc.boundsMin.x, config.cellSize); x <= get_cell(desc.boundsMax.x, config.cellSize); x++)
+      for (int32_t z = get_cell(desc.boundsMin.z, config.cellSize); z <= get_cell(desc.boundsMax.z, config.cellSize); z++)
+        grid[get_cell_key(x, z)].push_back(tileId);
+
+    tiles.push_back(Tile {.desc = std::move(desc)});
+  }
+  stats.tiles = uint32_t(tiles.size());
+
+  auto &ctx = etna::get_context();
+  scene = std::make_unique<GLTFScene>();
+  scene->vertexBuffer = ctx.createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(Vertex) * config.vertexPoolSize,
+    .bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  scene->indexBuffer = ctx.createBuffer(etna::Buffer::CreateInfo {
+    .size = sizeof(uint32_t) * config.indexPoolSize,
+    .bufferUsage = vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst
+  });
+
+  // renderers bind sampler 0 with the stub texture
+  vk::SamplerCreateInfo defaultSampler {
+    .magFilter = vk::Filter::eLinear,
+    .minFilter = vk::Filter::eLinear,
+    .mipmapMode = vk::SamplerMipmapMode::eLinear,
+    .addressModeU = vk::SamplerAddressMode::eRepeat,
+    .addressModeV = vk::SamplerAddressMode::eRepeat,
+    .addressModeW = vk::SamplerAddressMode::eRepeat,
+    .maxLod = VK_LOD_CLAMP_NONE
+  };
+  getSamplerId(defaultSampler);
+
+  // recorded on the first update
+  imageSlots.push_back(ImageSlot {});
+  scene->images.emplace_back();
+
+  spdlog::info("World : {} tiles in {} grid cells, geometry pools of {} MiB vertices and {} MiB indices",
+    tiles.size(), grid.size(), (sizeof(Vertex) * config.vertexPoolSize) >> 20,
+    (sizeof(uint32_t) * config.indexPoolSize) >> 20);
+}
+
+WorldManager::~WorldManager()
+{
+  for (auto &tile : tiles)
+  {
+    if (tile.preparing.valid())
+      tile.preparing.wait();
+  }
+
+  // shared buffers, images and staging may still be read by frames in flight
+  if (stubRecorded)
+    etna::get_context().getQueue().waitIdle();
+}
+
+std::vector<uint32_t> WorldManager::queryTiles(const glm::vec3 &camera_pos, float radius)
+{
+  std::vector<uint32_t> found;
+  for (int32_t x = get_cell(camera_pos.x - radius, config.cellSize); x <= get_cell(camera_pos.x + radius, config.cellSize); x++)
+  {
+    for (int32_t z = get_cell(camera_pos.z - radius, config.cellSize); z <= get_cell(camera_pos.z + radius, config.cellSize); z++)
+    {
+      auto it = grid.find(get_cell_key(x, z));
+      if (it == grid.end())
+        continue;
+
+      for (auto tileId : it->second)
+      {
+        auto &tile = tiles[tileId];
+        if (std::exchange(tile.queryFrame, frameIndex) == frameIndex)
+          continue;
+        tile.distance = get_distance(camera_pos, tile.desc.boundsMin, tile.desc.boundsMax);
+        found.push_back(tileId);
+      }
+    }
+  }
+  return found;
+}
+
+void WorldManager::update(etna::SyncCommandBuffer &cmd, const glm::vec3 &camera_pos)
+{
+  frameIndex++;
+
+  // ranges and image slots are reused only once frames that read them are done
+  uint32_t framesInFlight = etna::get_context().getNumFramesInFlight();
+  while (!retired.empty() && retired.front().frame + framesInFlight <= frameIndex)
+  {
+    auto &entry = retired.front();
+    if (entry.vertexCount)
+      vertexPool.free(entry.firstVertex, entry.vertexCount);
+    if (entry.indexCount)
+      indexPool.free(entry.firstIndex, entry.indexCount);
+    if (entry.imageSlot)
+      freeImageSlots.push_back(*entry.imageSlot);
+    retired.pop_front();
+  }
+
+  if (!std::exchange(stubRecorded, true))
+  {
+    scene->stubTexture = record_stub_texture(cmd);
+    scene->images[0] = record_stub_texture(cmd);
+  }
+
+  bool changed = false;
+  uint32_t preparingCount = 0;
+
+  for (size_t i = 0; i < activeTiles.size();)
+  {
+    uint32_t tileId = activeTiles[i];
+    auto &tile = tiles[tileId];
+    tile.distance = get_distance(camera_pos, tile.desc.boundsMin, tile.desc.boundsMax);
+
+    if (tile.state == TileState::Preparing && tile.preparing.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+      tile.prepared = tile.preparing.get();
+      tile.state = TileState::Prepared;
+    }
+
+    // preparation can not be cancelled, a tile that left the radius is dropped once it is done
+    if (tile.state == TileState::Preparing || tile.distance <= config.unloadRadius)
+    {
+      preparingCount += tile.state == TileState::Preparing ? 1 : 0;
+      i++;
+      continue;
+    }
+
+    if (tile.state == TileState::Resident)
+    {
+      releaseTile(tileId);
+      changed = true;
+    }
+
+    tile.prepared = {};
+    tile.uploadDeferred = false;
+    tile.state = TileState::Unloaded;
+    activeTiles[i] = activeTiles.back();
+    activeTiles.pop_back();
+  }
+
+  std::vector<uint32_t> candidates;
+  for (auto tileId : queryTiles(camera_pos, config.loadRadius))
+  {
+    if (tiles[tileId].state == TileState::Unloaded && tiles[tileId].distance <= config.loadRadius)
+      candidates.push_back(tileId);
+  }
+
+  auto nearer = [&](uint32_t a, uint32_t b) { return tiles[a].distance < tiles[b].distance; };
+  std::sort(candidates.begin(), candidates.end(), nearer);
+
+  for (auto tileId : candidates)
+  {
+    if (preparingCount >= config.maxConcurrentLoads)
+      break;
+
+    auto &tile = tiles[tileId];
+    tile.state = TileState::Preparing;
+    tile.preparing = std::async(std::launch::async, [path = tile.desc.path, options = options]() {
+      PreparedTile prepared {.scene = prepare_scene(path, options)};
+      const auto &textures = prepared.scene->textures;
+      prepared.imageKeys.resize(textures.size());
+      for (uint32_t imageId = 0; imageId < textures.size(); imageId++)
+      {
+        if (textures[imageId].has_value())
+          prepared.imageKeys[imageId] = get_image_key(*textures[imageId], prepared.scene->srgbImages[imageId]);
+      }
+      return prepared;
+    });
+
+    activeTiles.push_back(tileId);
+    preparingCount++;
+  }
+
+  std::vector<uint32_t> uploads;
+  for (auto tileId : activeTiles)
+  {
+    if (tiles[tileId].state == TileState::Prepared)
+      uploads.push_back(tileId);
+  }
+  std::sort(uploads.begin(), uploads.end(), nearer);
+
+  uint32_t uploaded = 0;
+  for (auto tileId : uploads)
+  {
+    if (uploaded >= config.maxTileUploadsPerFrame)
+      break;
+    if (uploadTile(cmd, tileId))
+    {
+      changed = true;
+      uploaded++;
+    }
+  }
+
+  if (changed)
+    rebuildScene();
+
+  stats.residentTiles = 0;
+  stats.loadingTiles = 0;
+  for (auto tileId : activeTiles)
+  {
+    if (tiles[tileId].state == TileState::Resident)
+      stats.residentTiles++;
+    else
+      stats.loadingTiles++;
+  }
+  stats.images = uint32_t(imageSlotsByKey.size());
+  stats.vertexPoolUsed = vertexPool.getUsed();
+  stats.indexPoolUsed = indexPool.getUsed();
+  stats.vertexFreeRanges = vertexPool.getFreeRangesCount();
+  stats.indexFreeRanges = indexPool.getFreeRangesCount();
+}
+
+bool WorldManager::uploadTile(etna::SyncCommandBuffer &cmd, uint32_t tile_id)
+{
+  auto &tile = tiles[tile_id];
+  auto &prepared = *tile.prepared.scene;
+
+  uint64_t vertexCount = prepared.vertices.size();
+  uint64_t indexCount = prepared.indices.size();
+  auto firstVertex = vertexCount ? vertexPool.allocate(vertexCount) : std::optional<uint64_t> {0};
+  auto firstIndex = indexCount ? indexPool.allocate(indexCount) : std::optional<uint64_t> {0};
+
+  if (!firstVertex || !firstIndex)
+  {
+    if (firstVertex && vertexCount)
+      vertexPool.free(*firstVertex, vertexCount);
+    if (firstIndex && indexCount)
+      indexPool.free(*firstIndex, indexCount);
+
+    if (!std::exchange(tile.uploadDeferred, true))
+      spdlog::warn("World : no room for {} ({} vertices, {} indices) in the geometry pools, waiting for unloads",
+        tile.desc.path, vertexCount, indexCount);
+    return false;
+  }
+
+  auto resident = std::make_unique<ResidentTile>();
+  resident->firstVertex = *firstVertex;
+  resident->vertexCount = vertexCount;
+  resident->firstIndex = *firstIndex;
+  resident->indexCount = indexCount;
+
+  std::vector<etna::Buffer> staging;
+  auto copyToPool = [&](std::span<const uint8_t> bytes, const etna::Buffer &dst, uint64_t dst_offset) {
+    auto buffer = etna::get_context().createBuffer(etna::Buffer::CreateInfo {
+      .size = bytes.size(),
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU
+    });
+
+    auto ptr = buffer.map();
+    std::memcpy(ptr, bytes.data(), bytes.size());
+    buffer.unmap();
+
+    cmd.copyBuffer(buffer, dst, {vk::BufferCopy{.srcOffset = 0, .dstOffset = dst_offset, .size = bytes.size()}});
+    staging.push_back(std::move(buffer));
+  };
+
+  if (vertexCount)
+  {
+    copyToPool({reinterpret_cast<const uint8_t*>(prepared.vertices.data()), sizeof(Vertex) * vertexCount},
+      scene->vertexBuffer, sizeof(Vertex) * *firstVertex);
+  }
+
+  if (indexCount)
+  {
+    copyToPool({reinterpret_cast<const uint8_t*>(prepared.indices.data()), sizeof(uint32_t) * indexCount},
+      scene->indexBuffer, sizeof(uint32_t) * *firstIndex);
+  }
+
+  // indices stay relative to the draw call vertex offset
+  resident->meshes = std::move(prepared.meshes);
+  for (auto &mesh : resident->meshes)
+  {
+    for (auto &drawCall : mesh.drawCalls)
+    {
+      drawCall.firstIndex += uint32_t(*firstIndex);
+      drawCall.vertexOffset += uint32_t(*firstVertex);
+    }
+  }
+
+  for (uint32_t imageId = 0; imageId < prepared.textures.size(); imageId++)
+  {
+    resident->imageSlots.push_back(
+      acquireImageSlot(cmd, prepared, imageId, tile.prepared.imageKeys[imageId], staging));
+  }
+
+  std::vector<uint32_t> samplerIds;
+  for (const auto &info : prepared.samplers)
+    samplerIds.push_back(getSamplerId(info));
+
+  // textures without an image or sampler get the stub and the default sampler
+  for (auto [imageId, samplerId] : prepared.imageSamplers)
+  {
+    resident->imageSamplers.push_back({
+      imageId < resident->imageSlots.size() ? resident->imageSlots[imageId] : 0,
+      samplerId < samplerIds.size() ? samplerIds[samplerId] : 0
+    });
+  }
+
+  resident->nodes = std::move(prepared.nodes);
+  resident->rootNodes = std::move(prepared.rootNodes);
+  resident->materials = std::move(prepared.materials);
+
+  for (auto &buffer : staging)
+    retired.push_back(Retired {.frame = frameIndex, .staging = std::move(buffer)});
+
+  tile.resident = std::move(resident);
+  tile.prepared = {};
+  tile.uploadDeferred = false;
+  tile.state = TileState::Resident;
+  return true;
+}
+
+uint32_t WorldManager::acquireImageSlot(etna::SyncCommandBuffer &cmd, const PreparedScene &prepared,
+  uint32_t image_id, uint64_t key, std::vector<etna::Buffer> &staging)
+{
+  const auto &texture = prepared.textures[image_id];
+  if (!texture.has_value())
+    return 0;
+
+  if (auto it = imageSlotsByKey.find(key); it != imageSlotsByKey.end())
+  {
+    imageSlots[it->second].refs++;
+    stats.sharedImageRefs++;
+    return it->second;
+  }
+
+  uint32_t slot = uint32_t(imageSlots.size());
+  if (!freeImageSlots.empty())
+  {
+    slot = freeImageSlots.back();
+    freeImageSlots.pop_back();
+  }
+  else
+  {
+    imageSlots.emplace_back();
+    scene->images.emplace_back();
+  }
+
+  scene->images[slot] = upload_texture(cmd, *texture, 0, prepared.srgbImages[image_id], options.mipGenerator, staging);
+  imageSlots[slot] = ImageSlot {.key = key, .refs = 1};
+  imageSlotsByKey.emplace(key, slot);
+  return slot;
+}
+
+uint32_t WorldManager::getSamplerId(const vk::SamplerCreateInfo &info)
+{
+  auto it = std::find(samplerInfos.begin(), samplerInfos.end(), info);
+  if (it != samplerInfos.end())
+    return uint32_t(it - samplerInfos.begin());
+
+  samplerInfos.push_back(info);
+  scene->samplers.emplace_back(etna::get_context().getDevice().createSamplerUnique(info).value);
+  return uint32_t(samplerInfos.size() - 1);
+}
+
+void WorldManager::releaseTile(uint32_t tile_id)
+{
+  auto resident = std::move(tiles[tile_id].resident);
+
+  // frames in flight may still draw the tile, its ranges and images are reused once they are done
+  retired.push_back(Retired {
+    .frame = frameIndex,
+    .firstVertex = resident->firstVertex,
+    .vertexCount = resident->vertexCount,
+    .firstIndex = resident->firstIndex,
+    .indexCount = resident->indexCount
+  });
+
+  for (auto slot : resident->imageSlots)
+  {
+    if (slot == 0 || --imageSlots[slot].refs > 0)
+      continue;
+
+    imageSlotsByKey.erase(imageSlots[slot].key);
+    retired.push_back(Retired {
+      .frame = frameIndex,
+      .image = std::exchange(scene->images[slot], etna::Image {}),
+      .imageSlot = slot
+    });
+  }
+}
+
+void WorldManager::rebuildScene()
+{
+  scene->meshes.clear();
+  scene->nodes.clear();
+  scene->rootNodes.clear();
+  scene->materials.clear();
+  scene->imageSamplers.clear();
+
+  for (auto tileId : activeTiles)
+  {
+    if (tiles[tileId].state != TileState::Resident)
+      continue;
+
+    const auto &tile = *tiles[tileId].resident;
+    uint32_t meshBase = uint32_t(scene->meshes.size());
+    uint32_t nodeBase = uint32_t(scene->nodes.size());
+    uint32_t materialBase = uint32_t(scene->materials.size());
+    uint32_t textureBase = uint32_t(scene->imageSamplers.size());
+
+    for (auto mesh : tile.meshes)
+    {
+      for (auto &drawCall : mesh.drawCalls)
+        drawCall.materialId += materialBase;
+      scene->meshes.push_back(std::move(mesh));
+    }
+
+    for (auto node : tile.nodes)
+    {
+      if (node.meshIndex.has_value())
+        *node.meshIndex += meshBase;
+      for (auto &childId : node.childNodes)
+        childId += nodeBase;
+      scene->nodes.push_back(std::move(node));
+    }
+
+    for (auto rootId : tile.rootNodes)
+      scene->rootNodes.push_back(rootId + nodeBase);
+
+    for (auto material : tile.materials)
+    {
+      for (auto texId : {&material.baseColorId, &material.metallicRoughnessId, &material.normalTexId, &material.occlusionTexId})
+      {
+        if (texId->has_value())
+          **texId += textureBase;
+      }
+      scene->materials.push_back(material);
+    }
+
+    scene->imageSamplers.insert(scene->imageSamplers.end(), tile.imageSamplers.begin(), tile.imageSamplers.end());
+  }
+
+  scene->initTransforms();
+  generation++;
+}
+
+} // namespace scene
@@ -0,0 +1,181 @@
+#ifndef SCENE_WORLD_MANAGER_HPP_INCLUDED
+#define SCENE_WORLD_MANAGER_HPP_INCLUDED
+
+#include "GLTFScene.hpp"
+#include "util/RangeAllocator.hpp"
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <unordered_map>
+
+namespace scene
+{
+
+struct WorldTile
+{
+  std::string path;
+  glm::vec3 boundsMin {0.f}; // world space
+  glm::vec3 boundsMax {0.f};
+};
+
+// Tile list of a .world file. One tile per line: the glTF path relative to the file, optionally
+// followed by its world space bounds "minX minY minZ maxX maxY maxZ". Bounds of tiles without them
+// are read from the glTF accessors. Empty lines and lines starting with # are skipped.
+std::vector<WorldTile> load_world_index(const std::string &path);
+
+struct WorldConfig
+{
+  // tiles closer to the camera than loadRadius are loaded and unloaded once they are farther than
+  // unloadRadius, the gap keeps tiles at the border from being reloaded on every step
+  float loadRadius = 150.f;
+  float unloadRadius = 200.f;
+
+  float cellSize = 64.f; // XZ cell of the tile grid
+
+  uint32_t maxConcurrentLoads = 2; // tiles prepared on worker threads at once
+  uint32_t maxTileUploadsPerFrame = 1;
+
+  // shared geometry pools, in elements
+  uint64_t vertexPoolSize = 8ull << 20;
+  uint64_t indexPoolSize = 32ull << 20;
+};
+
+// Streams a world split into glTF tiles around the camera.
+//  - Tiles are indexed by bounds in a uniform XZ grid, update() only looks at cells around the camera.
+//  - Tiles within loadRadius are prepared with prepare_scene on worker threads, nearest first, and
+//    uploaded into the frame command buffer. Resident tiles beyond unloadRadius are released.
+//  - Geometry of all tiles lives in one vertex and one index buffer, sub-allocated per tile. Images with
+//    identical content are shared between tiles, freed image slots are reused.
+//  - Resident tiles are merged into a single GLTFScene. It is rebuilt when the tile set changes,
+//    getGeneration() changes with it and renderers have to be re-attached then.
+// Textures are uploaded whole, the merged scene has no TextureStreamer or virtual texture sources.
+struct WorldManager
+{
+  struct Stats
+  {
+    uint32_t tiles = 0;
+    uint32_t residentTiles = 0;
+    uint32_t loadingTiles = 0; // preparing or waiting for upload
+    uint32_t images = 0; // resident, shared images count once
+    uint32_t sharedImageRefs = 0; // tile images that reused a resident image instead of an upload, in total
+    uint64_t vertexPoolUsed = 0;
+    uint64_t indexPoolUsed = 0;
+    uint32_t vertexFreeRanges = 0;
+    uint32_t indexFreeRanges = 0;
+  };
+
+  WorldManager(std::vector<WorldTile> world_tiles, const SceneLoadOptions &options, const WorldConfig &config = {});
+  ~WorldManager(); // waits for tile preparation, and for the GPU if tiles were uploaded
+
+  WorldManager(const WorldManager &) = delete;
+  WorldManager &operator=(const WorldManager &) = delete;
+
+  // Picks tiles to load and unload around camera_pos and records tile uploads into cmd
+  void update(etna::SyncCommandBuffer &cmd, const glm::vec3 &camera_pos);
+
+  GLTFScene &getScene() { return *scene; }
+  const GLTFScene &getScene() const { return *scene; }
+  uint64_t getGeneration() const { return generation; }
+
+  const Stats &getStats() const { return stats; }
+  const WorldConfig &getConfig() const { return config; }
+
+private:
+  enum class TileState
+  {
+    Unloaded,
+    Preparing,
+    Prepared, // waiting for upload
+    Resident
+  };
+
+  struct PreparedTile
+  {
+    std::unique_ptr<PreparedScene> scene;
+    std::vector<uint64_t> imageKeys; // content hashes of the prepared textures
+  };
+
+  // CPU side of a resident tile, draw calls already point into the shared buffers
+  struct ResidentTile
+  {
+    std::vector<GLTFScene::Mesh> meshes;
+    std::vector<GLTFScene::Node> nodes;
+    std::vector<uint32_t> rootNodes;
+    std::vector<GLTFScene::Material> materials;
+    std::vector<std::tuple<uint32_t, uint32_t>> imageSamplers; // world image and sampler ids
+
+    uint64_t firstVertex = 0;
+    uint64_t vertexCount = 0;
+    uint64_t firstIndex = 0;
+    uint64_t indexCount = 0;
+    std::vector<uint32_t> imageSlots; // referenced world images
+  };
+
+  struct Tile
+  {
+    WorldTile desc;
+    TileState state = TileState::Unloaded;
+    float distance = 0.f; // to the camera, as of the last update
+    uint64_t queryFrame = 0;
+    bool uploadDeferred = false; // the geometry pools had no room for it
+
+    std::future<PreparedTile> preparing;
+    PreparedTile prepared;
+    std::unique_ptr<ResidentTile> resident;
+  };
+
+  struct ImageSlot
+  {
+    uint64_t key = 0;
+    uint32_t refs = 0;
+  };
+
+  struct Retired
+  {
+    uint64_t frame;
+    etna::Buffer staging;
+    etna::Image image;
+    std::optional<uint32_t> imageSlot;
+    uint64_t firstVertex = 0;
+    uint64_t vertexCount = 0;
+    uint64_t firstIndex = 0;
+    uint64_t indexCount = 0;
+  };
+
+  std::vector<uint32_t> queryTiles(const glm::vec3 &camera_pos, float radius);
+  bool uploadTile(etna::SyncCommandBuffer &cmd, uint32_t tile_id);
+  void releaseTile(uint32_t tile_id);
+  uint32_t acquireImageSlot(etna::SyncCommandBuffer &cmd, const PreparedScene &prepared, uint32_t image_id,
+    uint64_t key, std::vector<etna::Buffer> &staging);
+  uint32_t getSamplerId(const vk::SamplerCreateInfo &info);
+  void rebuildScene();
+
+  SceneLoadOptions options;
+  WorldConfig config;
+  std::vector<Tile> tiles;
+
+  // tile ids per XZ cell, tiles are listed in every cell their bounds overlap
+  std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+
+  std::unique_ptr<GLTFScene> scene;
+  util::RangeAllocator vertexPool;
+  util::RangeAllocator indexPool;
+
+  std::vector<ImageSlot> imageSlots; // indexed like scene->images, slot 0 is the stub for unsupported images
+  std::vector<uint32_t> freeImageSlots;
+  std::unordered_map<uint64_t, uint32_t> imageSlotsByKey;
+  std::vector<vk::SamplerCreateInfo> samplerInfos; // indexed like scene->samplers, 0 is the default
+
+  std::vector<uint32_t> activeTiles; // not unloaded
+  std::deque<Retired> retired;
+  uint64_t frameIndex = 0;
+  uint64_t generation = 0;
+  bool stubRecorded = false;
+
+  Stats stats;
+};
+
+} // namespace scene
+
+#endif
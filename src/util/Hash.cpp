@@ -0,0 +1,62 @@
+#include "Hash.hpp"
+
+#include <cstring>
+
+namespace util
+{
+
+static constexpr uint64_t PRIME_1 = 0x9e3779b185ebca87ull;
+static constexpr uint64_t PRIME_2 = 0xc2b2ae3d27d4eb4full;
+
+static uint64_t rotl(uint64_t v, int r)
+{
+  return (v << r) | (v >> (64 - r));
+}
+
+static uint64_t mix(uint64_t acc, uint64_t v)
+{
+  acc += v * PRIME_2;
+  acc = rotl(acc, 31);
+  return acc * PRIME_1;
+}
+
+uint64_t hash_bytes(std::span<const uint8_t> bytes, uint64_t seed)
+{
+  // four independent lanes over 32 byte stripes, then a scalar tail
+  uint64_t lanes[4] {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+
+  const uint8_t *ptr = bytes.data();
+  size_t size = bytes.size();
+
+  for (; size >= 32; ptr += 32, size -= 32)
+  {
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+      uint64_t v;
+      std::memcpy(&v, ptr + 8 * lane, 8);
+      lanes[lane] = mix(lanes[lane], v);
+    }
+  }
+
+  uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+  h += bytes.size();
+
+  for (; size >= 8; ptr += 8, size -= 8)
+  {
+    uint64_t v;
+    std::memcpy(&v, ptr, 8);
+    h = rotl(h ^ mix(0, v), 27) * PRIME_1 + PRIME_2;
+  }
+
+  for (; size > 0; ptr++, size--)
+    h = rotl(h ^ (uint64_t(*ptr) * PRIME_1), 11) * PRIME_2;
+
+  h ^= h >> 33;
+  h *= PRIME_2;
+  h ^= h >> 29;
+  h *= PRIME_1;
+  h ^= h >> 32;
+  return h;
+}
+
+} // namespace util
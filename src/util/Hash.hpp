@@ -0,0 +1,20 @@
+#ifndef UTIL_HASH_HPP_INCLUDED
+#define UTIL_HASH_HPP_INCLUDED
+
+#include <cstdint>
+#include <span>
+
+namespace util
+{
+
+// 64 bit non-cryptographic hash of a byte range, for content addressed caches
+uint64_t hash_bytes(std::span<const uint8_t> bytes, uint64_t seed = 0);
+
+inline uint64_t hash_combine(uint64_t h, uint64_t v)
+{
+  return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 12) + (h >> 4));
+}
+
+} // namespace util
+
+#endif
@@ -0,0 +1,65 @@
+#include "Memory.hpp"
+
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace util
+{
+
+// reads a "Name:   value kB" line of /proc/self/status
+static uint64_t read_status_kib(const char *name)
+{
+  FILE *status = std::fopen("/proc/self/status", "r");
+  if (!status)
+    return 0;
+
+  char line[256];
+  uint64_t value = 0;
+  size_t nameLength = std::strlen(name);
+  while (std::fgets(line, sizeof(line), status))
+  {
+    if (std::strncmp(line, name, nameLength) == 0)
+    {
+      unsigned long long kib = 0;
+      if (std::sscanf(line + nameLength, " %llu", &kib) == 1)
+        value = uint64_t(kib) * 1024;
+      break;
+    }
+  }
+  std::fclose(status);
+  return value;
+}
+
+uint64_t get_peak_rss()
+{
+  // VmHWM follows reset_peak_rss, ru_maxrss does not
+  if (uint64_t hwm = read_status_kib("VmHWM:"))
+    return hwm;
+
+  rusage usage {};
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return uint64_t(usage.ru_maxrss) * 1024; // KiB on Linux
+}
+
+uint64_t get_rss()
+{
+  return read_status_kib("VmRSS:");
+}
+
+bool reset_peak_rss()
+{
+  // "5" resets the peak RSS of the process, Linux 4.0+
+  int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  bool reset = write(fd, "5", 1) == 1;
+  close(fd);
+  return reset;
+}
+
+} // namespace util
@@ -0,0 +1,21 @@
+#ifndef UTIL_MEMORY_HPP_INCLUDED
+#define UTIL_MEMORY_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace util
+{
+
+// peak resident set size of the process in bytes (VmHWM), 0 if unavailable
+uint64_t get_peak_rss();
+
+// current resident set size in bytes (VmRSS), 0 if unavailable
+uint64_t get_rss();
+
+// Resets the peak to the current RSS so get_peak_rss measures a single phase.
+// Returns false if the kernel does not allow it, the peak then keeps growing from process start.
+bool reset_peak_rss();
+
+} // namespace util
+
+#endif
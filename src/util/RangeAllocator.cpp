@@ -0,0 +1,85 @@
+#include "RangeAllocator.hpp"
+
+#include <etna/Etna.hpp>
+
+#include <algorithm>
+
+namespace util
+{
+
+RangeAllocator::RangeAllocator(uint64_t pool_size)
+  : size {pool_size}
+{
+  if (size)
+    freeRanges.emplace(0, size);
+}
+
+std::optional<uint64_t> RangeAllocator::allocate(uint64_t range_size)
+{
+  if (range_size == 0)
+    return std::nullopt;
+
+  auto best = freeRanges.end();
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); it++)
+  {
+    if (it->second >= range_size && (best == freeRanges.end() || it->second < best->second))
+    {
+      best = it;
+      if (best->second == range_size)
+        break;
+    }
+  }
+
+  if (best == freeRanges.end())
+    return std::nullopt;
+
+  auto [offset, freeSize] = *best;
+  freeRanges.erase(best);
+  if (freeSize > range_size)
+    freeRanges.emplace(offset + range_size, freeSize - range_size);
+
+  used += range_size;
+  return offset;
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t range_size)
+{
+  if (range_size == 0)
+    return;
+
+  ETNA_ASSERT(offset + range_size <= size && range_size <= used);
+  used -= range_size;
+
+  auto next = freeRanges.lower_bound(offset);
+  ETNA_ASSERT(next == freeRanges.end() || offset + range_size <= next->first);
+
+  if (next != freeRanges.begin())
+  {
+    auto prev = std::prev(next);
+    ETNA_ASSERT(prev->first + prev->second <= offset);
+    if (prev->first + prev->second == offset)
+    {
+      offset = prev->first;
+      range_size += prev->second;
+      freeRanges.erase(prev);
+    }
+  }
+
+  if (next != freeRanges.end() && offset + range_size == next->first)
+  {
+    range_size += next->second;
+    freeRanges.erase(next);
+  }
+
+  freeRanges.emplace(offset, range_size);
+}
+
+uint64_t RangeAllocator::getLargestFree() const
+{
+  uint64_t largest = 0;
+  for (auto [offset, rangeSize] : freeRanges)
+    largest = std::max(largest, rangeSize);
+  return largest;
+}
+
+} // namespace util
@@ -0,0 +1,34 @@
+#ifndef UTIL_RANGE_ALLOCATOR_HPP_INCLUDED
+#define UTIL_RANGE_ALLOCATOR_HPP_INCLUDED
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+namespace util
+{
+
+// Sub-allocates ranges of a fixed size pool, e.g. elements of a shared GPU buffer. Best fit over
+// a free list ordered by offset, freed ranges are merged with their free neighbours.
+struct RangeAllocator
+{
+  explicit RangeAllocator(uint64_t pool_size = 0);
+
+  // nullopt if no free range fits range_size
+  std::optional<uint64_t> allocate(uint64_t range_size);
+  void free(uint64_t offset, uint64_t range_size);
+
+  uint64_t getSize() const { return size; }
+  uint64_t getUsed() const { return used; }
+  uint64_t getLargestFree() const;
+  uint32_t getFreeRangesCount() const { return uint32_t(freeRanges.size()); }
+
+private:
+  std::map<uint64_t, uint64_t> freeRanges; // offset -> size
+  uint64_t size = 0;
+  uint64_t used = 0;
+};
+
+} // namespace util
+
+#endif
@@ -0,0 +1,95 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace util
+{
+
+ThreadPool::ThreadPool(uint32_t threads_count)
+{
+  workers.reserve(threads_count);
+  for (uint32_t i = 0; i < threads_count; i++)
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard guard {lock};
+    stop = true;
+  }
+  wakeup.notify_all();
+
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+  {
+    std::lock_guard guard {lock};
+    tasks.push_back(std::move(task));
+  }
+  wakeup.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+  while (true)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock guard {lock};
+      wakeup.wait(guard, [&]() { return stop || !tasks.empty(); });
+      if (stop && tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)> &fn)
+{
+  if (count == 0)
+    return;
+
+  struct LoopState
+  {
+    std::atomic<uint32_t> next {0};
+    std::atomic<uint32_t> completed {0};
+  };
+
+  // helpers may be scheduled after the loop is finished, they only touch the shared state then
+  auto state = std::make_shared<LoopState>();
+  const uint32_t total = count;
+
+  auto runItems = [state, total, &fn]() {
+    for (uint32_t i = state->next++; i < total; i = state->next++)
+    {
+      fn(i);
+      if (++state->completed == total)
+        state->completed.notify_all();
+    }
+  };
+
+  uint32_t helpers = std::min(getThreadsCount(), count - 1);
+  for (uint32_t i = 0; i < helpers; i++)
+    submit(runItems);
+
+  runItems();
+
+  for (uint32_t done = state->completed.load(); done != total; done = state->completed.load())
+    state->completed.wait(done);
+}
+
+ThreadPool &get_thread_pool()
+{
+  static ThreadPool pool {std::max(std::thread::hardware_concurrency(), 2u) - 1u};
+  return pool;
+}
+
+} // namespace util
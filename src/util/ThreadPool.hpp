@@ -0,0 +1,46 @@
+#ifndef UTIL_THREAD_POOL_HPP_INCLUDED
+#define UTIL_THREAD_POOL_HPP_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace util
+{
+
+struct ThreadPool
+{
+  explicit ThreadPool(uint32_t threads_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+
+  // Runs fn(i) for every i in [0, count). The calling thread takes part in the loop,
+  // so it is safe to call from a pool thread and it returns only when every item is done.
+  void parallelFor(uint32_t count, const std::function<void(uint32_t)> &fn);
+
+  uint32_t getThreadsCount() const { return uint32_t(workers.size()); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  bool stop = false;
+};
+
+// shared pool for asset loading, hardware_concurrency - 1 workers
+ThreadPool &get_thread_pool();
+
+} // namespace util
+
+#endif